@@ -0,0 +1,59 @@
+
+#include "Benchmark.hpp"
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+
+#include <cstdio>
+
+
+Benchmark::Benchmark(int minTime, QString const& filter) :
+    mMinTime(minTime),
+    mFilter(filter),
+    mResults()
+{
+}
+
+bool Benchmark::enabled(QString const& name) const {
+    return mFilter.isEmpty() || name.contains(mFilter);
+}
+
+void Benchmark::run(QString const& name, QString const& module, QString const& unit, Function const& fn) {
+    if (!enabled(name)) {
+        return;
+    }
+
+    // warm-up, fills caches and lets lazy initialization happen
+    fn();
+
+    qint64 const minTime = (qint64)mMinTime * 1000000;
+    double work = 0.0;
+    int iterations = 0;
+    QElapsedTimer timer;
+    timer.start();
+    qint64 elapsed;
+    do {
+        work += fn();
+        ++iterations;
+        elapsed = timer.nsecsElapsed();
+    } while (elapsed < minTime);
+
+    auto const seconds = elapsed / 1e9;
+    auto const throughput = work / seconds;
+
+    mResults.append(QJsonObject{
+        { "name", name },
+        { "module", module },
+        { "iterations", iterations },
+        { "seconds", seconds },
+        { "value", throughput },
+        { "unit", unit + QStringLiteral("/s") }
+    });
+
+    // progress goes to stderr, stdout may be the JSON output
+    fprintf(stderr, "%-20s %-48s %14.1f %s/s\n", qPrintable(name), qPrintable(module), throughput, qPrintable(unit));
+}
+
+QJsonArray const& Benchmark::results() const {
+    return mResults;
+}
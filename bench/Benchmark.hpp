@@ -0,0 +1,51 @@
+#pragma once
+
+#include <QJsonArray>
+#include <QString>
+
+#include <functional>
+
+//
+// Minimal benchmark harness. A benchmark's function is called repeatedly
+// until a minimum amount of time has elapsed, and its throughput is recorded
+// as a JSON object in the results array.
+//
+class Benchmark {
+
+public:
+
+    //
+    // Runs one iteration of a benchmark, returning the amount of work done
+    // in the benchmark's unit (ie frames rendered, rows drawn).
+    //
+    using Function = std::function<double()>;
+
+    //
+    // minTime is the minimum time, in milliseconds, to run each benchmark.
+    // Only benchmarks whose name contains filter are run, all are run if
+    // filter is empty.
+    //
+    explicit Benchmark(int minTime, QString const& filter);
+
+    //
+    // Returns true if the benchmark with the given name passes the filter.
+    // Use this to skip costly setup for benchmarks that will not be run.
+    //
+    bool enabled(QString const& name) const;
+
+    //
+    // Runs and records a benchmark. The first iteration is a warm-up and is
+    // not timed. Throughput is reported as work per second, with unit being
+    // the unit of work.
+    //
+    void run(QString const& name, QString const& module, QString const& unit, Function const& fn);
+
+    QJsonArray const& results() const;
+
+private:
+
+    int mMinTime;
+    QString mFilter;
+    QJsonArray mResults;
+
+};
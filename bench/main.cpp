@@ -0,0 +1,326 @@
+
+#include "Benchmark.hpp"
+
+#include "clipboard/PatternClip.hpp"
+#include "config/data/Palette.hpp"
+#include "core/Module.hpp"
+#include "core/ModuleFile.hpp"
+#include "export/WavExporter.hpp"
+#include "graphics/PatternLayout.hpp"
+#include "graphics/PatternPainter.hpp"
+#include "version.hpp"
+
+#include "trackerboy/apu/DefaultApu.hpp"
+#include "trackerboy/engine/Engine.hpp"
+#include "trackerboy/note.hpp"
+#include "trackerboy/Synth.hpp"
+
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFontDatabase>
+#include <QGuiApplication>
+#include <QImage>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPainter>
+#include <QTemporaryDir>
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#define TU benchTU
+namespace TU {
+
+static constexpr int EXIT_BAD_ARGUMENTS = 1;
+static constexpr int EXIT_SETUP_FAILED = 2;
+
+static constexpr int SAMPLERATE = 44100;
+// frames rendered per iteration of the engine benchmark, 10 seconds at 60 Hz
+static constexpr int ENGINE_FRAMES = 600;
+// seconds of audio exported per iteration of the export benchmark
+static constexpr int EXPORT_SECONDS = 10;
+
+static constexpr int SYNTHETIC_PATTERNS = 16;
+static constexpr int SYNTHETIC_ROWS = 64;
+
+struct BenchModule {
+    QString name;
+    std::unique_ptr<Module> mod;
+};
+
+//
+// Creates a module with every row of every track filled, which is the worst
+// case for both the engine and the pattern painter.
+//
+static std::unique_ptr<Module> createSyntheticModule() {
+    auto mod = std::make_unique<Module>();
+    auto &data = mod->data();
+    data.instrumentTable().insert();
+    data.waveformTable().insert();
+
+    auto &song = *data.songs().get(0);
+    song.patterns().setLength(SYNTHETIC_ROWS);
+    auto &order = song.order();
+    while ((int)order.size() < SYNTHETIC_PATTERNS) {
+        order.insert((int)order.size(), order.nextUnused());
+    }
+
+    for (int ch = 0; ch < 4; ++ch) {
+        auto const chType = static_cast<trackerboy::ChType>(ch);
+        for (int id = 0; id < SYNTHETIC_PATTERNS; ++id) {
+            auto &track = song.patterns().getTrack(chType, (uint8_t)id);
+            for (int row = 0; row < SYNTHETIC_ROWS; ++row) {
+                auto const note = trackerboy::NOTE_C + trackerboy::OCTAVE_3 + (row + ch * 7 + id) % 48;
+                track.setNote((uint16_t)row, (uint8_t)note);
+                track.setInstrument((uint16_t)row, 0);
+                track.setEffect((uint16_t)row, 0, trackerboy::EffectType::vibrato, 0x24);
+                track.setEffect((uint16_t)row, 1, trackerboy::EffectType::setPanning, 0x11);
+                track.setEffect((uint16_t)row, 2, trackerboy::EffectType::arpeggio, 0x37);
+            }
+        }
+    }
+
+    return mod;
+}
+
+static std::vector<BenchModule> loadModules(QString const& examplesDir) {
+    std::vector<BenchModule> modules;
+    modules.push_back({ QStringLiteral("synthetic"), createSyntheticModule() });
+
+    if (examplesDir.isEmpty()) {
+        return modules;
+    }
+
+    QDir dir(examplesDir);
+    for (auto const& entry : dir.entryInfoList({ QStringLiteral("*.tbm") }, QDir::Files, QDir::Name)) {
+        auto mod = std::make_unique<Module>();
+        ModuleFile file;
+        if (file.open(entry.filePath(), *mod)) {
+            modules.push_back({ entry.fileName(), std::move(mod) });
+        } else {
+            fprintf(stderr, "skipping %s: could not open module\n", qPrintable(entry.fileName()));
+        }
+    }
+    return modules;
+}
+
+//
+// Engine::step + Synth::run + Apu::readSamples, the same work the renderer
+// does for every frame of playback.
+//
+static void benchEngine(Benchmark &bench, BenchModule &bm) {
+    auto &data = bm.mod->data();
+    trackerboy::DefaultApu apu;
+    trackerboy::Synth synth(apu, SAMPLERATE, data.framerate());
+    trackerboy::Engine engine(apu, &data);
+    engine.setSong(data.songs().get(0));
+    engine.play(0, 0);
+
+    auto const framesize = synth.framesize();
+    auto buffer = std::make_unique<float[]>(framesize * 2);
+    trackerboy::Frame frame;
+
+    bench.run(QStringLiteral("engine_synth"), bm.name, QStringLiteral("frames"), [&]() {
+        for (int i = 0; i < ENGINE_FRAMES; ++i) {
+            engine.step(frame);
+            if (frame.halted) {
+                engine.play(0, 0);
+            }
+            synth.run();
+            apu.readSamples(buffer.get(), framesize);
+        }
+        return (double)ENGINE_FRAMES;
+    });
+}
+
+//
+// End-to-end export of the first song, reported as seconds of audio per
+// second, ie the realtime factor.
+//
+static void benchExport(Benchmark &bench, BenchModule &bm, QTemporaryDir const& tempDir) {
+    auto const filename = tempDir.filePath(QStringLiteral("export.wav"));
+    bench.run(QStringLiteral("wav_export"), bm.name, QStringLiteral("audio_s"), [&]() {
+        WavExporter exporter(bm.mod->data(), SAMPLERATE);
+        exporter.setDuration(std::chrono::seconds(EXPORT_SECONDS));
+        exporter.setDestination(filename);
+        exporter.setMaxThreads(1);
+        exporter.start();
+        exporter.wait();
+        return (double)EXPORT_SECONDS;
+    });
+}
+
+static void benchPaint(Benchmark &bench, BenchModule &bm) {
+    auto song = bm.mod->data().songs().get(0);
+    auto const pattern = song->getPattern(0);
+    auto const rows = (int)song->patterns().length();
+
+    PatternPainter painter(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    painter.setColors(Palette());
+    PatternLayout layout;
+    layout.setCellSize(painter.cellWidth(), painter.cellHeight());
+
+    QImage image(
+        layout.patternStart() + layout.rowWidth(),
+        rows * painter.cellHeight() + 1,
+        QImage::Format_ARGB32_Premultiplied
+    );
+
+    bench.run(QStringLiteral("pattern_paint"), bm.name, QStringLiteral("rows"), [&]() {
+        image.fill(Qt::transparent);
+        QPainter p(&image);
+        painter.drawPattern(p, layout, pattern, 0, rows - 1, 0);
+        return (double)rows;
+    });
+}
+
+static void benchClip(Benchmark &bench, BenchModule &bm) {
+    auto song = bm.mod->data().songs().get(0);
+    auto pattern = song->getPattern(0);
+    auto const rows = (int)song->patterns().length();
+    PatternSelection const all(
+        PatternAnchor(0, PatternAnchor::SelectNote, 0),
+        PatternAnchor(rows - 1, PatternAnchor::SelectEffect3, 3)
+    );
+
+    PatternClip clip;
+    bench.run(QStringLiteral("pattern_clip_save"), bm.name, QStringLiteral("ops"), [&]() {
+        clip.save(pattern, all);
+        return 1.0;
+    });
+
+    clip.save(pattern, all);
+    bench.run(QStringLiteral("pattern_clip_restore"), bm.name, QStringLiteral("ops"), [&]() {
+        clip.restore(pattern);
+        return 1.0;
+    });
+    bench.run(QStringLiteral("pattern_clip_paste"), bm.name, QStringLiteral("ops"), [&]() {
+        clip.paste(pattern, PatternCursor(0, 0, 0), false);
+        return 1.0;
+    });
+    bench.run(QStringLiteral("pattern_clip_mix"), bm.name, QStringLiteral("ops"), [&]() {
+        clip.paste(pattern, PatternCursor(0, 0, 0), true);
+        return 1.0;
+    });
+}
+
+static void benchModuleFile(Benchmark &bench, BenchModule &bm, QTemporaryDir const& tempDir) {
+    auto const filename = tempDir.filePath(QStringLiteral("module.tbm"));
+
+    bench.run(QStringLiteral("module_save"), bm.name, QStringLiteral("files"), [&]() {
+        ModuleFile file;
+        file.save(filename, *bm.mod);
+        return 1.0;
+    });
+
+    ModuleFile saved;
+    if (!saved.save(filename, *bm.mod)) {
+        return;
+    }
+    Module loaded;
+    bench.run(QStringLiteral("module_open"), bm.name, QStringLiteral("files"), [&]() {
+        ModuleFile file;
+        file.open(filename, loaded);
+        return 1.0;
+    });
+}
+
+}
+
+
+int main(int argc, char *argv[]) {
+
+    // the pattern painter needs a QGuiApplication, but no display
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    QGuiApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("bench_trackerboy"));
+    QCoreApplication::setApplicationVersion(VERSION_STR);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Trackerboy benchmark suite, results are written as JSON"));
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    QCommandLineOption outputOption(
+        { "o", "output" },
+        QStringLiteral("File to write results to, defaults to stdout"),
+        QStringLiteral("file")
+    );
+    QCommandLineOption filterOption(
+        "filter",
+        QStringLiteral("Only run benchmarks whose name contains the given text"),
+        QStringLiteral("text")
+    );
+    QCommandLineOption minTimeOption(
+        "min-time",
+        QStringLiteral("Minimum time to run each benchmark, in milliseconds"),
+        QStringLiteral("ms"),
+        QStringLiteral("1000")
+    );
+    QCommandLineOption examplesOption(
+        "examples",
+        QStringLiteral("Directory of modules to benchmark in addition to the synthetic module"),
+        QStringLiteral("dir"),
+        QStringLiteral(BENCH_EXAMPLES_DIR)
+    );
+    QCommandLineOption syntheticOnlyOption("synthetic-only", QStringLiteral("Only benchmark the synthetic module"));
+    parser.addOptions({ outputOption, filterOption, minTimeOption, examplesOption, syntheticOnlyOption });
+    parser.process(app);
+
+    bool ok;
+    auto const minTime = parser.value(minTimeOption).toInt(&ok);
+    if (!ok || minTime < 1) {
+        fputs("invalid minimum time\n", stderr);
+        return TU::EXIT_BAD_ARGUMENTS;
+    }
+
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid()) {
+        fputs("could not create temporary directory\n", stderr);
+        return TU::EXIT_SETUP_FAILED;
+    }
+
+    auto modules = TU::loadModules(parser.isSet(syntheticOnlyOption) ? QString() : parser.value(examplesOption));
+
+    Benchmark bench(minTime, parser.value(filterOption));
+    for (auto &bm : modules) {
+        TU::benchEngine(bench, bm);
+        if (bench.enabled(QStringLiteral("wav_export"))) {
+            TU::benchExport(bench, bm, tempDir);
+        }
+        TU::benchPaint(bench, bm);
+        TU::benchClip(bench, bm);
+        TU::benchModuleFile(bench, bm, tempDir);
+    }
+
+    QJsonObject root{
+        { "version", QString::fromLatin1(VERSION_STR) },
+        { "revision", QString::fromLatin1(GIT_SHA1) },
+        { "qt", QString::fromLatin1(qVersion()) },
+        { "timestamp", QDateTime::currentDateTimeUtc().toString(Qt::ISODate) },
+        { "minTimeMs", minTime },
+        { "benchmarks", bench.results() }
+    };
+    auto const json = QJsonDocument(root).toJson();
+
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size()) {
+            fprintf(stderr, "could not write to %s\n", qPrintable(file.fileName()));
+            return TU::EXIT_SETUP_FAILED;
+        }
+    } else {
+        fwrite(json.constData(), 1, (size_t)json.size(), stdout);
+    }
+
+    return 0;
+}
+
+#undef TU
@@ -2,6 +2,7 @@
 #include "audio/AudioEnumerator.hpp"
 
 #include <QCoreApplication>
+#include <QMutexLocker>
 #include <QtDebug>
 
 #include <array>
@@ -38,45 +39,37 @@ void logCallback(void *pUserData, ma_uint32 logLevel, const char* message) {
     }() << "[Miniaudio]" << msgFixed.c_str();
 }
 
+//
+// Deleter for contexts, contexts are shared with the devices using them so
+// the last owner uninitializes it.
+//
+struct ContextDeleter {
+    bool initialized;
+
+    void operator()(ma_context *context) const {
+        if (initialized) {
+            ma_context_uninit(context);
+        }
+        delete context;
+    }
+};
+
 }
 
 
 AudioEnumerator::Context::Context(ma_backend backend) :
     mContext(),
     mInitialized(false),
+    mPopulated(false),
     mBackend(backend),
     mDevices()
 {
 }
 
-AudioEnumerator::Context::~Context() {
-    if (mContext != nullptr && mInitialized) {
-        ma_context_uninit(mContext.get());
-    }
-}
-
 ma_backend AudioEnumerator::Context::backend() const {
     return mBackend;
 }
 
-//
-// Gets the miniaudio context for this backend
-//
-ma_context* AudioEnumerator::Context::get() {
-    if (mContext == nullptr) {
-        // lazy loading
-        mContext = std::make_shared<ma_context>();
-        probe();
-    }
-
-
-    return mContext.get();
-}
-
-ma_context* AudioEnumerator::Context::get() const {
-    return mContext.get();
-}
-
 std::shared_ptr<ma_context> AudioEnumerator::Context::getShared() const {
     return mContext;
 }
@@ -120,45 +113,53 @@ int AudioEnumerator::Context::devices() const {
     return (int)mDevices.size() + 1;
 }
 
-//
-// Probe all devices in the miniaudio context, updating ids and names
-//
-void AudioEnumerator::Context::probe() {
-    if (mContext == nullptr) {
-        get(); // get calls probe when allocating context
-        return;
-    }
+bool AudioEnumerator::Context::populated() const {
+    return mPopulated;
+}
 
-    if (!mInitialized) {
-        // context not initialized, attempt to do so and log error on failure
+void AudioEnumerator::Context::probe(QMutex &mutex) {
+    // only probes modify the context, and they are done one at a time, so
+    // it can be read here without the mutex
+    auto context = mContext;
 
+    if (!mInitialized) {
+        // lazy loading, the context is initialized on first probe. Attempt to
+        // do so and log error on failure
+        auto newContext = std::make_unique<ma_context>();
         auto config = ma_context_config_init();
-        auto result = ma_context_init(&mBackend, 1, &config, mContext.get());
-        if (result == MA_SUCCESS) {
-            mInitialized = true;
-            // register logging callback
-            auto logResult = ma_log_register_callback(
-                ma_context_get_log(mContext.get()),
-                ma_log_callback_init(TU::logCallback, nullptr)
-            );
-            Q_ASSERT(logResult == MA_SUCCESS);
-            Q_UNUSED(logResult)
-        } else {
+        auto result = ma_context_init(&mBackend, 1, &config, newContext.get());
+        if (result != MA_SUCCESS) {
             qCritical().nospace() << "Failed to initialize audio backend '"
                                   << ma_get_backend_name(mBackend) << "': "
                                   << ma_result_description(result);
             // no context, nothing to probe
+            QMutexLocker locker(&mutex);
+            mPopulated = true;
             return;
         }
 
-    }
+        // register logging callback
+        auto logResult = ma_log_register_callback(
+            ma_context_get_log(newContext.get()),
+            ma_log_callback_init(TU::logCallback, nullptr)
+        );
+        Q_ASSERT(logResult == MA_SUCCESS);
+        Q_UNUSED(logResult)
 
-    mDevices.clear();
-    auto result = ma_context_enumerate_devices(mContext.get(), enumerateCallback, this);
+        context = std::shared_ptr<ma_context>(newContext.release(), TU::ContextDeleter{ true });
+    }
 
+    std::vector<ma_device_info> devices;
+    auto result = ma_context_enumerate_devices(context.get(), enumerateCallback, &devices);
     if (result != MA_SUCCESS) {
-        mDevices.clear();
+        devices.clear();
     }
+
+    QMutexLocker locker(&mutex);
+    mContext = std::move(context);
+    mInitialized = true;
+    mPopulated = true;
+    mDevices = std::move(devices);
 }
 
 
@@ -170,21 +171,25 @@ ma_bool32 AudioEnumerator::Context::enumerateCallback(
 ) {
     Q_UNUSED(pContext)
     if (deviceType == ma_device_type_playback) {
-        static_cast<Context*>(pUserData)->enumerate(pInfo);
+        static_cast<std::vector<ma_device_info>*>(pUserData)->push_back(*pInfo);
     }
 
     return MA_TRUE;
 
 }
 
-void AudioEnumerator::Context::enumerate(ma_device_info const* info) {
-    mDevices.push_back(*info);
-}
-
 
 
-AudioEnumerator::AudioEnumerator()
+AudioEnumerator::AudioEnumerator(QObject *parent) :
+    QObject(parent),
+    mBackendNames(),
+    mMutex(),
+    mContexts(),
+    mProber()
 {
+    // one prober, so that probes of a backend never overlap
+    mProber.setMaxThreadCount(1);
+
     std::array<ma_backend, MA_BACKEND_COUNT> backendArr;
     size_t count;
     ma_get_enabled_backends(backendArr.data(), backendArr.size(), &count);
@@ -196,11 +201,16 @@ AudioEnumerator::AudioEnumerator()
     }
 }
 
+AudioEnumerator::~AudioEnumerator() {
+    mProber.waitForDone();
+}
+
 bool AudioEnumerator::backendIsAvailable(int backend) const {
     if (indexIsInvalid(backend)) {
         return false;
     }
 
+    QMutexLocker locker(&mMutex);
     return mContexts[backend].initialized();
 }
 
@@ -217,6 +227,7 @@ QStringList AudioEnumerator::deviceNames(int backend) const {
         return {};
     }
 
+    QMutexLocker locker(&mMutex);
     return mContexts[backend].deviceNames();
 }
 
@@ -225,17 +236,21 @@ int AudioEnumerator::devices(int backend) const {
         return 0;
     }
 
+    QMutexLocker locker(&mMutex);
     return mContexts[backend].devices();
 }
 
 AudioEnumerator::Device AudioEnumerator::device(int backend, int device) const {
     if (indexIsInvalid(backend)) {
-        return { nullptr, nullptr };
+        return { nullptr, std::nullopt };
     } else {
-        return {
-            mContexts[backend].getShared(),
-            mContexts[backend].id(device)
-        };
+        QMutexLocker locker(&mMutex);
+        auto const& context = mContexts[backend];
+        Device result{ context.getShared(), std::nullopt };
+        if (auto id = context.id(device); id != nullptr) {
+            result.id = *id;
+        }
+        return result;
     }
 }
 
@@ -244,7 +259,31 @@ void AudioEnumerator::populate(int backend) {
         return;
     }
 
-    mContexts[backend].probe();
+    // wait for any async probes, as only one probe can be done at a time
+    mProber.waitForDone();
+    mContexts[backend].probe(mMutex);
+}
+
+void AudioEnumerator::populateAsync(int backend) {
+    if (indexIsInvalid(backend)) {
+        return;
+    }
+
+    mProber.start([this, backend]() {
+        mContexts[backend].probe(mMutex);
+        QMetaObject::invokeMethod(this, [this, backend]() {
+            emit populated(backend);
+        }, Qt::QueuedConnection);
+    });
+}
+
+bool AudioEnumerator::isPopulated(int backend) const {
+    if (indexIsInvalid(backend)) {
+        return false;
+    }
+
+    QMutexLocker locker(&mMutex);
+    return mContexts[backend].populated();
 }
 
 QVariant AudioEnumerator::serializeDevice(int backend, int device) const {
@@ -252,6 +291,7 @@ QVariant AudioEnumerator::serializeDevice(int backend, int device) const {
         return {};
     }
 
+    QMutexLocker locker(&mMutex);
     auto id = mContexts[backend].id(device);
     if (id == nullptr) {
         // default device
@@ -276,11 +316,12 @@ int AudioEnumerator::deserializeDevice(int backend, const QVariant &data) const
     } else if (idData.size() != sizeof(ma_device_id)) {
         return -1;
     }
+    QMutexLocker locker(&mMutex);
     return mContexts[backend].findDevice(reinterpret_cast<ma_device_id const&>(*idData.data()));
 }
 
 bool AudioEnumerator::indexIsInvalid(int backendIndex) const {
-    return backendIndex < 0 || backendIndex > (int)mContexts.size();
+    return backendIndex < 0 || backendIndex >= (int)mContexts.size();
 }
 
 
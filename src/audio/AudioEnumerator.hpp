@@ -1,12 +1,16 @@
 
 #pragma once
 
+#include <QMutex>
+#include <QObject>
 #include <QStringList>
+#include <QThreadPool>
 #include <QVariant>
 
 #include "miniaudio.h"
 
 #include <memory>
+#include <optional>
 #include <vector>
 
 //
@@ -17,16 +21,29 @@
 // Index 0 is known as the "default device". The actual device used is determined by the backend,
 // and for some backends, allows automatic stream routing.
 //
-class AudioEnumerator {
+// Probing a backend can block for a long time (initializing PulseAudio or
+// ALSA for example), so populateAsync probes on a worker thread. The device
+// lists are swapped in once probed, every other method can be called while a
+// probe is in progress.
+//
+class AudioEnumerator : public QObject {
+
+    Q_OBJECT
 
 public:
 
     struct Device {
         std::shared_ptr<ma_context> context;
-        ma_device_id const* id;
+        // not set for the default device
+        std::optional<ma_device_id> id;
     };
 
-    explicit AudioEnumerator();
+    explicit AudioEnumerator(QObject *parent = nullptr);
+
+    //
+    // Waits for any probes in progress to finish.
+    //
+    ~AudioEnumerator();
 
 
     bool backendIsAvailable(int backend) const;
@@ -52,17 +69,30 @@ public:
    int devices(int backend) const;
 
     //
-    // Gets a reference to a device handle for the given device address.
-    // This handle is temporary and should be used immediately.
+    // Gets a device handle for the given device address. The handle keeps
+    // the backend's context alive and is not affected by later probes.
     //
     Device device(int backend, int device) const;
 
     //
     // Populates the device list for the given backend. To rescan for changes in the
-    // device list, call this method again.
+    // device list, call this method again. Blocks until the backend has
+    // been probed.
     //
     void populate(int backend);
 
+    //
+    // Same as populate, but probes the backend on a worker thread. The
+    // populated signal is emitted when done. Probes are performed in the
+    // order requested.
+    //
+    void populateAsync(int backend);
+
+    //
+    // Determines if the given backend has been populated at least once.
+    //
+    bool isPopulated(int backend) const;
+
     //
     // Serialize the device so that it can be uniquely identified. The
     // result of this function can be written to file using a QSettings.
@@ -76,7 +106,15 @@ public:
     //
     int deserializeDevice(int backend, QVariant const& data) const;
 
+signals:
+
+    //
+    // Emitted when a probe requested by populateAsync has completed.
+    //
+    void populated(int backend);
+
 private:
+    Q_DISABLE_COPY(AudioEnumerator)
 
     bool indexIsInvalid(int backendIndex) const;
 
@@ -88,17 +126,9 @@ private:
         explicit Context(ma_backend backend);
         Context(const Context&) = delete;
         Context(Context&&) = default;
-        ~Context();
 
         ma_backend backend() const;
 
-        //
-        // Gets the miniaudio context for this backend
-        //
-        ma_context* get();
-
-        ma_context* get() const;
-
         std::shared_ptr<ma_context> getShared() const;
 
         ma_device_id const* id(int deviceIndex) const;
@@ -111,15 +141,18 @@ private:
 
         int devices() const;
 
+        bool populated() const;
+
         //
-        // Probe all devices in the rtaudio handle, updating ids and names
+        // Probe all devices in the miniaudio context, updating ids and names.
+        // The context is initialized and enumerated without holding the
+        // mutex, it is only locked to store the results.
         //
-        void probe();
+        void probe(QMutex &mutex);
 
     private:
 
         static ma_bool32 enumerateCallback(ma_context* pContext, ma_device_type deviceType, const ma_device_info* pInfo, void* pUserData);
-        void enumerate(ma_device_info const* info);
 
         // a pointer is used for lazy loading
         // this way we only initialize the backends when they are used
@@ -128,6 +161,7 @@ private:
 
         std::shared_ptr<ma_context> mContext;
         bool mInitialized;
+        bool mPopulated;
         ma_backend const mBackend;
 
         std::vector<ma_device_info> mDevices;
@@ -136,6 +170,11 @@ private:
 
     QStringList mBackendNames;
 
+    // guards the contexts' results, probes are done without it
+    mutable QMutex mMutex;
     std::vector<Context> mContexts;
 
+    // probes backends, one at a time
+    QThreadPool mProber;
+
 };
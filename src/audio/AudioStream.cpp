@@ -16,6 +16,7 @@ static const char* LOG_PREFIX = "[AudioStream]";
 
 AudioStream::MaDeviceWrapper::MaDeviceWrapper() :
     mInitialized(false),
+    mContext(),
     mDevice()
 {
 }
@@ -26,14 +27,16 @@ AudioStream::MaDeviceWrapper::~MaDeviceWrapper() {
     }
 }
 
-ma_result AudioStream::MaDeviceWrapper::init(ma_context *ctx, ma_device_config const* config) {
-    auto result = ma_device_init(ctx, config, &mDevice);
+ma_result AudioStream::MaDeviceWrapper::init(std::shared_ptr<ma_context> ctx, ma_device_config const* config) {
+    mContext = std::move(ctx);
+    auto result = ma_device_init(mContext.get(), config, &mDevice);
     mInitialized = result == MA_SUCCESS;
     return result;
 }
 
 void AudioStream::MaDeviceWrapper::uninit() {
     ma_device_uninit(&mDevice);
+    mInitialized = false;
 }
 
 ma_device* AudioStream::MaDeviceWrapper::get() {
@@ -46,13 +49,30 @@ AudioStream::AudioStream(QObject *parent) :
     mEnabled(false),
     mRunning(false),
     mBuffer(),
-    mContext(),
     mDevice(),
     mPlaybackDelay(0),
+    mDeviceLatency(0),
+    mDeviceRenderCallback(nullptr),
+    mRenderData(nullptr),
+    mRequest(0),
+    mPreparing(false),
+    mPrepared(),
     mUnderruns(0),
-    mDraining(false)
+    mDraining(false),
+    mCallbackIntervals(),
+    mLastCallback(),
+    mWorker()
 {
+    // one worker, so that a device is never initialized while another one
+    // is being uninitialized
+    mWorker.setMaxThreadCount(1);
+}
 
+AudioStream::~AudioStream() {
+    // discard any prepare in progress
+    ++mRequest;
+    disable();
+    mWorker.waitForDone();
 }
 
 bool AudioStream::isEnabled() const {
@@ -67,14 +87,27 @@ unsigned AudioStream::underruns() const {
     return mUnderruns.load();
 }
 
-void AudioStream::resetUnderruns() {
+Histogram::Snapshot AudioStream::callbackIntervals() const {
+    return mCallbackIntervals.snapshot();
+}
+
+void AudioStream::resetStats() {
     mUnderruns = 0;
+    mCallbackIntervals.clear();
 }
 
 size_t AudioStream::bufferSize() const {
     return mBuffer.size();
 }
 
+size_t AudioStream::deviceLatency() const {
+    return mDeviceLatency;
+}
+
+size_t AudioStream::playbackDelay() const {
+    return mPlaybackDelay.load(std::memory_order_relaxed);
+}
+
 void AudioStream::setDraining(bool draining) {
     mDraining = draining;
 }
@@ -83,39 +116,118 @@ AudioRingbuffer::Writer AudioStream::writer() {
     return mBuffer.writer();
 }
 
-void AudioStream::open(AudioEnumerator::Device const& device, int samplerate, int latency) {
+void const* AudioStream::bufferData() const {
+    return mBuffer.data();
+}
+
+bool AudioStream::hasRenderCallback() const {
+    return mDeviceRenderCallback != nullptr;
+}
+
+void AudioStream::prepare(Settings const& settings) {
+    auto const request = ++mRequest;
+    mPreparing = true;
+
+    mWorker.start([this, request, settings]() {
+        if (request != mRequest) {
+            // superseded before we got to it
+            return;
+        }
+
+        auto pending = std::make_shared<PreparedDevice>();
+        pending->settings = settings;
+
+        auto deviceConfig = ma_device_config_init(ma_device_type_playback);
+        // always 32-bit float stereo format
+        deviceConfig.playback.format = ma_format_f32;
+        deviceConfig.playback.channels = 2;
+        deviceConfig.dataCallback = deviceDataCallback;
+        deviceConfig.stopCallback = deviceStopCallback;
+        deviceConfig.pUserData = this;
+        deviceConfig.sampleRate = settings.samplerate;
+        deviceConfig.playback.pDeviceID = settings.device.id ? &*settings.device.id : nullptr;
+        if (settings.renderCallback) {
+            // no playback buffer, the latency is the device's buffer size
+            deviceConfig.periodSizeInMilliseconds = (ma_uint32)settings.latency;
+            deviceConfig.performanceProfile = ma_performance_profile_low_latency;
+        }
+
+        // callbacks are not made until the device is started, which is only
+        // done after committing
+        auto device = std::make_unique<MaDeviceWrapper>();
+        auto result = device->init(settings.device.context, &deviceConfig);
+        if (result == MA_SUCCESS) {
+            pending->device = std::move(device);
+        } else {
+            qCritical().noquote()
+                << TU::LOG_PREFIX
+                << "could not initialize device:"
+                << ma_result_description(result);
+        }
+
+        QMetaObject::invokeMethod(this, [this, request, pending]() {
+            if (request != mRequest) {
+                // a newer request is in progress
+                release(std::move(pending->device));
+                return;
+            }
+
+            auto const success = pending->device != nullptr;
+            if (mPrepared) {
+                // the last prepared device was never committed
+                release(std::move(mPrepared->device));
+            }
+            mPrepared = std::make_unique<PreparedDevice>(std::move(*pending));
+            mPreparing = false;
+            emit prepared(success);
+        }, Qt::QueuedConnection);
+    });
+}
+
+bool AudioStream::isPreparing() const {
+    return mPreparing;
+}
+
+bool AudioStream::commit() {
+    if (!mPrepared) {
+        return isEnabled();
+    }
+
+    auto prepared = std::move(mPrepared);
 
     // get the current running state
-    // if we are running then we will have to start the newly opened stream
+    // if we are running then we will have to start the new device
     bool running = isRunning();
 
-    // must be disabled when changing settings
+    // must be disabled when changing settings, the old device is only
+    // stopped here, uninitializing it is left to the worker
     disable();
 
-    // update buffer size
-    mBuffer.init((size_t)(latency * samplerate / 1000));
-
-    auto deviceConfig = ma_device_config_init(ma_device_type_playback);
-    // always 32-bit float stereo format
-    deviceConfig.playback.format = ma_format_f32;
-    deviceConfig.playback.channels = 2;
-    deviceConfig.dataCallback = deviceDataCallback;
-    deviceConfig.stopCallback = deviceStopCallback;
-    deviceConfig.pUserData = this;
-    deviceConfig.sampleRate = samplerate;
-    deviceConfig.playback.pDeviceID = device.id;
-
-    mContext = device.context;
-    auto result = mDevice.init(mContext.get(), &deviceConfig);
-    if (result != MA_SUCCESS) {
-        handleError("could not initialize device:", result);
-        return;
+    if (prepared->device == nullptr) {
+        // failed to initialize, stay disabled
+        return false;
     }
 
+    auto const& settings = prepared->settings;
+    mDevice = std::move(prepared->device);
+    mDeviceRenderCallback = settings.renderCallback;
+    mRenderData = settings.renderData;
+
+    // update buffer size, the old buffer is freed
+    mBuffer.init((size_t)(settings.latency * settings.samplerate / 1000));
+
+    // the device's internal buffer, converted to our samplerate in case the
+    // device resamples
+    auto const& playback = mDevice->get()->playback;
+    mDeviceLatency = playback.internalSampleRate == 0 ? 0 :
+        (size_t)((uint64_t)playback.internalPeriodSizeInFrames * playback.internalPeriods *
+                 settings.samplerate / playback.internalSampleRate);
+
     mEnabled = true;
     if (running) {
         start();
     }
+    return isEnabled();
 }
 
 bool AudioStream::start() {
@@ -123,7 +235,9 @@ bool AudioStream::start() {
         mBuffer.reset();
         mPlaybackDelay = mBuffer.size();
         mDraining = false;
-        auto result = ma_device_start(mDevice.get());
+        // the first callback has no interval
+        mLastCallback = {};
+        auto result = ma_device_start(mDevice->get());
         if (result != MA_SUCCESS) {
             handleError("failed to start device:", result);
             return false;
@@ -138,7 +252,7 @@ bool AudioStream::stop() {
     if (isRunning()) {
         mRunning = false;
 
-        auto result = ma_device_stop(mDevice.get());
+        auto result = ma_device_stop(mDevice->get());
         if (result != MA_SUCCESS) {
             handleError("failed to stop device:", result);
             return false;
@@ -149,13 +263,31 @@ bool AudioStream::stop() {
 }
 
 void AudioStream::disable() {
-    mRunning = false;
+    bool const running = mRunning.exchange(false);
+    mDeviceLatency = 0;
     if (mEnabled) {
         mEnabled = false;
-        mDevice.uninit();
+        if (running) {
+            // stop here so that the callback is no longer called once we
+            // return, uninitializing is left to the worker
+            ma_device_stop(mDevice->get());
+        }
+        release(std::move(mDevice));
     }
 }
 
+void AudioStream::release(std::unique_ptr<MaDeviceWrapper> device) {
+    if (device == nullptr) {
+        return;
+    }
+
+    // uninitializing can block as long as initializing
+    std::shared_ptr<MaDeviceWrapper> shared(std::move(device));
+    mWorker.start([shared]() mutable {
+        shared.reset();
+    });
+}
+
 
 
 void AudioStream::deviceDataCallback(ma_device *device, void *out, const void *in, ma_uint32 frames) {
@@ -169,17 +301,34 @@ void AudioStream::deviceDataCallback(ma_device *device, void *out, const void *i
 
 void AudioStream::handleData(float *out, size_t frames) {
 
+    auto const now = std::chrono::steady_clock::now();
+    if (mLastCallback != std::chrono::steady_clock::time_point()) {
+        auto const interval = std::chrono::duration_cast<std::chrono::microseconds>(now - mLastCallback);
+        mCallbackIntervals.record((uint32_t)interval.count());
+    }
+    mLastCallback = now;
+
+    if (mDeviceRenderCallback) {
+        // render directly into the device's buffer, no playback delay needed
+        auto nrendered = mDeviceRenderCallback(mRenderData, out, frames);
+        if (nrendered < frames && !mDraining) {
+            ++mUnderruns;
+        }
+        return;
+    }
+
     // an entire buffer's worth of silence is played when the stream is started
     // this gives the us ample time to fill the buffer before playing from it.
     // Without this the output might be choppy at the start.
 
-    if (mPlaybackDelay) {
-        auto samples = std::min(mPlaybackDelay, frames);
+    auto const delay = mPlaybackDelay.load(std::memory_order_relaxed);
+    if (delay) {
+        auto samples = std::min(delay, frames);
         frames -= samples;
         // miniaudio clears the output buffer before calling the callback
         // so just seek the output pointer
         out += samples * 2;
-        mPlaybackDelay -= samples;
+        mPlaybackDelay.store(delay - samples, std::memory_order_relaxed);
     }
 
     auto nread = mBuffer.reader().fullRead(out, frames);
@@ -2,25 +2,64 @@
 
 #include "audio/AudioEnumerator.hpp"
 #include "audio/Ringbuffer.hpp"
+#include "utils/Histogram.hpp"
 
 #include "miniaudio.h"
 
 #include <QObject>
+#include <QThreadPool>
 
 #include <atomic>
+#include <chrono>
 #include <cstddef>
+#include <memory>
 
 //
 // AudioStream class. Manages a miniaudio device and a playback buffer for
 // asynchronous sound output.
 //
+// Devices are opened in two steps. prepare initializes the new device on a
+// worker thread, as this can block for hundreds of milliseconds with some
+// backends, while the current device keeps playing. Once prepared, commit
+// swaps in the new device on the GUI thread, which only has to stop the old
+// device and start the new one. Old devices are also uninitialized on the
+// worker.
+//
 class AudioStream : public QObject {
 
     Q_OBJECT
 
 public:
+
+    //
+    // Callback function for rendering audio directly in the device's
+    // callback. The function must fill the given buffer with the requested
+    // number of stereo samples and return the amount actually rendered.
+    //
+    using RenderCallback = size_t(*)(void *data, float *out, size_t frames);
+
+    //
+    // Settings for a device to be opened by prepare
+    //
+    struct Settings {
+        AudioEnumerator::Device device;
+        int samplerate;
+        // size of the playback buffer, or the device's period size when
+        // rendering via callback, in milliseconds
+        int latency;
+        // when set, the callback is called directly from the device's thread
+        // whenever it needs audio instead of using the playback buffer
+        RenderCallback renderCallback;
+        void *renderData;
+    };
+
     explicit AudioStream(QObject *parent = nullptr);
 
+    //
+    // Stops the stream and waits for the worker to finish.
+    //
+    ~AudioStream();
+
     //
     // Determines if the stream is enabled. If enabled, audio can be played
     // out by starting the stream and then writing to its buffer. The stream
@@ -43,31 +82,79 @@ public:
     //
     unsigned underruns() const;
 
+    //
+    // Gets a snapshot of the intervals, in microseconds, between calls to the
+    // device's callback.
+    //
+    Histogram::Snapshot callbackIntervals() const;
+
     //
     // Gets the size of the buffer, in samples. The size of the buffer is determined
     // by the latency parameter in open().
     //
     size_t bufferSize() const;
 
+    //
+    // Gets the output latency of the device, in samples: the amount of audio
+    // the device buffers internally before it is heard. Determined by
+    // open(), 0 if the stream is disabled.
+    //
+    size_t deviceLatency() const;
+
+    //
+    // Gets the number of samples of silence left to play before the device
+    // starts reading from the playback buffer. Thread-safe.
+    //
+    size_t playbackDelay() const;
+
     void setDraining(bool draining);
 
     //
-    // Resets the underrun counter to 0.
+    // Resets the underrun counter to 0 and clears the callback interval
+    // histogram.
+    //
+    void resetStats();
+
+    //
+    // Begins opening a device with the given settings on the worker thread.
+    // The current device is unaffected and keeps playing. The prepared signal
+    // is emitted when the device has been initialized, after which commit
+    // will use it. Requests not yet prepared are discarded by newer ones, so
+    // only the most recent request is prepared.
+    //
+    // NOTE: this function should only be called from the GUI thread
+    //
+    void prepare(Settings const& settings);
+
+    //
+    // Determines if a device is being prepared.
     //
-    void resetUnderruns();
+    bool isPreparing() const;
 
     //
-    // Opens an output stream for the configured device.
-    // On success the stream is enabled, and audio can now be played out. On
-    // failure the stream is disabled. If the stream was running when this
-    // function is called, it is stopped and then restarted.
+    // Replaces the current device with the prepared one. On success the
+    // stream is enabled, and audio can now be played out. On failure the
+    // stream is disabled. If the stream was running when this function is
+    // called, the old device is stopped and the new one is started. Does
+    // nothing if no device was prepared.
     //
     // NOTE: this function should only be called from the GUI thread
     //
-    void open(AudioEnumerator::Device const& device, int samplerate, int latency);
+    bool commit();
 
     AudioRingbuffer::Writer writer();
 
+    //
+    // Storage of the playback buffer, bufferSize() stereo samples. The
+    // buffer is reallocated by commit.
+    //
+    void const* bufferData() const;
+
+    //
+    // Determines if the stream is rendering via a callback.
+    //
+    bool hasRenderCallback() const;
+
     bool start();
 
     bool stop();
@@ -78,6 +165,13 @@ signals:
 
     void aborted();
 
+    //
+    // Emitted when the most recent call to prepare has completed. success
+    // is false if the device could not be initialized, committing it will
+    // disable the stream.
+    //
+    void prepared(bool success);
+
 private:
 
     static void deviceDataCallback(ma_device *device, void *out, const void *in, ma_uint32 frames);
@@ -90,7 +184,8 @@ private:
 
     //
     // Wrapper for a ma_device, ensures that the wrapped device is uninit'd on
-    // destruction.
+    // destruction. The device cannot be moved once initialized, so wrappers
+    // are only passed around by pointer.
     //
     class MaDeviceWrapper {
 
@@ -98,27 +193,63 @@ private:
         MaDeviceWrapper();
         ~MaDeviceWrapper();
 
-        ma_result init(ma_context *ctx, ma_device_config const* config);
+        ma_result init(std::shared_ptr<ma_context> ctx, ma_device_config const* config);
 
         void uninit();
 
         ma_device* get();
 
     private:
+        Q_DISABLE_COPY(MaDeviceWrapper)
+
         bool mInitialized;
+        // the context must outlive the device
+        std::shared_ptr<ma_context> mContext;
         ma_device mDevice;
     };
 
+    //
+    // A device initialized by the worker, waiting to be committed
+    //
+    struct PreparedDevice {
+        // nullptr if initialization failed
+        std::unique_ptr<MaDeviceWrapper> device;
+        Settings settings;
+    };
+
+    //
+    // Uninitializes the given device on the worker thread.
+    //
+    void release(std::unique_ptr<MaDeviceWrapper> device);
+
     bool mEnabled;
     std::atomic_bool mRunning;
     AudioRingbuffer mBuffer;
 
-    std::shared_ptr<ma_context> mContext;
-    MaDeviceWrapper mDevice;
-    size_t mPlaybackDelay;
+    std::unique_ptr<MaDeviceWrapper> mDevice;
+    std::atomic<size_t> mPlaybackDelay;
+    size_t mDeviceLatency;
+
+    // callback used by the current device, from the settings it was
+    // prepared with
+    RenderCallback mDeviceRenderCallback;
+    void *mRenderData;
+
+    // incremented for each prepare, so that stale requests are discarded
+    std::atomic_int mRequest;
+    bool mPreparing;
+    std::unique_ptr<PreparedDevice> mPrepared;
 
     std::atomic_uint mUnderruns;
     std::atomic_bool mDraining;
 
+    Histogram mCallbackIntervals;
+    // time of the last callback, only accessed by the device's thread while
+    // running
+    std::chrono::steady_clock::time_point mLastCallback;
+
+    // initializes and uninitializes devices, one at a time
+    QThreadPool mWorker;
+
 };
 
@@ -0,0 +1,126 @@
+
+#include "audio/ChannelTapApu.hpp"
+
+#define TU ChannelTapApuTU
+namespace TU {
+
+// panning register, bit n routes channel n to the right terminal and bit
+// n + 4 to the left
+constexpr uint8_t REG_NR51 = 0x25;
+
+}
+
+
+ChannelTapApu::ChannelTapApu(bool mix, unsigned channels) :
+    mMixEnabled(mix),
+    mChannelsEnabled(channels & 0xF),
+    mPanning(0),
+    mMix(),
+    mChannels()
+{
+}
+
+bool ChannelTapApu::isChannelEnabled(int channel) const noexcept {
+    return !!(mChannelsEnabled & (1u << channel));
+}
+
+trackerboy::DefaultApu* ChannelTapApu::firstEnabled() noexcept {
+    if (mMixEnabled) {
+        return &mMix;
+    }
+    for (int i = 0; i < CHANNELS; ++i) {
+        if (isChannelEnabled(i)) {
+            return &mChannels[i];
+        }
+    }
+    return nullptr;
+}
+
+template <class Fn>
+void ChannelTapApu::forEachEnabled(Fn fn) {
+    if (mMixEnabled) {
+        fn(mMix);
+    }
+    for (int i = 0; i < CHANNELS; ++i) {
+        if (isChannelEnabled(i)) {
+            fn(mChannels[i]);
+        }
+    }
+}
+
+void ChannelTapApu::step(uint32_t cycles) noexcept {
+    forEachEnabled([cycles](trackerboy::DefaultApu &apu) {
+        apu.step(cycles);
+    });
+}
+
+void ChannelTapApu::endFrame() noexcept {
+    forEachEnabled([](trackerboy::DefaultApu &apu) {
+        apu.endFrame();
+    });
+}
+
+void ChannelTapApu::reset() noexcept {
+    forEachEnabled([](trackerboy::DefaultApu &apu) {
+        apu.reset();
+    });
+    // no panning has been masked yet
+    auto const apu = firstEnabled();
+    mPanning = apu ? apu->readRegister(TU::REG_NR51) : 0;
+}
+
+void ChannelTapApu::setSamplerate(int rate) {
+    forEachEnabled([rate](trackerboy::DefaultApu &apu) {
+        apu.setSamplerate(rate);
+    });
+}
+
+void ChannelTapApu::setBuffer(size_t samples) {
+    forEachEnabled([samples](trackerboy::DefaultApu &apu) {
+        apu.setBuffer(samples);
+    });
+}
+
+size_t ChannelTapApu::samplesAvailable() noexcept {
+    return mMixEnabled ? mMix.samplesAvailable() : 0;
+}
+
+size_t ChannelTapApu::readSamples(float *buf, size_t samples) noexcept {
+    return mMixEnabled ? mMix.readSamples(buf, samples) : 0;
+}
+
+uint8_t ChannelTapApu::readRegister(uint8_t reg) noexcept {
+    if (reg == TU::REG_NR51) {
+        return mPanning;
+    }
+    // all other registers are the same in every enabled APU
+    auto const apu = firstEnabled();
+    return apu ? apu->readRegister(reg) : 0xFF;
+}
+
+void ChannelTapApu::writeRegister(uint8_t reg, uint8_t value) noexcept {
+    if (reg == TU::REG_NR51) {
+        mPanning = value;
+    }
+    if (mMixEnabled) {
+        mMix.writeRegister(reg, value);
+    }
+    for (int i = 0; i < CHANNELS; ++i) {
+        if (!isChannelEnabled(i)) {
+            continue;
+        }
+        auto channelValue = value;
+        if (reg == TU::REG_NR51) {
+            // keep this channel's panning only
+            channelValue &= (uint8_t)(0x11 << i);
+        }
+        mChannels[i].writeRegister(reg, channelValue);
+    }
+}
+
+size_t ChannelTapApu::readChannelSamples(int channel, float *buf, size_t samples) noexcept {
+    Q_ASSERT(channel >= 0 && channel < CHANNELS);
+    return isChannelEnabled(channel) ? mChannels[channel].readSamples(buf, samples) : 0;
+}
+
+#undef TU
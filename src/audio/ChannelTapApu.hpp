@@ -0,0 +1,81 @@
+#pragma once
+
+#include "trackerboy/apu/DefaultApu.hpp"
+#include "trackerboy/apu/IApu.hpp"
+
+#include <QtGlobal>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+//
+// APU with an output tap for each channel. Register writes from the engine
+// are fanned out to the mix APU and to four channel APUs, each of which has
+// the panning register (NR51) masked so that only its channel is heard. A
+// single engine and synth pass therefore produces the mix and the four
+// channel outputs, instead of running the engine once per channel.
+//
+// The IApu interface (readSamples, samplesAvailable) refers to the mix. Every
+// enabled output accumulates samples, so the taps must be read (or discarded)
+// along with the mix each frame.
+//
+// Outputs that are not needed can be left out so that they are not emulated:
+// when only the channel files are exported, the mix is disabled and reads
+// from it return no samples. Disabled channel taps do the same.
+//
+class ChannelTapApu : public trackerboy::IApu {
+
+public:
+
+    static constexpr int CHANNELS = 4;
+
+    //
+    // Constructs the APU with the mix enabled or not, and a tap for each
+    // channel set in channels (bit n for channel n).
+    //
+    explicit ChannelTapApu(bool mix = true, unsigned channels = 0xF);
+
+    virtual void step(uint32_t cycles) noexcept override;
+
+    virtual void endFrame() noexcept override;
+
+    virtual void reset() noexcept override;
+
+    virtual void setSamplerate(int rate) override;
+
+    virtual void setBuffer(size_t samples) override;
+
+    virtual size_t samplesAvailable() noexcept override;
+
+    virtual size_t readSamples(float *buf, size_t samples) noexcept override;
+
+    virtual uint8_t readRegister(uint8_t reg) noexcept override;
+
+    virtual void writeRegister(uint8_t reg, uint8_t value) noexcept override;
+
+    //
+    // Reads stereo samples of a single channel (0-3), panned as in the mix.
+    //
+    size_t readChannelSamples(int channel, float *buf, size_t samples) noexcept;
+
+private:
+
+    Q_DISABLE_COPY(ChannelTapApu)
+
+    bool isChannelEnabled(int channel) const noexcept;
+
+    trackerboy::DefaultApu* firstEnabled() noexcept;
+
+    template <class Fn>
+    void forEachEnabled(Fn fn);
+
+    bool mMixEnabled;
+    unsigned mChannelsEnabled;
+    // NR51 as written by the engine, the channel APUs only have their bits
+    uint8_t mPanning;
+
+    trackerboy::DefaultApu mMix;
+    std::array<trackerboy::DefaultApu, CHANNELS> mChannels;
+
+};
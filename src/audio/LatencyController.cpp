@@ -0,0 +1,84 @@
+
+#include "audio/LatencyController.hpp"
+
+#include <algorithm>
+#include <limits>
+
+
+LatencyController::LatencyController() :
+    mMin(0),
+    mMax(0),
+    mTarget(0),
+    mSamplerate(0),
+    mUnderruns(0),
+    mLowestFill(0),
+    mLongestPeriod(0),
+    mWindowTime(0),
+    mCooldown(MIN_COOLDOWN),
+    mCooldownLeft(0)
+{
+    startWindow();
+}
+
+void LatencyController::reset(size_t minTarget, size_t maxTarget, int samplerate) {
+    mMax = maxTarget;
+    mMin = std::min(minTarget, maxTarget);
+    mTarget = mMax;
+    mSamplerate = samplerate;
+    mCooldown = MIN_COOLDOWN;
+    mCooldownLeft = Duration::zero();
+    startWindow();
+}
+
+void LatencyController::restart(unsigned underruns) {
+    mUnderruns = underruns;
+    startWindow();
+}
+
+size_t LatencyController::update(size_t fill, unsigned underruns, Duration periodTime) {
+    if (underruns < mUnderruns) {
+        // the counter was reset
+        mUnderruns = underruns;
+    }
+
+    if (underruns != mUnderruns) {
+        mUnderruns = underruns;
+        // grow quickly, the underruns are audible
+        mTarget += (mMax - mTarget + 1) / 2;
+        mCooldownLeft = mCooldown;
+        mCooldown = std::min(mCooldown * 2, MAX_COOLDOWN);
+        startWindow();
+        return mTarget;
+    }
+
+    if (mCooldownLeft > Duration::zero()) {
+        mCooldownLeft -= periodTime;
+        return mTarget;
+    }
+
+    mLowestFill = std::min(mLowestFill, fill);
+    mLongestPeriod = std::max(mLongestPeriod, periodTime);
+    mWindowTime += periodTime;
+
+    if (mWindowTime >= WINDOW) {
+        // keep enough headroom for another period as long as the longest one
+        auto const margin = (size_t)(std::chrono::duration<double>(mLongestPeriod).count() * mSamplerate);
+        if (mLowestFill > margin) {
+            auto const shrink = std::min((mLowestFill - margin) / 2, mTarget);
+            mTarget = std::max(mMin, mTarget - shrink);
+        }
+        startWindow();
+    }
+
+    return mTarget;
+}
+
+size_t LatencyController::target() const {
+    return mTarget;
+}
+
+void LatencyController::startWindow() {
+    mLowestFill = std::numeric_limits<size_t>::max();
+    mLongestPeriod = Duration::zero();
+    mWindowTime = Duration::zero();
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <chrono>
+#include <cstddef>
+
+//
+// Adaptive sizing of the playback buffer. Instead of filling the playback
+// buffer completely every period, the render thread fills it up to a target
+// level. The controller adjusts the target at runtime, between a minimum and
+// the buffer's capacity, settling on the lowest level that does not underrun
+// under the current machine load:
+//
+//  * an underrun grows the target by half of the remaining range
+//  * if the buffer never dropped below a safety margin over a window of time,
+//    the target shrinks by half of the unused headroom. The margin is what
+//    the longest period in the window consumed, so that jitter is accounted
+//    for.
+//
+// Each underrun doubles the time waited before shrinking again, so that the
+// target stops oscillating once a stable level has been found.
+//
+// The controller is only bookkeeping, it is updated by the render thread
+// once per period. Since the buffer is not resized, changing the target never
+// requires reopening the device.
+//
+class LatencyController {
+
+public:
+
+    using Duration = std::chrono::nanoseconds;
+
+    // time measured before the target can shrink
+    static constexpr Duration WINDOW = std::chrono::seconds(1);
+    // time waited after the first underrun before shrinking
+    static constexpr Duration MIN_COOLDOWN = std::chrono::seconds(2);
+    // the cooldown doubles with each underrun, up to this amount
+    static constexpr Duration MAX_COOLDOWN = std::chrono::seconds(64);
+
+    LatencyController();
+
+    //
+    // Sets the bounds of the target, in samples. The target starts at the
+    // maximum and the cooldown is reset.
+    //
+    void reset(size_t minTarget, size_t maxTarget, int samplerate);
+
+    //
+    // Starts a new measurement, call when the buffer has been emptied (ie
+    // when rendering begins). The target is kept. underruns is the current
+    // count of underruns.
+    //
+    void restart(unsigned underruns);
+
+    //
+    // Updates the target with the measurements of a period: the buffer fill
+    // at the start of the period, the total count of underruns so far and
+    // the time since the previous period. Returns the new target.
+    //
+    size_t update(size_t fill, unsigned underruns, Duration periodTime);
+
+    //
+    // Target fill level of the playback buffer, in samples.
+    //
+    size_t target() const;
+
+private:
+
+    void startWindow();
+
+    size_t mMin;
+    size_t mMax;
+    size_t mTarget;
+    int mSamplerate;
+
+    // underrun count as of the last update
+    unsigned mUnderruns;
+
+    // measurements for the current window
+    size_t mLowestFill;
+    Duration mLongestPeriod;
+    Duration mWindowTime;
+
+    // time to wait after the next underrun
+    Duration mCooldown;
+    // time left to wait before measuring
+    Duration mCooldownLeft;
+
+};
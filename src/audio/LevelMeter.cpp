@@ -0,0 +1,130 @@
+
+#include "audio/LevelMeter.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// SSE2 is part of the x86-64 baseline, see SampleConverter
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LEVEL_METER_SSE2
+#include <emmintrin.h>
+#endif
+
+#define TU LevelMeterTU
+namespace TU {
+
+//
+// Stores the peak in dest, or the largest of it and dest's current value
+// when accumulating. Only the render thread writes dest.
+//
+static void storePeak(std::atomic<float> &dest, float peak, bool accumulate) {
+    if (accumulate) {
+        peak = std::max(peak, dest.load(std::memory_order_relaxed));
+    }
+    dest.store(peak, std::memory_order_relaxed);
+}
+
+}
+
+
+LevelMeter::LevelMeter() :
+    mPeak{ 0.0f, 0.0f },
+    mSumSquares{ 0.0, 0.0 },
+    mCount(0),
+    mSequence(0),
+    mPolled(0),
+    mPeakLeft(0.0f),
+    mPeakRight(0.0f),
+    mRmsLeft(0.0f),
+    mRmsRight(0.0f)
+{
+}
+
+void LevelMeter::measure(float const *samples, size_t count) {
+    size_t i = 0;
+
+    #ifdef LEVEL_METER_SSE2
+    // each vector holds two stereo samples: L R L R
+    auto const absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    auto vpeak = _mm_setzero_ps();
+    auto vsum = _mm_setzero_ps();
+    for (; i + 2 <= count; i += 2) {
+        auto const v = _mm_loadu_ps(samples + i * 2);
+        vpeak = _mm_max_ps(vpeak, _mm_and_ps(v, absMask));
+        vsum = _mm_add_ps(vsum, _mm_mul_ps(v, v));
+    }
+    // fold the upper sample onto the lower one
+    vpeak = _mm_max_ps(vpeak, _mm_movehl_ps(vpeak, vpeak));
+    vsum = _mm_add_ps(vsum, _mm_movehl_ps(vsum, vsum));
+
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, vpeak);
+    mPeak[0] = std::max(mPeak[0], lanes[0]);
+    mPeak[1] = std::max(mPeak[1], lanes[1]);
+    _mm_store_ps(lanes, vsum);
+    mSumSquares[0] += lanes[0];
+    mSumSquares[1] += lanes[1];
+    #endif
+
+    for (; i < count; ++i) {
+        auto const left = samples[i * 2];
+        auto const right = samples[i * 2 + 1];
+        mPeak[0] = std::max(mPeak[0], std::abs(left));
+        mPeak[1] = std::max(mPeak[1], std::abs(right));
+        mSumSquares[0] += left * left;
+        mSumSquares[1] += right * right;
+    }
+
+    mCount += count;
+}
+
+void LevelMeter::publish() {
+    if (mCount == 0) {
+        return;
+    }
+
+    // peaks are held until the poller has seen them, so that a peak between
+    // polls is not missed
+    auto const sequence = mSequence.load(std::memory_order_relaxed);
+    bool const accumulate = mPolled.load(std::memory_order_acquire) != sequence;
+    TU::storePeak(mPeakLeft, mPeak[0], accumulate);
+    TU::storePeak(mPeakRight, mPeak[1], accumulate);
+    mRmsLeft.store((float)std::sqrt(mSumSquares[0] / mCount), std::memory_order_relaxed);
+    mRmsRight.store((float)std::sqrt(mSumSquares[1] / mCount), std::memory_order_relaxed);
+    mSequence.store(sequence + 1, std::memory_order_release);
+
+    mPeak[0] = mPeak[1] = 0.0f;
+    mSumSquares[0] = mSumSquares[1] = 0.0;
+    mCount = 0;
+}
+
+void LevelMeter::reset() {
+    mPeak[0] = mPeak[1] = 0.0f;
+    mSumSquares[0] = mSumSquares[1] = 0.0;
+    mCount = 0;
+    mPeakLeft.store(0.0f, std::memory_order_relaxed);
+    mPeakRight.store(0.0f, std::memory_order_relaxed);
+    mRmsLeft.store(0.0f, std::memory_order_relaxed);
+    mRmsRight.store(0.0f, std::memory_order_relaxed);
+    mSequence.fetch_add(1, std::memory_order_release);
+}
+
+bool LevelMeter::poll(Levels &levels) {
+    auto const sequence = mSequence.load(std::memory_order_acquire);
+    if (sequence == mPolled.load(std::memory_order_relaxed)) {
+        return false;
+    }
+
+    // a publish made while reading is accumulated into the peaks read here,
+    // it is returned again by the next poll
+    levels = {
+        mPeakLeft.load(std::memory_order_relaxed),
+        mPeakRight.load(std::memory_order_relaxed),
+        mRmsLeft.load(std::memory_order_relaxed),
+        mRmsRight.load(std::memory_order_relaxed)
+    };
+    mPolled.store(sequence, std::memory_order_release);
+    return true;
+}
+
+#undef TU
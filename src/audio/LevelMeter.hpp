@@ -0,0 +1,86 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <cstddef>
+
+//
+// Peak and RMS metering of the rendered output. The render thread measures
+// each block of samples as it is rendered and publishes the levels once per
+// period through atomics. A meter in the GUI polls the levels at display
+// rate, neither side ever waits on the other.
+//
+// A period can be much longer than a displayed frame, so most polls find
+// nothing new. Each publish increments a sequence number, and a poll only
+// returns levels when it has changed. The poller acknowledges the sequence
+// it has seen: until then, the render thread keeps the peak published so far
+// and accumulates the next period into it, so a peak is never lost or
+// returned as 0 between publishes.
+//
+// Levels are linear amplitudes, where 1.0 is full scale.
+//
+class LevelMeter {
+
+public:
+
+    struct Levels {
+        // largest absolute sample since the last acknowledged poll
+        float peakLeft;
+        float peakRight;
+        // RMS of the most recently published period
+        float rmsLeft;
+        float rmsRight;
+    };
+
+    LevelMeter();
+
+    // Render thread =========================================================
+
+    //
+    // Measures the given block of interleaved stereo samples, count being
+    // the number of stereo samples. The levels are accumulated until publish
+    // is called.
+    //
+    void measure(float const *samples, size_t count);
+
+    //
+    // Publishes the levels measured since the last publish. Wait-free.
+    //
+    void publish();
+
+    //
+    // Resets all levels to 0, the next poll returns them. Only call when not
+    // rendering.
+    //
+    void reset();
+
+    // Poller ================================================================
+
+    //
+    // Gets the levels if they were published since the last poll, returning
+    // true. Otherwise false is returned and levels is not modified. Only one
+    // thread should poll.
+    //
+    bool poll(Levels &levels);
+
+private:
+    Q_DISABLE_COPY(LevelMeter)
+
+    // render thread only
+    float mPeak[2];
+    double mSumSquares[2];
+    size_t mCount;
+
+    // incremented by each publish (and reset)
+    std::atomic_uint32_t mSequence;
+    // last sequence seen by the poller
+    std::atomic_uint32_t mPolled;
+
+    // written by the render thread only
+    std::atomic<float> mPeakLeft;
+    std::atomic<float> mPeakRight;
+    std::atomic<float> mRmsLeft;
+    std::atomic<float> mRmsRight;
+
+};
@@ -6,11 +6,67 @@
 #include "trackerboy/engine/ChannelControl.hpp"
 
 #include <QMutexLocker>
+#include <QTimerEvent>
 #include <QtDebug>
 
+#include <algorithm>
+#include <limits>
 #include <ratio>
 
-//static auto LOG_PREFIX = "[Renderer]";
+#define TU RendererTU
+namespace TU {
+
+static auto LOG_PREFIX = "[Renderer]";
+
+//
+// Locks the mutex, or only attempts to if we cannot wait. Returns true if the
+// mutex was locked.
+//
+bool lockMutex(QMutex &mutex, bool wait) {
+    if (wait) {
+        mutex.lock();
+        return true;
+    } else {
+        return mutex.tryLock();
+    }
+}
+
+//
+// MidiPreview is packed into a single atomic, one byte per field. track and
+// id are offset by 1 so that -1 is stored as 0.
+//
+static uint32_t packPreview(Renderer::MidiPreview preview) {
+    return (uint32_t)(preview.type & 0xFF) |
+           ((uint32_t)((preview.track + 1) & 0xFF) << 8) |
+           ((uint32_t)((preview.id + 1) & 0xFF) << 16);
+}
+
+static Renderer::MidiPreview unpackPreview(uint32_t packed) {
+    return {
+        (Renderer::MidiPreview::Type)(packed & 0xFF),
+        (int)((packed >> 8) & 0xFF) - 1,
+        (int)((packed >> 16) & 0xFF) - 1
+    };
+}
+
+// MIDI notes older than this when taken by the render thread are dropped
+static constexpr auto MIDI_STALE_TIME = std::chrono::milliseconds(250);
+
+// interval, in milliseconds, at which the GUI checks if the render thread
+// has stopped itself. Output is already silent once it has, this only delays
+// closing the stream.
+static constexpr int STOP_POLL_INTERVAL = 10;
+
+template <class Duration>
+uint32_t toMicroseconds(Duration duration) {
+    auto const us = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    if (us < 0) {
+        return 0;
+    }
+    return (uint32_t)std::min((decltype(us))std::numeric_limits<uint32_t>::max(), us);
+}
+
+}
 
 
 // Renderer Notes
@@ -23,6 +79,33 @@
 // utilization indicates that the callback is consuming faster than the rate the
 // audio is being produced. When this happens underruns occur, as the callback doesn't
 // get what it needs and there are now gaps in the playback.
+//
+// The render thread never waits on the GUI thread. While rendering, the
+// RenderContext belongs to the render thread and the GUI thread communicates
+// with it through a lock-free command queue (mCommands). The render thread
+// publishes the current frame and diagnostics through a triple buffer
+// (mStatus). When not rendering, the GUI thread owns the context and
+// processes commands immediately. Rare operations that reconfigure the synth
+// (ie setConfig) pause the timer instead.
+//
+// setConfig never blocks on the device. The new device is opened by the
+// stream's worker thread while the current one keeps playing, and
+// finishConfig switches over once it is ready. A render requested before the
+// first device is ready is deferred until then (mRenderPending).
+//
+// In low latency mode there is no timer or playback buffer. The device's
+// callback renders exactly what it needs via renderDirect, making the device
+// thread the render thread. This path never waits: if the module is locked
+// for editing, the engine frame is skipped and caught up on the next frame
+// that gets the lock, so the song keeps its tempo.
+//
+// MIDI notes bypass the GUI thread entirely. The MIDI input thread queues
+// them (mMidiNotes) and the render thread applies each one at the position in
+// the block corresponding to when it was received. When nothing is playing,
+// the rest of the current APU frame is dropped so the note starts at that
+// position instead of on the next frame. While MIDI notes are being
+// previewed, the render is kept running so that the stream is already open
+// when a note arrives.
 
 
 Renderer::RenderContext::RenderContext(Module &mod) :
@@ -36,17 +119,62 @@ Renderer::RenderContext::RenderContext(Module &mod) :
     ip(),
     previewState(PreviewState::none),
     previewChannel(trackerboy::ChType::ch1),
+    outputFlags(ChannelOutput::AllOn),
     state(State::stopped),
     stopCounter(0),
+    skippedFrames(0),
     bufferSize(0),
+    adaptive(false),
+    latency(),
+    midiArmed(false),
+    midiNotes(),
+    midiCount(0),
+    midiNext(0),
+    midiPosition(0),
+    deferredCommand(),
+    commandDeferred(false),
+    position(0),
+    frameHistory(),
+    frameHead(0),
+    frameCount(0),
+    deviceLatency(0),
     watchdog(),
     lastPeriod(),
     periodTime(0),
-    writesSinceLastPeriod(0)
+    writesSinceLastPeriod(0),
+    expectedPeriod(0),
+    firstPeriod(true)
 {
 }
 
 
+Renderer::Command::Command() :
+    Command(Type::stopPreview)
+{
+}
+
+Renderer::Command::Command(Type type, int param1, int param2, int param3) :
+    type(type),
+    param1(param1),
+    param2(param2),
+    param3(param3)
+{
+}
+
+Renderer::Status::Status() :
+    frame(),
+    writesSinceLastPeriod(0),
+    periodTime(0),
+    targetFill(0),
+    time(),
+    position(0),
+    latency(0),
+    frames(),
+    frameHead(0),
+    frameCount(0)
+{
+}
+
 
 Renderer::Renderer(Module &mod, QObject *parent) :
     QObject(parent),
@@ -54,9 +182,29 @@ Renderer::Renderer(Module &mod, QObject *parent) :
     mTimer(new FastTimer),
     mStream(),
     mVisBuffer(),
-    mOutputFlags(ChannelOutput::AllOn),
+    mLevelMeter(),
     mRenderStartTime(),
-    mContext(mod)
+    mRendering(false),
+    mStopPoll(),
+    mStepping(false),
+    mLowLatency(false),
+    mConfig(),
+    mRenderPending(false),
+    mRealtime(false),
+    mRealtimeApplied(false),
+    mMemoryLock(),
+    mStopRequested(false),
+    mStopAborted(false),
+    mContext(mod),
+    mCommands(),
+    mMidiNotes(),
+    mMidiPreview(TU::packPreview({ MidiPreview::None, -1, -1 })),
+    mMidiArmed(false),
+    mStatus(),
+    mUpdates(Renderer::NoUpdate),
+    mRenderTimeStat(),
+    mJitterStat(),
+    mBufferFillStat()
 {
     mTimer->setCallback(timerCallback, this);
     mTimer->moveToThread(&mTimerThread);
@@ -66,9 +214,9 @@ Renderer::Renderer(Module &mod, QObject *parent) :
 
     connect(&mStream, &AudioStream::aborted, this,
         [this]() {
-            auto handle = mContext.access();
-            stopRender(handle, true);
+            stopRender(true);
         });
+    connect(&mStream, &AudioStream::prepared, this, &Renderer::finishConfig);
 
     connect(&mod, &Module::songChanged, this, &Renderer::setSong);
     setSong();
@@ -83,21 +231,26 @@ Renderer::~Renderer() {
 
     mTimerThread.quit();
     mTimerThread.wait();
+
+    mMemoryLock.unlock();
 }
 
 void Renderer::setSong() {
-    auto ctx = mContext.access();
-    ctx->song = ctx->mod.songShared();
-    ctx->engine.setSong(ctx->song.get());
+    bool const paused = pauseRender();
+    mContext.song = mContext.mod.songShared();
+    mContext.engine.setSong(mContext.song.get());
+    if (paused) {
+        resumeRender();
+    }
 
     // if we are playing, restart playback from the start with the new song
     // if we are stepping, stop playback
 
     if (mStream.isRunning()) {
-        if (ctx->stepping) {
-            _stopMusic(ctx);
+        if (mStepping) {
+            stopMusic();
         } else {
-            _play(ctx, 0, 0, false);
+            play(0, 0, false);
         }
     }
 }
@@ -107,15 +260,26 @@ unsigned Renderer::statUnderruns() const {
 }
 
 Renderer::BufferStats Renderer::statBuffer() {
-    auto handle = mContext.access();
-    // it is safe to access the writer since we have acquired access to mContext
-
-    auto const size = handle->bufferSize;
+    auto const& status = mStatus.read();
+    // the ringbuffer's write count is read atomically, so it is safe to
+    // access the writer from this thread
+    // (there is no playback buffer in low latency mode)
+    auto const size = mLowLatency ? 0 : mStream.bufferSize();
     return {
-        (int)(size - mStream.writer().availableWrite()),
+        (int)(size - (mLowLatency ? 0 : mStream.writer().availableWrite())),
         (int)size,
-        (int)handle->writesSinceLastPeriod,
-        std::chrono::duration<double, std::milli>{handle->periodTime}.count()
+        (int)status.writesSinceLastPeriod,
+        std::chrono::duration<double, std::milli>{status.periodTime}.count(),
+        (int)(mLowLatency ? 0 : status.targetFill)
+    };
+}
+
+Renderer::TimingStats Renderer::statTiming() const {
+    return {
+        mRenderTimeStat.snapshot(),
+        mJitterStat.snapshot(),
+        mStream.callbackIntervals(),
+        mBufferFillStat.snapshot()
     };
 }
 
@@ -126,167 +290,359 @@ long Renderer::statElapsed() const {
 }
 
 int Renderer::samplerate() {
-    return mContext.access()->synth.samplerate();
+    // the samplerate is only changed from this thread while the render thread
+    // is paused
+    return mContext.synth.samplerate();
 }
 
-Guarded<VisualizerBuffer>& Renderer::visualizerBuffer() {
+VisualizerBuffer& Renderer::visualizerBuffer() {
     return mVisBuffer;
 }
 
+LevelMeter& Renderer::levelMeter() {
+    return mLevelMeter;
+}
+
 bool Renderer::isRunning() {
     return mStream.isRunning();
 }
 
 bool Renderer::isStepping() {
-    return mContext.access()->stepping;
+    return mStepping;
 }
 
 bool Renderer::isPlaying() {
-    return !mContext.access()->currentEngineFrame.halted;
+    return !mStatus.read().frame.halted;
 }
 
 trackerboy::Frame Renderer::currentFrame() {
-    auto handle = mContext.access();
-    return handle->currentEngineFrame;
+    return mStatus.read().frame;
+}
+
+trackerboy::Frame Renderer::playbackFrame() {
+    auto const& status = mStatus.read();
+    if (status.frameCount == 0) {
+        return status.frame;
+    }
+
+    // the position being heard when the status was published, advanced by
+    // the time since. It cannot pass what has been rendered.
+    auto const elapsed = std::chrono::duration<double>(Clock::now() - status.time).count();
+    auto audible = (int64_t)status.position - (int64_t)status.latency + (int64_t)(elapsed * samplerate());
+    audible = std::min(audible, (int64_t)status.position);
+
+    // the last frame started at or before the audible position
+    auto index = status.frameHead;
+    for (size_t i = 0; i < status.frameCount; ++i) {
+        index = (index + FRAME_HISTORY - 1) % FRAME_HISTORY;
+        if ((int64_t)status.frames[index].position <= audible) {
+            return status.frames[index].frame;
+        }
+    }
+    // older than the history, the oldest frame is the closest
+    return status.frames[index].frame;
+}
+
+Renderer::Updates Renderer::takeUpdates() {
+    return Updates(mUpdates.exchange(NoUpdate, std::memory_order_acquire));
 }
 
-bool Renderer::setConfig(SoundConfig const &soundConfig, AudioEnumerator const& enumerator) {
+void Renderer::setConfig(SoundConfig const &soundConfig, AudioEnumerator const& enumerator) {
+    // the rest of the config is applied once the device is ready
+    mConfig = soundConfig;
+    mStream.prepare({
+        enumerator.device(soundConfig.backendIndex(), soundConfig.deviceIndex()),
+        soundConfig.samplerate(),
+        soundConfig.latency(),
+        soundConfig.isLowLatency() ? renderCallback : nullptr,
+        this
+    });
+}
+
+Renderer::DeviceState Renderer::deviceState() const {
+    if (mStream.isPreparing()) {
+        return DeviceState::opening;
+    }
+    return mStream.isEnabled() ? DeviceState::open : DeviceState::closed;
+}
+
+bool Renderer::isRealtime() const {
+    return mRealtime;
+}
+
+void Renderer::finishConfig() {
+    auto const& soundConfig = mConfig;
 
     // if there is rendering going at on when this function is called it will
     // resume with a slight gap in playback if the config applied without error,
     // otherwise the render is stopped
 
-
-    bool wasRunning = mStream.isRunning();
-    if (wasRunning) {
-        mTimer->stop();
+    bool const wasRendering = pauseRender();
+    if (wasRendering) {
+        // keep the stream stopped until the synth is updated, resumeRender
+        // will restart it
+        mStream.stop();
     }
 
-    mStream.open(
-        enumerator.device(soundConfig.backendIndex(), soundConfig.deviceIndex()),
-        soundConfig.samplerate(),
-        soundConfig.latency()
-    );
+    // the playback and visualizer buffers may be reallocated, they are locked
+    // again by applyRealtime
+    mMemoryLock.unlock();
+
+    // the old device was used until now
+    mStream.commit();
+    mLowLatency = soundConfig.isLowLatency();
 
     if (mStream.isEnabled()) {
 
         mTimer->setInterval(soundConfig.period(), Qt::PreciseTimer);
-        
-
-        // update the synthesizer (the guard isn't necessary here but we'll use it anyways)
-        {
-            auto handle = mContext.access();
-            
-            bool reloadRegisters = false;
-            auto const samplerate = soundConfig.samplerate();
-            if (samplerate != handle->synth.samplerate()) {
-                handle->synth.setSamplerate(samplerate);
-                reloadRegisters = wasRunning;
-            }
-            //handle->synth.apu().setQuality(static_cast<gbapu::Apu::Quality>(soundConfig.quality()));
-            handle->synth.setupBuffers();
+        mContext.expectedPeriod = std::chrono::milliseconds(soundConfig.period());
 
-            if (reloadRegisters) {
-                // resizing the buffers in synth results in an APU reset so we need to
-                // rewrite channel registers
-                handle->engine.reload();
-            }
+        // update the synthesizer, the render thread is paused so we have
+        // access to the context
 
-            handle->bufferSize = mStream.bufferSize();
+        bool reloadRegisters = false;
+        auto const samplerate = soundConfig.samplerate();
+        if (samplerate != mContext.synth.samplerate()) {
+            mContext.synth.setSamplerate(samplerate);
+            reloadRegisters = wasRendering;
+        }
+        //mContext.synth.apu().setQuality(static_cast<gbapu::Apu::Quality>(soundConfig.quality()));
+        mContext.synth.setupBuffers();
 
+        if (reloadRegisters) {
+            // resizing the buffers in synth results in an APU reset so we need to
+            // rewrite channel registers
+            mContext.engine.reload();
+        }
 
-            mVisBuffer.access()->resize(handle->synth.framesize());
+        mContext.bufferSize = mStream.bufferSize();
+        mContext.deviceLatency = mStream.deviceLatency();
 
+        // the buffer is allocated for the configured latency, which is the
+        // most the adaptive target can grow to
+        mContext.adaptive = soundConfig.isAdaptiveLatency() && !mLowLatency;
+        mContext.latency.reset(
+            (size_t)soundConfig.minLatency() * samplerate / 1000,
+            mContext.bufferSize,
+            samplerate
+        );
+        mContext.latency.restart(mStream.underruns());
 
+        mVisBuffer.resize(mContext.synth.framesize());
 
+        applyRealtime(soundConfig);
+
+        if (wasRendering) {
+            resumeRender();
+        } else if (mRenderPending) {
+            mRenderPending = false;
+            beginRender();
         }
 
-        if (wasRunning && mStream.isRunning()) {
-            mTimer->start();
+        if (mMidiArmed) {
+            armMidi();
         }
 
-        return true;
+        emit configApplied(true);
 
     } else {
-        // something went wrong
-        mContext.access()->state = State::stopped;
-        return false;
+        // something went wrong, a pending render is dropped as well
+        if (wasRendering) {
+            // the render was stopped with the old device, clear the
+            // visualizers and notify that playback has stopped
+            stopRender(false);
+        } else {
+            endRender();
+        }
+        emit configApplied(false);
     }
 }
 
-void Renderer::beginRender(Handle &handle) {
-    if (handle->state == State::stopped) {
+void Renderer::applyRealtime(SoundConfig const& soundConfig) {
+    auto const realtime = soundConfig.isRealtime();
+
+    // the timer's thread only renders in timer mode
+    auto const timerRealtime = realtime && !mLowLatency;
+    if (timerRealtime || mRealtimeApplied) {
+        auto const priority = soundConfig.realtimePriority();
+        auto const cpu = soundConfig.renderCpu();
+        bool granted = false;
+        // the timer is stopped so its thread is idle, this does not wait
+        // for long
+        QMetaObject::invokeMethod(mTimer, [&]() {
+            if (timerRealtime) {
+                granted = setRealtimePriority(priority);
+                setThreadAffinity(cpu);
+                prefaultStack();
+            } else {
+                clearRealtimePriority();
+                setThreadAffinity(-1);
+            }
+        }, Qt::BlockingQueuedConnection);
+        mRealtime = granted;
+        mRealtimeApplied = timerRealtime;
+        if (timerRealtime && !granted) {
+            qWarning() << TU::LOG_PREFIX << "real-time scheduling unavailable, using normal scheduling";
+        }
+    }
 
-        bool success = mStream.start();
+    // keep what the render touches resident, the regions were unlocked by
+    // finishConfig since they may have been reallocated
+    mMemoryLock.unlock();
+    if (realtime) {
+        mMemoryLock.lock(&mContext, sizeof(mContext), "render context");
+        mMemoryLock.lock(
+            mStream.bufferData(),
+            mStream.bufferSize() * 2 * sizeof(float),
+            "playback buffer"
+        );
+        mVisBuffer.lockMemory(mMemoryLock);
+    }
+}
 
-        if (success) {
-            auto const now = Clock::now();
-            handle->lastPeriod = now;
-            handle->watchdog = now;
-            mRenderStartTime = now;
-            mTimer->start();
-            handle.unlock();
-            emit audioStarted();
-            handle.relock();
+// GUI thread =================================================================
+
+void Renderer::sendCommand(Command const& cmd) {
+    if (mRendering) {
+        if (!mCommands.push(cmd)) {
+            qWarning() << TU::LOG_PREFIX << "command queue is full, dropping command";
+        }
+    } else {
+        // no render thread, we have the context
+        processCommand(cmd, true);
+    }
+}
+
+bool Renderer::pauseRender() {
+    if (mRendering) {
+        // both block until the current render (if any) completes
+        if (mLowLatency) {
+            mStream.stop();
         } else {
-            // unable to start, an error occurred
-            handle.unlock();
-            emit audioError();
-            return;
+            mTimer->stop();
         }
+        return true;
+    } else {
+        return false;
+    }
+}
 
+void Renderer::resumeRender() {
+    // if the render thread requested a stop while we were paused, let
+    // finishRender decide whether to resume
+    if (!mStopRequested) {
+        // the stream may have been stopped by pauseRender or setConfig
+        if (!mStream.start()) {
+            stopRender(true);
+        } else if (!mLowLatency) {
+            mTimer->start();
+        }
     }
+}
 
-    // reset state to running
-    handle->state = State::running;
-    handle->stopCounter = 0;
+void Renderer::beginRender() {
+    if (mRendering) {
+        // the render thread will pick up the command on its next render
+        return;
+    }
+
+    if (!mStream.isEnabled() && mStream.isPreparing()) {
+        // no device yet, the render begins once it is ready
+        mRenderPending = true;
+        return;
+    }
+
+    // the history is for this render only
+    mContext.frameHead = 0;
+    mContext.frameCount = 0;
+
+    // in low latency mode, rendering begins as soon as the stream starts
+    mRendering = true;
+
+    if (mStream.start()) {
+        mRenderStartTime = Clock::now();
+        if (!mLowLatency) {
+            mTimer->start();
+        }
+        mStopPoll.start(TU::STOP_POLL_INTERVAL, this);
+        emit audioStarted();
+    } else {
+        // unable to start, an error occurred
+        mRendering = false;
+        mContext.state = State::stopped;
+        emit audioError();
+    }
 }
 
-void Renderer::stopRender(Handle &handle, bool aborted) {
+void Renderer::endRender() {
+    mRenderPending = false;
+    if (mRendering) {
+        pauseRender();
+        mStopPoll.stop();
+        mRendering = false;
+        mStopRequested = false;
+        // the render thread is no longer running, process whatever it missed
+        // so that the queue is empty when not rendering
+        processCommands(true);
+    }
+    mContext.state = State::stopped;
+}
 
+void Renderer::stopRender(bool aborted) {
 
-    // this lambda must only be called from the same thread as the Renderer
-    auto stopRender_ = [this](bool aborted) {
+    endRender();
 
-        auto success = mStream.stop();
+    auto success = mStream.stop();
 
-        mVisBuffer.access()->clear();
-        emit updateVisualizers();
+    mVisBuffer.clear();
+    mLevelMeter.reset();
+    mUpdates.fetch_or(VisualizerUpdate, std::memory_order_release);
 
-        if (aborted) {
-            mStream.disable();
-            emit audioError();
+    if (aborted) {
+        mStream.disable();
+        emit audioError();
+    } else {
+        if (success) {
+            emit audioStopped();
         } else {
-            if (success) {
-                emit audioStopped();
-            } else {
-                emit audioError();
-            }
+            emit audioError();
         }
-    };
-
-    // determine if we are in the GUI thread (same thread as the Renderer)
-    // this function is mostly called from the timer thread, occurs when:
-    //  - the buffer has drained and we are stopping
-    //  - the watchdog timer has exceeded 1 second (unknown problem with device)
-    // for these cases we need to invoke the lambda in the GUI thread (AudioStream is not thread-safe)
+    }
+}
 
-    mTimer->stop();
+void Renderer::armMidi() {
+    // the render thread keeps running until disarmed
+    sendCommand({ Command::Type::midiArm, true });
+    beginRender();
+}
 
-    if (objectInCurrentThread(*this)) {
-        handle->state = State::stopped;
-        handle.unlock();
-        stopRender_(aborted);
+void Renderer::timerEvent(QTimerEvent *evt) {
+    if (evt->timerId() == mStopPoll.timerId()) {
+        if (mStopRequested.load()) {
+            finishRender(mStopAborted.load(std::memory_order_relaxed));
+        }
     } else {
-        // stopRender was called from mTimerThread, invoke the lambda in the renderer's thread
-        handle.unlock();
-        QMetaObject::invokeMethod(this, [this, &stopRender_, aborted]() {
-            mContext.access()->state = State::stopped;
-            stopRender_(aborted);
-        }, Qt::BlockingQueuedConnection);
+        QObject::timerEvent(evt);
     }
+}
 
+void Renderer::finishRender(bool aborted) {
+    if (!mRendering) {
+        return;
+    }
+
+    if (!mStopRequested.exchange(false)) {
+        // the render thread resumed on its own (low latency mode only)
+        return;
+    }
 
+    if (!aborted && !mCommands.isEmpty()) {
+        // commands were sent after the render thread stopped itself, resume
+        // so that they get processed
+        resumeRender();
+    } else {
+        stopRender(aborted);
+    }
 }
 
 
@@ -294,147 +650,82 @@ void Renderer::stopRender(Handle &handle, bool aborted) {
 // SLOTS
 
 void Renderer::clearDiagnostics() {
-    mStream.resetUnderruns();
+    mStream.resetStats();
+    mRenderTimeStat.clear();
+    mJitterStat.clear();
+    mBufferFillStat.clear();
 }
 
 void Renderer::play(int pattern, int row, bool stepmode) {
 
     if (mStream.isEnabled()) {
-        auto handle = mContext.access();
-        _play(handle, pattern, row, stepmode);
+        mStepping = stepmode;
+        sendCommand({ Command::Type::play, pattern, row, stepmode });
+        beginRender();
     }
 }
 
 
 void Renderer::stepNextFrame() {
     
-    if (mStream.isEnabled()) {
-        auto handle = mContext.access();
-        if (handle->stepping) {
-            handle->step = true;
-        }
-
+    if (mStream.isEnabled() && mStepping) {
+        sendCommand({ Command::Type::step });
     }
 }
 
 void Renderer::stepOut() {
     if (mStream.isEnabled()) {
-        mContext.access()->stepping = false;
+        mStepping = false;
+        sendCommand({ Command::Type::stepOut });
     }
 }
 
 void Renderer::jumpToPattern(int pattern) {
     if (mStream.isEnabled()) {
-        auto ctx = mContext.access();
-        ctx->engine.jump(pattern);
+        sendCommand({ Command::Type::jump, pattern });
     }
 }
 
 void Renderer::setPatternRepeat(bool repeat) {
 
     if (mStream.isEnabled()) {
-        mContext.access()->engine.repeatPattern(repeat);
+        sendCommand({ Command::Type::patternRepeat, repeat });
     }
 }
 
 void Renderer::setPreviewNote(int note) {
     if (mStream.isEnabled()) {
-        auto ctx = mContext.access();
-        switch (ctx->previewState) {
-            case PreviewState::waveform: {
-                auto freq = trackerboy::lookupToneNote(note);
-                ctx->apu.writeRegister(trackerboy::Apu::REG_NR33, (uint8_t)(freq & 0xFF));
-                ctx->apu.writeRegister(trackerboy::Apu::REG_NR34, (uint8_t)(freq >> 8));
-                break;
-            }
-            case PreviewState::instrument:
-                // update the current note
-                ctx->ip.play((uint8_t)note);
-                break;
-            default:
-                break;
-        
-        }
+        sendCommand({ Command::Type::previewNote, note });
     }
 }
 
 void Renderer::instrumentPreview(int note, int track, int instrumentId) {
     if (mStream.isEnabled()) {
-        auto ctx = mContext.access();
-        switch (ctx->previewState) {
-            case PreviewState::instrument:
-            case PreviewState::waveform:
-                resetPreview(ctx);
-                [[fallthrough]];
-            case PreviewState::none: {
-                auto const& itable = ctx->mod.data().instrumentTable();
-                std::shared_ptr<const trackerboy::Instrument> inst = nullptr;
-                if (instrumentId != -1) {
-                    inst = itable.getShared((uint8_t)instrumentId);
-                }
-
-                if (track == -1) {
-                    // instrument preview
-                    Q_ASSERT(inst != nullptr); // must have an instrument
-                    ctx->previewChannel = inst->channel();
-                } else {
-                    // note preview
-                    ctx->previewChannel = static_cast<trackerboy::ChType>(track);
-                }
-
-                ctx->ip.setInstrument(std::move(inst), ctx->previewChannel);
-
-                ctx->previewState = PreviewState::instrument;
-                // unlock the channel for preview
-                ctx->engine.unlock(ctx->previewChannel);
-                ctx->ip.play((uint8_t)note);
-                break;
-            }
-        }
-        beginRender(ctx);
+        sendCommand({ Command::Type::instrumentPreview, note, track, instrumentId });
+        beginRender();
     }
 }
 
 void Renderer::waveformPreview(int note, int waveId) {
     if (mStream.isEnabled()) {
-        auto ctx = mContext.access();
-        switch (ctx->previewState) {
-            case PreviewState::instrument:
-            case PreviewState::waveform:
-                resetPreview(ctx);
-                [[fallthrough]];
-            case PreviewState::none:
-                ctx->previewState = PreviewState::waveform;
-                ctx->previewChannel = trackerboy::ChType::ch3;
-                // unlock the channel, no longer effected by music
-                ctx->engine.unlock(trackerboy::ChType::ch3);
-
-                trackerboy::ChannelState state(trackerboy::ChType::ch3);
-                state.playing = true;
-                state.frequency = trackerboy::lookupToneNote(note);
-                state.envelope = (uint8_t)waveId;
-                trackerboy::ChannelControl<trackerboy::ChType::ch3>::init(
-                    ctx->apu, ctx->mod.data().waveformTable(), state
-                );
-                break;
-        }
-        beginRender(ctx);
+        sendCommand({ Command::Type::waveformPreview, note, waveId });
+        beginRender();
     }
 }
 
 void Renderer::updateFramerate() {
-    auto ctx = mContext.access();
-    ctx->synth.setFramerate(ctx->mod.data().framerate());
-    ctx->synth.setupBuffers();
+    bool const paused = pauseRender();
+    mContext.synth.setFramerate(mContext.mod.data().framerate());
+    mContext.synth.setupBuffers();
+    if (paused) {
+        resumeRender();
+    }
 }
 
 void Renderer::stopPreview() {
 
     if (mStream.isEnabled()) {
-        auto handle = mContext.access();
-        if (handle->previewState != PreviewState::none) {
-            resetPreview(handle);
-        }
+        sendCommand({ Command::Type::stopPreview });
     }
     
 }
@@ -442,225 +733,694 @@ void Renderer::stopPreview() {
 void Renderer::stopMusic() {
     
     if (mStream.isEnabled()) {
-        auto handle = mContext.access();
-        _stopMusic(handle);
+        mStepping = false;
+        sendCommand({ Command::Type::stopMusic });
     }
 
 }
 
-void Renderer::_stopMusic(Handle &handle) {
-    handle->engine.halt();
-    handle->stepping = false;
+void Renderer::forceStop() {
+
+    if (mStream.isEnabled() && mRendering) {
+        stopRender();
+        // render thread has stopped, we can access the context now
+        resetPreview();
+        _stopMusic();
+        mStepping = false;
+
+        if (mMidiArmed) {
+            armMidi();
+        }
+    }
 }
 
-void Renderer::forceStop() {
+void Renderer::resetGlobalVolume() {
+    sendCommand({ Command::Type::resetVolume });
+}
 
-    if (mStream.isEnabled()) {
-        auto handle = mContext.access();
-        if (handle->state != State::stopped) {
-            resetPreview(handle);
-            handle->engine.halt();
-            handle->stepping = false;
-            stopRender(handle);
+void Renderer::setChannelOutput(ChannelOutput::Flags flags) {
+    sendCommand({ Command::Type::channelOutput, (int)flags });
+}
+
+void Renderer::setMidiPreview(MidiPreview preview) {
+    mMidiPreview.store(TU::packPreview(preview), std::memory_order_relaxed);
+
+    if (preview.type != MidiPreview::None) {
+        auto const wasArmed = mMidiArmed;
+        mMidiArmed = true;
+        if (mStream.isEnabled() && (!wasArmed || !mRendering)) {
+            armMidi();
         }
+    } else if (mMidiArmed) {
+        mMidiArmed = false;
+        sendCommand({ Command::Type::midiArm, false });
     }
 }
 
-void Renderer::_play(Handle &handle, int orderNo, int rowNo, bool stepping) {
+// MIDI thread ================================================================
 
-    handle->engine.play(orderNo, rowNo);
-    _setChannelOutput(handle, mOutputFlags);
-    handle->stepping = stepping;
-    handle->step = stepping;
-    beginRender(handle);
+void Renderer::midiNoteOn(int note) {
+    // a full queue means the render thread is not running, drop the note
+    mMidiNotes.push({ true, note, Clock::now(), 0 });
+}
 
+void Renderer::midiNoteOff() {
+    mMidiNotes.push({ false, 0, Clock::now(), 0 });
 }
 
-void Renderer::resetPreview(Handle &handle) {
+// Render thread ==============================================================
+
+void Renderer::processCommands(bool canWait) {
+    auto &ctx = mContext;
+    if (ctx.commandDeferred) {
+        if (!processCommand(ctx.deferredCommand, canWait)) {
+            return;
+        }
+        ctx.commandDeferred = false;
+    }
+
+    Command cmd;
+    while (mCommands.pop(cmd)) {
+        if (!processCommand(cmd, canWait)) {
+            // keep the order, the rest of the queue waits behind it
+            ctx.deferredCommand = cmd;
+            ctx.commandDeferred = true;
+            return;
+        }
+    }
+}
+
+bool Renderer::processCommand(Command const& cmd, bool canWait) {
+    switch (cmd.type) {
+        case Command::Type::play:
+            _play(cmd.param1, cmd.param2, cmd.param3 != 0);
+            break;
+        case Command::Type::step:
+            if (mContext.stepping) {
+                mContext.step = true;
+            }
+            break;
+        case Command::Type::stepOut:
+            mContext.stepping = false;
+            break;
+        case Command::Type::jump:
+            mContext.engine.jump(cmd.param1);
+            break;
+        case Command::Type::patternRepeat:
+            mContext.engine.repeatPattern(cmd.param1 != 0);
+            break;
+        case Command::Type::previewNote:
+            switch (mContext.previewState) {
+                case PreviewState::waveform: {
+                    auto freq = trackerboy::lookupToneNote(cmd.param1);
+                    mContext.apu.writeRegister(trackerboy::Apu::REG_NR33, (uint8_t)(freq & 0xFF));
+                    mContext.apu.writeRegister(trackerboy::Apu::REG_NR34, (uint8_t)(freq >> 8));
+                    break;
+                }
+                case PreviewState::instrument:
+                    // update the current note
+                    mContext.ip.play((uint8_t)cmd.param1);
+                    break;
+                default:
+                    break;
+            }
+            break;
+        case Command::Type::instrumentPreview:
+            if (_instrumentPreview(cmd.param1, cmd.param2, cmd.param3, canWait) == PreviewResult::busy) {
+                return false;
+            }
+            break;
+        case Command::Type::waveformPreview:
+            if (_waveformPreview(cmd.param1, cmd.param2, canWait) == PreviewResult::busy) {
+                return false;
+            }
+            break;
+        case Command::Type::stopPreview:
+            if (mContext.previewState != PreviewState::none) {
+                resetPreview();
+            }
+            break;
+        case Command::Type::stopMusic:
+            _stopMusic();
+            break;
+        case Command::Type::channelOutput:
+            mContext.outputFlags = ChannelOutput::Flags((ChannelOutput::Flag)cmd.param1);
+            _setChannelOutput(mContext.outputFlags);
+            break;
+        case Command::Type::resetVolume:
+            mContext.apu.writeRegister(trackerboy::IApuIo::REG_NR50, 0x77);
+            break;
+        case Command::Type::midiArm:
+            mContext.midiArmed = cmd.param1 != 0;
+            if (mContext.midiArmed) {
+                setRunning();
+            }
+            break;
+    }
+    return true;
+}
+
+Renderer::PreviewResult Renderer::_instrumentPreview(int note, int track, int instrumentId, bool canWait) {
+    std::shared_ptr<const trackerboy::Instrument> inst = nullptr;
+    if (instrumentId != -1) {
+        if (!TU::lockMutex(mContext.mod.mutex(), canWait)) {
+            return PreviewResult::busy;
+        }
+        inst = mContext.mod.data().instrumentTable().getShared((uint8_t)instrumentId);
+        mContext.mod.mutex().unlock();
+    }
+
+    if (track == -1) {
+        // instrument preview, the instrument may have been removed since
+        // the preview was requested
+        if (inst == nullptr) {
+            return PreviewResult::missing;
+        }
+        track = (int)inst->channel();
+    }
+
+    if (mContext.previewState != PreviewState::none) {
+        resetPreview();
+    }
+
+    mContext.previewChannel = static_cast<trackerboy::ChType>(track);
+    mContext.ip.setInstrument(std::move(inst), mContext.previewChannel);
+
+    mContext.previewState = PreviewState::instrument;
+    // unlock the channel for preview
+    mContext.engine.unlock(mContext.previewChannel);
+    mContext.ip.play((uint8_t)note);
+
+    setRunning();
+    return PreviewResult::started;
+}
+
+Renderer::PreviewResult Renderer::_waveformPreview(int note, int waveId, bool canWait) {
+    if (!TU::lockMutex(mContext.mod.mutex(), canWait)) {
+        return PreviewResult::busy;
+    }
+
+    if (mContext.previewState != PreviewState::none) {
+        resetPreview();
+    }
+
+    mContext.previewState = PreviewState::waveform;
+    mContext.previewChannel = trackerboy::ChType::ch3;
+    // unlock the channel, no longer effected by music
+    mContext.engine.unlock(trackerboy::ChType::ch3);
+
+    trackerboy::ChannelState state(trackerboy::ChType::ch3);
+    state.playing = true;
+    state.frequency = trackerboy::lookupToneNote(note);
+    state.envelope = (uint8_t)waveId;
+    trackerboy::ChannelControl<trackerboy::ChType::ch3>::init(
+        mContext.apu, mContext.mod.data().waveformTable(), state
+    );
+    mContext.mod.mutex().unlock();
+
+    setRunning();
+    return PreviewResult::started;
+}
+
+void Renderer::_stopMusic() {
+    mContext.engine.halt();
+    mContext.stepping = false;
+    mContext.skippedFrames = 0;
+}
+
+void Renderer::_play(int orderNo, int rowNo, bool stepping) {
+
+    mContext.engine.play(orderNo, rowNo);
+    mContext.skippedFrames = 0;
+    _setChannelOutput(mContext.outputFlags);
+    mContext.stepping = stepping;
+    mContext.step = stepping;
+    setRunning();
+
+}
+
+void Renderer::resetPreview() {
     // lock the channel so it can be used for music
-    handle->engine.lock(handle->previewChannel);
-    handle->ip.setInstrument(nullptr);
-    handle->previewState = PreviewState::none;
+    mContext.engine.lock(mContext.previewChannel);
+    mContext.ip.setInstrument(nullptr);
+    mContext.previewState = PreviewState::none;
 }
 
-void Renderer::resetGlobalVolume() {
-    auto ctx = mContext.access();
-    ctx->apu.writeRegister(trackerboy::IApuIo::REG_NR50, 0x77);
-}
-
- void Renderer::setChannelOutput(ChannelOutput::Flags flags) {
-     mOutputFlags = flags;
-     auto ctx = mContext.access();
-     _setChannelOutput(ctx, flags);
- }
-
- void Renderer::_setChannelOutput(Handle &handle, ChannelOutput::Flags flags) {
-     int flag = ChannelOutput::CH1;
-     for (int i = 0; i < 4; ++i) {
-         auto ch = static_cast<trackerboy::ChType>(i);
-         if (flags.testFlag((ChannelOutput::Flag)(flag))) {
-             handle->engine.lock(ch);
-         } else {
-             // channel is disabled, keep unlocked
-             handle->engine.unlock(ch);
-         }
-         flag <<= 1;
-     }
- }
+void Renderer::_setChannelOutput(ChannelOutput::Flags flags) {
+    int flag = ChannelOutput::CH1;
+    for (int i = 0; i < 4; ++i) {
+        auto ch = static_cast<trackerboy::ChType>(i);
+        if (flags.testFlag((ChannelOutput::Flag)(flag))) {
+            mContext.engine.lock(ch);
+        } else {
+            // channel is disabled, keep unlocked
+            mContext.engine.unlock(ch);
+        }
+        flag <<= 1;
+    }
+}
+
+void Renderer::setRunning() {
+    if (mContext.state != State::running) {
+        if (mContext.state == State::stopped) {
+            auto const now = Clock::now();
+            mContext.lastPeriod = now;
+            mContext.watchdog = now;
+            mContext.firstPeriod = true;
+            // the buffer is empty, measure from here
+            mContext.latency.restart(mStream.underruns());
+        }
+        mStream.setDraining(false);
+        mContext.state = State::running;
+        // cancel any pending stop (low latency mode)
+        mStopRequested = false;
+    }
+    mContext.stopCounter = 0;
+}
+
+void Renderer::requestStop(bool aborted) {
+    mContext.state = State::stopped;
+    mStopAborted.store(aborted, std::memory_order_relaxed);
+    mStopRequested = true;
+    mStream.setDraining(true);
+    if (!mLowLatency) {
+        // we are in the timer's thread, so this stops it immediately
+        mTimer->stop();
+    }
+    // AudioStream is not thread-safe, the GUI thread stops it once it polls
+    // the request
+}
 
 void Renderer::timerCallback(void *userData) {
     // called by FastTimer 
     static_cast<Renderer*>(userData)->render();
 }
 
+size_t Renderer::renderCallback(void *userData, float *out, size_t frames) {
+    // called by AudioStream, low latency mode only
+    return static_cast<Renderer*>(userData)->renderDirect(out, frames);
+}
+
 // this is the number of frames to output before stopping playback
 // (prevents a hard pop noise that may occur when stopping abruptly, as
 // the high pass filter will decay the signal to 0)
 constexpr int STOP_FRAMES = 5;
 
+size_t Renderer::synthesize(float *out, size_t samples, bool &newFrame, bool canWait) {
+
+    auto &ctx = mContext;
+    auto &frame = ctx.currentEngineFrame;
+    // cache a ref to the apu, we'll be using it often
+    auto &apu = ctx.apu;
+
+    size_t written = 0;
+    while (written < samples) {
+
+        if (apu.samplesAvailable() == 0) {
+            // new frame
+
+            if (ctx.state == State::stopping) {
+                break; // stop, don't render any more
+            }
+
+            if (ctx.stopCounter) {
+                if (--ctx.stopCounter == 0) {
+                    ctx.state = State::stopping;
+                    mStream.setDraining(true);
+                }
+            } else {
+                newFrame = true;
+
+                // the engine and previewer have read access to the module
+                // so the document must be locked when stepping
+
+                // step engine/previewer
+                if (!ctx.stepping || ctx.step) {
+                    if (TU::lockMutex(ctx.mod.mutex(), canWait)) {
+                        // frames skipped while the module was locked are
+                        // stepped now, in this frame's time
+                        auto steps = ctx.skippedFrames + 1;
+                        ctx.skippedFrames = 0;
+                        do {
+                            ctx.engine.step(frame);
+                            markFrame(ctx.position + written);
+
+                            if (frame.startedNewRow) {
+                                ctx.step = false;
+                            }
+                        } while (--steps && !frame.halted && (!ctx.stepping || ctx.step));
+                        ctx.mod.mutex().unlock();
+                    } else if (!ctx.stepping) {
+                        // in step mode the step is simply retried
+                        ++ctx.skippedFrames;
+                    }
+                }
+
+                if (ctx.previewState == PreviewState::instrument) {
+                    auto &mod = ctx.mod.data();
+                    trackerboy::RuntimeContext rc(apu, mod.instrumentTable(), mod.waveformTable());
+
+                    if (TU::lockMutex(ctx.mod.mutex(), canWait)) {
+                        ctx.ip.step(rc);
+                        ctx.mod.mutex().unlock();
+                    }
+                }
+
+
+                if (frame.halted && ctx.previewState == PreviewState::none && !ctx.midiArmed) {
+                    // no longer doing anything, start the stop counter
+                    ctx.stopCounter = STOP_FRAMES;
+                }
+
+            }
+
+            ctx.synth.run();
+
+        }
+
+        size_t toWrite = std::min(samples - written, apu.samplesAvailable());
+        apu.readSamples(out + (written * 2), toWrite);
+        written += toWrite;
+    }
+
+    ctx.position += written;
+    return written;
+}
+
+void Renderer::beginMidi(Clock::time_point now, size_t samples) {
+    auto &ctx = mContext;
+    ctx.midiCount = 0;
+    ctx.midiNext = 0;
+    ctx.midiPosition = 0;
+
+    // the block plays for as long as the period it was rendered for, so a
+    // note's offset in the block is its offset in the period
+    auto const periodStart = now - ctx.periodTime;
+    auto const periodCount = ctx.periodTime.count();
+    MidiNote note;
+    while (ctx.midiCount < ctx.midiNotes.size() && mMidiNotes.pop(note)) {
+        if (note.noteOn && now - note.time > TU::MIDI_STALE_TIME) {
+            // queued while not rendering, too late to play
+            continue;
+        }
+
+        size_t offset = 0;
+        if (periodCount > 0 && note.time > periodStart) {
+            auto const ratio = (double)(note.time - periodStart).count() / periodCount;
+            offset = std::min(samples, (size_t)(ratio * samples));
+        }
+        note.offset = offset;
+        ctx.midiNotes[ctx.midiCount++] = note;
+    }
+}
+
+size_t Renderer::synthesizeMidi(float *out, size_t samples, bool &newFrame, bool canWait) {
+    auto &ctx = mContext;
+
+    size_t written = 0;
+    while (written < samples) {
+        auto toWrite = samples - written;
+        if (ctx.midiNext < ctx.midiCount) {
+            auto const& note = ctx.midiNotes[ctx.midiNext];
+            if (note.offset <= ctx.midiPosition) {
+                applyMidiNote(note, canWait);
+                ++ctx.midiNext;
+                continue;
+            }
+            toWrite = std::min(toWrite, note.offset - ctx.midiPosition);
+        }
+
+        auto const amount = synthesize(out + (written * 2), toWrite, newFrame, canWait);
+        written += amount;
+        ctx.midiPosition += amount;
+        if (amount < toWrite) {
+            // stopping
+            break;
+        }
+    }
+
+    return written;
+}
+
+void Renderer::endMidi(bool canWait) {
+    auto &ctx = mContext;
+    while (ctx.midiNext < ctx.midiCount) {
+        applyMidiNote(ctx.midiNotes[ctx.midiNext++], canWait);
+    }
+}
+
+void Renderer::applyMidiNote(MidiNote const& note, bool canWait) {
+    auto &ctx = mContext;
+
+    if (!note.noteOn) {
+        if (ctx.previewState != PreviewState::none) {
+            resetPreview();
+        }
+        return;
+    }
+
+    auto const preview = TU::unpackPreview(mMidiPreview.load(std::memory_order_relaxed));
+    PreviewResult result;
+    switch (preview.type) {
+        case MidiPreview::Instrument:
+            if (preview.track == -1 && preview.id == -1) {
+                // instrument previews need an instrument
+                return;
+            }
+            result = _instrumentPreview(note.note, preview.track, preview.id, canWait);
+            break;
+        case MidiPreview::Waveform:
+            result = _waveformPreview(note.note, preview.id, canWait);
+            break;
+        default:
+            return;
+    }
+
+    if (result != PreviewResult::started) {
+        // the module is being edited or the instrument was removed, a late
+        // note is worse than a dropped one
+        return;
+    }
+
+    if (ctx.currentEngineFrame.halted) {
+        // nothing else is playing, drop the rest of the current frame so that
+        // the next one, with the note, starts here
+        float discard[256 * 2];
+        auto remaining = ctx.apu.samplesAvailable();
+        while (remaining) {
+            auto const amount = std::min(remaining, (size_t)256);
+            ctx.apu.readSamples(discard, amount);
+            remaining -= amount;
+        }
+    }
+}
+
+void Renderer::recordPeriod(Clock::duration expected) {
+    auto &ctx = mContext;
+    if (ctx.firstPeriod) {
+        // the first period is measured from when rendering started
+        ctx.firstPeriod = false;
+    } else {
+        auto const jitter = ctx.periodTime - expected;
+        mJitterStat.record(TU::toMicroseconds(jitter < Clock::duration::zero() ? -jitter : jitter));
+    }
+}
+
+void Renderer::markFrame(uint64_t position) {
+    auto &ctx = mContext;
+    ctx.frameHistory[ctx.frameHead] = { position, ctx.currentEngineFrame };
+    ctx.frameHead = (ctx.frameHead + 1) % FRAME_HISTORY;
+    ctx.frameCount = std::min(ctx.frameCount + 1, FRAME_HISTORY);
+}
+
+void Renderer::publish(bool haltedBefore, bool newFrame, Clock::time_point now, size_t latency) {
+    auto const& ctx = mContext;
+
+    Status status;
+    status.frame = ctx.currentEngineFrame;
+    status.writesSinceLastPeriod = ctx.writesSinceLastPeriod;
+    status.periodTime = ctx.periodTime;
+    status.targetFill = ctx.adaptive ? ctx.latency.target() : ctx.bufferSize;
+    status.time = now;
+    status.position = ctx.position;
+    status.latency = latency;
+    status.frames = ctx.frameHistory;
+    status.frameHead = ctx.frameHead;
+    status.frameCount = ctx.frameCount;
+    mStatus.write(status);
+
+    // the GUI polls these at display rate, signalling them would queue an
+    // event every period
+    int updates = NoUpdate;
+    if (ctx.writesSinceLastPeriod) {
+        updates |= VisualizerUpdate;
+    }
+    if (newFrame) {
+        updates |= FrameUpdate;
+    }
+    if (updates != NoUpdate) {
+        mUpdates.fetch_or(updates, std::memory_order_release);
+    }
+
+    if (newFrame && haltedBefore != ctx.currentEngineFrame.halted) {
+        emit isPlayingChanged(!ctx.currentEngineFrame.halted);
+    }
+}
+
 void Renderer::render() {
     // This function is called from a separate thread!
     // FastTimer lives in its own thread and calls this function via the timer callback
     
     auto now = Clock::now();
 
-    auto handle = mContext.access();
+    auto &ctx = mContext;
+
+    processCommands(true);
 
-    if (handle->state == State::stopped) {
+    if (ctx.state == State::stopped) {
+        // resumed with nothing to play
+        requestStop(false);
         return;
     }
 
 
     // diagnostics
-    handle->periodTime = now - handle->lastPeriod;
-    handle->lastPeriod = now;
-    handle->writesSinceLastPeriod = 0;
+    ctx.periodTime = now - ctx.lastPeriod;
+    ctx.lastPeriod = now;
+    ctx.writesSinceLastPeriod = 0;
+    recordPeriod(ctx.expectedPeriod);
 
 
     auto writer = mStream.writer();
-    auto framesToRender = writer.availableWrite();
+    auto const available = writer.availableWrite();
+    auto const fill = ctx.bufferSize - available;
+    if (ctx.bufferSize) {
+        mBufferFillStat.record((uint32_t)(fill * 100 / ctx.bufferSize));
+    }
+
+    size_t framesToRender = available;
+    if (ctx.adaptive) {
+        auto const target = ctx.latency.update(fill, mStream.underruns(), ctx.periodTime);
+        framesToRender = target > fill ? std::min(target - fill, available) : 0;
+    }
 
-    if (framesToRender) {
+    if (available) {
         // reset the watchdog
-        handle->watchdog = now;
+        ctx.watchdog = now;
     } else {
         constexpr auto WATCHDOG_INTERVAL = std::chrono::seconds(1);
-        auto timeSinceLastWatchdogReset = now - handle->watchdog;
+        auto timeSinceLastWatchdogReset = now - ctx.watchdog;
         if (timeSinceLastWatchdogReset >= WATCHDOG_INTERVAL) {
             // we have gone 1 second without renderering anything
             // abort the render
-            handle.unlock();
-            stopRender(handle, true);
+            requestStop(true);
         }
         // no frames to render, exit early
         return;
     }
 
-    
-    auto frame = handle->currentEngineFrame;
-    auto const haltedBefore = frame.halted;
+    if (ctx.state == State::stopping && available == ctx.bufferSize) {
+        // the buffer has been drained, stop the callback
+        requestStop(false);
+        return;
+    }
 
-    // cache a ref to the apu, we'll be using it often
-    auto &apu = handle->apu;
+    if (framesToRender == 0) {
+        // already filled to the target
+        return;
+    }
 
+    auto const haltedBefore = ctx.currentEngineFrame.halted;
     bool newFrame = false;
 
-    auto visHandle = mVisBuffer.access();
-    visHandle->beginWrite(framesToRender);
+    beginMidi(now, framesToRender);
+    mVisBuffer.beginWrite(framesToRender);
 
     while (framesToRender) {
+        size_t toWrite = framesToRender;
+        auto writePtr = writer.acquireWrite(toWrite);
 
-        if (handle->state == State::stopping) {
-            if (writer.availableWrite() == handle->bufferSize) {
-                // the buffer has been drained, stop the callback
-                visHandle.unlock();
-                stopRender(handle);
-            }
-            return;
+        auto const written = synthesizeMidi(writePtr, toWrite, newFrame, true);
+        // send a copy to the visualizer buffer as well
+        mVisBuffer.write(writePtr, written);
+        mLevelMeter.measure(writePtr, written);
+        writer.commitWrite(written);
 
-        } else {
+        ctx.writesSinceLastPeriod += written;
+        framesToRender -= written;
 
-            if (apu.samplesAvailable() == 0) {
-                // new frame
+        if (written < toWrite) {
+            // stopping, wait for the buffer to drain
+            break;
+        }
+    }
 
-                if (handle->state == State::stopping) {
-                    break; // stop, don't render any more
-                }
+    endMidi(true);
 
-                if (handle->stopCounter) {
-                    if (--handle->stopCounter == 0) {
-                        handle->state = State::stopping;
-                        mStream.setDraining(true);
-                    }
-                } else {
-                    newFrame = true;
-
-                    // the engine and previewer have read access to the module
-                    // so the document must be locked when stepping
-
-                    // step engine/previewer
-                    if (!handle->stepping || handle->step) {
-                        
-                        {
-                            QMutexLocker locker(&handle->mod.mutex());
-                            handle->engine.step(frame);
-                        }
-                        
-                        if (frame.startedNewRow) {
-                            handle->step = false;
-                        }
-                    }
+    // visualizers get the new samples without us waiting on them
+    mVisBuffer.endWrite();
+    mLevelMeter.publish();
 
-                    if (handle->previewState == PreviewState::instrument) {
-                        auto &mod = handle->mod.data();
-                        trackerboy::RuntimeContext rc(apu, mod.instrumentTable(), mod.waveformTable());
-                        
-                        {
-                            QMutexLocker locker(&handle->mod.mutex());
-                            handle->ip.step(rc);
-                        }
-                    }
+    // everything still in the playback buffer is heard before what was just
+    // rendered, along with the device's own buffer
+    auto const latency = ctx.bufferSize - writer.availableWrite() + mStream.playbackDelay() + ctx.deviceLatency;
+    publish(haltedBefore, newFrame, now, latency);
 
+    mRenderTimeStat.record(TU::toMicroseconds(Clock::now() - now));
 
-                    if (frame.halted && handle->previewState == PreviewState::none) {
-                        // no longer doing anything, start the stop counter
-                        handle->stopCounter = STOP_FRAMES;
-                    }
+}
 
-                }
+size_t Renderer::renderDirect(float *out, size_t frames) {
+    // This function is called from the audio device's thread!
+    // It must never wait on another thread.
 
-                handle->synth.run();
+    auto now = Clock::now();
 
-            }
+    auto &ctx = mContext;
 
-            size_t toWrite = std::min(framesToRender, apu.samplesAvailable());
-            auto writePtr = writer.acquireWrite(toWrite);
-            
-            // read from the apu to the ringbuffer
-            apu.readSamples(writePtr, toWrite);
-            // send a copy to the visualizer buffer as well
-            visHandle->write(writePtr, toWrite);
-            
-            writer.commitWrite(toWrite);
-            
-            handle->writesSinceLastPeriod += toWrite;
-            framesToRender -= toWrite;
+    processCommands(false);
 
+    if (ctx.state == State::stopped) {
+        // nothing to play, output silence until the GUI stops the stream.
+        // A deferred command may start something, wait for it instead
+        if (!mStopRequested && !ctx.commandDeferred) {
+            requestStop(false);
         }
-
+        return 0;
     }
 
-    if (handle->writesSinceLastPeriod) {
-        emit updateVisualizers();
-    }
+    ctx.periodTime = now - ctx.lastPeriod;
+    ctx.lastPeriod = now;
+    // the device's period is the time it takes to play the requested frames
+    recordPeriod(std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>((double)frames / ctx.synth.samplerate())
+    ));
 
-    if (newFrame) {
-        handle->currentEngineFrame = frame;
-        handle.unlock(); // always unlock before emitting signals
-        if (haltedBefore != frame.halted) {
-            emit isPlayingChanged(!frame.halted);
-        }
-        emit frameSync();
+    auto const haltedBefore = ctx.currentEngineFrame.halted;
+    bool newFrame = false;
+
+    beginMidi(now, frames);
+    auto const rendered = synthesizeMidi(out, frames, newFrame, false);
+    endMidi(false);
+    ctx.writesSinceLastPeriod = rendered;
+
+    mVisBuffer.beginWrite(rendered);
+    mVisBuffer.write(out, rendered);
+    mVisBuffer.endWrite();
+    mLevelMeter.measure(out, rendered);
+    mLevelMeter.publish();
+
+    if (rendered < frames) {
+        // no buffer to drain, we can stop right away
+        requestStop(false);
     }
 
+    // rendered straight into the device's buffer, only its latency applies
+    publish(haltedBefore, newFrame, now, rendered + ctx.deviceLatency);
+
+    mRenderTimeStat.record(TU::toMicroseconds(Clock::now() - now));
+
+    return rendered;
 }
+
+#undef TU
@@ -3,12 +3,18 @@
 
 #include "audio/AudioStream.hpp"
 #include "audio/AudioEnumerator.hpp"
+#include "audio/LatencyController.hpp"
+#include "audio/LevelMeter.hpp"
 #include "audio/VisualizerBuffer.hpp"
 #include "config/data/SoundConfig.hpp"
 #include "core/ChannelOutput.hpp"
 #include "utils/FastTimer.hpp"
 #include "core/Module.hpp"
-#include "utils/Guarded.hpp"
+#include "midi/IMidiReceiver.hpp"
+#include "utils/Histogram.hpp"
+#include "utils/realtime.hpp"
+#include "utils/SpscQueue.hpp"
+#include "utils/TripleBuffer.hpp"
 
 #include "trackerboy/apu/DefaultApu.hpp"
 #include "trackerboy/data/Song.hpp"
@@ -19,16 +25,25 @@
 #include "trackerboy/Synth.hpp"
 #include "trackerboy/note.hpp"
 
+#include <QBasicTimer>
+#include <QFlags>
 #include <QObject>
 #include <QThread>
 
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 
 //
 // Class handles all sound renderering. Sound is sent to the
 // configured device set in Config.
 //
-class Renderer : public QObject {
+// The renderer is also a MIDI receiver, called directly from the MIDI input
+// thread so that notes played on a controller are previewed without waiting
+// on the GUI thread.
+//
+class Renderer : public QObject, public IMidiReceiver {
 
     Q_OBJECT
 
@@ -45,6 +60,64 @@ public:
         int writesSinceLastPeriod;
         // duration of the last period, in milliseconds
         double lastPeriodMs;
+        // level, in number of samples, the buffer is filled to each period.
+        // Equal to capacity unless adaptive latency is enabled
+        int targetFill;
+    };
+
+    //
+    // Distributions of render timings, collected over all renders since the
+    // last call to clearDiagnostics.
+    //
+    struct TimingStats {
+        // time spent rendering each period, in microseconds
+        Histogram::Snapshot renderTime;
+        // difference between the actual and expected period, in microseconds
+        Histogram::Snapshot periodJitter;
+        // interval between calls to the device's callback, in microseconds
+        Histogram::Snapshot callbackInterval;
+        // playback buffer usage at the start of each period, in percent
+        // (not collected in low latency mode)
+        Histogram::Snapshot bufferFill;
+    };
+
+    //
+    // Changes made by the render thread that the GUI should display.
+    //
+    enum UpdateFlag {
+        NoUpdate = 0x0,
+        // a new engine frame was rendered, see currentFrame
+        FrameUpdate = 0x1,
+        // the visualizer buffer was modified
+        VisualizerUpdate = 0x2
+    };
+    Q_DECLARE_FLAGS(Updates, UpdateFlag)
+
+    //
+    // State of the output device, see setConfig
+    //
+    enum class DeviceState {
+        closed,     // no device, playback is disabled
+        opening,    // a device is being opened, the current one is still used
+        open        // ready for playback
+    };
+
+    //
+    // Determines how notes received from MIDI input are previewed.
+    //
+    struct MidiPreview {
+        enum Type {
+            None,       // MIDI notes are not previewed
+            Instrument, // same as instrumentPreview
+            Waveform    // same as waveformPreview
+        };
+
+        Type type;
+        // Instrument: track (0-3) for a note preview, -1 for an instrument preview
+        int track;
+        // Instrument: instrument id, or -1 for none (note previews only)
+        // Waveform: waveform id
+        int id;
     };
 
     explicit Renderer(Module &mod, QObject *parent = nullptr);
@@ -59,7 +132,7 @@ public:
     unsigned statUnderruns() const;
 
     //
-    // Gets the current buffer statistics.
+    // Gets the current buffer statistics, as of the last period.
     //
     BufferStats statBuffer();
 
@@ -69,16 +142,27 @@ public:
     //
     long statElapsed() const;
 
+    //
+    // Gets the current timing histograms. Never blocks the render thread.
+    //
+    TimingStats statTiming() const;
+
     //
     // Get the current samplerate
     //
     int samplerate();
 
     //
-    // Accessor for the visualizer buffer. The updateVisualizers() signal is
-    // emitted when this buffer is modified.
+    // Accessor for the visualizer buffer. VisualizerUpdate is set when this
+    // buffer is modified. Only read from the buffer, the renderer is its
+    // writer.
+    //
+    VisualizerBuffer& visualizerBuffer();
+
+    //
+    // Accessor for the output level meter, to be polled by the GUI.
     //
-    Guarded<VisualizerBuffer>& visualizerBuffer();
+    LevelMeter& levelMeter();
 
     //
     // Determines if the renderer is renderering sound.
@@ -96,16 +180,46 @@ public:
     bool isPlaying();
 
     //
-    // Gets a copy of the current engine frame.
+    // Gets a copy of the current engine frame. The frame is the last one
+    // published by the render thread, so this function never blocks.
     //
     trackerboy::Frame currentFrame();
 
     //
-    // Configures the output device with the given Sound config. If device
-    // cannot be configured, the renderer is disabled. This function must
-    // be called from the GUI thread.
+    // Gets the engine frame that is currently being heard. currentFrame is
+    // ahead of the output by the playback buffer and the device's latency,
+    // this function compensates for both using the frame history published
+    // by the render thread. The position is interpolated from the time of the
+    // last period, so that it advances between periods. Never blocks.
+    //
+    trackerboy::Frame playbackFrame();
+
+    //
+    // Gets and clears the updates made since the last call. Updates are
+    // coalesced instead of signalled, so that the GUI can poll them once per
+    // displayed frame rather than handling an event for every render period.
+    // Thread-safe, never blocks.
+    //
+    Updates takeUpdates();
+
+    //
+    // Configures the output device with the given Sound config. The device
+    // is opened in the background and configApplied is emitted when done.
+    // The current device keeps playing until the new one is ready, the render
+    // then switches over with only a brief pause. If the device cannot be
+    // configured, the renderer is disabled. This function must be called from
+    // the GUI thread.
     //
-    bool setConfig(SoundConfig const& config, AudioEnumerator const& enumerator);
+    void setConfig(SoundConfig const& config, AudioEnumerator const& enumerator);
+
+    DeviceState deviceState() const;
+
+    //
+    // Determines if the render thread was granted real-time scheduling by
+    // the last config applied. Always false in low latency mode, where the
+    // render runs on the device's thread.
+    //
+    bool isRealtime() const;
 
     //
     // Changes the note being previewed for an instrument/waveform preview.
@@ -189,6 +303,25 @@ public:
 
     void setChannelOutput(ChannelOutput::Flags output);
 
+    //
+    // Sets how MIDI notes are previewed. While set to something other than
+    // MidiPreview::None, the renderer keeps rendering (silence when idle) so
+    // that MIDI notes can start sounding without the GUI thread starting the
+    // audio stream.
+    //
+    void setMidiPreview(MidiPreview preview);
+
+    // MIDI thread ===========================================================
+    //
+    // Called from the MIDI input thread, only one thread may call these.
+    // Notes are queued for the render thread without blocking, and are
+    // applied at the position in the rendered block matching when they were
+    // received.
+
+    virtual void midiNoteOn(int note) override;
+
+    virtual void midiNoteOff() override;
+
 signals:
 
     //
@@ -212,14 +345,15 @@ signals:
     void audioError();
 
     //
-    // emitted when a new frame is renderered
+    // Emitted when the device requested by setConfig is ready, or could not
+    // be opened. When setConfig is called again before the device is ready,
+    // only the last request is reported.
     //
-    void frameSync();
+    void configApplied(bool success);
 
-    //
-    // Emitted when the visualizer buffer has been modified
-    //
-    void updateVisualizers();
+protected:
+
+    void timerEvent(QTimerEvent *evt) override;
 
 private:
 
@@ -237,6 +371,15 @@ private:
         instrument
     };
 
+    //
+    // Outcome of starting an instrument or waveform preview
+    //
+    enum class PreviewResult {
+        started,
+        busy,       // the module is locked and we could not wait for it
+        missing     // the instrument no longer exists, nothing to preview
+    };
+
     enum class State {
         running,    // render samples
         stopping,   // no longing synthesizing, transitions to stopped when the buffer empties
@@ -244,9 +387,91 @@ private:
     };
 
     //
-    // This struct contains shared data between the GUI thread and the
+    // A request from the GUI thread to the render thread. Commands are sent
+    // through a lock-free queue and are processed at the start of each render.
+    //
+    struct Command {
+
+        enum class Type {
+            play,               // param1: pattern, param2: row, param3: stepmode
+            step,               // step the next row, if stepping
+            stepOut,            // exit step mode
+            jump,               // param1: pattern
+            patternRepeat,      // param1: repeat
+            previewNote,        // param1: note
+            instrumentPreview,  // param1: note, param2: track, param3: instrument
+            waveformPreview,    // param1: note, param2: waveform
+            stopPreview,
+            stopMusic,
+            channelOutput,      // param1: ChannelOutput::Flags
+            resetVolume,
+            midiArm             // param1: keep rendering for MIDI notes
+        };
+
+        Type type;
+        int param1;
+        int param2;
+        int param3;
+
+        Command();
+        Command(Type type, int param1 = 0, int param2 = 0, int param3 = 0);
+    };
+
+    //
+    // A note received from MIDI input, sent from the MIDI thread to the
     // render thread.
     //
+    struct MidiNote {
+        bool noteOn;
+        int note;
+        Clock::time_point time;
+        // position in the current block, in samples (set by the render thread)
+        size_t offset;
+    };
+
+    static constexpr size_t MIDI_QUEUE_SIZE = 64;
+
+    //
+    // Start of an engine frame in the rendered output
+    //
+    struct FrameMark {
+        // sample position of the frame's first sample
+        uint64_t position;
+        trackerboy::Frame frame;
+    };
+
+    // number of frame marks kept, enough for the maximum latency setting at
+    // the default framerate
+    static constexpr size_t FRAME_HISTORY = 64;
+
+    //
+    // State published by the render thread for the GUI thread, once per
+    // render period.
+    //
+    struct Status {
+        trackerboy::Frame frame;
+        size_t writesSinceLastPeriod;
+        Clock::duration periodTime;
+        size_t targetFill;
+
+        // time of publishing
+        Clock::time_point time;
+        // samples rendered so far, as of time
+        uint64_t position;
+        // rendered samples not yet heard as of time
+        size_t latency;
+        // the most recent frames rendered, a ring buffer ending at frameHead
+        std::array<FrameMark, FRAME_HISTORY> frames;
+        size_t frameHead;
+        size_t frameCount;
+
+        Status();
+    };
+
+    //
+    // This struct contains all the data used for synthesis. It is owned by
+    // the render thread while rendering, and by the GUI thread otherwise.
+    //
     struct RenderContext {
         // the current module
         Module &mod;
@@ -270,47 +495,220 @@ private:
         PreviewState previewState;
         trackerboy::ChType previewChannel;
 
+        // channels enabled for music playback
+        ChannelOutput::Flags outputFlags;
+
         trackerboy::Frame currentEngineFrame;
 
         State state;
         int stopCounter;
+        // engine frames not stepped because the module was locked (low
+        // latency mode), caught up on the next frame
+        int skippedFrames;
 
         size_t bufferSize; // cache this here so we don't have to call mStream.bufferSize() in the render thread
 
+        // fill the buffer up to the controller's target instead of completely
+        bool adaptive;
+        LatencyController latency;
+
+        // MIDI notes are previewed, do not stop when idle
+        bool midiArmed;
+        // MIDI notes to apply during the current block
+        std::array<MidiNote, MIDI_QUEUE_SIZE> midiNotes;
+        size_t midiCount;
+        size_t midiNext;
+        // samples rendered in the current block
+        size_t midiPosition;
+
+        // command that could not be processed without waiting on the module
+        // (low latency mode), retried before any other command
+        Command deferredCommand;
+        bool commandDeferred;
+
+        // playback position, in samples rendered since rendering began
+        uint64_t position;
+        // recent frame starts, same layout as Status::frames
+        std::array<FrameMark, FRAME_HISTORY> frameHistory;
+        size_t frameHead;
+        size_t frameCount;
+        // output latency of the device, cached from mStream
+        size_t deviceLatency;
+
         // diagnostics
         Clock::time_point watchdog; // occurance of last watchdog reset
         Clock::time_point lastPeriod; // occurance of the last period
         Clock::duration periodTime; // time difference between the last period and the current one
         size_t writesSinceLastPeriod; // number of samples written for the last period
+        Clock::duration expectedPeriod; // timer interval from the sound config
+        bool firstPeriod; // true if lastPeriod is the time rendering started
 
         RenderContext(Module &mod);
     };
 
-    // type alias for mutually exclusive access to the RenderContext
-    using Handle = Locked<RenderContext>;
+    // GUI thread ------------------------------------------------------------
+
+    //
+    // Sends a command to the render thread. If the render thread is not
+    // running, the command is processed immediately.
+    //
+    void sendCommand(Command const& cmd);
+
+    //
+    // Stops the render thread so that the context can be modified from the
+    // GUI thread. Returns true if the render thread was running, in which
+    // case resumeRender must be called afterwards. In low latency mode the
+    // render thread is the device's thread, so the stream is stopped.
+    //
+    bool pauseRender();
+
+    //
+    // Restarts the render thread after pauseRender. Does nothing if the render
+    // thread requested a stop, finishRender will resume it if needed.
+    //
+    void resumeRender();
+
+    //
+    // Start the audio stream and render thread for the configured device. If
+    // rendering has already begun, this function does nothing.
+    //
+    void beginRender();
+
+    //
+    // Stops the render thread and takes back ownership of the context.
+    //
+    void endRender();
+
+    //
+    // Immediately stops the render without letting the buffer drain.
+    //
+    void stopRender(bool aborted = false);
+
+    //
+    // Keeps the render thread running for MIDI notes, starting it if needed.
+    //
+    void armMidi();
+
+    //
+    // Completes a stop requested by the render thread via requestStop, called
+    // when mStopPoll sees the request.
+    //
+    void finishRender(bool aborted);
+
+    //
+    // Switches to the device prepared by setConfig and applies the rest of
+    // the config.
+    //
+    void finishConfig();
+
+    //
+    // Applies the real-time settings to the timer's thread and locks the
+    // memory used while rendering. The render must be paused.
+    //
+    void applyRealtime(SoundConfig const& soundConfig);
+
+    // Render thread (or the GUI thread when not rendering) ------------------
+
+    //
+    // Processes the queued commands. If canWait is false, a command that
+    // cannot lock the module without waiting is deferred to the next call,
+    // along with the commands queued after it.
+    //
+    void processCommands(bool canWait);
+
+    //
+    // Returns false if the command was not processed because the module was
+    // locked and canWait is false.
+    //
+    bool processCommand(Command const& cmd, bool canWait);
 
     // sets up the engine to play starting at the given pattern and row
-    void _play(Handle &handle, int pattern, int row, bool stepping = false);
+    void _play(int pattern, int row, bool stepping);
 
-    void _stopMusic(Handle &handle);
+    void _stopMusic();
 
     // utility function for preview slots
-    void resetPreview(Handle &handle);
+    void resetPreview();
+
+    //
+    // Start a preview. The module is locked to look up the instrument or
+    // waveform, if canWait is false the preview does not start when the
+    // module is already locked. The current preview is kept if the new one
+    // does not start.
+    //
+    PreviewResult _instrumentPreview(int note, int track, int instrumentId, bool canWait);
+
+    PreviewResult _waveformPreview(int note, int waveId, bool canWait);
+
+    void _setChannelOutput(ChannelOutput::Flags flags);
+
+    //
+    // Puts the context in the running state, called by commands that
+    // produce sound.
+    //
+    void setRunning();
+
+    //
+    // Stops the timer and flags the GUI thread to stop the stream. Must be
+    // called from the render thread. Nothing is posted to the GUI, since in
+    // low latency mode this is the device's callback: the request is polled
+    // by the GUI thread instead (mStopPoll).
+    //
+    void requestStop(bool aborted);
+
+    //
+    // Synthesizes up to the given number of samples into the buffer. Fewer
+    // samples are returned only when the renderer is stopping. If canWait is
+    // false, the module is not waited on and the engine may be stepped late.
+    //
+    size_t synthesize(float *out, size_t samples, bool &newFrame, bool canWait);
+
+    //
+    // Takes the queued MIDI notes for a block of the given size, rendered
+    // for the period ending at now. Each note's offset in the block is
+    // its time in the period, so that notes keep their relative timing.
+    //
+    void beginMidi(Clock::time_point now, size_t samples);
+
+    //
+    // Same as synthesize, but applies the block's MIDI notes when their
+    // offset is reached.
+    //
+    size_t synthesizeMidi(float *out, size_t samples, bool &newFrame, bool canWait);
 
-    void previewNoteOrInstrument(int note, int track = -1, int instrument = -1);
+    //
+    // Applies the MIDI notes not yet applied in the block.
+    //
+    void endMidi(bool canWait);
 
-    void _setChannelOutput(Handle &handle, ChannelOutput::Flags flags);
+    //
+    // Starts or stops a preview for the note. If the module cannot be locked
+    // without waiting, or the instrument was removed, the note is dropped.
+    //
+    void applyMidiNote(MidiNote const& note, bool canWait);
 
-    // stream management -----------------------------------------------------
+    //
+    // Records the jitter of the current period, given the expected period.
+    //
+    void recordPeriod(Clock::duration expected);
+
+    //
+    // Adds the current engine frame to the frame history, starting at the
+    // given sample position.
+    //
+    void markFrame(uint64_t position);
 
     //
-    // Start the audio callback thread for the configured device. If the audio
-    // callback thread is already running, the stop countdown is cancelled
+    // Publishes the render's results to the GUI thread. now is the time the
+    // period began and latency is the number of rendered samples that have
+    // not been heard yet.
     //
-    void beginRender(Handle &handle);
+    void publish(bool haltedBefore, bool newFrame, Clock::time_point now, size_t latency);
 
     static void timerCallback(void *userData);
 
+    static size_t renderCallback(void *userData, float *out, size_t frames);
+
     //
     // Fills the playback buffer with newly renderered samples. Stops rendering
     // if there is no work to do and the buffer has drained completely.
@@ -320,9 +718,11 @@ private:
     void render();
 
     //
-    // Immediately stops the render without letting the buffer drain.
+    // Low latency mode: renders samples directly into the device's buffer.
+    //
+    // This function is called from the audio device's thread.
     //
-    void stopRender(Handle &handle, bool aborted = false);
+    size_t renderDirect(float *out, size_t frames);
 
     // class members ---------------------------------------------------------
 
@@ -330,18 +730,56 @@ private:
     FastTimer *mTimer;      // thread-safe: yes
 
     AudioStream mStream;    // thread-safe: no
-    Guarded<VisualizerBuffer> mVisBuffer;
-
-    ChannelOutput::Flags mOutputFlags;
+    VisualizerBuffer mVisBuffer;    // thread-safe: readers only, written with the context
+    LevelMeter mLevelMeter;         // thread-safe: poll only, measured with the context
 
+    // GUI thread only
     Clock::time_point mRenderStartTime;
-
-    //
-    // All variables accessible from multiple threads are stored in the RenderContext
-    // struct, access to them is guarded by a mutex.
-    //
-    Guarded<RenderContext> mContext;
-    
-
+    // true when the render thread owns mContext
+    bool mRendering;
+    // polls mStopRequested while rendering
+    QBasicTimer mStopPoll;
+    // GUI copy of the stepping flag
+    bool mStepping;
+    // true when rendering from the device callback instead of the timer,
+    // only modified while not rendering
+    bool mLowLatency;
+    // last config given to setConfig, applied by finishConfig
+    SoundConfig mConfig;
+    // render requested while the first device was being opened
+    bool mRenderPending;
+    // the timer's thread was given real-time scheduling
+    bool mRealtime;
+    // the timer's thread scheduling or affinity has been changed
+    bool mRealtimeApplied;
+    // memory touched by the render, when real-time
+    MemoryLock mMemoryLock;
+
+    // set by the render thread when it has stopped itself via requestStop
+    std::atomic_bool mStopRequested;
+    // whether the requested stop was due to an error, set before mStopRequested
+    std::atomic_bool mStopAborted;
+
+    RenderContext mContext;
+
+    // GUI -> render thread
+    SpscQueue<Command, 256> mCommands;
+    // MIDI -> render thread
+    SpscQueue<MidiNote, MIDI_QUEUE_SIZE> mMidiNotes;
+    // packed MidiPreview, set by the GUI and read by the render thread
+    std::atomic_uint32_t mMidiPreview;
+    // GUI copy of the armed state
+    bool mMidiArmed;
+    // render thread -> GUI
+    TripleBuffer<Status> mStatus;
+    // pending UpdateFlags, set by the render thread and taken by the GUI
+    std::atomic_int mUpdates;
+
+    // recorded by the render thread, read by the GUI
+    Histogram mRenderTimeStat;
+    Histogram mJitterStat;
+    Histogram mBufferFillStat;
 
 };
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(Renderer::Updates)
@@ -41,6 +41,10 @@ size_t RingbufferBase::size() const {
     return mSize;
 }
 
+void const* RingbufferBase::data() const {
+    return mInitialized ? mRingbuffer.pBuffer : nullptr;
+}
+
 size_t RingbufferBase::read(void *data, size_t sizeInBytes) {
     size_t bytesToRead = sizeInBytes;
     void *src;
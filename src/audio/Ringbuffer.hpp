@@ -18,6 +18,11 @@ public:
 
     void reset();
 
+    //
+    // Storage used by the ringbuffer, nullptr if not initialized.
+    //
+    void const* data() const;
+
 protected:
     RingbufferBase();
 
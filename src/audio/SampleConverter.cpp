@@ -0,0 +1,172 @@
+
+#include "audio/SampleConverter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// SSE2 is part of the x86-64 baseline, so no extra compiler flags or runtime
+// detection are needed
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SAMPLE_CONVERTER_SSE2
+#include <emmintrin.h>
+#endif
+
+#define TU SampleConverterTU
+namespace TU {
+
+// full scale is symmetric, the most negative integer is only reached by clipping
+static constexpr float PCM16_SCALE = 32767.0f;
+static constexpr float PCM16_MIN = -32768.0f;
+static constexpr float PCM16_MAX = 32767.0f;
+
+static constexpr float PCM24_SCALE = 8388607.0f;
+static constexpr float PCM24_MIN = -8388608.0f;
+static constexpr float PCM24_MAX = 8388607.0f;
+
+// bit pattern of 1.0f
+static constexpr uint32_t FLOAT_ONE = 0x3F800000;
+
+static inline uint32_t xorshift(uint32_t &state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+//
+// Converts random bits to a float in [0, 1), using the upper 23 bits as the
+// mantissa of a float in [1, 2).
+//
+static inline float uniform(uint32_t bits) {
+    uint32_t const repr = (bits >> 9) | FLOAT_ONE;
+    float result;
+    std::memcpy(&result, &repr, sizeof(result));
+    return result - 1.0f;
+}
+
+static inline void store16(uint8_t *out, int32_t sample) {
+    out[0] = (uint8_t)sample;
+    out[1] = (uint8_t)(sample >> 8);
+}
+
+static inline void store24(uint8_t *out, int32_t sample) {
+    out[0] = (uint8_t)sample;
+    out[1] = (uint8_t)(sample >> 8);
+    out[2] = (uint8_t)(sample >> 16);
+}
+
+#ifdef SAMPLE_CONVERTER_SSE2
+
+static inline __m128i xorshift4(__m128i &state) {
+    state = _mm_xor_si128(state, _mm_slli_epi32(state, 13));
+    state = _mm_xor_si128(state, _mm_srli_epi32(state, 17));
+    state = _mm_xor_si128(state, _mm_slli_epi32(state, 5));
+    return state;
+}
+
+static inline __m128 uniform4(__m128i bits) {
+    auto const repr = _mm_or_si128(_mm_srli_epi32(bits, 9), _mm_set1_epi32((int)FLOAT_ONE));
+    return _mm_sub_ps(_mm_castsi128_ps(repr), _mm_set1_ps(1.0f));
+}
+
+#endif
+
+}
+
+
+SampleConverter::SampleConverter(Wav::Format format, bool dither) :
+    mFormat(format),
+    mDither(dither),
+    mSimd(hasSimd()),
+    mRng{ 0x9E3779B9, 0x7F4A7C15, 0x85EBCA6B, 0xC2B2AE35 }
+{
+}
+
+Wav::Format SampleConverter::format() const {
+    return mFormat;
+}
+
+bool SampleConverter::dither() const {
+    return mDither;
+}
+
+bool SampleConverter::hasSimd() {
+    #ifdef SAMPLE_CONVERTER_SSE2
+    return true;
+    #else
+    return false;
+    #endif
+}
+
+void SampleConverter::setSimdEnabled(bool enabled) {
+    mSimd = enabled && hasSimd();
+}
+
+void SampleConverter::convert(float const *in, void *out, size_t count) {
+    if (mFormat == Wav::Format::float32) {
+        std::copy_n(in, count, static_cast<float*>(out));
+    } else {
+        convertInt(in, static_cast<uint8_t*>(out), count);
+    }
+}
+
+void SampleConverter::convertInt(float const *in, uint8_t *out, size_t count) {
+    bool const is16 = mFormat == Wav::Format::pcm16;
+    float const scale = is16 ? TU::PCM16_SCALE : TU::PCM24_SCALE;
+    float const lo = is16 ? TU::PCM16_MIN : TU::PCM24_MIN;
+    float const hi = is16 ? TU::PCM16_MAX : TU::PCM24_MAX;
+
+    size_t i = 0;
+
+    #ifdef SAMPLE_CONVERTER_SSE2
+    if (mSimd) {
+        auto const vscale = _mm_set1_ps(scale);
+        auto const vlo = _mm_set1_ps(lo);
+        auto const vhi = _mm_set1_ps(hi);
+        auto rng = _mm_loadu_si128(reinterpret_cast<__m128i const*>(mRng.data()));
+        alignas(16) int32_t samples[4];
+
+        for (; i + 4 <= count; i += 4) {
+            auto v = _mm_mul_ps(_mm_loadu_ps(in + i), vscale);
+            if (mDither) {
+                auto const r1 = TU::uniform4(TU::xorshift4(rng));
+                auto const r2 = TU::uniform4(TU::xorshift4(rng));
+                v = _mm_add_ps(v, _mm_sub_ps(r1, r2));
+            }
+            v = _mm_min_ps(_mm_max_ps(v, vlo), vhi);
+            // rounds to nearest, same as lrint in the scalar path
+            auto const iv = _mm_cvtps_epi32(v);
+
+            if (is16) {
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i * 2), _mm_packs_epi32(iv, iv));
+            } else {
+                _mm_store_si128(reinterpret_cast<__m128i*>(samples), iv);
+                auto dest = out + i * 3;
+                for (auto sample : samples) {
+                    TU::store24(dest, sample);
+                    dest += 3;
+                }
+            }
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(mRng.data()), rng);
+    }
+    #endif
+
+    // scalar path, or the remaining samples from the SIMD path
+    for (; i < count; ++i) {
+        auto v = in[i] * scale;
+        if (mDither) {
+            v += TU::uniform(TU::xorshift(mRng[0])) - TU::uniform(TU::xorshift(mRng[0]));
+        }
+        auto const sample = (int32_t)std::lrint(std::clamp(v, lo, hi));
+        if (is16) {
+            TU::store16(out + i * 2, sample);
+        } else {
+            TU::store24(out + i * 3, sample);
+        }
+    }
+}
+
+#undef TU
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "audio/Wav.hpp"
+
+#include <QtGlobal>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+//
+// Converts float samples to the sample formats supported by Wav. Samples
+// converted to an integer format are clipped, and can optionally be dithered
+// with triangular (TPDF) noise of +/- 1 LSB.
+//
+// Conversion is vectorized using SSE2 when available, with a scalar fallback
+// for other targets.
+//
+class SampleConverter {
+
+public:
+
+    explicit SampleConverter(Wav::Format format, bool dither = false);
+
+    Wav::Format format() const;
+
+    bool dither() const;
+
+    //
+    // Returns true if the SIMD conversion kernels are available on this
+    // target.
+    //
+    static bool hasSimd();
+
+    //
+    // Enables or disables the SIMD kernels, they are enabled by default when
+    // available. Only useful for testing.
+    //
+    void setSimdEnabled(bool enabled);
+
+    //
+    // Converts count samples from in to out. The output buffer must be at
+    // least count * Wav::sampleSize(format()) bytes.
+    //
+    void convert(float const *in, void *out, size_t count);
+
+private:
+    Q_DISABLE_COPY(SampleConverter)
+
+    void convertInt(float const *in, uint8_t *out, size_t count);
+
+    Wav::Format mFormat;
+    bool mDither;
+    bool mSimd;
+
+    // xorshift state for dither noise, one per SIMD lane
+    std::array<uint32_t, 4> mRng;
+
+};
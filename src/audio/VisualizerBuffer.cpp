@@ -3,13 +3,28 @@
 
 #include <algorithm>
 
-#include <QtGlobal>
+
+VisualizerBuffer::Snapshots::Snapshots(size_t size) :
+    size(size),
+    samples(std::make_unique<std::atomic<float>[]>(size * 2 * SNAPSHOTS)),
+    sequences(),
+    newest(0)
+{
+    for (auto &sequence : sequences) {
+        sequence.store(0, std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < size * 2 * SNAPSHOTS; ++i) {
+        samples[i].store(0.0f, std::memory_order_relaxed);
+    }
+}
 
 VisualizerBuffer::VisualizerBuffer() :
     mBufferData(),
     mBufferSize(0),
     mIndex(0),
-    mIgnoreCounter(0)
+    mIgnoreCounter(0),
+    mWriterSnapshots(std::make_shared<Snapshots>(0)),
+    mSnapshots(mWriterSnapshots)
 {
 }
 
@@ -17,6 +32,7 @@ void VisualizerBuffer::clear() {
     std::fill_n(mBufferData.get(), mBufferSize * 2, 0.0f);
     mIndex = 0;
     mIgnoreCounter = 0;
+    publish();
 }
 
 void VisualizerBuffer::resize(size_t size) {
@@ -27,51 +43,16 @@ void VisualizerBuffer::resize(size_t size) {
         auto samples = size * 2;
         mBufferData = std::make_unique<float[]>(samples);
 
+        // readers still holding the old snapshots keep them alive until
+        // they are done
+        mWriterSnapshots = std::make_shared<Snapshots>(size);
+        std::atomic_store(&mSnapshots, mWriterSnapshots);
+
         // resize the buffer clears it
         clear();
     }
 }
 
-size_t VisualizerBuffer::size() const {
-    return mBufferSize;
-}
-
-
-void VisualizerBuffer::read(size_t index, float &outLeft, float &outRight) {
-    Q_ASSERT(index < mBufferSize);
-
-    index = (index + mIndex) % mBufferSize;
-
-    auto buf = mBufferData.get() + (index * 2);
-    outLeft = *buf++;
-    outRight = *buf;
-
-}
-
-void VisualizerBuffer::averageSample(float index, float bin, float &outLeft, float &outRight) {
-    
-    // determine the number of samples to average, with a minimum of 1 sample
-    int samples = std::max(1, (int)((index + bin) - (int)index));
-
-    size_t bufIndex = (mIndex + (size_t)index) % mBufferSize;
-    auto buf = mBufferData.get() + (bufIndex * 2);
-
-    float sumLeft = 0.0f;
-    float sumRight = 0.0f;
-    for (int i = 0; i < samples; ++i) {
-        sumLeft += *buf++;
-        sumRight += *buf++;
-        if (++bufIndex == mBufferSize) {
-            bufIndex = 0;
-            buf = mBufferData.get();
-        }
-    }
-    
-    outLeft = (float)sumLeft / samples;
-    outRight = (float)sumRight / samples;
-
-}
-
 void VisualizerBuffer::beginWrite(size_t amount) {
 
     if (amount > mBufferSize) {
@@ -81,7 +62,7 @@ void VisualizerBuffer::beginWrite(size_t amount) {
     }
 }
 
-void VisualizerBuffer::write(float buf[], size_t amount) {
+void VisualizerBuffer::write(float const buf[], size_t amount) {
 
     auto ignoring = std::min(mIgnoreCounter, amount);
     amount -= ignoring;
@@ -121,3 +102,81 @@ void VisualizerBuffer::write(float buf[], size_t amount) {
     }
 
 }
+
+void VisualizerBuffer::endWrite() {
+    publish();
+}
+
+void VisualizerBuffer::publish() {
+    auto &snapshots = *mWriterSnapshots;
+    auto const count = mBufferSize * 2;
+    if (count == 0) {
+        return;
+    }
+
+    // write to the oldest snapshot, the newest one stays readable
+    auto const index = (snapshots.newest.load(std::memory_order_relaxed) + 1) % SNAPSHOTS;
+    auto &sequence = snapshots.sequences[index];
+    auto const seq = sequence.load(std::memory_order_relaxed);
+    sequence.store(seq + 1, std::memory_order_relaxed);
+    // the odd sequence must be visible before any of the samples
+    std::atomic_thread_fence(std::memory_order_release);
+
+    // linearize, oldest sample first
+    auto dest = snapshots.samples.get() + index * count;
+    auto const oldest = (mBufferSize - mIndex) * 2;
+    auto src = mBufferData.get() + (mIndex * 2);
+    for (size_t i = 0; i < oldest; ++i) {
+        dest[i].store(src[i], std::memory_order_relaxed);
+    }
+    src = mBufferData.get();
+    for (size_t i = oldest; i < count; ++i) {
+        dest[i].store(src[i - oldest], std::memory_order_relaxed);
+    }
+
+    sequence.store(seq + 2, std::memory_order_release);
+    snapshots.newest.store(index, std::memory_order_release);
+}
+
+void VisualizerBuffer::lockMemory(MemoryLock &lock) const {
+    lock.lock(mBufferData.get(), mBufferSize * 2 * sizeof(float), "visualizer buffer");
+    if (mWriterSnapshots) {
+        lock.lock(
+            mWriterSnapshots->samples.get(),
+            mWriterSnapshots->size * 2 * SNAPSHOTS * sizeof(std::atomic<float>),
+            "visualizer snapshots"
+        );
+    }
+}
+
+size_t VisualizerBuffer::read(std::vector<float> &dest) const {
+    auto const snapshotsPtr = std::atomic_load(&mSnapshots);
+    auto const& snapshots = *snapshotsPtr;
+    auto const count = snapshots.size * 2;
+    dest.resize(count);
+    if (count == 0) {
+        return 0;
+    }
+
+    for (;;) {
+        auto const index = snapshots.newest.load(std::memory_order_acquire);
+        auto const& sequence = snapshots.sequences[index];
+        auto const seq = sequence.load(std::memory_order_acquire);
+        if (seq & 1) {
+            // the writer lapped us and is rewriting this snapshot
+            continue;
+        }
+
+        auto src = snapshots.samples.get() + index * count;
+        for (size_t i = 0; i < count; ++i) {
+            dest[i] = src[i].load(std::memory_order_relaxed);
+        }
+
+        // the copy must complete before checking the sequence again
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) == seq) {
+            return snapshots.size;
+        }
+        // torn read, retry with the newest snapshot
+    }
+}
@@ -1,52 +1,70 @@
 #pragma once
 
+#include "utils/realtime.hpp"
+
+#include <QtGlobal>
+
+#include <array>
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <vector>
 
 
 //
 // Audio buffer for visualizers.
-// 
-// 
-// The buffer is a rotating sample buffer, with newest data at the end of the buffer
-// The index determines the starting and ending position of the buffer
-// 
+//
+// The writer (the render thread) keeps a rotating sample buffer, with newest
+// data at the end of the buffer. The index determines the starting and ending
+// position of the buffer
+//
 // 0 0 0 0 0
 // ^
-// 
+//
 // write A B C to the buffer (0 is now the oldest, C is the newest)
-// 
+//
 // A B C 0 0
 //       ^
-// 
+//
 // write D E F to the buffer (B is now the oldest, F is the newest)
-// 
+//
 // F B C D E
 //   ^
-// 
+//
 // When the index gets to the end of the buffer, it wraps (rotates) to the start
 // The index points to the oldest sample in the buffer, the sample before it is the newest.
 //
+// Readers never access the rotating buffer. Instead, endWrite publishes a copy
+// of it to a ring of snapshots, each guarded by a sequence number (seqlock).
+// A reader copies the newest snapshot and checks that its sequence number did
+// not change during the copy, retrying if the writer overwrote it. The writer
+// never waits on a reader, and any number of threads may read.
+//
 class VisualizerBuffer {
 
+    // number of snapshots, the writer has to publish this many times during a
+    // single read for that read to be retried
+    static constexpr size_t SNAPSHOTS = 4;
+
 public:
     VisualizerBuffer();
     ~VisualizerBuffer() = default;
 
-    void clear();
-
-    void resize(size_t size);
-
-    size_t size() const;
+    // Writer ================================================================
+    //
+    // Only one thread may write at a time.
 
-    void read(size_t index, float &outLeft, float &outRight);
+    //
+    // Clears the buffer to silence, and publishes it.
+    //
+    void clear();
 
     //
-    // Computes the average left and right samples for the given index and bin
-    // size. Bin size refers to the ratio of samples per pixel. ie, a bin size
-    // of 2.5 means that 2.5 samples are represented by a single pixel.
+    // Sets the size of the buffer in stereo samples, clearing it. Readers
+    // reading during the resize will get the old size.
     //
-    void averageSample(float index, float bin, float &outLeft, float &outRight);
+    void resize(size_t size);
 
     //
     // Begin a write operation. If amount is greater than this buffer's
@@ -57,16 +75,58 @@ public:
     //
     void beginWrite(size_t amount);
 
-    void write(float buf[], size_t amount);
+    void write(float const buf[], size_t amount);
 
+    //
+    // Ends a write operation, publishing the buffer to readers. Wait-free.
+    //
+    void endWrite();
+
+    //
+    // Locks the memory used by the writer with the given lock, it must be
+    // unlocked before the buffer is resized.
+    //
+    void lockMemory(MemoryLock &lock) const;
+
+    // Reader ================================================================
+
+    //
+    // Copies the most recently published buffer to dest, oldest sample first.
+    // dest is resized to fit the buffer. The size of the buffer in stereo
+    // samples is returned, 0 if the buffer has no size. Thread-safe, never
+    // blocks the writer.
+    //
+    size_t read(std::vector<float> &dest) const;
 
 private:
+    Q_DISABLE_COPY(VisualizerBuffer)
+
+    //
+    // Published snapshots. Samples are stored as relaxed atomics so that
+    // reading a snapshot while it is being written is well-defined, the read
+    // is then discarded by checking the sequence number.
+    //
+    struct Snapshots {
+        size_t size;
+        std::unique_ptr<std::atomic<float>[]> samples;
+        // odd while the snapshot is being written
+        std::array<std::atomic_uint32_t, SNAPSHOTS> sequences;
+        // index of the newest snapshot
+        std::atomic_size_t newest;
+
+        explicit Snapshots(size_t size);
+    };
 
+    void publish();
+
+    // writer only
     std::unique_ptr<float[]> mBufferData;
     size_t mBufferSize;
-
     size_t mIndex;
-
     size_t mIgnoreCounter;
+    std::shared_ptr<Snapshots> mWriterSnapshots;
+
+    // replaced by the writer on resize, readers hold a reference while reading
+    std::shared_ptr<Snapshots> mSnapshots;
 
 };
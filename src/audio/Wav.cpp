@@ -10,7 +10,8 @@ namespace WavPrivate {
 #pragma pack(push, 1)
 
 //
-// Header for wav files with 32-bit floating point samples
+// Header for wav files. The same layout is used for all sample formats, the
+// fact subchunk is optional for integer PCM but is still valid.
 //
 struct WavHeader {
 
@@ -25,12 +26,12 @@ struct WavHeader {
     // fmt subchunk
     char fmtId[4];              // = "fmt "
     uint32_t fmtChunkSize;      // = 18
-    uint16_t fmtTag;            // = 0x3 for IEEE_FLOAT
+    uint16_t fmtTag;            // [B] = 0x3 for IEEE_FLOAT, 0x1 for PCM
     uint16_t fmtChannels;       // [B]
     uint32_t fmtSampleRate;     // [B]
-    uint32_t fmtAvgBytesPerSec; // [B] = 4 * fmtSampleRate * fmtChannels
-    uint16_t fmtBlockAlign;     // [B] = 4 * fmtChannels
-    uint16_t fmtBitsPerSample;  // = 32
+    uint32_t fmtAvgBytesPerSec; // [B] = sampleSize * fmtSampleRate * fmtChannels
+    uint16_t fmtBlockAlign;     // [B] = sampleSize * fmtChannels
+    uint16_t fmtBitsPerSample;  // [B] = 8 * sampleSize
     uint16_t fmtCbSize;         // = 0
     // fact subchunk
     char factId[4];             // = "fact"
@@ -71,19 +72,37 @@ struct WavHeader {
 
 
 
-Wav::Wav(std::string const& filename, int channels, int samplerate) :
+int Wav::sampleSize(Format format) {
+    switch (format) {
+        case Format::pcm16:
+            return 2;
+        case Format::pcm24:
+            return 3;
+        default:
+            return 4;
+    }
+}
+
+Wav::Wav(std::string const& filename, int channels, int samplerate, Format format) :
     mStream(filename, std::ios::out | std::ios::binary),
     mSampleCount(0),
     mChannels(channels),
-    mSamplingRate(samplerate)
+    mSamplingRate(samplerate),
+    mFormat(format)
 {
     assert(channels > 0);
     assert(samplerate > 0);
 
+    auto const size = sampleSize(format);
+
     WavPrivate::WavHeader header;
+    if (format != Format::float32) {
+        header.fmtTag = 0x1;
+    }
     header.fmtChannels = mChannels;
     header.fmtSampleRate = mSamplingRate;
-    uint16_t bytesPerChannel = mChannels * 4;
+    header.fmtBitsPerSample = size * 8;
+    uint16_t bytesPerChannel = mChannels * size;
     header.fmtAvgBytesPerSec = bytesPerChannel * mSamplingRate;
     header.fmtBlockAlign = bytesPerChannel;
 
@@ -94,7 +113,7 @@ Wav::Wav(std::string const& filename, int channels, int samplerate) :
 
 Wav::~Wav() {
     uint32_t totalSamples = static_cast<uint32_t>(mSampleCount);
-    uint32_t dataChunkSize = totalSamples * mChannels * 4;
+    uint32_t dataChunkSize = totalSamples * mChannels * sampleSize(mFormat);
 
     // chunk size totals
     // 4: riff chunk
@@ -129,10 +148,19 @@ std::ofstream const& Wav::stream() const {
     return mStream;
 }
 
+Wav::Format Wav::format() const {
+    return mFormat;
+}
+
 void Wav::write(float buf[], std::size_t nsamples) {
+    assert(mFormat == Format::float32);
+    writeRaw(buf, nsamples);
+}
+
+void Wav::writeRaw(void const *buf, std::size_t nsamples) {
 
-    std::size_t totalSamples = mChannels * nsamples;
-    mStream.write(reinterpret_cast<const char*>(buf), totalSamples * sizeof(float));
+    std::size_t totalBytes = mChannels * nsamples * sampleSize(mFormat);
+    mStream.write(reinterpret_cast<const char*>(buf), totalBytes);
     if (!mStream.good()) {
         return;
     }
@@ -8,7 +8,9 @@
 ** and samplerate. Then write as many samples you want to it via the write
 ** method. Note that for multichannel data, the samples are interleaved.
 **
-** This library only writes wav files using 32-bit float samples.
+** Samples can be stored as 32-bit float, or as 16-bit or 24-bit integer PCM.
+** Only float samples can be written directly, integer samples must be
+** converted by the caller and written with writeRaw.
 **
 ** stoneface86
 **
@@ -52,12 +54,27 @@ class Wav {
 
 public:
 
+    enum class Format {
+        float32,    // 32-bit IEEE float
+        pcm16,      // 16-bit signed integer
+        pcm24       // 24-bit signed integer, packed little endian
+    };
 
     //
-    // Opens a wav file for writing sample data with the given channel count
-    // and samplerate. Existing files will be overwritten.
+    // Gets the size, in bytes, of a single sample in the given format.
     //
-    explicit Wav(std::string const& filename, int channels, int samplerate);
+    static int sampleSize(Format format);
+
+    //
+    // Opens a wav file for writing sample data with the given channel count,
+    // samplerate and sample format. Existing files will be overwritten.
+    //
+    explicit Wav(
+        std::string const& filename,
+        int channels,
+        int samplerate,
+        Format format = Format::float32
+    );
 
     //
     // Adjusts the wav header with the final number of samples written and
@@ -70,12 +87,22 @@ public:
     //
     std::ofstream const& stream() const;
 
+    Format format() const;
+
     //
     // Writes the given number of samples from the given buffer to the wav
     // file. The buffer should be at least the size of nsamples * channels.
+    // The format of the file must be float32.
     //
     void write(float buf[], std::size_t nsamples);
 
+    //
+    // Writes the given number of samples, already encoded in the file's
+    // format. The buffer should be at least the size of
+    // nsamples * channels * sampleSize(format()) bytes.
+    //
+    void writeRaw(void const *buf, std::size_t nsamples);
+
 private:
 
     // non-copyable
@@ -91,5 +118,6 @@ private:
 
     int mChannels;
     int mSamplingRate;
+    Format mFormat;
 
 };
@@ -0,0 +1,137 @@
+
+#include "audio/WavWriter.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+
+WavWriter::WavWriter(
+    std::string const& filename,
+    int channels,
+    int samplerate,
+    Wav::Format format,
+    bool dither,
+    size_t blockSize
+) :
+    mWav(std::make_unique<Wav>(filename, channels, samplerate, format)),
+    mChannels(channels),
+    mConverter(format, dither),
+    mEncoded(),
+    mFailed(!mWav->stream().good()),
+    mFront(),
+    mFrontCount(0),
+    mMutex(),
+    mBackReady(),
+    mBackFree(),
+    mBack(),
+    mBackCount(0),
+    mBackPending(false),
+    mQuit(false),
+    mThread()
+{
+    // blocks hold a whole number of multichannel samples
+    auto blockSamples = std::max(blockSize / (sizeof(float) * channels), (size_t)1);
+    mFront.resize(blockSamples * channels);
+    mBack.resize(blockSamples * channels);
+    if (format != Wav::Format::float32) {
+        mEncoded.resize(mBack.size() * Wav::sampleSize(format));
+    }
+
+    mThread.reset(QThread::create([this]() {
+        ioLoop();
+    }));
+    mThread->start();
+}
+
+WavWriter::~WavWriter() {
+    close();
+}
+
+bool WavWriter::good() const {
+    return !mFailed.load(std::memory_order_relaxed);
+}
+
+void WavWriter::write(float const buf[], size_t nsamples) {
+    assert(mThread);
+
+    auto count = nsamples * mChannels;
+    while (count) {
+        auto const toCopy = std::min(count, mFront.size() - mFrontCount);
+        std::copy_n(buf, toCopy, mFront.data() + mFrontCount);
+        mFrontCount += toCopy;
+        buf += toCopy;
+        count -= toCopy;
+
+        if (mFrontCount == mFront.size()) {
+            submit();
+        }
+    }
+}
+
+void WavWriter::close() {
+    if (!mThread) {
+        return;
+    }
+
+    if (mFrontCount) {
+        submit();
+    }
+
+    mMutex.lock();
+    mQuit = true;
+    mBackReady.wakeOne();
+    mMutex.unlock();
+
+    mThread->wait();
+    mThread.reset();
+
+    // the wav header is finalized on destruction
+    mWav.reset();
+}
+
+void WavWriter::submit() {
+    QMutexLocker locker(&mMutex);
+    while (mBackPending) {
+        mBackFree.wait(&mMutex);
+    }
+
+    std::swap(mFront, mBack);
+    mBackCount = mFrontCount;
+    mBackPending = true;
+    mBackReady.wakeOne();
+
+    mFrontCount = 0;
+}
+
+void WavWriter::ioLoop() {
+    QMutexLocker locker(&mMutex);
+    for (;;) {
+        while (!mBackPending && !mQuit) {
+            mBackReady.wait(&mMutex);
+        }
+
+        if (!mBackPending) {
+            // quit, and nothing left to write
+            break;
+        }
+
+        // the back block belongs to this thread until mBackPending is cleared
+        locker.unlock();
+        if (good()) {
+            auto const nsamples = mBackCount / mChannels;
+            if (mEncoded.empty()) {
+                mWav->write(mBack.data(), nsamples);
+            } else {
+                mConverter.convert(mBack.data(), mEncoded.data(), mBackCount);
+                mWav->writeRaw(mEncoded.data(), nsamples);
+            }
+            if (!mWav->stream().good()) {
+                mFailed = true;
+            }
+        }
+        locker.relock();
+
+        mBackPending = false;
+        mBackFree.wakeOne();
+    }
+}
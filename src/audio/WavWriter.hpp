@@ -0,0 +1,102 @@
+#pragma once
+
+#include "audio/SampleConverter.hpp"
+#include "audio/Wav.hpp"
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+//
+// Buffered, asynchronous writer for wav files. Samples are accumulated into
+// large blocks which are written to disk by a dedicated I/O thread. Two
+// blocks are used, so that the caller can fill one while the other is being
+// written, overlapping sample generation with disk I/O.
+//
+// Samples are always given as float, conversion to the file's sample format
+// is also done by the I/O thread.
+//
+class WavWriter {
+
+public:
+
+    // default size of a block, in bytes
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 4 * 1024 * 1024;
+
+    explicit WavWriter(
+        std::string const& filename,
+        int channels,
+        int samplerate,
+        Wav::Format format = Wav::Format::float32,
+        bool dither = false,
+        size_t blockSize = DEFAULT_BLOCK_SIZE
+    );
+
+    //
+    // Closes the writer if it was not closed already.
+    //
+    ~WavWriter();
+
+    //
+    // Returns false if the file could not be opened or if a write failed.
+    // Thread-safe.
+    //
+    bool good() const;
+
+    //
+    // Queues the given number of samples to be written. The buffer should be
+    // at least the size of nsamples * channels. Blocks only when both blocks
+    // are full, waiting for the I/O thread to finish writing one of them.
+    //
+    void write(float const buf[], size_t nsamples);
+
+    //
+    // Writes any remaining samples, waits for the I/O thread to finish and
+    // finalizes the file. Nothing can be written after closing.
+    //
+    void close();
+
+private:
+    Q_DISABLE_COPY(WavWriter)
+
+    //
+    // Hands the front block over to the I/O thread, waiting for the back
+    // block to be written if needed.
+    //
+    void submit();
+
+    // I/O thread
+    void ioLoop();
+
+    // only accessed from the I/O thread after construction
+    std::unique_ptr<Wav> mWav;
+    int const mChannels;
+    SampleConverter mConverter;
+    // back block converted to the file's format, unused for float32
+    std::vector<uint8_t> mEncoded;
+
+    std::atomic_bool mFailed;
+
+    // block being filled by the caller
+    std::vector<float> mFront;
+    size_t mFrontCount;
+
+    // block being written by the I/O thread, guarded by mMutex
+    QMutex mMutex;
+    QWaitCondition mBackReady;
+    QWaitCondition mBackFree;
+    std::vector<float> mBack;
+    size_t mBackCount;
+    bool mBackPending;
+    bool mQuit;
+
+    std::unique_ptr<QThread> mThread;
+
+};
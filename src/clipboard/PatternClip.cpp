@@ -145,10 +145,18 @@ bool PatternClip::hasData() const {
     return bool(mData);
 }
 
-PatternSelection const& PatternClip::selection() {
+PatternSelection const& PatternClip::selection() const {
     return mLocation;
 }
 
+size_t PatternClip::byteSize() const {
+    if (!mData) {
+        return 0;
+    }
+    auto iter = mLocation.iterator();
+    return TU::getRowLength(iter) * iter.rows();
+}
+
 void PatternClip::restore(trackerboy::Pattern &dest) const {
     pasteImpl(dest, std::nullopt, false);
 
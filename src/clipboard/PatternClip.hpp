@@ -49,7 +49,13 @@ public:
     //
     // Gets the selection the clip was sourced from
     //
-    PatternSelection const& selection();
+    PatternSelection const& selection() const;
+
+    //
+    // Gets the size, in bytes, of the clip's data. 0 is returned if there is
+    // no data.
+    //
+    size_t byteSize() const;
 
     //
     // Restores previously clipped data to the given pattern.
@@ -17,7 +17,13 @@ SoundConfig::SoundConfig() :
     mDeviceIndex(0),
     mSamplerateIndex(4),
     mLatency(40),
-    mPeriod(5)
+    mPeriod(5),
+    mLowLatency(false),
+    mAdaptiveLatency(false),
+    mMinLatency(10),
+    mRealtime(false),
+    mRealtimePriority(70),
+    mRenderCpu(-1)
 {
 }
 
@@ -45,6 +51,30 @@ int SoundConfig::period() const {
     return mPeriod;
 }
 
+bool SoundConfig::isLowLatency() const {
+    return mLowLatency;
+}
+
+bool SoundConfig::isAdaptiveLatency() const {
+    return mAdaptiveLatency;
+}
+
+int SoundConfig::minLatency() const {
+    return mMinLatency;
+}
+
+bool SoundConfig::isRealtime() const {
+    return mRealtime;
+}
+
+int SoundConfig::realtimePriority() const {
+    return mRealtimePriority;
+}
+
+int SoundConfig::renderCpu() const {
+    return mRenderCpu;
+}
+
 void SoundConfig::setBackendIndex(int index) {
     if (index >= -1) {
         mBackendIndex = index;
@@ -92,6 +122,40 @@ void SoundConfig::setPeriod(int period) {
     mPeriod = period;
 }
 
+void SoundConfig::setLowLatency(bool lowLatency) {
+    mLowLatency = lowLatency;
+}
+
+void SoundConfig::setAdaptiveLatency(bool adaptive) {
+    mAdaptiveLatency = adaptive;
+}
+
+void SoundConfig::setMinLatency(int latency) {
+    if (latency < MIN_LATENCY || latency > MAX_LATENCY) {
+        qWarning() << TU::LOG_PREFIX << "invalid minimum latency";
+        return;
+    }
+    mMinLatency = latency;
+}
+
+void SoundConfig::setRealtime(bool realtime) {
+    mRealtime = realtime;
+}
+
+void SoundConfig::setRealtimePriority(int priority) {
+    if (priority < MIN_REALTIME_PRIORITY || priority > MAX_REALTIME_PRIORITY) {
+        qWarning() << TU::LOG_PREFIX << "invalid real-time priority";
+        return;
+    }
+    mRealtimePriority = priority;
+}
+
+void SoundConfig::setRenderCpu(int cpu) {
+    if (cpu >= -1) {
+        mRenderCpu = cpu;
+    }
+}
+
 void SoundConfig::readSettings(QSettings &settings, AudioEnumerator &enumerator) {
     settings.beginGroup(Keys::Sound);
 
@@ -114,7 +178,11 @@ void SoundConfig::readSettings(QSettings &settings, AudioEnumerator &enumerator)
     }
 
     setBackendIndex(backend);
-    enumerator.populate(backend);
+    // probing can take a while, only do it the first time. The device list
+    // can be refreshed from the config dialog
+    if (!enumerator.isPopulated(backend)) {
+        enumerator.populate(backend);
+    }
 
     auto deviceId = settings.value(Keys::deviceId);
     int device = enumerator.deserializeDevice(backend, deviceId);
@@ -127,6 +195,12 @@ void SoundConfig::readSettings(QSettings &settings, AudioEnumerator &enumerator)
     setSamplerate(settings.value(Keys::samplerate, samplerate()).toInt());
     setLatency(settings.value(Keys::latency, mLatency).toInt());
     setPeriod(settings.value(Keys::period, mPeriod).toInt());
+    setLowLatency(settings.value(Keys::lowLatency, mLowLatency).toBool());
+    setAdaptiveLatency(settings.value(Keys::adaptiveLatency, mAdaptiveLatency).toBool());
+    setMinLatency(settings.value(Keys::minLatency, mMinLatency).toInt());
+    setRealtime(settings.value(Keys::realtime, mRealtime).toBool());
+    setRealtimePriority(settings.value(Keys::realtimePriority, mRealtimePriority).toInt());
+    setRenderCpu(settings.value(Keys::renderCpu, mRenderCpu).toInt());
 
     settings.endGroup();
 }
@@ -147,6 +221,12 @@ void SoundConfig::writeSettings(QSettings &settings, AudioEnumerator const& enum
     settings.setValue(Keys::samplerate, samplerate());
     settings.setValue(Keys::latency, mLatency);
     settings.setValue(Keys::period, mPeriod);
+    settings.setValue(Keys::lowLatency, mLowLatency);
+    settings.setValue(Keys::adaptiveLatency, mAdaptiveLatency);
+    settings.setValue(Keys::minLatency, mMinLatency);
+    settings.setValue(Keys::realtime, mRealtime);
+    settings.setValue(Keys::realtimePriority, mRealtimePriority);
+    settings.setValue(Keys::renderCpu, mRenderCpu);
 
     settings.endGroup();
 }
@@ -15,6 +15,9 @@ public:
     static constexpr int MIN_LATENCY = 1;
     static constexpr int MAX_LATENCY = 500;
 
+    static constexpr int MIN_REALTIME_PRIORITY = 1;
+    static constexpr int MAX_REALTIME_PRIORITY = 99;
+
     SoundConfig();
     
     int backendIndex() const;
@@ -24,6 +27,31 @@ public:
     int latency() const;
     int period() const;
 
+    //
+    // When enabled, audio is synthesized on demand in the device's callback
+    // instead of periodically filling a buffer. The period setting is unused
+    // and the latency setting becomes the device's period size.
+    //
+    bool isLowLatency() const;
+
+    //
+    // When enabled, the playback buffer is only filled up to a target level
+    // that adapts to measured underruns, between minLatency and latency.
+    // Has no effect in low latency mode.
+    //
+    bool isAdaptiveLatency() const;
+    int minLatency() const;
+
+    //
+    // When enabled, the render thread is given real-time scheduling with
+    // realtimePriority and the playback buffer is locked in memory (Linux
+    // only). The render thread is pinned to renderCpu, unless it is -1.
+    // Falls back to normal scheduling if not permitted.
+    //
+    bool isRealtime() const;
+    int realtimePriority() const;
+    int renderCpu() const;
+
     void setBackendIndex(int index);
 
     void setDeviceIndex(int index);
@@ -35,6 +63,18 @@ public:
     void setLatency(int latency);
 
     void setPeriod(int period);
+
+    void setLowLatency(bool lowLatency);
+
+    void setAdaptiveLatency(bool adaptive);
+
+    void setMinLatency(int latency);
+
+    void setRealtime(bool realtime);
+
+    void setRealtimePriority(int priority);
+
+    void setRenderCpu(int cpu);
     
     void readSettings(QSettings &settings, AudioEnumerator &enumerator);
 
@@ -47,4 +87,10 @@ private:
     int mSamplerateIndex;        // index of the current samplerate
     int mLatency;                // latency, or internal buffer size, in milliseconds
     int mPeriod;                 // period, in milliseconds
+    bool mLowLatency;            // render in the device callback
+    bool mAdaptiveLatency;       // adapt the buffer fill level to underruns
+    int mMinLatency;             // lowest adaptive latency, in milliseconds
+    bool mRealtime;              // real-time scheduling for the render thread
+    int mRealtimePriority;       // SCHED_FIFO priority
+    int mRenderCpu;              // CPU the render thread is pinned to, -1 for any
 };
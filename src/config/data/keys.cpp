@@ -34,6 +34,12 @@ QString const rownoHex ( QStringLiteral("rownoHex") );
 QString const samplerate { QStringLiteral("samplerate") };
 QString const period { QStringLiteral("period") };
 QString const latency { QStringLiteral("latency") };
+QString const lowLatency { QStringLiteral("lowLatency") };
+QString const adaptiveLatency { QStringLiteral("adaptiveLatency") };
+QString const minLatency { QStringLiteral("minLatency") };
+QString const realtime { QStringLiteral("realtime") };
+QString const realtimePriority { QStringLiteral("realtimePriority") };
+QString const renderCpu { QStringLiteral("renderCpu") };
 QString const deviceId { QStringLiteral("deviceId") };
 QString const noteCut { QStringLiteral("noteCut") };
 
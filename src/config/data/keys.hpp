@@ -45,6 +45,12 @@ extern QString const rownoHex;
 extern QString const samplerate;
 extern QString const period;
 extern QString const latency;
+extern QString const lowLatency;
+extern QString const adaptiveLatency;
+extern QString const minLatency;
+extern QString const realtime;
+extern QString const realtimePriority;
+extern QString const renderCpu;
 extern QString const deviceId;
 extern QString const noteCut;
 
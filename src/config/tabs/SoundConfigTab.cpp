@@ -4,7 +4,9 @@
 #include "core/StandardRates.hpp"
 #include "midi/MidiEnumerator.hpp"
 #include "utils/connectutils.hpp"
+#include "utils/realtime.hpp"
 
+#include <QCheckBox>
 #include <QComboBox>
 #include <QGridLayout>
 #include <QGroupBox>
@@ -12,6 +14,7 @@
 #include <QPushButton>
 #include <QSignalBlocker>
 #include <QSpinBox>
+#include <QThread>
 
 //
 // QGroupBox subclass containing a combobox for an API and Device
@@ -58,6 +61,16 @@ public:
         mErrorLabel->setVisible(!available);
     }
 
+    //
+    // Disables the group while its API is being probed
+    //
+    void setScanning(bool scanning) {
+        mErrorLabel->setText(scanning ? tr("Scanning...") : tr("API Unavailable"));
+        mErrorLabel->setVisible(scanning);
+        mDeviceCombo->setEnabled(!scanning && mDeviceCombo->count() > 0);
+        mRescanButton->setEnabled(!scanning);
+    }
+
     template <class Enumerator>
     void init(Enumerator const& enumerator, int backend, int device) {
         mApiCombo->addItems(enumerator.backendNames());
@@ -95,7 +108,8 @@ SoundConfigTab::SoundConfigTab(
 ) :
     ConfigTab(parent),
     mAudioEnumerator(audio),
-    mMidiEnumerator(midi)
+    mMidiEnumerator(midi),
+    mAudioRestoreDevice()
 {
 
     mAudioGroup = new DeviceGroup(tr("Output device"));
@@ -118,6 +132,33 @@ SoundConfigTab::SoundConfigTab(
     mSamplerateCombo = new QComboBox;
     audioLayout->addWidget(mSamplerateCombo, 2, 1);
 
+    // row 3, low latency mode
+    mLowLatencyCheck = new QCheckBox(tr("Low latency mode (render in audio callback)"));
+    audioLayout->addWidget(mLowLatencyCheck, 3, 0, 1, 2);
+
+    // row 4, adaptive buffer size
+    mAdaptiveCheck = new QCheckBox(tr("Adaptive buffer size (buffer size is the maximum)"));
+    audioLayout->addWidget(mAdaptiveCheck, 4, 0, 1, 2);
+
+    // row 5, minimum buffer size
+    audioLayout->addWidget(new QLabel(tr("Minimum buffer size")), 5, 0);
+    mMinLatencySpin = new QSpinBox;
+    audioLayout->addWidget(mMinLatencySpin, 5, 1);
+
+    // row 6, real-time mode
+    mRealtimeCheck = new QCheckBox(tr("Real-time render thread (locks buffers in memory)"));
+    audioLayout->addWidget(mRealtimeCheck, 6, 0, 1, 2);
+
+    // row 7, real-time priority
+    audioLayout->addWidget(new QLabel(tr("Real-time priority")), 7, 0);
+    mPrioritySpin = new QSpinBox;
+    audioLayout->addWidget(mPrioritySpin, 7, 1);
+
+    // row 8, render thread CPU affinity
+    audioLayout->addWidget(new QLabel(tr("Render thread CPU")), 8, 0);
+    mCpuCombo = new QComboBox;
+    audioLayout->addWidget(mCpuCombo, 8, 1);
+
     audioGroup->setLayout(audioLayout);
 
     mMidiGroup = new DeviceGroup(tr("MIDI Input"));
@@ -143,6 +184,26 @@ SoundConfigTab::SoundConfigTab(
     mSamplerateCombo->setCurrentIndex(soundConfig.samplerateIndex());
     mLatencySpin->setValue(soundConfig.latency());
     mPeriodSpin->setValue(soundConfig.period());
+    mLowLatencyCheck->setChecked(soundConfig.isLowLatency());
+    mAdaptiveCheck->setChecked(soundConfig.isAdaptiveLatency());
+
+    mPrioritySpin->setRange(SoundConfig::MIN_REALTIME_PRIORITY, SoundConfig::MAX_REALTIME_PRIORITY);
+    mPrioritySpin->setValue(soundConfig.realtimePriority());
+    mCpuCombo->addItem(tr("Any"));
+    auto const cpus = QThread::idealThreadCount();
+    for (int i = 0; i < cpus; ++i) {
+        mCpuCombo->addItem(tr("CPU %1").arg(i));
+    }
+    // index 0 is any CPU (-1)
+    auto const cpu = soundConfig.renderCpu();
+    mCpuCombo->setCurrentIndex(cpu < cpus ? cpu + 1 : 0);
+    if (realtimeSupported()) {
+        mRealtimeCheck->setChecked(soundConfig.isRealtime());
+    } else {
+        mRealtimeCheck->setEnabled(false);
+        mRealtimeCheck->setToolTip(tr("Not supported on this platform"));
+    }
+    updateLatencyControls();
 
     auto setupTimeSpinbox = [](QSpinBox &spin, int min, int max) {
         spin.setSuffix(tr(" ms"));
@@ -151,6 +212,8 @@ SoundConfigTab::SoundConfigTab(
     };
     setupTimeSpinbox(*mLatencySpin, SoundConfig::MIN_LATENCY, SoundConfig::MAX_LATENCY);
     setupTimeSpinbox(*mPeriodSpin, SoundConfig::MIN_PERIOD, SoundConfig::MAX_PERIOD);
+    setupTimeSpinbox(*mMinLatencySpin, SoundConfig::MIN_LATENCY, SoundConfig::MAX_LATENCY);
+    mMinLatencySpin->setValue(soundConfig.minLatency());
 
     mMidiGroup->init(mMidiEnumerator, midiConfig.backendIndex(), midiConfig.portIndex());
 
@@ -158,10 +221,21 @@ SoundConfigTab::SoundConfigTab(
     connect(mSamplerateCombo, qOverload<int>(&QComboBox::currentIndexChanged), this, &SoundConfigTab::setDirty<Config::CategorySound>);
     connect(mLatencySpin, qOverload<int>(&QSpinBox::valueChanged), this, &SoundConfigTab::setDirty<Config::CategorySound>);
     connect(mPeriodSpin, qOverload<int>(&QSpinBox::valueChanged), this, &SoundConfigTab::setDirty<Config::CategorySound>);
+    connect(mMinLatencySpin, qOverload<int>(&QSpinBox::valueChanged), this, &SoundConfigTab::setDirty<Config::CategorySound>);
+    auto latencyModeChanged = [this]() {
+        updateLatencyControls();
+        setDirty<Config::CategorySound>();
+    };
+    connect(mLowLatencyCheck, &QCheckBox::toggled, this, latencyModeChanged);
+    connect(mAdaptiveCheck, &QCheckBox::toggled, this, latencyModeChanged);
+    connect(mRealtimeCheck, &QCheckBox::toggled, this, latencyModeChanged);
+    connect(mPrioritySpin, qOverload<int>(&QSpinBox::valueChanged), this, &SoundConfigTab::setDirty<Config::CategorySound>);
+    connect(mCpuCombo, qOverload<int>(&QComboBox::currentIndexChanged), this, &SoundConfigTab::setDirty<Config::CategorySound>);
 
     connect(mAudioGroup->mApiCombo, qOverload<int>(&QComboBox::currentIndexChanged), this, &SoundConfigTab::audioApiChanged);
     connect(mAudioGroup->mDeviceCombo, qOverload<int>(&QComboBox::currentIndexChanged), this, &SoundConfigTab::setDirty<Config::CategorySound>);
     lazyconnect(mAudioGroup->mRescanButton, clicked, this, audioRescan);
+    lazyconnect(&mAudioEnumerator, populated, this, audioPopulated);
 
     lazyconnect(mMidiGroup, toggled, this, setDirty<Config::CategoryMidi>);
     connect(mMidiGroup->mApiCombo, qOverload<int>(&QComboBox::currentIndexChanged), this, &SoundConfigTab::midiApiChanged);
@@ -176,6 +250,12 @@ void SoundConfigTab::apply(SoundConfig &soundConfig) {
 
     soundConfig.setLatency(mLatencySpin->value());
     soundConfig.setPeriod(mPeriodSpin->value());
+    soundConfig.setLowLatency(mLowLatencyCheck->isChecked());
+    soundConfig.setAdaptiveLatency(mAdaptiveCheck->isChecked());
+    soundConfig.setMinLatency(mMinLatencySpin->value());
+    soundConfig.setRealtime(mRealtimeCheck->isChecked());
+    soundConfig.setRealtimePriority(mPrioritySpin->value());
+    soundConfig.setRenderCpu(mCpuCombo->currentIndex() - 1);
 
     clean();
 }
@@ -191,11 +271,6 @@ void SoundConfigTab::apply(MidiConfig &midiConfig) {
     clean();
 }
 
-template <>
-void SoundConfigTab::setDirtyFromEnumerator<AudioEnumerator>() {
-    setDirty<Config::CategorySound>();
-}
-
 template <>
 void SoundConfigTab::setDirtyFromEnumerator<MidiEnumerator>() {
     setDirty<Config::CategoryMidi>();
@@ -215,7 +290,10 @@ void SoundConfigTab::apiChanged(Enumerator &enumerator, DeviceGroup *group, int
 }
 
 void SoundConfigTab::audioApiChanged(int index) {
-    apiChanged(mAudioEnumerator, mAudioGroup, index);
+    // the default device is selected once probed
+    mAudioRestoreDevice.clear();
+    scanAudio(index);
+    setDirty<Config::CategorySound>();
 }
 
 void SoundConfigTab::midiApiChanged(int index) {
@@ -244,7 +322,54 @@ void SoundConfigTab::rescan(Enumerator &enumerator, DeviceGroup *group) {
 }
 
 void SoundConfigTab::audioRescan() {
-    rescan(mAudioEnumerator, mAudioGroup);
+    mAudioRestoreDevice = mAudioGroup->mDeviceCombo->currentText();
+    scanAudio(mAudioGroup->mApiCombo->currentIndex());
+}
+
+void SoundConfigTab::scanAudio(int backend) {
+    // audio backends can take a while to probe, so unlike MIDI this is done
+    // in the background, see audioPopulated
+    QSignalBlocker blocker(mAudioGroup->mDeviceCombo);
+    mAudioGroup->mDeviceCombo->clear();
+    mAudioGroup->setScanning(true);
+    mAudioEnumerator.populateAsync(backend);
+}
+
+void SoundConfigTab::audioPopulated(int backend) {
+    auto group = mAudioGroup;
+    if (backend != group->mApiCombo->currentIndex()) {
+        // the API was changed, another probe is on its way
+        return;
+    }
+
+    QSignalBlocker blocker(group->mDeviceCombo);
+    group->setScanning(false);
+    group->populateDevices(mAudioEnumerator);
+
+    // search for the previous selection in the new list, defaulting to 0 if
+    // not found
+    int index = 0;
+    if (!mAudioRestoreDevice.isEmpty()) {
+        index = group->mDeviceCombo->findText(mAudioRestoreDevice);
+        if (index == -1) {
+            index = 0;
+            setDirty<Config::CategorySound>();
+        }
+    }
+    group->mDeviceCombo->setCurrentIndex(index);
+    group->setAvailable(mAudioEnumerator.backendIsAvailable(backend));
+}
+
+void SoundConfigTab::updateLatencyControls() {
+    auto const lowLatency = mLowLatencyCheck->isChecked();
+    mPeriodSpin->setEnabled(!lowLatency);
+    mAdaptiveCheck->setEnabled(!lowLatency);
+    mMinLatencySpin->setEnabled(!lowLatency && mAdaptiveCheck->isChecked());
+    // memory is locked in either mode, but the render thread is the device's
+    // in low latency mode
+    auto const realtime = mRealtimeCheck->isChecked();
+    mPrioritySpin->setEnabled(!lowLatency && realtime);
+    mCpuCombo->setEnabled(!lowLatency && realtime);
 }
 
 void SoundConfigTab::midiRescan() {
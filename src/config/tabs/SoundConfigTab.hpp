@@ -5,6 +5,7 @@
 class AudioEnumerator;
 class MidiEnumerator;
 
+class QCheckBox;
 class QComboBox;
 class QGroupBox;
 class QSpinBox;
@@ -42,6 +43,19 @@ private:
     void audioApiChanged(int index);
     void midiApiChanged(int index);
 
+    //
+    // Probes the given audio backend in the background, the device list is
+    // updated by audioPopulated.
+    //
+    void scanAudio(int backend);
+    void audioPopulated(int backend);
+
+    //
+    // Enables the period, adaptive latency and render thread settings, which
+    // are unused in low latency mode.
+    //
+    void updateLatencyControls();
+
     template <class Enumerator>
     void apiChanged(Enumerator &enumerator, DeviceGroup *group, int index);
 
@@ -54,12 +68,21 @@ private:
     AudioEnumerator &mAudioEnumerator;
     MidiEnumerator &mMidiEnumerator;
 
+    // device to select once the audio backend is probed, empty for default
+    QString mAudioRestoreDevice;
+
     DeviceGroup *mAudioGroup;
     DeviceGroup *mMidiGroup;
 
     QSpinBox *mLatencySpin;
     QSpinBox *mPeriodSpin;
     QComboBox *mSamplerateCombo;
+    QCheckBox *mLowLatencyCheck;
+    QCheckBox *mAdaptiveCheck;
+    QSpinBox *mMinLatencySpin;
+    QCheckBox *mRealtimeCheck;
+    QSpinBox *mPrioritySpin;
+    QComboBox *mCpuCombo;
 
 
 };
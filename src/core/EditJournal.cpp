@@ -0,0 +1,424 @@
+
+#include "core/EditJournal.hpp"
+
+#include <QFileInfo>
+#include <QTimerEvent>
+#include <QtDebug>
+
+#include <algorithm>
+#include <iterator>
+
+#define TU EditJournalTU
+namespace TU {
+
+// file starts with this signature, followed by records
+static constexpr char SIGNATURE[] = { 'T', 'B', 'J', '1' };
+static constexpr int SIGNATURE_SIZE = (int)sizeof(SIGNATURE);
+
+// buffered records are written at least this often, in milliseconds
+static constexpr int FLUSH_INTERVAL = 1000;
+// or sooner if this many bytes are buffered
+static constexpr int FLUSH_SIZE = 64 * 1024;
+
+enum RecordType : uint8_t {
+    // song, channel, track id, row (16-bit), track row (8 bytes)
+    RecordTrackRow = 1,
+    // song, count (16-bit), count order rows (4 bytes each)
+    RecordOrder = 2,
+    // no data, an edit was made that could not be journaled
+    RecordGap = 3
+};
+
+static uint32_t trackKey(int song, int channel, int id) {
+    return (uint32_t)song << 16 | (uint32_t)channel << 8 | (uint32_t)id;
+}
+
+static bool rowsEqual(trackerboy::TrackRow const& a, trackerboy::TrackRow const& b) {
+    if (a.note != b.note || a.instrumentId != b.instrumentId) {
+        return false;
+    }
+    for (size_t i = 0; i < std::size(a.effects); ++i) {
+        if (a.effects[i].type != b.effects[i].type || a.effects[i].param != b.effects[i].param) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void appendU8(QByteArray &data, int value) {
+    data.append((char)(uint8_t)value);
+}
+
+static void appendU16(QByteArray &data, int value) {
+    appendU8(data, value & 0xFF);
+    appendU8(data, (value >> 8) & 0xFF);
+}
+
+static void appendTrackRow(QByteArray &data, trackerboy::TrackRow const& row) {
+    appendU8(data, row.note);
+    appendU8(data, row.instrumentId);
+    for (auto const& effect : row.effects) {
+        appendU8(data, (uint8_t)effect.type);
+        appendU8(data, effect.param);
+    }
+}
+
+//
+// Reads fields from a journal. All reads fail once the end of the data is
+// reached, so a record torn by a crash is detected.
+//
+class Reader {
+
+public:
+    explicit Reader(QByteArray const& data) :
+        mData(data),
+        mPos(TU::SIGNATURE_SIZE)
+    {
+    }
+
+    bool atEnd() const {
+        return mPos >= mData.size();
+    }
+
+    bool readU8(uint8_t &value) {
+        if (mPos + 1 > mData.size()) {
+            return false;
+        }
+        value = (uint8_t)mData[mPos++];
+        return true;
+    }
+
+    bool readU16(uint16_t &value) {
+        uint8_t lo, hi;
+        if (!readU8(lo) || !readU8(hi)) {
+            return false;
+        }
+        value = (uint16_t)(lo | hi << 8);
+        return true;
+    }
+
+    bool readTrackRow(trackerboy::TrackRow &row) {
+        if (!readU8(row.note) || !readU8(row.instrumentId)) {
+            return false;
+        }
+        for (auto &effect : row.effects) {
+            uint8_t type;
+            if (!readU8(type) || !readU8(effect.param)) {
+                return false;
+            }
+            effect.type = (trackerboy::EffectType)type;
+        }
+        return true;
+    }
+
+private:
+    QByteArray const& mData;
+    int mPos;
+
+};
+
+}
+
+
+EditJournal::EditJournal(QObject *parent) :
+    QObject(parent),
+    mTracks(),
+    mOrders(),
+    mGapRecorded(false),
+    mBuffer(),
+    mWritten(0),
+    mCheckpoint(-1),
+    mFlushTimer(),
+    mFile(),
+    mPath(),
+    mWriter()
+{
+    // one writer, so that records are written in order
+    mWriter.setMaxThreadCount(1);
+}
+
+EditJournal::~EditJournal() {
+    close();
+}
+
+QString EditJournal::pathFor(QString const& moduleFile) {
+    return moduleFile + QStringLiteral(".journal");
+}
+
+void EditJournal::start(QString const& path, bool truncate) {
+    close();
+
+    // records are relative to the module as it is on disk
+    mTracks.clear();
+    mOrders.clear();
+    mGapRecorded = false;
+
+    bool const append = !truncate && hasRecords(path);
+    mPath = path;
+    mWritten = append ? QFileInfo(path).size() : 0;
+    mCheckpoint = -1;
+    mFile = std::make_shared<QFile>(path);
+    mWriter.start([file = mFile, append]() {
+        auto const mode = append ? QIODevice::Append : QIODevice::Truncate;
+        if (!file->open(QIODevice::WriteOnly | mode)) {
+            qWarning() << "cannot open edit journal:" << file->errorString();
+        }
+    });
+
+    if (!append) {
+        writeHeader();
+    }
+    mFlushTimer.start(TU::FLUSH_INTERVAL, this);
+}
+
+void EditJournal::checkpoint() {
+    if (isActive()) {
+        flush();
+        mCheckpoint = mWritten;
+        // edits after the snapshot that cannot be journaled must be recorded
+        // again, the gap before it is covered by the save
+        mGapRecorded = false;
+    }
+}
+
+void EditJournal::restart() {
+    if (!isActive()) {
+        return;
+    }
+
+    flush();
+    auto const offset = mCheckpoint >= 0 ? mCheckpoint : mWritten;
+    auto const tailSize = mWritten - offset;
+    mCheckpoint = -1;
+    mWritten = TU::SIGNATURE_SIZE + tailSize;
+
+    // The journaled state (mTracks, mOrders) is kept: the records after the
+    // checkpoint are replayed on top of the snapshot, so the changes that
+    // follow are still relative to them.
+    mWriter.start([file = mFile, offset, tailSize]() {
+        if (!file->isOpen()) {
+            return;
+        }
+        QByteArray data(TU::SIGNATURE, TU::SIGNATURE_SIZE);
+        if (tailSize > 0) {
+            QFile reader(file->fileName());
+            if (reader.open(QIODevice::ReadOnly) && reader.seek(offset)) {
+                data.append(reader.read(tailSize));
+            }
+        }
+        if (!file->resize(0) || !file->seek(0)) {
+            qWarning() << "cannot truncate edit journal:" << file->errorString();
+            return;
+        }
+        file->write(data);
+        file->flush();
+    });
+}
+
+void EditJournal::stop() {
+    if (isActive()) {
+        auto const path = mPath;
+        close();
+        QFile::remove(path);
+    }
+}
+
+bool EditJournal::isActive() const {
+    return mFile != nullptr;
+}
+
+void EditJournal::record(trackerboy::Song &song, int songIndex, int pattern) {
+    if (!isActive()) {
+        return;
+    }
+
+    auto &order = song.order();
+    auto const orderSize = (int)order.size();
+
+    auto &orderState = mOrders[songIndex];
+    bool orderChanged = (int)orderState.size() != orderSize;
+    for (int i = 0; !orderChanged && i < orderSize; ++i) {
+        orderChanged = orderState[i] != order[i];
+    }
+    if (orderChanged) {
+        orderState.resize(orderSize);
+        TU::appendU8(mBuffer, TU::RecordOrder);
+        TU::appendU8(mBuffer, songIndex);
+        TU::appendU16(mBuffer, orderSize);
+        for (int i = 0; i < orderSize; ++i) {
+            orderState[i] = order[i];
+            for (auto id : orderState[i]) {
+                TU::appendU8(mBuffer, id);
+            }
+        }
+    }
+
+    if (pattern >= 0 && pattern < orderSize) {
+        auto const orderRow = order[pattern];
+        for (int ch = 0; ch < (int)orderRow.size(); ++ch) {
+            auto const id = orderRow[ch];
+            auto &track = song.patterns().getTrack(static_cast<trackerboy::ChType>(ch), id);
+            auto const rows = (int)track.size();
+
+            auto &trackState = mTracks[TU::trackKey(songIndex, ch, id)];
+            // the first time a track is recorded, all of its rows are written
+            bool const fresh = (int)trackState.size() != rows;
+            if (fresh) {
+                trackState.resize(rows);
+            }
+
+            for (int row = 0; row < rows; ++row) {
+                auto const& rowdata = track[row];
+                if (fresh || !TU::rowsEqual(rowdata, trackState[row])) {
+                    trackState[row] = rowdata;
+                    TU::appendU8(mBuffer, TU::RecordTrackRow);
+                    TU::appendU8(mBuffer, songIndex);
+                    TU::appendU8(mBuffer, ch);
+                    TU::appendU8(mBuffer, id);
+                    TU::appendU16(mBuffer, row);
+                    TU::appendTrackRow(mBuffer, rowdata);
+                }
+            }
+        }
+    }
+
+    if (mBuffer.size() >= TU::FLUSH_SIZE) {
+        flush();
+    }
+}
+
+void EditJournal::recordGap() {
+    if (isActive() && !mGapRecorded) {
+        mGapRecorded = true;
+        TU::appendU8(mBuffer, TU::RecordGap);
+    }
+}
+
+void EditJournal::flush() {
+    if (!isActive() || mBuffer.isEmpty()) {
+        return;
+    }
+
+    mWriter.start([file = mFile, data = mBuffer]() {
+        if (file->isOpen()) {
+            file->write(data);
+            file->flush();
+        }
+    });
+    mWritten += mBuffer.size();
+    mBuffer.clear();
+}
+
+bool EditJournal::hasRecords(QString const& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly) || file.size() <= TU::SIGNATURE_SIZE) {
+        return false;
+    }
+    auto const signature = file.read(TU::SIGNATURE_SIZE);
+    return std::equal(signature.begin(), signature.end(), TU::SIGNATURE);
+}
+
+EditJournal::Recovery EditJournal::replay(QString const& path, trackerboy::Module &mod) {
+    Recovery recovery{ 0, false };
+
+    if (!hasRecords(path)) {
+        return recovery;
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return recovery;
+    }
+    auto const data = file.readAll();
+
+    auto &songs = mod.songs();
+    TU::Reader reader(data);
+    while (!reader.atEnd()) {
+        uint8_t type;
+        reader.readU8(type);
+
+        if (type == TU::RecordTrackRow) {
+            uint8_t song, ch, id;
+            uint16_t row;
+            trackerboy::TrackRow rowdata;
+            if (!reader.readU8(song) || !reader.readU8(ch) || !reader.readU8(id) ||
+                !reader.readU16(row) || !reader.readTrackRow(rowdata)) {
+                break;
+            }
+            if ((size_t)song < (size_t)songs.size() && ch < 4) {
+                auto &track = songs.getShared(song)->patterns().getTrack(static_cast<trackerboy::ChType>(ch), id);
+                if ((size_t)row < (size_t)track.size()) {
+                    track[row] = rowdata;
+                    ++recovery.records;
+                }
+            }
+        } else if (type == TU::RecordOrder) {
+            uint8_t song;
+            uint16_t count;
+            if (!reader.readU8(song) || !reader.readU16(count)) {
+                break;
+            }
+            std::vector<trackerboy::OrderRow> rows(count);
+            bool complete = true;
+            for (auto &orderRow : rows) {
+                for (auto &id : orderRow) {
+                    complete = complete && reader.readU8(id);
+                }
+            }
+            if (!complete) {
+                break;
+            }
+            if ((size_t)song < (size_t)songs.size() && count > 0) {
+                auto &order = songs.getShared(song)->order();
+                while ((int)order.size() < count) {
+                    order.insert((int)order.size(), {});
+                }
+                while ((int)order.size() > count) {
+                    order.remove((int)order.size() - 1);
+                }
+                for (int i = 0; i < count; ++i) {
+                    order[i] = rows[i];
+                }
+                ++recovery.records;
+            }
+        } else if (type == TU::RecordGap) {
+            recovery.hasGap = true;
+        } else {
+            // corrupted, stop here
+            qWarning() << "edit journal is corrupted, stopped at record" << recovery.records;
+            break;
+        }
+    }
+
+    return recovery;
+}
+
+void EditJournal::timerEvent(QTimerEvent *evt) {
+    if (evt->timerId() == mFlushTimer.timerId()) {
+        flush();
+    } else {
+        QObject::timerEvent(evt);
+    }
+}
+
+void EditJournal::writeHeader() {
+    mBuffer.append(TU::SIGNATURE, TU::SIGNATURE_SIZE);
+}
+
+void EditJournal::close() {
+    if (!isActive()) {
+        return;
+    }
+
+    mFlushTimer.stop();
+    flush();
+    mWriter.start([file = mFile]() {
+        file->close();
+    });
+    mWriter.waitForDone();
+    mFile.reset();
+    mPath.clear();
+    mBuffer.clear();
+}
+
+#undef TU
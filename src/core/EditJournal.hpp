@@ -0,0 +1,150 @@
+#pragma once
+
+#include "trackerboy/data/Module.hpp"
+#include "trackerboy/data/Song.hpp"
+#include "trackerboy/data/TrackRow.hpp"
+
+#include <QBasicTimer>
+#include <QByteArray>
+#include <QFile>
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+//
+// Append-only journal of edits made to a module since it was last saved, used
+// to recover the edits after a crash. Rather than journaling each undo
+// command, the journal records the resulting state: every time a pattern or
+// the order is modified (by an edit, undo or redo), the rows that differ from
+// what was last journaled are appended. Replaying the journal on top of the
+// saved module then restores the module exactly, regardless of the commands
+// used.
+//
+// Only pattern and order edits (everything on the undo stacks) are journaled.
+// Edits that cannot be undone (song settings, instruments, waveforms, the
+// song list) are recorded as a gap, so that a recovery can warn that they
+// were lost.
+//
+// Records are buffered in memory and written to the journal file
+// periodically from a worker thread, the GUI thread never waits on the disk.
+//
+class EditJournal : public QObject {
+
+    Q_OBJECT
+
+public:
+
+    struct Recovery {
+        // number of records replayed
+        int records;
+        // true if edits that cannot be journaled were made
+        bool hasGap;
+    };
+
+    explicit EditJournal(QObject *parent = nullptr);
+
+    //
+    // Writes any buffered records and closes the journal.
+    //
+    ~EditJournal();
+
+    //
+    // Gets the path of the journal for the given module file.
+    //
+    static QString pathFor(QString const& moduleFile);
+
+    //
+    // Starts journaling to the given file. If truncate is true, the file is
+    // cleared, otherwise records are appended to it. The journal should be
+    // started (truncated) whenever the module is saved or loaded.
+    //
+    void start(QString const& path, bool truncate = true);
+
+    //
+    // Marks the point at which a snapshot of the module was taken for a
+    // background save. Records made before the checkpoint are discarded by
+    // the next restart, records made after it are kept since the snapshot
+    // does not contain them.
+    //
+    void checkpoint();
+
+    //
+    // Clears the journal up to the checkpoint (or entirely if there is none),
+    // call once the module has been written to disk. The journal file is
+    // truncated by the writer, this does not wait.
+    //
+    void restart();
+
+    //
+    // Stops journaling and removes the journal file. Call when the module is
+    // closed without a crash.
+    //
+    void stop();
+
+    bool isActive() const;
+
+    //
+    // Records the order of the given song and the tracks of the given
+    // pattern (order row). Only the changes since the last record are
+    // written. pattern can be -1 to only record the order.
+    //
+    void record(trackerboy::Song &song, int songIndex, int pattern);
+
+    //
+    // Records that an edit that cannot be journaled was made.
+    //
+    void recordGap();
+
+    //
+    // Writes buffered records to the journal file (in the background).
+    //
+    void flush();
+
+    //
+    // Determines if the given journal file exists and has records to replay.
+    //
+    static bool hasRecords(QString const& path);
+
+    //
+    // Replays the given journal on top of the given module data. Records
+    // that no longer apply to the module are skipped.
+    //
+    static Recovery replay(QString const& path, trackerboy::Module &mod);
+
+protected:
+
+    void timerEvent(QTimerEvent *evt) override;
+
+private:
+    Q_DISABLE_COPY(EditJournal)
+
+    void writeHeader();
+
+    void close();
+
+    // journaled state, so that only changes are recorded
+    // key is song << 16 | channel << 8 | track id
+    std::unordered_map<uint32_t, std::vector<trackerboy::TrackRow>> mTracks;
+    std::unordered_map<int, std::vector<trackerboy::OrderRow>> mOrders;
+    bool mGapRecorded;
+
+    // records not yet handed to the writer
+    QByteArray mBuffer;
+    // size of the journal file once the writer has written everything
+    // handed to it
+    qint64 mWritten;
+    // mWritten when checkpoint() was called, or -1 if there is no checkpoint
+    qint64 mCheckpoint;
+    QBasicTimer mFlushTimer;
+
+    // only accessed from the writer after start
+    std::shared_ptr<QFile> mFile;
+    QString mPath;
+    QThreadPool mWriter;
+
+};
@@ -1,5 +1,18 @@
 
 #include "core/Module.hpp"
+#include "model/commands/undo.hpp"
+
+#define TU ModuleTU
+namespace TU {
+
+// undo history memory limit for each song
+static constexpr size_t UNDO_BUDGET = 32 * 1024 * 1024;
+
+// limit on the number of commands, so that the overhead of evicted commands
+// stays within a quarter of the budget
+static constexpr int UNDO_LIMIT = (int)(UNDO_BUDGET / UndoCmd::OVERHEAD / 4);
+
+}
 
 
 Module::Editor::Editor(Module &mod) :
@@ -24,7 +37,10 @@ Module::Module(QObject *parent) :
     mMutex(),
     mUndoGroup(new QUndoGroup(this)),
     mUndoStacks(),
+    mUndoBudget(),
     mSong(),
+    mSongIndex(0),
+    mJournal(),
     mPermaDirty(false),
     mModified(false)
 {
@@ -70,6 +86,10 @@ std::shared_ptr<trackerboy::Song> Module::songShared() {
     return mSong;
 }
 
+int Module::songIndex() const {
+    return mSongIndex;
+}
+
 bool Module::isModified() const {
     return mModified;
 }
@@ -86,6 +106,14 @@ QUndoStack* Module::undoStack() {
     return mUndoGroup->activeStack();
 }
 
+std::shared_ptr<UndoBudget> Module::undoBudget() {
+    return mUndoBudget;
+}
+
+EditJournal& Module::journal() {
+    return mJournal;
+}
+
 void Module::reset() {
 
     setSong(0);
@@ -93,6 +121,17 @@ void Module::reset() {
     emit reloaded();
 }
 
+void Module::replace(trackerboy::Module &data) {
+    {
+        QMutexLocker locker(&mMutex);
+        mModule = std::move(data);
+    }
+
+    // history refers to the old songs
+    mUndoStacks.clear();
+    reset();
+}
+
 Module::Editor Module::edit() {
     return { *this };
 }
@@ -114,6 +153,7 @@ void Module::clean() {
 }
 
 void Module::makeDirty() {
+    mJournal.recordGap();
     if (!mPermaDirty) {
         mPermaDirty = true;
         if (!mModified) {
@@ -125,19 +165,29 @@ void Module::makeDirty() {
 
 void Module::setSong(int index) {
     mSong = mModule.songs().getShared(index);
+    mSongIndex = index;
 
-    QUndoStack *stack;
     auto iter = mUndoStacks.find(mSong.get());
-    if (iter != mUndoStacks.end()) {
-        // contain the existing stack
-        stack = iter->second.get();
-    } else {
+    if (iter == mUndoStacks.end()) {
         // no history for this song yet, create it and add to group
-        stack = new QUndoStack(this);
-        mUndoGroup->addStack(stack);
-        mUndoStacks.emplace(mSong.get(), stack);
+        History history;
+        history.budget = std::make_shared<UndoBudget>(TU::UNDO_BUDGET);
+        history.stack = std::make_unique<QUndoStack>(this);
+        // can only be set while the stack is empty
+        history.stack->setUndoLimit(TU::UNDO_LIMIT);
+        mUndoGroup->addStack(history.stack.get());
+
+        auto stack = history.stack.get();
+        auto budget = history.budget.get();
+        connect(stack, &QUndoStack::indexChanged, this,
+            [stack, budget]() {
+                UndoCmd::trim(*stack, *budget);
+            });
+
+        iter = mUndoStacks.emplace(mSong.get(), std::move(history)).first;
     }
-    mUndoGroup->setActiveStack(stack);
+    mUndoBudget = iter->second.budget;
+    mUndoGroup->setActiveStack(iter->second.stack.get());
     emit songChanged();
 }
 
@@ -157,3 +207,5 @@ void Module::nameFirstSong() {
     // excuse the jank
     mModule.songs().get(0)->setName(defaultSongName().toStdString());
 }
+
+#undef TU
@@ -1,6 +1,9 @@
 
 #pragma once
 
+#include "core/EditJournal.hpp"
+#include "core/UndoBudget.hpp"
+
 #include "trackerboy/data/Module.hpp"
 #include "trackerboy/data/Song.hpp"
 
@@ -77,6 +80,11 @@ public:
     //
     std::shared_ptr<trackerboy::Song> songShared();
 
+    //
+    // Index of the current song.
+    //
+    int songIndex() const;
+
     bool isModified() const;
 
     QMutex& mutex();
@@ -85,6 +93,19 @@ public:
 
     QUndoStack* undoStack();
 
+    //
+    // Memory budget of the current song's undo stack. Commands account for
+    // their memory usage in it, and the oldest commands are evicted when it
+    // is exceeded.
+    //
+    std::shared_ptr<UndoBudget> undoBudget();
+
+    //
+    // Journal of edits made since the module was last saved. The owner of
+    // the module's file is responsible for starting and stopping it.
+    //
+    EditJournal& journal();
+
     //
     // Reset the module. All undo stacks are deleted and the module is cleaned.
     // The reloaded signal is then emitted. This method is called when the
@@ -92,6 +113,13 @@ public:
     //
     void reset();
 
+    //
+    // Replaces the module's data with the given data, which is left in an
+    // unspecified state. The swap is done while holding the mutex, all undo
+    // history is removed and the module is then reset.
+    //
+    void replace(trackerboy::Module &data);
+
     //
     // Sets the current song for editing. The song's QUndoStack becomes the
     // active stack for this class's QUndoGroup. The songChanged signal is
@@ -120,7 +148,8 @@ public:
     PermanentEditor permanentEdit();
 
     //
-    // Sets the permanent dirty flag. 
+    // Sets the permanent dirty flag. Permanent edits cannot be journaled, so
+    // a gap is recorded in the journal.
     //
     void makeDirty();
 
@@ -178,11 +207,21 @@ private:
     QMutex mMutex;
     QUndoGroup *mUndoGroup;
 
+    struct History {
+        // commands hold a reference to the budget, so it outlives the stack
+        std::shared_ptr<UndoBudget> budget;
+        std::unique_ptr<QUndoStack> stack;
+    };
+
     // each Song has its own QUndoStack and is created when the user selects the song
     // for editing
-    std::unordered_map<trackerboy::Song*, std::unique_ptr<QUndoStack> > mUndoStacks;
+    std::unordered_map<trackerboy::Song*, History> mUndoStacks;
+    std::shared_ptr<UndoBudget> mUndoBudget;
 
     std::shared_ptr<trackerboy::Song> mSong;
+    int mSongIndex;
+
+    EditJournal mJournal;
 
     // permanent dirty flag. Not all edits to the document can be undone. When such
     // edit occurs, this flag is set to true. It is reset when the document is
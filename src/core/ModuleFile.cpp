@@ -7,6 +7,7 @@
 #include <QtDebug>
 
 #include <fstream>
+#include <sstream>
 
 ModuleFile::ModuleFile() :
     mFilename(),
@@ -41,6 +42,23 @@ bool ModuleFile::open(QString const& path, Module &mod) {
     return false;
 }
 
+bool ModuleFile::open(ModuleLoader &loader, Module &mod) {
+    if (loader.wasCancelled()) {
+        return false;
+    }
+
+    mIoError = loader.hasIoError();
+    mLastError = loader.lastError();
+    if (loader.succeeded()) {
+        updateFilename(loader.path());
+        // emits the reset signal
+        mod.replace(loader.data());
+        return true;
+    }
+
+    return false;
+}
+
 bool ModuleFile::save(Module &mod) {
     if (mFilepath.isEmpty()) {
         return false;
@@ -59,6 +77,37 @@ bool ModuleFile::save(QString const& filename, Module &mod) {
    
 }
 
+bool ModuleFile::save(ModuleSaver &saver, Module &mod) {
+    if (mFilepath.isEmpty()) {
+        return false;
+    }
+
+    auto const data = snapshot(mod);
+    if (data.isEmpty()) {
+        return false;
+    }
+
+    // edits made while the snapshot is being written will dirty the module again
+    mod.clean();
+    saver.save(mFilepath, data, mAutoBackup);
+    return true;
+}
+
+QByteArray ModuleFile::snapshot(Module &mod) {
+    mod.beginSave();
+
+    std::ostringstream out(std::ios::binary | std::ios::out);
+    {
+        QMutexLocker locker(&mod.mutex());
+        if (mod.data().serialize(out) != trackerboy::FormatError::none) {
+            return {};
+        }
+    }
+
+    auto const str = out.str();
+    return QByteArray(str.data(), (qsizetype)str.size());
+}
+
 QString ModuleFile::crashSave(Module &mod) {
     // attempt to save a copy of the module
     // the copy is the same path of the module, but with .crash-%1 appended
@@ -132,54 +181,15 @@ void ModuleFile::setAutoBackup(bool backup) {
 }
 
 bool ModuleFile::doSave(QString const& filename, Module &mod) {
-    if (mAutoBackup) {
-        static constexpr auto errorPrefix = "failed to backup module:";
-
-        // backup the current file if it exists
-        QFileInfo info(filename);
-        if (info.exists() && info.isFile()) {
-            do { // do-once and break on error
-
-                // Qt doesn't have an overwrite file copy function so
-                // we'll have to remove first and then copy
-
-                QFileInfo backupInfo(filename + ".bak");
-                QString backupPath = backupInfo.filePath();
-                if (backupInfo.exists()) {
-                    if (!backupInfo.isFile()) {
-                        // ERROR! the backup dest is not a file!
-                        qWarning() << errorPrefix << "backup destination in use";
-                        break;
-                    }
-                    // remove old backup
-                    if (!QFile::remove(backupPath)) {
-                        // ERROR! failed to remove existing backup
-                        qWarning() << errorPrefix << "cannot remove existing backup";
-                        break;
-                    }
-                }
-                if (!QFile::copy(filename, backupPath)) {
-                    // ERROR! failed to backup module
-                    qWarning() << errorPrefix << "cannot copy existing module";
-                    break;
-                }
-                qInfo() << "module backup saved to" << backupPath;
-            } while (false);
-        }
+    auto const data = snapshot(mod);
+    if (data.isEmpty()) {
+        return false;
     }
 
-    bool success = false;
-    std::ofstream out(filename.toStdString(), std::ios::binary | std::ios::out);
-    if (out.good()) {
-        mod.beginSave();
-        success = mod.data().serialize(out) == trackerboy::FormatError::none;
-        if (success) {
-            mod.clean();
-        }
-
+    auto const success = ModuleSaver::write(filename, data, mAutoBackup);
+    if (success) {
+        mod.clean();
     }
-
-    out.close();
     return success;
 }
 
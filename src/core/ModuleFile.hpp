@@ -2,6 +2,10 @@
 #pragma once
 
 #include "core/Module.hpp"
+#include "core/ModuleLoader.hpp"
+#include "core/ModuleSaver.hpp"
+
+#include <QByteArray>
 
 #include <QString>
 
@@ -19,6 +23,13 @@ public:
     // is reverted to a new document.
     bool open(QString const& filename, Module &mod);
 
+    //
+    // Opens the module loaded by the given finished loader, true is returned
+    // on success. On success, the loaded data replaces the module's data.
+    // On failure or cancellation, the module is left untouched.
+    //
+    bool open(ModuleLoader &loader, Module &mod);
+
     //
     // saves the document to the previously loaded/saved file
     //
@@ -29,6 +40,22 @@ public:
     //
     bool save(QString const& filename, Module &mod);
 
+    //
+    // Saves the document to the previously loaded/saved file in the
+    // background. The module is snapshotted and marked clean immediately,
+    // the snapshot is then written by the given saver. If the write fails,
+    // the saver's saved signal reports it and the module should be made
+    // dirty again. false is returned if the document has no file or could
+    // not be snapshotted.
+    //
+    bool save(ModuleSaver &saver, Module &mod);
+
+    //
+    // Serializes the module to memory while holding its mutex. An empty
+    // array is returned on failure.
+    //
+    static QByteArray snapshot(Module &mod);
+
     //
     // Saves a copy of the given module data using this module's file info.
     // The file path of the saved copy is returned on success, amy empty string is
@@ -77,7 +104,8 @@ public:
     //
     // Set auto-backup enable. If enabled, existing files will be copied to a .bak file
     // before saving. ie if the user saves "foo.tbm" the current file will be copied to
-    // "foo.tbm.bak" in the same directory as foo.tbm. Existing bak files will be overwritten
+    // "foo.tbm.bak" in the same directory as foo.tbm. Existing bak files will be replaced
+    // once the copy has completed.
     //
     void setAutoBackup(bool backup);
 
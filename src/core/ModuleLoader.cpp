@@ -0,0 +1,214 @@
+
+#include "core/ModuleLoader.hpp"
+
+#include <QByteArray>
+#include <QFile>
+
+#include <algorithm>
+#include <functional>
+#include <istream>
+#include <streambuf>
+
+#define TU ModuleLoaderTU
+namespace TU {
+
+// progress is reported on a 0 to PROGRESS_MAX scale
+static constexpr int PROGRESS_MAX = 1000;
+
+// number of bytes read, or exposed to the deserializer, at a time
+static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+//
+// Input stream buffer over a block of memory. The memory is exposed in chunks
+// so that a callback is invoked as the stream is read. The callback is given
+// the current position and returns false to stop the stream (end of file is
+// then reported).
+//
+class ChunkedBuf : public std::streambuf {
+
+public:
+    using Callback = std::function<bool(size_t)>;
+
+    ChunkedBuf(char const *data, size_t size, Callback callback) :
+        mData(const_cast<char*>(data)),
+        mSize(size),
+        mCallback(std::move(callback))
+    {
+        setg(mData, mData, mData);
+    }
+
+protected:
+
+    int_type underflow() override {
+        if (gptr() < egptr()) {
+            return traits_type::to_int_type(*gptr());
+        }
+
+        auto const pos = (size_t)(egptr() - mData);
+        if (pos >= mSize || !mCallback(pos)) {
+            return traits_type::eof();
+        }
+
+        setWindow(pos);
+        return traits_type::to_int_type(*gptr());
+    }
+
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+        off_type base;
+        switch (dir) {
+            case std::ios_base::beg:
+                base = 0;
+                break;
+            case std::ios_base::cur:
+                base = gptr() - mData;
+                break;
+            default:
+                base = (off_type)mSize;
+                break;
+        }
+        return seekpos(base + off, which);
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+        off_type const offset = pos;
+        if (!(which & std::ios_base::in) || offset < 0 || offset > (off_type)mSize) {
+            return pos_type(off_type(-1));
+        }
+        setWindow((size_t)offset);
+        return pos;
+    }
+
+private:
+
+    void setWindow(size_t pos) {
+        setg(mData, mData + pos, mData + std::min(pos + CHUNK_SIZE, mSize));
+    }
+
+    char *mData;
+    size_t mSize;
+    Callback mCallback;
+
+};
+
+}
+
+
+ModuleLoader::ModuleLoader(QString const& path, QObject *parent) :
+    QThread(parent),
+    mPath(path),
+    mData(),
+    mLastError(trackerboy::FormatError::none),
+    mIoError(false),
+    mCancelled(false),
+    mLastProgress(0)
+{
+}
+
+ModuleLoader::~ModuleLoader() {
+    cancel();
+    wait();
+}
+
+QString ModuleLoader::path() const {
+    return mPath;
+}
+
+void ModuleLoader::cancel() {
+    mCancelled = true;
+}
+
+bool ModuleLoader::wasCancelled() const {
+    return mCancelled;
+}
+
+trackerboy::FormatError ModuleLoader::lastError() const {
+    return mLastError;
+}
+
+bool ModuleLoader::hasIoError() const {
+    return mIoError;
+}
+
+bool ModuleLoader::succeeded() const {
+    return !mCancelled && !mIoError && mLastError == trackerboy::FormatError::none;
+}
+
+trackerboy::Module& ModuleLoader::data() {
+    return mData;
+}
+
+void ModuleLoader::run() {
+    mLastError = trackerboy::FormatError::none;
+    mIoError = false;
+    mLastProgress = 0;
+    emit progressMax(TU::PROGRESS_MAX);
+    emit progress(0);
+
+    QFile file(mPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        mIoError = true;
+        return;
+    }
+
+    auto const size = (size_t)file.size();
+    if (size == 0) {
+        // nothing to map, let the deserializer report the error
+        parse(nullptr, 0, 0);
+        return;
+    }
+
+    if (auto const mapped = file.map(0, file.size()); mapped != nullptr) {
+        // pages are read in as the deserializer touches them
+        parse(reinterpret_cast<char const*>(mapped), size, 0);
+        file.unmap(mapped);
+        return;
+    }
+
+    // mapping is not supported for this file, read it in chunks instead
+    // with the read taking the first half of the progress
+    QByteArray contents;
+    contents.resize((qsizetype)size);
+    size_t read = 0;
+    while (read < size) {
+        if (mCancelled) {
+            return;
+        }
+        auto const amount = file.read(contents.data() + read, (qint64)std::min(TU::CHUNK_SIZE, size - read));
+        if (amount <= 0) {
+            mIoError = true;
+            return;
+        }
+        read += (size_t)amount;
+        reportProgress((int)(TU::PROGRESS_MAX / 2 * read / size));
+    }
+
+    parse(contents.constData(), size, TU::PROGRESS_MAX / 2);
+}
+
+void ModuleLoader::parse(char const *contents, size_t size, int progressBase) {
+    auto const scale = TU::PROGRESS_MAX - progressBase;
+    TU::ChunkedBuf buf(contents, size, [this, size, progressBase, scale](size_t pos) {
+        if (mCancelled) {
+            return false;
+        }
+        reportProgress(progressBase + (int)(scale * pos / size));
+        return true;
+    });
+    std::istream in(&buf);
+
+    mLastError = mData.deserialize(in);
+    if (!mCancelled) {
+        mIoError = in.bad();
+        reportProgress(TU::PROGRESS_MAX);
+    }
+}
+
+void ModuleLoader::reportProgress(int amount) {
+    // only emit when the amount changes, at most PROGRESS_MAX times
+    if (amount != mLastProgress) {
+        mLastProgress = amount;
+        emit progress(amount);
+    }
+}
+
+#undef TU
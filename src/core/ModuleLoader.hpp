@@ -0,0 +1,89 @@
+#pragma once
+
+#include "trackerboy/data/Module.hpp"
+
+#include <QString>
+#include <QThread>
+
+#include <atomic>
+
+//
+// Worker thread for loading a module file. The file is memory-mapped when
+// possible (or read in chunks otherwise) and deserialized into a separate
+// trackerboy::Module, so that the GUI stays responsive while loading large
+// modules or modules on slow drives. The loaded module can then be swapped
+// into the editor's Module via ModuleFile::open once the thread has finished.
+//
+class ModuleLoader : public QThread {
+    Q_OBJECT
+
+public:
+    explicit ModuleLoader(QString const& path, QObject *parent = nullptr);
+
+    //
+    // Cancels and waits for the load if it is still in progress.
+    //
+    ~ModuleLoader();
+
+    QString path() const;
+
+    //
+    // Requests the load to be cancelled. The thread finishes shortly after,
+    // with wasCancelled() returning true. Thread-safe.
+    //
+    void cancel();
+
+    bool wasCancelled() const;
+
+    //
+    // Format error from deserializing, only valid when finished.
+    //
+    trackerboy::FormatError lastError() const;
+
+    //
+    // Returns true if the file could not be read, only valid when finished.
+    //
+    bool hasIoError() const;
+
+    //
+    // Returns true if the load finished without error or cancellation.
+    //
+    bool succeeded() const;
+
+    //
+    // The loaded module. Only access when finished.
+    //
+    trackerboy::Module& data();
+
+signals:
+    //
+    // Progress is reported on a fixed scale, progressMax is emitted once at
+    // the start of the load, and progress is emitted as the file is read.
+    //
+    void progressMax(int max);
+    void progress(int amount);
+
+protected:
+    virtual void run() override;
+
+private:
+    Q_DISABLE_COPY(ModuleLoader)
+
+    //
+    // Deserializes the module from the given file contents. progressBase is
+    // the progress already made before parsing.
+    //
+    void parse(char const *contents, size_t size, int progressBase);
+
+    void reportProgress(int amount);
+
+    QString mPath;
+    trackerboy::Module mData;
+
+    trackerboy::FormatError mLastError;
+    bool mIoError;
+
+    std::atomic_bool mCancelled;
+    int mLastProgress;
+
+};
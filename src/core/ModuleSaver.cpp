@@ -0,0 +1,107 @@
+
+#include "core/ModuleSaver.hpp"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtDebug>
+
+#define TU ModuleSaverTU
+namespace TU {
+
+//
+// Copies filename to filename.bak, replacing the existing backup.
+//
+static void backupFile(QString const& filename) {
+    static constexpr auto errorPrefix = "failed to backup module:";
+
+    QFileInfo info(filename);
+    if (!info.exists() || !info.isFile()) {
+        return;
+    }
+
+    // Qt doesn't have an overwrite file copy function so copy to a
+    // temporary name first and then replace the old backup
+    QFileInfo backupInfo(filename + ".bak");
+    QString backupPath = backupInfo.filePath();
+    if (backupInfo.exists() && !backupInfo.isFile()) {
+        // ERROR! the backup dest is not a file!
+        qWarning() << errorPrefix << "backup destination in use";
+        return;
+    }
+
+    QString const tempPath = backupPath + ".tmp";
+    QFile::remove(tempPath);
+    if (!QFile::copy(filename, tempPath)) {
+        // ERROR! failed to backup module
+        qWarning() << errorPrefix << "cannot copy existing module";
+        return;
+    }
+
+    if (backupInfo.exists() && !QFile::remove(backupPath)) {
+        // ERROR! failed to remove existing backup
+        qWarning() << errorPrefix << "cannot remove existing backup";
+        QFile::remove(tempPath);
+        return;
+    }
+
+    if (!QFile::rename(tempPath, backupPath)) {
+        qWarning() << errorPrefix << "cannot rename backup";
+        QFile::remove(tempPath);
+        return;
+    }
+
+    qInfo() << "module backup saved to" << backupPath;
+}
+
+}
+
+
+ModuleSaver::ModuleSaver(QObject *parent) :
+    QObject(parent),
+    mPool()
+{
+    // one writer, so that writes to the same file happen in order
+    mPool.setMaxThreadCount(1);
+}
+
+ModuleSaver::~ModuleSaver() {
+    waitForDone();
+}
+
+void ModuleSaver::save(QString const& filename, QByteArray const& data, bool backup) {
+    mPool.start([this, filename, data, backup]() {
+        auto const success = write(filename, data, backup);
+        QMetaObject::invokeMethod(this, [this, filename, success]() {
+            emit saved(filename, success);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void ModuleSaver::waitForDone() {
+    mPool.waitForDone();
+}
+
+bool ModuleSaver::write(QString const& filename, QByteArray const& data, bool backup) {
+    if (backup) {
+        TU::backupFile(filename);
+    }
+
+    // QSaveFile writes to a temporary file, which is synced to disk and then
+    // renamed over the destination on commit
+    QSaveFile file(filename);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "cannot save module:" << file.errorString();
+        return false;
+    }
+
+    if (file.write(data) != data.size()) {
+        qWarning() << "cannot save module:" << file.errorString();
+        file.cancelWriting();
+        return false;
+    }
+
+    return file.commit();
+}
+
+#undef TU
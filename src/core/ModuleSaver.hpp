@@ -0,0 +1,61 @@
+#pragma once
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+
+//
+// Writes serialized modules to disk from a worker thread. Modules are
+// snapshotted by serializing them to memory on the GUI thread (see
+// ModuleFile::snapshot), and the snapshot is then written here so that the
+// GUI does not wait on the disk. Writes are performed in the order they were
+// requested.
+//
+class ModuleSaver : public QObject {
+
+    Q_OBJECT
+
+public:
+
+    explicit ModuleSaver(QObject *parent = nullptr);
+
+    //
+    // Waits for any pending writes to finish.
+    //
+    ~ModuleSaver();
+
+    //
+    // Queues the given snapshot to be written to filename. The saved signal
+    // is emitted when the write completes.
+    //
+    void save(QString const& filename, QByteArray const& data, bool backup);
+
+    //
+    // Blocks until all queued writes have completed.
+    //
+    void waitForDone();
+
+    //
+    // Writes data to filename. The data is written to a temporary file in the
+    // same directory, flushed to disk and then renamed over filename, so that
+    // filename is never left partially written. If backup is true, the
+    // existing file is first copied to filename.bak, replacing the previous
+    // backup. Thread-safe.
+    //
+    static bool write(QString const& filename, QByteArray const& data, bool backup);
+
+signals:
+
+    //
+    // Emitted in the saver's thread (the thread it was created in) when a
+    // queued write has completed.
+    //
+    void saved(QString const& filename, bool success);
+
+private:
+    Q_DISABLE_COPY(ModuleSaver)
+
+    QThreadPool mPool;
+
+};
@@ -0,0 +1,212 @@
+
+#include "core/PatternIndex.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+#define TU PatternIndexTU
+namespace TU {
+
+static bool effectMatches(PatternQuery const& query, trackerboy::Effect const& effect) {
+    return effect.type != trackerboy::EffectType::noEffect &&
+           (uint8_t)effect.type == query.value &&
+           (!query.param || *query.param == effect.param);
+}
+
+}
+
+
+PatternQuery PatternQuery::note(uint8_t note) {
+    return { ColumnNote, note, std::nullopt };
+}
+
+PatternQuery PatternQuery::instrument(uint8_t instrument) {
+    return { ColumnInstrument, instrument, std::nullopt };
+}
+
+PatternQuery PatternQuery::effect(trackerboy::EffectType type, std::optional<uint8_t> param) {
+    return { ColumnEffect, (uint8_t)type, param };
+}
+
+bool PatternQuery::matches(trackerboy::TrackRow const& row) const {
+    switch (column) {
+        case ColumnNote:
+            return row.queryNote() == value;
+        case ColumnInstrument:
+            return row.queryInstrument() == value;
+        case ColumnEffect:
+            for (auto const& effect : row.effects) {
+                if (TU::effectMatches(*this, effect)) {
+                    return true;
+                }
+            }
+            break;
+    }
+    return false;
+}
+
+bool PatternReplacement::apply(PatternQuery const& query, trackerboy::TrackRow &row) const {
+    auto const original = row;
+
+    switch (query.column) {
+        case PatternQuery::ColumnNote:
+            if (value && row.queryNote() == query.value) {
+                row.note = trackerboy::TrackRow::convertColumn(value);
+            }
+            break;
+        case PatternQuery::ColumnInstrument:
+            if (value && row.queryInstrument() == query.value) {
+                row.instrumentId = trackerboy::TrackRow::convertColumn(value);
+            }
+            break;
+        case PatternQuery::ColumnEffect:
+            for (auto &effect : row.effects) {
+                if (TU::effectMatches(query, effect)) {
+                    if (value) {
+                        effect.type = static_cast<trackerboy::EffectType>(*value);
+                    }
+                    if (param) {
+                        effect.param = *param;
+                    }
+                }
+            }
+            break;
+    }
+
+    return !(row.note == original.note &&
+             row.instrumentId == original.instrumentId &&
+             std::equal(std::begin(row.effects), std::end(row.effects), std::begin(original.effects),
+                [](trackerboy::Effect const& a, trackerboy::Effect const& b) {
+                    return a.type == b.type && a.param == b.param;
+                }));
+}
+
+
+PatternIndex::PatternIndex() :
+    mUsage(TRACKS)
+{
+    invalidate();
+}
+
+void PatternIndex::invalidate() {
+    for (auto &usage : mUsage) {
+        usage.valid = false;
+    }
+}
+
+void PatternIndex::invalidate(TrackRef ref) {
+    mUsage[key(ref)].valid = false;
+}
+
+void PatternIndex::invalidate(trackerboy::OrderRow const& row) {
+    for (size_t track = 0; track < row.size(); ++track) {
+        invalidate(TrackRef{ (uint8_t)track, row[track] });
+    }
+}
+
+std::vector<PatternIndex::TrackRef> PatternIndex::tracks(trackerboy::Song &song, PatternQuery const& query) {
+    std::vector<TrackRef> result;
+    // tracks already visited
+    std::bitset<TRACKS> seen;
+
+    auto const& order = song.order();
+    auto const orderSize = (int)order.size();
+    for (int pattern = 0; pattern < orderSize; ++pattern) {
+        auto const row = order[pattern];
+        for (size_t track = 0; track < row.size(); ++track) {
+            TrackRef const ref{ (uint8_t)track, row[track] };
+            auto const k = key(ref);
+            if (!seen[k]) {
+                seen[k] = true;
+                if (uses(song, ref, query)) {
+                    result.push_back(ref);
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+std::vector<PatternIndex::Match> PatternIndex::find(trackerboy::Song &song, PatternQuery const& query) {
+    std::vector<Match> matches;
+
+    // rows matched in each track, only tracks using the query are scanned
+    std::vector<std::vector<int>> trackMatches(TRACKS);
+    for (auto ref : tracks(song, query)) {
+        auto const& track = song.patterns().getTrack(static_cast<trackerboy::ChType>(ref.track), ref.id);
+        auto &rows = trackMatches[key(ref)];
+        auto const size = (int)track.size();
+        for (int row = 0; row < size; ++row) {
+            if (query.matches(track[row])) {
+                rows.push_back(row);
+            }
+        }
+    }
+
+    auto const& order = song.order();
+    auto const orderSize = (int)order.size();
+    for (int pattern = 0; pattern < orderSize; ++pattern) {
+        auto const orderRow = order[pattern];
+        auto const first = matches.size();
+        for (size_t track = 0; track < orderRow.size(); ++track) {
+            for (auto row : trackMatches[key(TrackRef{ (uint8_t)track, orderRow[track] })]) {
+                matches.push_back({ pattern, (int)track, row });
+            }
+        }
+        // sort this pattern's matches by row
+        std::stable_sort(matches.begin() + first, matches.end(),
+            [](Match const& lhs, Match const& rhs) {
+                return lhs.row < rhs.row;
+            });
+    }
+
+    return matches;
+}
+
+size_t PatternIndex::key(TrackRef ref) {
+    return ((size_t)ref.track << 8) | ref.id;
+}
+
+PatternIndex::Usage const& PatternIndex::usage(trackerboy::Song &song, TrackRef ref) {
+    auto &usage = mUsage[key(ref)];
+    if (!usage.valid) {
+        usage.instruments = 0;
+        usage.notes.reset();
+        usage.effects.reset();
+
+        auto const& track = song.patterns().getTrack(static_cast<trackerboy::ChType>(ref.track), ref.id);
+        auto const size = (int)track.size();
+        for (int row = 0; row < size; ++row) {
+            auto const& rowdata = track[row];
+            if (auto note = rowdata.queryNote(); note) {
+                usage.notes[*note] = true;
+            }
+            if (auto instrument = rowdata.queryInstrument(); instrument) {
+                usage.instruments |= UINT64_C(1) << (*instrument & 63);
+            }
+            for (auto const& effect : rowdata.effects) {
+                if (effect.type != trackerboy::EffectType::noEffect) {
+                    usage.effects[(uint8_t)effect.type] = true;
+                }
+            }
+        }
+        usage.valid = true;
+    }
+    return usage;
+}
+
+bool PatternIndex::uses(trackerboy::Song &song, TrackRef ref, PatternQuery const& query) {
+    auto const& trackUsage = usage(song, ref);
+    switch (query.column) {
+        case PatternQuery::ColumnNote:
+            return trackUsage.notes[query.value];
+        case PatternQuery::ColumnInstrument:
+            return query.value < 64 && (trackUsage.instruments & (UINT64_C(1) << query.value));
+        case PatternQuery::ColumnEffect:
+            return trackUsage.effects[query.value];
+    }
+    return false;
+}
+
+#undef TU
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "trackerboy/data/Song.hpp"
+#include "trackerboy/data/Track.hpp"
+#include "trackerboy/data/TrackRow.hpp"
+
+#include <bitset>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+//
+// Search criteria for pattern data. A query matches a single column of a
+// track row: the note, the instrument or any of the effects. Effects are
+// matched by type and optionally by parameter.
+//
+struct PatternQuery {
+
+    enum Column {
+        ColumnNote,
+        ColumnInstrument,
+        ColumnEffect
+    };
+
+    Column column;
+    // note, instrument id or effect type
+    uint8_t value;
+    // effect parameter to match, any parameter matches if not set
+    std::optional<uint8_t> param;
+
+    static PatternQuery note(uint8_t note);
+
+    static PatternQuery instrument(uint8_t instrument);
+
+    static PatternQuery effect(trackerboy::EffectType type, std::optional<uint8_t> param = std::nullopt);
+
+    //
+    // Determines if the given row matches this query.
+    //
+    bool matches(trackerboy::TrackRow const& row) const;
+
+};
+
+//
+// Replacement for the column matched by a PatternQuery. Unset values are
+// kept, so an effect's parameter can be replaced without changing its type.
+//
+struct PatternReplacement {
+
+    // new note, instrument id or effect type
+    std::optional<uint8_t> value;
+    // new effect parameter, effect queries only
+    std::optional<uint8_t> param;
+
+    //
+    // Replaces the columns of the row matched by the query. Returns true if
+    // the row was changed.
+    //
+    bool apply(PatternQuery const& query, trackerboy::TrackRow &row) const;
+
+};
+
+//
+// Index of the notes, instruments and effect types used by each track in a
+// song. Searches only need to scan the tracks that use the value being
+// searched for, instead of every row in the song.
+//
+// The index is maintained incrementally: edits invalidate the tracks they
+// modify and the usage of a track is recomputed the next time it is needed.
+// Order changes do not invalidate anything, as the order is only consulted
+// when searching.
+//
+class PatternIndex {
+
+public:
+
+    //
+    // Identifies a track in a song's pattern map
+    //
+    struct TrackRef {
+        uint8_t track;  // channel
+        uint8_t id;
+
+        bool operator==(TrackRef const& other) const noexcept {
+            return track == other.track && id == other.id;
+        }
+    };
+
+    //
+    // A row matching a query. Since tracks can be used by multiple patterns,
+    // a track row appears once for every pattern using it.
+    //
+    struct Match {
+        int pattern;    // index in the order
+        int track;      // channel
+        int row;
+    };
+
+    PatternIndex();
+
+    //
+    // Invalidates every track, call when the song changes.
+    //
+    void invalidate();
+
+    //
+    // Invalidates a single track, call when the track has been modified.
+    //
+    void invalidate(TrackRef ref);
+
+    //
+    // Invalidates the tracks used by the given order row.
+    //
+    void invalidate(trackerboy::OrderRow const& row);
+
+    //
+    // Gets the tracks used by the song's order that have at least one row
+    // matching the query (according to the index). Each track appears once,
+    // in order of first use.
+    //
+    std::vector<TrackRef> tracks(trackerboy::Song &song, PatternQuery const& query);
+
+    //
+    // Finds every row in the song matching the query, sorted by pattern, row
+    // and then track.
+    //
+    std::vector<Match> find(trackerboy::Song &song, PatternQuery const& query);
+
+private:
+
+    // values used by a track
+    struct Usage {
+        bool valid;
+        uint64_t instruments;
+        std::bitset<256> notes;
+        std::bitset<256> effects;
+    };
+
+    static constexpr size_t TRACKS = 4 * 256;
+
+    static size_t key(TrackRef ref);
+
+    Usage const& usage(trackerboy::Song &song, TrackRef ref);
+
+    bool uses(trackerboy::Song &song, TrackRef ref, PatternQuery const& query);
+
+    std::vector<Usage> mUsage;
+
+};
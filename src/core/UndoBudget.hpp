@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+
+//
+// Memory accounting for an undo stack. Commands add their size in bytes when
+// created and remove it when deleted. When the budget is exceeded, the oldest
+// history is evicted by the Module until usage is back under the budget.
+//
+class UndoBudget {
+
+public:
+
+    explicit UndoBudget(size_t limit) :
+        mLimit(limit),
+        mUsed(0)
+    {
+    }
+
+    size_t limit() const {
+        return mLimit;
+    }
+
+    size_t used() const {
+        return mUsed;
+    }
+
+    bool isExceeded() const {
+        return mUsed > mLimit;
+    }
+
+    void add(size_t bytes) {
+        mUsed += bytes;
+    }
+
+    void remove(size_t bytes) {
+        mUsed -= bytes;
+    }
+
+private:
+
+    size_t const mLimit;
+    size_t mUsed;
+
+};
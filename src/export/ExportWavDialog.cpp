@@ -6,6 +6,7 @@
 #include "export/WavExporter.hpp"
 
 #include <QCheckBox>
+#include <QComboBox>
 #include <QDialogButtonBox>
 #include <QFileDialog>
 #include <QFileInfo>
@@ -19,6 +20,8 @@
 #include <QStackedLayout>
 #include <QStringView>
 
+#include <vector>
+
 ExportWavDialog::ExportWavDialog(
     Module const& mod,
     ModuleFile const& modFile,
@@ -83,11 +86,25 @@ ExportWavDialog::ExportWavDialog(
     channelLayout->addStretch();
     mChannelsGroup->setLayout(channelLayout);
 
+    mFormatGroup = new QGroupBox(tr("Format"));
+    auto formatLayout = new QHBoxLayout;
+    mFormatCombo = new QComboBox;
+    mFormatCombo->addItem(tr("32-bit float"), QVariant::fromValue((int)Wav::Format::float32));
+    mFormatCombo->addItem(tr("24-bit PCM"), QVariant::fromValue((int)Wav::Format::pcm24));
+    mFormatCombo->addItem(tr("16-bit PCM"), QVariant::fromValue((int)Wav::Format::pcm16));
+    mDitherCheck = new QCheckBox(tr("Dither"));
+    formatLayout->addWidget(mFormatCombo);
+    formatLayout->addWidget(mDitherCheck);
+    formatLayout->addStretch();
+    mFormatGroup->setLayout(formatLayout);
+
     mDestinationGroup = new QGroupBox(tr("Destination"));
     auto destinationLayout = new QVBoxLayout;
     mSeparateChannelsCheck = new QCheckBox(tr("Export each channel separately"));
+    mAllSongsCheck = new QCheckBox(tr("Export all songs"));
     mDestinationStack = new QStackedLayout;
     destinationLayout->addWidget(mSeparateChannelsCheck);
+    destinationLayout->addWidget(mAllSongsCheck);
     destinationLayout->addLayout(mDestinationStack, 1);
     auto singleContainer = new QWidget;
     auto singleLayout = new QHBoxLayout;
@@ -127,6 +144,7 @@ ExportWavDialog::ExportWavDialog(
 
     layout->addWidget(mDurationGroup);
     layout->addWidget(mChannelsGroup);
+    layout->addWidget(mFormatGroup);
     layout->addWidget(mDestinationGroup);
     layout->addWidget(mProgress);
     layout->addWidget(mStatusLabel);
@@ -141,6 +159,11 @@ ExportWavDialog::ExportWavDialog(
     mTimeEdit->setInputMask(QStringLiteral("99:99"));
     mTimeEdit->setMaxLength(5);
     mProgress->setAlignment(Qt::AlignVCenter | Qt::AlignHCenter);
+    // dithering only applies to integer formats
+    mDitherCheck->setEnabled(false);
+    mDitherCheck->setChecked(true);
+    // only useful when there is more than one song to export
+    mAllSongsCheck->setEnabled(mod.data().songs().size() > 1);
     
     connect(buttons, &QDialogButtonBox::accepted, this, &ExportWavDialog::accept);
     connect(buttons, &QDialogButtonBox::rejected, this, &ExportWavDialog::reject);
@@ -214,6 +237,12 @@ ExportWavDialog::ExportWavDialog(
             mSeparateDestination->setText(path);
         });
 
+    connect(mFormatCombo, qOverload<int>(&QComboBox::currentIndexChanged), this,
+        [this](int index) {
+            auto format = (Wav::Format)mFormatCombo->itemData(index).toInt();
+            mDitherCheck->setEnabled(format != Wav::Format::float32);
+        });
+
     connect(mSeparateChannelsCheck, &QCheckBox::toggled, this,
         [this](bool checked) {
             mDestinationStack->setCurrentIndex(checked ? 1 : 0);
@@ -244,7 +273,7 @@ void ExportWavDialog::accept() {
 
     if (!isExporting) {
         if (mExporter == nullptr) {
-            mExporter = new WavExporter(mModule, mSamplerate, this);
+            mExporter = new WavExporter(mModule.data(), mSamplerate, this);
             connect(mExporter, &WavExporter::progressMax, mProgress, &QProgressBar::setMaximum);
             connect(mExporter, &WavExporter::progress, mProgress, &QProgressBar::setValue);
             connect(mExporter, &WavExporter::finished, this,
@@ -283,6 +312,22 @@ void ExportWavDialog::accept() {
             mExporter->setChannels(channels);
         }
 
+        mExporter->setFormat(
+            (Wav::Format)mFormatCombo->currentData().toInt(),
+            mDitherCheck->isChecked()
+        );
+
+        if (mAllSongsCheck->isChecked()) {
+            auto const& songs = mModule.data().songs();
+            std::vector<trackerboy::Song const*> songList;
+            for (int i = 0; i < songs.size(); ++i) {
+                songList.push_back(songs.get(i));
+            }
+            mExporter->setSongs(songList);
+        } else {
+            mExporter->setSongs({ mModule.song() });
+        }
+
         if (mSeparateChannelsCheck->isChecked()) {
             mExporter->setSeparate(true);
             mExporter->setDestination(mSeparateDestination->text());
@@ -316,5 +361,6 @@ void ExportWavDialog::reject() {
 void ExportWavDialog::setGroupsEnabled(bool enabled) {
     mDurationGroup->setEnabled(enabled);
     mChannelsGroup->setEnabled(enabled);
+    mFormatGroup->setEnabled(enabled);
     mDestinationGroup->setEnabled(enabled);
 }
@@ -6,6 +6,7 @@ class ModuleFile;
 class WavExporter;
 
 class QCheckBox;
+class QComboBox;
 #include <QDialog>
 class QDialogButtonBox;
 class QGroupBox;
@@ -46,6 +47,7 @@ private:
 
     QGroupBox *mDurationGroup;
     QGroupBox *mChannelsGroup;
+    QGroupBox *mFormatGroup;
     QGroupBox *mDestinationGroup;
 
     QRadioButton *mLoopRadio;
@@ -54,7 +56,11 @@ private:
     QLineEdit *mTimeEdit;
     std::array<QCheckBox*, 4> mChannelChecks;
 
+    QComboBox *mFormatCombo;
+    QCheckBox *mDitherCheck;
+
     QCheckBox *mSeparateChannelsCheck;
+    QCheckBox *mAllSongsCheck;
     QStackedLayout *mDestinationStack;
     QLineEdit *mSingleDestination;
     QLineEdit *mSeparateDestination;
@@ -0,0 +1,326 @@
+
+#include "export/RenderCommand.hpp"
+
+#include "audio/Wav.hpp"
+#include "core/ChannelOutput.hpp"
+#include "core/Module.hpp"
+#include "core/ModuleFile.hpp"
+#include "export/WavExporter.hpp"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutex>
+#include <QThread>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <optional>
+#include <vector>
+
+#define main_tr(str) QCoreApplication::translate("main", str)
+
+#define TU RenderCommandTU
+namespace TU {
+
+static constexpr int EXIT_BAD_ARGUMENTS = -1;
+static constexpr int EXIT_RENDER_FAILED = 2;
+
+static constexpr int DEFAULT_SAMPLERATE = 44100;
+
+struct Options {
+    QString outputDir;          // empty to output next to each module
+    std::vector<int> songs;     // 0-based song indices, empty for the first song
+    bool allSongs = false;
+    ChannelOutput::Flags channels = ChannelOutput::AllOn;
+    bool separate = false;
+    trackerboy::Player::Duration duration = 1;
+    int samplerate = DEFAULT_SAMPLERATE;
+    Wav::Format format = Wav::Format::float32;
+    bool dither = false;
+};
+
+// stdout and stderr are shared by all render threads
+static QMutex outputMutex;
+
+static void print(FILE *stream, QString const& message) {
+    QMutexLocker locker(&outputMutex);
+    fputs(qPrintable(message), stream);
+    fputc('\n', stream);
+}
+
+//
+// Parses a channel list, ie "134" for channels 1, 3 and 4.
+//
+static std::optional<ChannelOutput::Flags> parseChannels(QString const& str) {
+    ChannelOutput::Flags flags = ChannelOutput::AllOff;
+    for (auto ch : str) {
+        auto const num = ch.digitValue();
+        if (num < 1 || num > 4) {
+            return std::nullopt;
+        }
+        flags |= (ChannelOutput::Flag)(1 << (num - 1));
+    }
+
+    if (flags == ChannelOutput::AllOff) {
+        return std::nullopt;
+    }
+    return flags;
+}
+
+static std::optional<Wav::Format> parseFormat(QString const& str) {
+    if (str == QLatin1String("float32")) {
+        return Wav::Format::float32;
+    } else if (str == QLatin1String("pcm24")) {
+        return Wav::Format::pcm24;
+    } else if (str == QLatin1String("pcm16")) {
+        return Wav::Format::pcm16;
+    } else {
+        return std::nullopt;
+    }
+}
+
+//
+// Loads and renders a single module. On failure, false is returned and error
+// is set to the reason.
+//
+static bool renderModule(QString const& path, Options const& options, int threads, QString &error) {
+    Module mod;
+    ModuleFile file;
+    if (!file.open(path, mod)) {
+        if (file.hasIoError()) {
+            error = main_tr("could not read file");
+        } else {
+            error = main_tr("invalid module (format error %1)").arg((int)file.lastError());
+        }
+        return false;
+    }
+
+    auto const& songList = mod.data().songs();
+    std::vector<trackerboy::Song const*> songs;
+    if (options.allSongs) {
+        for (int i = 0; i < (int)songList.size(); ++i) {
+            songs.push_back(songList.get(i));
+        }
+    } else if (options.songs.empty()) {
+        songs.push_back(songList.get(0));
+    } else {
+        for (auto index : options.songs) {
+            if (index >= (int)songList.size()) {
+                error = main_tr("module has no song #%1").arg(index + 1);
+                return false;
+            }
+            songs.push_back(songList.get(index));
+        }
+    }
+
+    QFileInfo info(path);
+    QDir const dir = options.outputDir.isEmpty() ? info.dir() : QDir(options.outputDir);
+    auto const basename = info.completeBaseName();
+
+    WavExporter exporter(mod.data(), options.samplerate);
+    exporter.setSongs(songs);
+    exporter.setDuration(options.duration);
+    exporter.setChannels(options.channels);
+    exporter.setFormat(options.format, options.dither);
+    exporter.setSeparate(options.separate);
+    if (options.separate) {
+        exporter.setDestination(dir.path());
+        exporter.setSeparatePrefix(basename);
+    } else {
+        exporter.setDestination(dir.filePath(basename + QStringLiteral(".wav")));
+    }
+    exporter.setMaxThreads(threads);
+
+    exporter.start();
+    exporter.wait();
+
+    if (exporter.failed()) {
+        error = main_tr("could not write to %1").arg(dir.path());
+        return false;
+    }
+    return true;
+}
+
+}
+
+
+int runRenderCommand(QCoreApplication &app) {
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(main_tr("Renders Trackerboy modules to WAV files"));
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    QCommandLineOption renderOption("render", main_tr("Render modules to WAV without starting the GUI"));
+    QCommandLineOption outputOption(
+        { "o", "output" },
+        main_tr("Directory to write WAV files to, defaults to the directory of each module"),
+        main_tr("dir")
+    );
+    QCommandLineOption songOption(
+        "song",
+        main_tr("Song number to render, starting at 1. Can be given multiple times"),
+        main_tr("number")
+    );
+    QCommandLineOption allSongsOption("all-songs", main_tr("Render all songs in each module"));
+    QCommandLineOption channelsOption(
+        "channels",
+        main_tr("Channels to render, ie 13 for channels 1 and 3. Defaults to all"),
+        main_tr("list"),
+        QStringLiteral("1234")
+    );
+    QCommandLineOption separateOption("separate", main_tr("Render each channel to a separate file"));
+    QCommandLineOption loopsOption(
+        "loops",
+        main_tr("Number of times to play each song. Default is 1"),
+        main_tr("count")
+    );
+    QCommandLineOption secondsOption(
+        "seconds",
+        main_tr("Render each song for the given number of seconds instead of a loop count"),
+        main_tr("seconds")
+    );
+    QCommandLineOption samplerateOption(
+        "samplerate",
+        main_tr("Output samplerate in Hz"),
+        main_tr("rate"),
+        QString::number(TU::DEFAULT_SAMPLERATE)
+    );
+    QCommandLineOption formatOption(
+        "format",
+        main_tr("Sample format: float32, pcm24 or pcm16"),
+        main_tr("format"),
+        QStringLiteral("float32")
+    );
+    QCommandLineOption ditherOption("dither", main_tr("Dither integer sample formats"));
+    QCommandLineOption jobsOption(
+        { "j", "jobs" },
+        main_tr("Number of modules to render at once, defaults to the number of cores"),
+        main_tr("count")
+    );
+
+    parser.addOptions({
+        renderOption,
+        outputOption,
+        songOption,
+        allSongsOption,
+        channelsOption,
+        separateOption,
+        loopsOption,
+        secondsOption,
+        samplerateOption,
+        formatOption,
+        ditherOption,
+        jobsOption
+    });
+    parser.addPositionalArgument("modules", main_tr("Module files to render"), "<module_file...>");
+
+    parser.process(app);
+
+    auto badArgument = [&parser](QString const& message) {
+        TU::print(stderr, message);
+        TU::print(stderr, parser.helpText());
+        return TU::EXIT_BAD_ARGUMENTS;
+    };
+
+    auto const modules = parser.positionalArguments();
+    if (modules.isEmpty()) {
+        return badArgument(main_tr("no modules given"));
+    }
+
+    TU::Options options;
+    options.outputDir = parser.value(outputOption);
+    if (!options.outputDir.isEmpty() && !QDir().mkpath(options.outputDir)) {
+        return badArgument(main_tr("could not create output directory"));
+    }
+
+    options.allSongs = parser.isSet(allSongsOption);
+    for (auto const& value : parser.values(songOption)) {
+        bool ok;
+        auto const song = value.toInt(&ok);
+        if (!ok || song < 1) {
+            return badArgument(main_tr("invalid song number: %1").arg(value));
+        }
+        options.songs.push_back(song - 1);
+    }
+
+    auto const channels = TU::parseChannels(parser.value(channelsOption));
+    if (!channels) {
+        return badArgument(main_tr("invalid channel list"));
+    }
+    options.channels = *channels;
+    options.separate = parser.isSet(separateOption);
+
+    if (parser.isSet(loopsOption) && parser.isSet(secondsOption)) {
+        return badArgument(main_tr("--loops and --seconds cannot be used together"));
+    } else if (parser.isSet(secondsOption)) {
+        bool ok;
+        auto const seconds = parser.value(secondsOption).toInt(&ok);
+        if (!ok || seconds < 1) {
+            return badArgument(main_tr("invalid duration"));
+        }
+        options.duration = std::chrono::seconds(seconds);
+    } else {
+        auto loops = 1;
+        if (parser.isSet(loopsOption)) {
+            bool ok;
+            loops = parser.value(loopsOption).toInt(&ok);
+            if (!ok || loops < 1) {
+                return badArgument(main_tr("invalid loop count"));
+            }
+        }
+        options.duration = loops;
+    }
+
+    bool ok;
+    options.samplerate = parser.value(samplerateOption).toInt(&ok);
+    if (!ok || options.samplerate < 8000) {
+        return badArgument(main_tr("invalid samplerate"));
+    }
+
+    auto const format = TU::parseFormat(parser.value(formatOption));
+    if (!format) {
+        return badArgument(main_tr("invalid sample format"));
+    }
+    options.format = *format;
+    options.dither = parser.isSet(ditherOption);
+
+    auto const cores = std::max(1, QThread::idealThreadCount());
+    auto jobs = cores;
+    if (parser.isSet(jobsOption)) {
+        jobs = parser.value(jobsOption).toInt(&ok);
+        if (!ok || jobs < 1) {
+            return badArgument(main_tr("invalid job count"));
+        }
+    }
+    jobs = std::min(jobs, (int)modules.size());
+    // split the cores between the modules being rendered at once, so that a
+    // single module still renders its songs and channels in parallel
+    auto const threadsPerModule = std::max(1, cores / jobs);
+
+    std::atomic_int failures(0);
+    QThreadPool pool;
+    pool.setMaxThreadCount(jobs);
+    for (auto const& path : modules) {
+        pool.start([path, &options, threadsPerModule, &failures]() {
+            QString error;
+            if (TU::renderModule(path, options, threadsPerModule, error)) {
+                TU::print(stdout, main_tr("rendered %1").arg(path));
+            } else {
+                TU::print(stderr, QStringLiteral("%1: %2").arg(path, error));
+                ++failures;
+            }
+        });
+    }
+    pool.waitForDone();
+
+    return failures ? TU::EXIT_RENDER_FAILED : 0;
+}
+
+#undef main_tr
+#undef TU
@@ -0,0 +1,13 @@
+#pragma once
+
+class QCoreApplication;
+
+//
+// Headless batch rendering of modules to wav files, the --render command line
+// mode. Only a QCoreApplication is needed, no widgets are created. Modules
+// are loaded and rendered in parallel.
+//
+// The application's arguments are parsed and each module given is rendered.
+// The exit code for the process is returned.
+//
+int runRenderCommand(QCoreApplication &app);
@@ -1,49 +1,126 @@
 
 #include "export/WavExporter.hpp"
 
-#include "audio/Wav.hpp"
+#include "audio/ChannelTapApu.hpp"
+#include "audio/WavWriter.hpp"
+
+#include "trackerboy/apu/DefaultApu.hpp"
+#include "trackerboy/engine/Engine.hpp"
+#include "trackerboy/Synth.hpp"
 
 #include <QDir>
 #include <QFileInfo>
+#include <QThreadPool>
 
+#include <array>
+#include <atomic>
 #include <memory>
+#include <vector>
+
+
+#define TU WavExporterTU
+namespace TU {
+
+// aggregated progress is reported on a 0 to PROGRESS_MAX scale
+static constexpr int PROGRESS_MAX = 1000;
+
+// interval, in milliseconds, between progress updates
+static constexpr int PROGRESS_INTERVAL = 50;
+
+//
+// Inserts a tag before the suffix of the given filename,
+// ie "song.wav", "song2" -> "song.song2.wav"
+//
+static QString tagFilename(QString const& filename, QString const& tag) {
+    QFileInfo info(filename);
+    auto suffix = info.suffix();
+    QString base = info.dir().filePath(info.completeBaseName());
+    if (suffix.isEmpty()) {
+        return QStringLiteral("%1.%2").arg(base, tag);
+    } else {
+        return QStringLiteral("%1.%2.%3").arg(base, tag, suffix);
+    }
+}
 
+}
+
+struct WavExporter::Job {
+    // channels played by the engine
+    ChannelOutput::Flags channels;
+    trackerboy::Song const* song;
+    // the mix's file, empty when exporting channels separately
+    QString filename;
+    // each channel's file, empty for channels not exported separately
+    std::array<QString, ChannelTapApu::CHANNELS> channelFilenames;
+
+    // written by the pool thread, read by the exporter thread
+    std::atomic_int progress;
+    std::atomic_int progressMax;
+
+    Job(trackerboy::Song const* song, ChannelOutput::Flags channels) :
+        channels(channels),
+        song(song),
+        filename(),
+        channelFilenames(),
+        progress(0),
+        progressMax(0)
+    {
+    }
+
+    bool isSeparate() const {
+        return filename.isEmpty();
+    }
+};
 
 
 WavExporter::WavExporter(
-    Module const& mod,
+    trackerboy::Module const& mod,
     int samplerate,
     QObject *parent
 ) :
     QThread(parent),
+    mModule(mod),
     mSamplerate(samplerate),
-    mApu(),
-    mSynth(mApu, samplerate, mod.data().framerate()),
-    mEngine(mApu, &mod.data()),
+    mSongs({ mod.songs().get(0) }),
     mDuration(0),
     mChannels(ChannelOutput::AllOn),
     mSeparate(false),
     mDestination(),
+    mSeparatePrefix(),
+    mFormat(Wav::Format::float32),
+    mDither(false),
+    mMaxThreads(0),
     mFailed(false),
     mAbort(false)
 {
-    mEngine.setSong(mod.song());
 }
 
 void WavExporter::setDuration(trackerboy::Player::Duration duration) {
     mDuration = duration;
 }
 
+void WavExporter::setSongs(std::vector<trackerboy::Song const*> const& songs) {
+    mSongs = songs;
+}
+
 void WavExporter::setDestination(QString const& dest) {
     mDestination = dest;
 }
 
+void WavExporter::setFormat(Wav::Format format, bool dither) {
+    mFormat = format;
+    mDither = dither;
+}
+
+void WavExporter::setMaxThreads(int threads) {
+    mMaxThreads = threads;
+}
+
 bool WavExporter::failed() const {
     return mFailed;
 }
 
 void WavExporter::cancel() {
-    QMutexLocker locker(&mMutex);
     mAbort = true;
 }
 
@@ -59,112 +136,195 @@ void WavExporter::setSeparatePrefix(QString const& prefix) {
     mSeparatePrefix = prefix;
 }
 
-#define TU WavExporterTU
-namespace TU {
+void WavExporter::run() {
 
-struct Batch {
-    QString filename;
-    ChannelOutput::Flags channels;
-};
+    mAbort = false;
+    mFailed = false;
+
+    // jobs for this run, one per file
+    std::vector<std::unique_ptr<Job>> jobs;
+    bool const multiSong = mSongs.size() > 1;
+    int songNo = 1;
+    for (auto song : mSongs) {
+        QString const songTag = QStringLiteral("song%1").arg(songNo++);
+        auto job = std::make_unique<Job>(song, mChannels);
+        if (mSeparate) {
+            // separate channel per file, all written by the song's job
+            QDir dest(mDestination);
+            QString prefix = mSeparatePrefix;
+            if (multiSong) {
+                prefix = QStringLiteral("%1.%2").arg(prefix, songTag);
+            }
 
-}
+            bool any = false;
+            for (int i = 0; i < ChannelTapApu::CHANNELS; ++i) {
+                if (mChannels.testFlag((ChannelOutput::Flag)(1 << i))) {
+                    job->channelFilenames[i] = dest.filePath(QStringLiteral("%1.ch%2.wav").arg(prefix, QString::number(i + 1)));
+                    any = true;
+                }
+            }
+            if (!any) {
+                continue;
+            }
+        } else {
+            // one file per song
+            job->filename = multiSong ? TU::tagFilename(mDestination, songTag) : mDestination;
+        }
+        jobs.push_back(std::move(job));
+    }
 
+    if (jobs.empty()) {
+        return;
+    }
 
-void WavExporter::run() {
+    QThreadPool pool;
+    if (mMaxThreads > 0) {
+        pool.setMaxThreadCount(mMaxThreads);
+    }
+    for (auto &job : jobs) {
+        auto jobPtr = job.get();
+        pool.start([this, jobPtr]() {
+            exportJob(*jobPtr);
+        });
+    }
 
-    // batches for this run
-    std::array<TU::Batch, 4> batches;
-    int batchCount = 0;
-    if (mSeparate) {
-        // separate channel per file, each channel gets its own batch
-        auto iter = batches.begin();
-
-        QDir dest(mDestination);
-
-        for (int i = 0; i < 4; ++i) {
-            auto const flag = (ChannelOutput::Flag)(1 << i);
-            if (mChannels.testFlag(flag)) {
-                iter->channels = flag;
-                iter->filename = dest.filePath(
-                    QStringLiteral("%1.ch%2.wav").arg(
-                        mSeparatePrefix,
-                        QString::number(i + 1)
-                    ));
-                ++iter;
+    // every job contributes equally to the total progress
+    auto currentProgress = [&jobs]() {
+        double sum = 0.0;
+        for (auto const& job : jobs) {
+            auto const max = job->progressMax.load();
+            if (max > 0) {
+                sum += (double)job->progress.load() / max;
             }
         }
+        return (int)(TU::PROGRESS_MAX * sum / jobs.size());
+    };
+
+    emit progressMax(TU::PROGRESS_MAX);
+    int lastProgress = 0;
+    emit progress(lastProgress);
+    while (!pool.waitForDone(TU::PROGRESS_INTERVAL)) {
+        auto const amount = currentProgress();
+        if (amount != lastProgress) {
+            lastProgress = amount;
+            emit progress(amount);
+        }
+    }
+    emit progress(currentProgress());
+}
 
-        batchCount = iter - batches.begin();
+void WavExporter::exportJob(Job &job) {
+    // separate channels are tapped from a single engine and synth pass
+    std::unique_ptr<trackerboy::IApu> apu;
+    ChannelTapApu *taps = nullptr;
+    if (job.isSeparate()) {
+        // only the exported channels are emulated, the mix is not needed
+        unsigned channels = 0;
+        for (int ch = 0; ch < ChannelTapApu::CHANNELS; ++ch) {
+            if (!job.channelFilenames[ch].isEmpty()) {
+                channels |= 1u << ch;
+            }
+        }
+        auto tapApu = std::make_unique<ChannelTapApu>(false, channels);
+        taps = tapApu.get();
+        apu = std::move(tapApu);
     } else {
-        // one file, one batch
-        batchCount = 1;
-        batches[0].filename = mDestination;
-        batches[0].channels = mChannels;
+        apu = std::make_unique<trackerboy::DefaultApu>();
+    }
+    trackerboy::Synth synth(*apu, mSamplerate, mModule.framerate());
+    trackerboy::Engine engine(*apu, &mModule);
+    engine.setSong(job.song);
+
+    for (int ch = 0; ch < 4; ++ch) {
+        if (job.channels.testFlag((ChannelOutput::Flag)(1 << ch))) {
+            engine.lock(static_cast<trackerboy::ChType>(ch));
+        } else {
+            engine.unlock(static_cast<trackerboy::ChType>(ch));
+        }
     }
 
-    // temporary buffer for transferring samples from apu to the wav file
-    auto buffersize = mSynth.framesize() * 2;
-    auto buffer = std::make_unique<float[]>(buffersize);
-
-    for (int i = 0; i < batchCount; ++i) {
-
-        trackerboy::Player player(mEngine);
-        player.start(mDuration);
-
-        auto const channels = batches[i].channels;
-        for (int ch = 0; ch < 4; ++ch) {
-            if (channels.testFlag((ChannelOutput::Flag)(1 << ch))) {
-                mEngine.lock(static_cast<trackerboy::ChType>(ch));
-            } else {
-                mEngine.unlock(static_cast<trackerboy::ChType>(ch));
+    trackerboy::Player player(engine);
+    player.start(mDuration);
+    job.progressMax = player.progressMax();
+
+    // the mix's file, or a file for each separate channel (nullptr if the
+    // channel is not exported)
+    std::unique_ptr<WavWriter> mixWav;
+    std::array<std::unique_ptr<WavWriter>, ChannelTapApu::CHANNELS> channelWavs;
+    std::vector<WavWriter*> wavs;
+    auto openWav = [&](QString const& filename) {
+        auto wav = std::make_unique<WavWriter>(filename.toStdString(), 2, mSamplerate, mFormat, mDither);
+        wavs.push_back(wav.get());
+        return wav;
+    };
+    if (taps) {
+        for (int ch = 0; ch < ChannelTapApu::CHANNELS; ++ch) {
+            if (!job.channelFilenames[ch].isEmpty()) {
+                channelWavs[ch] = openWav(job.channelFilenames[ch]);
             }
         }
+    } else {
+        mixWav = openWav(job.filename);
+    }
 
-
-        Wav wav(batches[i].filename.toStdString(), 2, mSamplerate);
-        if (!wav.stream().good()) {
-            mFailed = true;
-            return;
+    auto allGood = [&wavs]() {
+        for (auto wav : wavs) {
+            if (!wav->good()) {
+                return false;
+            }
         }
+        return true;
+    };
 
-        emit progressMax(player.progressMax());
-        auto lastProgress = player.progress();
-        emit progress(lastProgress);
+    if (!allGood()) {
+        fail();
+        return;
+    }
 
-        for (;;) {
+    // temporary buffer for transferring samples from apu to the wav file
+    auto const framesize = synth.framesize();
+    auto buffer = std::make_unique<float[]>(framesize * 2);
 
-            mMutex.lock();
-            if (mAbort) {
-                mAbort = false;
-                mMutex.unlock();
-                break;
-            }
-            mMutex.unlock();
+    while (!mAbort.load(std::memory_order_relaxed)) {
+        job.progress = player.progress();
 
-            auto currentProgress = player.progress();
-            if (currentProgress != lastProgress) {
-                lastProgress = currentProgress;
-                emit progress(currentProgress);
-            }
-
-            player.step();
-            if (!player.isPlaying()) {
-                break;
-            }
-            mSynth.run();
+        player.step();
+        if (!player.isPlaying()) {
+            break;
+        }
+        synth.run();
 
-            auto samplesRead = mApu.readSamples(buffer.get(), mSynth.framesize());
-            wav.write(buffer.get(), samplesRead);
-            if (!wav.stream().good()) {
-                mFailed = true;
-                return;
+        // the writer only fails asynchronously, checking it is just an
+        // atomic load
+        if (mixWav) {
+            auto const samplesRead = apu->readSamples(buffer.get(), framesize);
+            mixWav->write(buffer.get(), samplesRead);
+        }
+        if (taps) {
+            for (int ch = 0; ch < ChannelTapApu::CHANNELS; ++ch) {
+                if (channelWavs[ch]) {
+                    auto const samplesRead = taps->readChannelSamples(ch, buffer.get(), framesize);
+                    channelWavs[ch]->write(buffer.get(), samplesRead);
+                }
             }
-
         }
+        if (!allGood()) {
+            break;
+        }
+    }
 
-        mFailed = false;
-
+    for (auto wav : wavs) {
+        wav->close();
     }
+    if (!allGood()) {
+        fail();
+    }
+}
+
+void WavExporter::fail() {
+    // stop all other jobs as well, the export as a whole has failed
+    mFailed = true;
+    mAbort = true;
 }
 
 #undef TU
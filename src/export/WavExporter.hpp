@@ -1,33 +1,57 @@
 
 #pragma once
 
-#include "core/Module.hpp"
+#include "audio/Wav.hpp"
 #include "core/ChannelOutput.hpp"
 
-#include "trackerboy/apu/DefaultApu.hpp"
+#include "trackerboy/data/Module.hpp"
 #include "trackerboy/export/Player.hpp"
-#include "trackerboy/Synth.hpp"
 
 #include <QThread>
-#include <QMutex>
+
+#include <atomic>
+#include <vector>
 
 //
-// Worker thread for exporting a module to a wav file
+// Worker thread for exporting a module to a wav file. Each song to export is
+// rendered by its own engine, apu and synth on a thread pool, so that
+// multi-song exports use all available cores. When exporting channels
+// separately, all of a song's channel files are written from a single pass
+// using a ChannelTapApu.
 //
 class WavExporter : public QThread {
     Q_OBJECT
 
 public:
     WavExporter(
-        Module const& mod,
+        trackerboy::Module const& mod,
         int samplerate,
         QObject *parent = nullptr
     );
 
     void setDuration(trackerboy::Player::Duration duration);
 
+    //
+    // Sets the songs to export. When more than one song is given, the song
+    // number is added to each exported filename. By default, the first song
+    // in the module is exported.
+    //
+    void setSongs(std::vector<trackerboy::Song const*> const& songs);
+
     void setDestination(QString const& dest);
 
+    //
+    // Sets the sample format of the exported files. Dithering is only applied
+    // to the integer PCM formats.
+    //
+    void setFormat(Wav::Format format, bool dither);
+
+    //
+    // Limits the number of threads used for rendering. By default (0), the
+    // ideal thread count for the system is used.
+    //
+    void setMaxThreads(int threads);
+
     void setChannels(ChannelOutput::Flags channels);
 
     void setSeparate(bool separate);
@@ -39,6 +63,11 @@ public:
     void cancel();
 
 signals:
+    //
+    // Progress is aggregated from all files being exported. progressMax is
+    // emitted once at the start of the export, and progress is emitted
+    // periodically thereafter.
+    //
     void progressMax(int max);
     void progress(int amount);
 
@@ -46,12 +75,20 @@ protected:
     virtual void run() override;
 
 private:
-    QMutex mMutex;
+    // a song to export, defined in WavExporter.cpp
+    struct Job;
+
+    //
+    // Renders the job's song to its files. Called from a pool thread.
+    //
+    void exportJob(Job &job);
 
+    void fail();
+
+    trackerboy::Module const& mModule;
     int mSamplerate;
-    trackerboy::DefaultApu mApu;
-    trackerboy::Synth mSynth;
-    trackerboy::Engine mEngine;
+
+    std::vector<trackerboy::Song const*> mSongs;
 
     trackerboy::Player::Duration mDuration;
 
@@ -61,7 +98,12 @@ private:
     QString mDestination;
     QString mSeparatePrefix;
 
-    bool mFailed;
-    bool mAbort;
+    Wav::Format mFormat;
+    bool mDither;
+
+    int mMaxThreads;
+
+    std::atomic_bool mFailed;
+    std::atomic_bool mAbort;
 
 };
@@ -1,6 +1,11 @@
 
 #include "forms/AudioDiagDialog.hpp"
 
+#include <QDateTime>
+#include <QFile>
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QTextStream>
 #include <QTimerEvent>
 
 #define TU AudioDiagDialogTU
@@ -8,6 +13,33 @@ namespace TU {
 
 constexpr int DEFAULT_REFRESH_INTERVAL = 100;
 
+static QString summarize(Histogram::Snapshot const& snapshot, QString const& unit) {
+    if (snapshot.total == 0) {
+        return AudioDiagDialog::tr("n/a");
+    }
+    return AudioDiagDialog::tr("p50 %1 / p99 %2 / max %3 %4")
+        .arg(snapshot.percentile(0.5))
+        .arg(snapshot.percentile(0.99))
+        .arg(snapshot.max)
+        .arg(unit);
+}
+
+static void writeHistogram(QTextStream &stream, const char *name, Histogram::Snapshot const& snapshot) {
+    stream << "# " << name << ": count=" << snapshot.total
+           << " min=" << snapshot.min()
+           << " p50=" << snapshot.percentile(0.5)
+           << " p99=" << snapshot.percentile(0.99)
+           << " max=" << snapshot.max << '\n';
+    for (int i = 0; i < Histogram::BUCKETS; ++i) {
+        if (snapshot.counts[i]) {
+            stream << name << ','
+                   << Histogram::bucketLower(i) << ','
+                   << Histogram::bucketUpper(i) << ','
+                   << snapshot.counts[i] << '\n';
+        }
+    }
+}
+
 }
 
 AudioDiagDialog::AudioDiagDialog(Renderer &renderer, QWidget *parent) :
@@ -20,11 +52,20 @@ AudioDiagDialog::AudioDiagDialog(Renderer &renderer, QWidget *parent) :
     mRenderLayout(),
     mUnderrunLabel(),
     mBufferProgress(),
+    mTargetFillLabel(),
     mStatusLabel(),
+    mRealtimeLabel(),
     mElapsedLabel(),
     mPeriodLabel(),
     mPeriodWrittenLabel(),
     mClearButton(tr("Clear")),
+    mTimingGroup(tr("Timing")),
+    mTimingLayout(),
+    mRenderTimeLabel(),
+    mJitterLabel(),
+    mCallbackLabel(),
+    mBufferFillLabel(),
+    mSaveButton(tr("Save...")),
     mButtonLayout(),
     mAutoRefreshCheck(tr("Auto refresh")),
     mIntervalSpin(),
@@ -33,13 +74,22 @@ AudioDiagDialog::AudioDiagDialog(Renderer &renderer, QWidget *parent) :
 {
     mRenderLayout.addRow(tr("Underruns"), &mUnderrunLabel);
     mRenderLayout.addRow(tr("Buffer usage"), &mBufferProgress);
+    mRenderLayout.addRow(tr("Target fill"), &mTargetFillLabel);
     mRenderLayout.addRow(tr("Status"), &mStatusLabel);
+    mRenderLayout.addRow(tr("Real-time"), &mRealtimeLabel);
     mRenderLayout.addRow(tr("Elapsed"), &mElapsedLabel);
     mRenderLayout.addRow(tr("Refresh rate"), &mPeriodLabel);
     mRenderLayout.addRow(tr("Samples written"), &mPeriodWrittenLabel);
-    mRenderLayout.setWidget(6, QFormLayout::LabelRole, &mClearButton);
+    mRenderLayout.setWidget(8, QFormLayout::LabelRole, &mClearButton);
     mRenderGroup.setLayout(&mRenderLayout);
 
+    mTimingLayout.addRow(tr("Render time"), &mRenderTimeLabel);
+    mTimingLayout.addRow(tr("Period jitter"), &mJitterLabel);
+    mTimingLayout.addRow(tr("Callback interval"), &mCallbackLabel);
+    mTimingLayout.addRow(tr("Buffer fill"), &mBufferFillLabel);
+    mTimingLayout.setWidget(4, QFormLayout::LabelRole, &mSaveButton);
+    mTimingGroup.setLayout(&mTimingLayout);
+
     mButtonLayout.addWidget(&mAutoRefreshCheck);
     mButtonLayout.addWidget(&mIntervalSpin);
     mButtonLayout.addWidget(&mRefreshButton);
@@ -47,6 +97,7 @@ AudioDiagDialog::AudioDiagDialog(Renderer &renderer, QWidget *parent) :
     mButtonLayout.addWidget(&mCloseButton);
 
     mLayout.addWidget(&mRenderGroup, 1);
+    mLayout.addWidget(&mTimingGroup, 1);
     mLayout.addLayout(&mButtonLayout);
     mLayout.setSizeConstraint(QLayout::SizeConstraint::SetFixedSize);
     setLayout(&mLayout);
@@ -69,6 +120,7 @@ AudioDiagDialog::AudioDiagDialog(Renderer &renderer, QWidget *parent) :
     connect(&mCloseButton, &QPushButton::clicked, this, &AudioDiagDialog::close);
     connect(&mRefreshButton, &QPushButton::clicked, this, &AudioDiagDialog::refresh);
     connect(&mClearButton, &QPushButton::clicked, &mRenderer, &Renderer::clearDiagnostics);
+    connect(&mSaveButton, &QPushButton::clicked, this, &AudioDiagDialog::saveHistograms);
     connect(&mAutoRefreshCheck, &QCheckBox::stateChanged, this,
         [this](int state) {
             bool checked = state == Qt::Checked;
@@ -127,12 +179,57 @@ void AudioDiagDialog::refresh() {
         setElapsed(mRenderer.statElapsed());        
     }
     setRunningLabel(isRunning);
+    mRealtimeLabel.setText(mRenderer.isRealtime() ? tr("Yes") : tr("No"));
 
     auto const bufferStat = mRenderer.statBuffer();
     mBufferProgress.setMaximum(bufferStat.capacity);
     mBufferProgress.setValue(bufferStat.usage);
+    mTargetFillLabel.setText(tr("%1 / %2").arg(bufferStat.targetFill).arg(bufferStat.capacity));
     mPeriodLabel.setText(tr("%1 ms").arg(bufferStat.lastPeriodMs, 0, 'f', 3));
     mPeriodWrittenLabel.setText(QString::number(bufferStat.writesSinceLastPeriod));
+
+    auto const timing = mRenderer.statTiming();
+    auto const us = QStringLiteral("us");
+    mRenderTimeLabel.setText(TU::summarize(timing.renderTime, us));
+    mJitterLabel.setText(TU::summarize(timing.periodJitter, us));
+    mCallbackLabel.setText(TU::summarize(timing.callbackInterval, us));
+    mBufferFillLabel.setText(TU::summarize(timing.bufferFill, QStringLiteral("%")));
+}
+
+void AudioDiagDialog::saveHistograms() {
+    auto const filename = QFileDialog::getSaveFileName(
+        this,
+        tr("Save timing histograms"),
+        QString(),
+        tr("CSV files (*.csv);;All files (*)")
+    );
+    if (filename.isEmpty()) {
+        return;
+    }
+
+    // take the snapshot before the dialog potentially took a while
+    auto const timing = mRenderer.statTiming();
+
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        QMessageBox::critical(this, windowTitle(), tr("Could not open %1 for writing").arg(filename));
+        return;
+    }
+
+    QTextStream stream(&file);
+    stream << "# trackerboy audio timing, " << QDateTime::currentDateTime().toString(Qt::ISODate) << '\n';
+    stream << "# times in microseconds, buffer fill in percent\n";
+    stream << "# underruns=" << mRenderer.statUnderruns() << '\n';
+    stream << "histogram,bucket_min,bucket_max,count\n";
+    TU::writeHistogram(stream, "render_time", timing.renderTime);
+    TU::writeHistogram(stream, "period_jitter", timing.periodJitter);
+    TU::writeHistogram(stream, "callback_interval", timing.callbackInterval);
+    TU::writeHistogram(stream, "buffer_fill", timing.bufferFill);
+    stream.flush();
+
+    if (file.error() != QFileDevice::NoError) {
+        QMessageBox::critical(this, windowTitle(), tr("Could not write to %1").arg(filename));
+    }
 }
 
 void AudioDiagDialog::setRunningLabel(bool const isRunning) {
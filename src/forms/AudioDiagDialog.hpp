@@ -43,6 +43,11 @@ private:
 
     void setElapsed(long const msecs);
 
+    //
+    // Prompts for a file and writes the full timing histograms to it
+    //
+    void saveHistograms();
+
     Renderer &mRenderer;
     int mTimerId;
     bool mLastIsRunning;
@@ -53,11 +58,20 @@ private:
                 QLabel mUnderrunLabel;
                 //QLabel mBufferLabel;
                 QProgressBar mBufferProgress;
+                QLabel mTargetFillLabel;
                 QLabel mStatusLabel;
+                QLabel mRealtimeLabel;
                 QLabel mElapsedLabel;
                 QLabel mPeriodLabel;
                 QLabel mPeriodWrittenLabel;
                 QPushButton mClearButton;
+        QGroupBox mTimingGroup;
+            QFormLayout mTimingLayout;
+                QLabel mRenderTimeLabel;
+                QLabel mJitterLabel;
+                QLabel mCallbackLabel;
+                QLabel mBufferFillLabel;
+                QPushButton mSaveButton;
         QHBoxLayout mButtonLayout;
             QCheckBox mAutoRefreshCheck;
             QSpinBox mIntervalSpin;
@@ -50,11 +50,15 @@ MainWindow::MainWindow() :
     mUntitledString(tr("Untitled")),
     mPianoInput(),
     mMidi(),
+    mMidiReceiver(nullptr),
     mModule(),
     mModuleFile(),
+    mModuleSaver(),
+    mLoader(nullptr),
     mErrorSinceLastConfig(false),
+    mReportAudioConfig(false),
     mLastEngineFrame(),
-    mFrameSkip(0),
+    mLastElapsed(-1),
     mAutosave(false),
     mAutosaveIntervalMs(30000),
     mAudioDiag(nullptr),
@@ -199,6 +203,8 @@ void MainWindow::closeEvent(QCloseEvent *evt) {
         #ifdef QT_DEBUG
         }
         #endif
+        // user saved or discarded changes, nothing to recover
+        mModule->journal().stop();
         evt->accept();
     } else {
         // user aborted closing, ignore this event
@@ -216,9 +222,15 @@ void MainWindow::timerEvent(QTimerEvent *evt) {
     if (evt->timerId() == mAutosaveTimer.timerId()) {
         if (mModuleFile.hasFile()) {
             qDebug() << "[MainWindow] Auto-saving...";
-            onFileSave();
+            // only the snapshot is taken here, the file is written in the background
+            // the journal is truncated once the file has been written, edits
+            // made until then are journaled after the checkpoint
+            mModule->journal().checkpoint();
+            mModuleFile.save(mModuleSaver, *mModule);
             mAutosaveTimer.stop();
         }
+    } else if (evt->timerId() == mRefreshTimer.timerId()) {
+        refreshRenderer();
     } else {
         QMainWindow::timerEvent(evt);
     }
@@ -305,6 +317,8 @@ void MainWindow::setupUi() {
 
     setCentralWidget(centralWidget);
     mMidi.setReceiver(mPatternEditor);
+    mMidi.setDirectReceiver(mRenderer);
+    mMidiReceiver = mPatternEditor;
 
     {
         auto grid = mPatternEditor->grid();
@@ -328,6 +342,13 @@ void MainWindow::setupUi() {
                 }
             }
             mPatternEditor->setInstrument(id);
+            updateMidiPreview();
+        });
+    connect(mPatternModel, &PatternModel::cursorChanged, this,
+        [this](PatternModel::CursorChangeFlags flags) {
+            if (flags.testFlag(PatternModel::CursorTrackChanged)) {
+                updateMidiPreview();
+            }
         });
 
     connect(mWaveforms, &TableView::selectedItemChanged, this,
@@ -453,6 +474,24 @@ void MainWindow::setupUi() {
 
     lazyconnect(&mMidi, error, this, onMidiError);
 
+    connect(&mModuleSaver, &ModuleSaver::saved, this,
+        [this](QString const& filename, bool success) {
+            if (success) {
+                // the snapshot is on disk, only the edits made since then
+                // need to be journaled
+                if (filename == mModuleFile.filepath()) {
+                    mModule->journal().restart();
+                }
+            } else {
+                qWarning() << "[MainWindow] Auto-save to" << filename << "failed";
+                // the module was cleaned when the snapshot was taken, unless
+                // another file has been opened or saved since
+                if (filename == mModuleFile.filepath()) {
+                    mModule->makeDirty();
+                }
+            }
+        });
+
     connect(mModule, &Module::modifiedChanged, this,
         [this](bool modified) {
             if (modified) {
@@ -469,11 +508,16 @@ void MainWindow::setupUi() {
     connect(mRenderer, &Renderer::audioStarted, this, &MainWindow::onAudioStart);
     connect(mRenderer, &Renderer::audioStopped, this, &MainWindow::onAudioStop);
     connect(mRenderer, &Renderer::audioError, this, &MainWindow::onAudioError);
-    connect(mRenderer, &Renderer::frameSync, this, &MainWindow::onFrameSync);
+    connect(mRenderer, &Renderer::configApplied, this, &MainWindow::onAudioConfigured);
     
     auto scope = mSidebar->scope();
     scope->setBuffer(&mRenderer->visualizerBuffer());
-    connect(mRenderer, &Renderer::updateVisualizers, scope, qOverload<>(&AudioScope::update));
+    auto peakMeter = mSidebar->peakMeter();
+    peakMeter->setMeter(&mRenderer->levelMeter());
+    // the meter only polls while rendering
+    connect(mRenderer, &Renderer::audioStarted, peakMeter, [peakMeter]() { peakMeter->setActive(true); });
+    connect(mRenderer, &Renderer::audioStopped, peakMeter, [peakMeter]() { peakMeter->setActive(false); });
+    connect(mRenderer, &Renderer::audioError, peakMeter, [peakMeter]() { peakMeter->setActive(false); });
 
     lazyconnect(mRenderer, isPlayingChanged, mPatternModel, setPlaying);
 
@@ -582,8 +626,36 @@ void MainWindow::handleFocusChange(QWidget *oldWidget, QWidget *newWidget) {
             widget = widget->parentWidget();
         }
         mMidi.setReceiver(receiver);
+        mMidiReceiver = receiver;
+        updateMidiPreview();
+    }
+
+}
+
+void MainWindow::updateMidiPreview() {
+    Renderer::MidiPreview preview{ Renderer::MidiPreview::None, -1, -1 };
+
+    if (mMidi.isOpen()) {
+        if (mMidiReceiver == mPatternEditor) {
+            preview = {
+                Renderer::MidiPreview::Instrument,
+                mPatternModel->cursorTrack(),
+                mPatternEditor->instrument()
+            };
+        } else if (mInstrumentEditor && mMidiReceiver == mInstrumentEditor->piano()) {
+            auto item = mInstrumentEditor->currentItem();
+            if (item != -1) {
+                preview = { Renderer::MidiPreview::Instrument, -1, mInstrumentModel->id(item) };
+            }
+        } else if (mWaveEditor && mMidiReceiver == mWaveEditor->piano()) {
+            auto item = mWaveEditor->currentItem();
+            if (item != -1) {
+                preview = { Renderer::MidiPreview::Waveform, -1, mWaveModel->id(item) };
+            }
+        }
     }
 
+    mRenderer->setMidiPreview(preview);
 }
 
 namespace TU {
@@ -53,6 +53,11 @@ public:
     //
     void panic(QString const& msg);
 
+    //
+    // Opens the given module file. The module is loaded in the background,
+    // with a progress dialog shown for long loads. Does nothing if a module
+    // is already being opened.
+    //
     void openFile(QString const& filepath);
 
 protected:
@@ -110,8 +115,15 @@ private:
 
     void onAudioStart();
     void onAudioError();
+    void onAudioConfigured(bool success);
     void onAudioStop();
-    void onFrameSync();
+
+    //
+    // Displays the updates made by the renderer since the last refresh.
+    // Called once per displayed frame while rendering.
+    //
+    void refreshRenderer();
+    void updateFrame();
 
     // shortcut slots
     void previousInstrument();
@@ -231,12 +243,30 @@ private:
     //
     void handleFocusChange(QWidget *oldWidget, QWidget *newWidget);
 
+    //
+    // Tells the renderer what MIDI notes should preview, based on the
+    // current MIDI receiver.
+    //
+    void updateMidiPreview();
+
     //
     // Pushes the given filename to the recent files list. Each file that is
     // successfully opened and newly saved files should get added to this list
     //
     void pushRecentFile(QString const& file);
 
+    //
+    // Called when the module loader has finished. Replaces the current
+    // module with the loaded one, or reports the error if the load failed.
+    //
+    void finishOpen();
+
+    //
+    // Asks the user to recover the edits in the given journal, replaying them
+    // onto the current module if accepted. Returns true if recovered.
+    //
+    bool recoverJournal(QString const& path);
+
     //
     // Updates the recent files actions with the list stored in the config
     //
@@ -268,9 +298,15 @@ private:
     Palette mPalette;
 
     Midi mMidi;
+    // current receiver of MIDI events
+    IMidiReceiver *mMidiReceiver;
 
     Module *mModule;
     ModuleFile mModuleFile;
+    // writes auto-saves in the background
+    ModuleSaver mModuleSaver;
+    // non-null while a module is being opened
+    ModuleLoader *mLoader;
 
     InstrumentListModel *mInstrumentModel;
     SongListModel *mSongListModel;
@@ -281,8 +317,11 @@ private:
     Renderer *mRenderer;
 
     bool mErrorSinceLastConfig;
+    // report the result of the next sound config to the user
+    bool mReportAudioConfig;
     trackerboy::Frame mLastEngineFrame;
-    int mFrameSkip;
+    int mLastElapsed;
+    QBasicTimer mRefreshTimer;
 
     bool mAutosave;
     int mAutosaveIntervalMs;
@@ -17,6 +17,11 @@
 #include <QMenuBar>
 #include <QDesktopServices>
 #include <QUrl>
+#include <QFileInfo>
+#include <QProgressDialog>
+#include <QScreen>
+
+#include <algorithm>
 
 #define TU MainWindowTU
 namespace TU {
@@ -34,6 +39,8 @@ void MainWindow::onFileNew() {
 
     mRenderer->forceStop();
 
+    // changes were saved or discarded, nothing to recover
+    mModule->journal().stop();
     mModule->clear();
 
     mModuleFile.setName(mUntitledString);
@@ -63,15 +70,60 @@ void MainWindow::onFileOpen() {
 }
 
 void MainWindow::openFile(QString const& path) {
+    if (mLoader != nullptr) {
+        // already opening a module
+        return;
+    }
+
     mRenderer->forceStop();
 
-    QApplication::setOverrideCursor(Qt::WaitCursor);
-    bool opened = mModuleFile.open(path, *mModule);
+    mLoader = new ModuleLoader(path, this);
+
+    auto progress = new QProgressDialog(
+        tr("Opening %1...").arg(QFileInfo(path).fileName()),
+        tr("Cancel"),
+        0,
+        0,
+        this
+    );
+    progress->setWindowTitle(tr("Open module"));
+    progress->setWindowModality(Qt::WindowModal);
+    // modules that load quickly do not flash the dialog
+    progress->setMinimumDuration(500);
+    progress->setAutoClose(false);
+    progress->setAutoReset(false);
+    connect(mLoader, &ModuleLoader::progressMax, progress, &QProgressDialog::setMaximum);
+    connect(mLoader, &ModuleLoader::progress, progress, &QProgressDialog::setValue);
+    connect(progress, &QProgressDialog::canceled, mLoader, &ModuleLoader::cancel);
+    connect(mLoader, &ModuleLoader::finished, this,
+        [this, progress]() {
+            progress->deleteLater();
+            finishOpen();
+        });
+
+    QApplication::setOverrideCursor(Qt::BusyCursor);
+    mLoader->start();
+}
+
+void MainWindow::finishOpen() {
     QApplication::restoreOverrideCursor();
 
-    if (opened) {
-        pushRecentFile(path);
-    } else {
+    auto loader = mLoader;
+    mLoader = nullptr;
+    loader->deleteLater();
+
+    if (loader->succeeded()) {
+        // the previous module is closed normally, its journal is not needed
+        mModule->journal().stop();
+    }
+
+    if (mModuleFile.open(*loader, *mModule)) {
+        auto const journalPath = EditJournal::pathFor(loader->path());
+        bool const recovered = EditJournal::hasRecords(journalPath) && recoverJournal(journalPath);
+        // keep journaling after the recovered edits, they are still unsaved
+        mModule->journal().start(journalPath, !recovered);
+        pushRecentFile(loader->path());
+    } else if (!loader->wasCancelled()) {
         QMessageBox msgbox;
         msgbox.setIcon(QMessageBox::Critical);
         msgbox.setText(tr("Could not open module"));
@@ -99,7 +151,7 @@ void MainWindow::openFile(QString const& path) {
 
 
         msgbox.exec();
-        mModuleFile.setName(mUntitledString);
+        // the current module was left as is
 
     }
 
@@ -107,9 +159,46 @@ void MainWindow::openFile(QString const& path) {
     updateWindowTitle();
 }
 
+bool MainWindow::recoverJournal(QString const& path) {
+    auto const result = QMessageBox::question(
+        this,
+        tr("Recover changes"),
+        tr("Trackerboy did not close properly while editing this module. Recover the unsaved changes?"),
+        QMessageBox::Yes | QMessageBox::No,
+        QMessageBox::Yes
+    );
+    if (result != QMessageBox::Yes) {
+        return false;
+    }
+
+    EditJournal::Recovery recovery;
+    {
+        auto editor = mModule->edit();
+        recovery = EditJournal::replay(path, mModule->data());
+    }
+    // refresh the models with the recovered data, which is still unsaved
+    mModule->reset();
+    mModule->makeDirty();
+
+    if (recovery.hasGap) {
+        QMessageBox::warning(
+            this,
+            tr("Recover changes"),
+            tr("Pattern and order changes were recovered. Other changes, such as to instruments, waveforms or song settings, could not be recovered.")
+        );
+    }
+    return true;
+}
+
 bool MainWindow::onFileSave() {
+    // an auto-save in progress must not overwrite this save
+    mModuleSaver.waitForDone();
     if (mModuleFile.hasFile()) {
-        return mModuleFile.save(*mModule);
+        auto const saved = mModuleFile.save(*mModule);
+        if (saved) {
+            mModule->journal().restart();
+        }
+        return saved;
     } else {
         return onFileSaveAs();
     }
@@ -135,8 +224,13 @@ bool MainWindow::onFileSaveAs() {
         return false;
     }
 
+    mModuleSaver.waitForDone();
     auto result = mModuleFile.save(path, *mModule);
     if (result) {
+        // journal the module under its new path
+        auto &journal = mModule->journal();
+        journal.stop();
+        journal.start(EditJournal::pathFor(path));
         pushRecentFile(path);
         // the document has a new name, update the window title
         updateWindowTitle();
@@ -254,6 +348,7 @@ void MainWindow::onMidiError() {
         msgbox.setDetailedText(mMidi.lastError());
         settingsMessageBox(msgbox);
     }
+    updateMidiPreview();
 }
 
 Config::Categories MainWindow::applyConfig(Config const& config, Config::Categories categories, QString *problems) {
@@ -283,18 +378,10 @@ Config::Categories MainWindow::applyConfig(Config const& config, Config::Categor
         auto const& sound = config.sound();
         mStatusSamplerate->setText(tr("%1 Hz").arg(sound.samplerate()));
 
-        mErrorSinceLastConfig = !mRenderer->setConfig(sound, mAudioEnumerator);
-        if (mErrorSinceLastConfig) {
-            flags |= Config::CategorySound;
-            setPlayingStatus(PlayingStatusText::error);
-            if (problems) {
-                problems->append(tr("[Sound] The configured device could not be initialized. Playback is disabled.\n"));
-            }
-        } else {
-            if (!mRenderer->isRunning()) {
-                setPlayingStatus(PlayingStatusText::ready);
-            }
-        }
+        // the device is opened in the background, errors are reported by
+        // onAudioConfigured instead of through problems
+        mReportAudioConfig = problems != nullptr;
+        mRenderer->setConfig(sound, mAudioEnumerator);
     }
 
     if (categories.testFlag(Config::CategoryAppearance)) {
@@ -357,6 +444,7 @@ Config::Categories MainWindow::applyConfig(Config const& config, Config::Categor
                 qCritical().noquote() << "[MIDI] Failed to initialize MIDI device:" << mMidi.lastError();
             }
         }
+        updateMidiPreview();
     }
 
     return flags;
@@ -455,6 +543,7 @@ void MainWindow::showInstrumentEditor() {
         lazyconnect(piano, keyChange, mRenderer, setPreviewNote);
         lazyconnect(piano, keyUp, mRenderer, stopPreview);
         lazyconnect(mInstrumentEditor, openWaveEditor, this, editWaveform);
+        lazyconnect(mInstrumentEditor, currentItemChanged, this, updateMidiPreview);
     }
 
     mInstrumentEditor->show();
@@ -475,6 +564,7 @@ void MainWindow::showWaveEditor() {
             });
         lazyconnect(piano, keyChange, mRenderer, setPreviewNote);
         lazyconnect(piano, keyUp, mRenderer, stopPreview);
+        lazyconnect(mWaveEditor, currentItemChanged, this, updateMidiPreview);
     }
     mWaveEditor->show();
 }
@@ -498,8 +588,15 @@ void MainWindow::onAudioStart() {
     }
 
     mLastEngineFrame = {};
-    mFrameSkip = 0;
+    mLastElapsed = -1;
     setPlayingStatus(PlayingStatusText::playing);
+
+    // poll the renderer once per displayed frame
+    int interval = 1000 / 60;
+    if (auto const scr = screen(); scr != nullptr && scr->refreshRate() > 0.0) {
+        interval = std::max(1, (int)(1000.0 / scr->refreshRate()));
+    }
+    mRefreshTimer.start(interval, Qt::PreciseTimer, this);
 }
 
 void MainWindow::onAudioError() {
@@ -519,11 +616,34 @@ void MainWindow::onAudioError() {
     onAudioStop();
 }
 
+void MainWindow::onAudioConfigured(bool success) {
+    mErrorSinceLastConfig = !success;
+    if (success) {
+        if (!mRenderer->isRunning()) {
+            setPlayingStatus(PlayingStatusText::ready);
+        }
+    } else {
+        setPlayingStatus(PlayingStatusText::error);
+        if (mReportAudioConfig) {
+            QMessageBox msgbox(this);
+            msgbox.setIcon(QMessageBox::Critical);
+            msgbox.setText(tr("Problem(s) occurred when applying the config"));
+            msgbox.setInformativeText(tr("The configured device could not be initialized. Playback is disabled."));
+            msgbox.exec();
+        }
+    }
+    mReportAudioConfig = false;
+}
+
 void MainWindow::onAudioStop() {
     if (mRenderer->isRunning()) {
         return; // sometimes it takes too long for this signal to get here
     }
 
+    // show whatever was updated before stopping (the cleared visualizers)
+    mRefreshTimer.stop();
+    refreshRenderer();
+
     mPatternModel->setPlaying(false);
 
     if (!mErrorSinceLastConfig) {
@@ -531,15 +651,30 @@ void MainWindow::onAudioStop() {
     }
 }
 
-void MainWindow::onFrameSync() {
-    // this slot is called when the renderer has renderered a new frame
-    // sync is a bit misleading here, as this slot is called when this frame
-    // is in process of being bufferred. It is not the current frame being played out.
+void MainWindow::refreshRenderer() {
+    auto const updates = mRenderer->takeUpdates();
+    // the frame being heard advances between renders, as the output catches
+    // up to what was rendered
+    if (updates.testFlag(Renderer::FrameUpdate) || mRenderer->isRunning()) {
+        updateFrame();
+    }
+    if (updates.testFlag(Renderer::VisualizerUpdate)) {
+        mSidebar->scope()->refresh();
+    }
+}
+
+void MainWindow::updateFrame() {
+    // the frame is the one being played out, not the latest one rendered,
+    // which can be ahead by up to the entire playback buffer. Several frames
+    // may have been heard since the last update, only the latest is shown.
 
-    auto frame = mRenderer->currentFrame();
+    auto frame = mRenderer->playbackFrame();
 
-    // check if the player position changed
-    if (frame.startedNewRow) {        
+    // check if the player position changed, intermediate frames may have
+    // started the row so compare with the last frame shown. The same frame
+    // is polled until the next one is heard, so it only counts once.
+    if ((frame.startedNewRow && frame.time != mLastEngineFrame.time) ||
+        frame.row != mLastEngineFrame.row || frame.order != mLastEngineFrame.order) {
         // update tracker position
         mPatternModel->setTrackerCursor(frame.row, frame.order);
 
@@ -558,28 +693,19 @@ void MainWindow::onFrameSync() {
         mStatusTempo->setText(tempoToString(tempo));
     }
 
-    constexpr auto FRAME_SKIP = 30;
+    // determine elapsed time, the label only changes once a second
+    //auto framerate = mDocument.framerate();
+    int elapsed = frame.time / 60;
+    if (elapsed != mLastElapsed) {
+        mLastElapsed = elapsed;
+        int secs = elapsed;
+        int mins = secs / 60;
+        secs = secs % 60;
 
-    if (mLastEngineFrame.time != frame.time) {
-        // determine elapsed time
-        if (mFrameSkip == 0) {
-
-            //auto framerate = mDocument.framerate();
-            int elapsed = frame.time / 60;
-            int secs = elapsed;
-            int mins = secs / 60;
-            secs = secs % 60;
-
-            QString str = QStringLiteral("%1:%2")
-                .arg(mins, 2, 10, QChar('0'))
-                .arg(secs, 2, 10, QChar('0'));
-            mStatusElapsed->setText(str);
-
-
-            mFrameSkip = FRAME_SKIP;
-        } else {
-            --mFrameSkip;
-        }
+        QString str = QStringLiteral("%1:%2")
+            .arg(mins, 2, 10, QChar('0'))
+            .arg(secs, 2, 10, QChar('0'));
+        mStatusElapsed->setText(str);
     }
 
     mLastEngineFrame = frame;
@@ -28,6 +28,13 @@ public:
     // 
     void openItem(int index);
 
+signals:
+
+    //
+    // Emitted when the item being edited changes, index is -1 for no item
+    //
+    void currentItemChanged(int index);
+
 protected:
 
     explicit BaseEditor(
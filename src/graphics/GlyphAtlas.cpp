@@ -0,0 +1,131 @@
+
+#include "graphics/GlyphAtlas.hpp"
+
+#include <QString>
+#include <QtMath>
+
+#define TU GlyphAtlasTU
+namespace TU {
+
+// all printable ASCII characters are in the atlas
+static constexpr int FIRST_GLYPH = ' ';
+static constexpr int LAST_GLYPH = '~';
+static constexpr int GLYPH_COUNT = LAST_GLYPH - FIRST_GLYPH + 1;
+
+static const char HEX_TABLE[] = "0123456789ABCDEF";
+
+}
+
+GlyphAtlas::GlyphAtlas() :
+    mFont(),
+    mCellWidth(0),
+    mCellHeight(0),
+    mColors(),
+    mPixmap(),
+    mPixmapRatio(1.0),
+    mCells(),
+    mFragments()
+{
+}
+
+void GlyphAtlas::setFont(QFont const& font, int cellWidth, int cellHeight) {
+    mFont = font;
+    mCellWidth = cellWidth;
+    mCellHeight = cellHeight;
+    mPixmap = QPixmap();
+}
+
+void GlyphAtlas::setColors(std::vector<QColor> const& colors) {
+    mColors = colors;
+    mPixmap = QPixmap();
+}
+
+int GlyphAtlas::add(char cell, int color, int xpos, int ypos) {
+    auto const glyph = (int)(unsigned char)cell - TU::FIRST_GLYPH;
+    if (glyph >= 0 && glyph < TU::GLYPH_COUNT) {
+        mCells.push_back({ glyph, color, xpos, ypos });
+    }
+    return xpos + mCellWidth;
+}
+
+int GlyphAtlas::addHex(int hex, int color, int xpos, int ypos) {
+    xpos = add(TU::HEX_TABLE[(hex >> 4) & 0xF], color, xpos, ypos);
+    return add(TU::HEX_TABLE[hex & 0xF], color, xpos, ypos);
+}
+
+int GlyphAtlas::addDec(int dec, int color, int xpos, int ypos) {
+    xpos = add('0' + (dec / 100), color, xpos, ypos);
+    dec %= 100;
+    xpos = add('0' + (dec / 10), color, xpos, ypos);
+    dec %= 10;
+    return add('0' + dec, color, xpos, ypos);
+}
+
+void GlyphAtlas::flush(QPainter &painter) {
+    if (mCells.empty()) {
+        return;
+    }
+
+    auto const ratio = painter.device()->devicePixelRatioF();
+    if (mPixmap.isNull() || !qFuzzyCompare(ratio, mPixmapRatio)) {
+        build(ratio);
+    }
+
+    if (!mPixmap.isNull()) {
+        // fragment source rects are in device pixels, scale them back down
+        // to logical pixels when drawing
+        auto const sourceWidth = mCellWidth * ratio;
+        auto const sourceHeight = mCellHeight * ratio;
+        auto const scale = 1.0 / ratio;
+        auto const centerX = mCellWidth * 0.5;
+        auto const centerY = mCellHeight * 0.5;
+
+        mFragments.clear();
+        for (auto const& cell : mCells) {
+            if (cell.color < 0 || cell.color >= (int)mColors.size()) {
+                continue;
+            }
+            mFragments.push_back(QPainter::PixmapFragment::create(
+                QPointF(cell.xpos + centerX, cell.ypos + centerY),
+                QRectF(cell.glyph * sourceWidth, cell.color * sourceHeight, sourceWidth, sourceHeight),
+                scale,
+                scale
+            ));
+        }
+        painter.drawPixmapFragments(mFragments.data(), (int)mFragments.size(), mPixmap);
+    }
+
+    mCells.clear();
+}
+
+void GlyphAtlas::build(qreal ratio) {
+    mPixmap = QPixmap();
+    mPixmapRatio = ratio;
+    if (mCellWidth <= 0 || mCellHeight <= 0 || mColors.empty()) {
+        return;
+    }
+
+    QSize const size(TU::GLYPH_COUNT * mCellWidth, (int)mColors.size() * mCellHeight);
+    mPixmap = QPixmap(qCeil(size.width() * ratio), qCeil(size.height() * ratio));
+    mPixmap.setDevicePixelRatio(ratio);
+    mPixmap.fill(Qt::transparent);
+
+    QPainter painter(&mPixmap);
+    painter.setFont(mFont);
+
+    // glyphs are drawn the same way as CellPainter::drawCell
+    QString scratch(1, QChar(' '));
+    int ypos = 0;
+    for (auto const& color : mColors) {
+        painter.setPen(color);
+        int xpos = 0;
+        for (int glyph = 0; glyph < TU::GLYPH_COUNT; ++glyph) {
+            scratch[0] = QChar(TU::FIRST_GLYPH + glyph);
+            painter.drawText(xpos, ypos, mCellWidth, mCellHeight, Qt::AlignBottom, scratch);
+            xpos += mCellWidth;
+        }
+        ypos += mCellHeight;
+    }
+}
+
+#undef TU
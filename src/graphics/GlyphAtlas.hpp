@@ -0,0 +1,72 @@
+#pragma once
+
+#include <QColor>
+#include <QFont>
+#include <QPainter>
+#include <QPixmap>
+
+#include <vector>
+
+//
+// Pre-rasterized cache of character cells, one row of glyphs per color. Cells
+// are queued with add() and then drawn all at once with flush(), which is
+// much faster than laying out text for each character.
+//
+// The atlas is rebuilt lazily whenever the font, cell size, colors or the
+// device pixel ratio of the painter changes.
+//
+class GlyphAtlas {
+
+public:
+    GlyphAtlas();
+
+    //
+    // Sets the font and the size of a single cell.
+    //
+    void setFont(QFont const& font, int cellWidth, int cellHeight);
+
+    //
+    // Sets the colors available to add(), the color parameter is an index
+    // into this list.
+    //
+    void setColors(std::vector<QColor> const& colors);
+
+    //
+    // Queues a cell to be drawn at the given position. The x position of the
+    // next cell is returned.
+    //
+    int add(char cell, int color, int xpos, int ypos);
+
+    int addHex(int hex, int color, int xpos, int ypos);
+
+    int addDec(int dec, int color, int xpos, int ypos);
+
+    //
+    // Draws all queued cells with a single call and clears the queue.
+    //
+    void flush(QPainter &painter);
+
+private:
+    Q_DISABLE_COPY(GlyphAtlas)
+
+    void build(qreal ratio);
+
+    struct Cell {
+        int glyph;
+        int color;
+        int xpos;
+        int ypos;
+    };
+
+    QFont mFont;
+    int mCellWidth;
+    int mCellHeight;
+    std::vector<QColor> mColors;
+
+    QPixmap mPixmap;
+    qreal mPixmapRatio;
+
+    std::vector<Cell> mCells;
+    std::vector<QPainter::PixmapFragment> mFragments;
+
+};
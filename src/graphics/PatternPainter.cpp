@@ -61,12 +61,20 @@ static char effectTypeToChar(trackerboy::EffectType et) {
     }
 }
 
+// glyph atlas colors, indices 0-2 are the foreground colors for each
+// highlight
+static constexpr int ATLAS_INSTRUMENT = 3;
+static constexpr int ATLAS_EFFECT = 4;
+
 } // namespace TU
 
 // NOTE
 // Do not create temporary QPens! The member variable, mPen, should be used
 // instead when needing to modify QPainter's pen. Doing so will prevent
 // unnecessary heap allocations and improve performance.
+//
+// Pattern text is not drawn with QPainter::drawText, instead cells are queued
+// in a GlyphAtlas and blitted all at once at the end of drawPattern.
 
 
 PatternPainter::PatternPainter(QFont const& font) :
@@ -82,7 +90,8 @@ PatternPainter::PatternPainter(QFont const& font) :
     mColorCursor(),
     mColorLine(),
     mRowColors(),
-    mPen()
+    mPen(),
+    mAtlas()
 {
     setFont(font);
 }
@@ -91,6 +100,11 @@ bool PatternPainter::flats() const {
     return mNoteTable == &NoteStrings::Flats;
 }
 
+void PatternPainter::setFont(QFont const& font) {
+    CellPainter::setFont(font);
+    mAtlas.setFont(font, cellWidth(), cellHeight());
+}
+
 void PatternPainter::setFirstHighlight(int interval) {
     Q_ASSERT(interval >= 0);
     mHighlightInterval1 = interval;
@@ -127,6 +141,14 @@ void PatternPainter::setColors(Palette const& colors) {
         color.setAlpha(128);
     }
 
+    mAtlas.setColors({
+        mForegroundColors[0],
+        mForegroundColors[1],
+        mForegroundColors[2],
+        mColorInstrument,
+        mColorEffect
+    });
+
 }
 
 void PatternPainter::drawRowBackground(QPainter &p, PatternLayout const& l, RowType type, int row) const {
@@ -200,19 +222,20 @@ int PatternPainter::drawPattern(
     // text centering
     ypos++;
 
-    auto rownoDraw = l.rownoHex() ? &PatternPainter::drawHex : &PatternPainter::drawDec;
+    auto rownoDraw = l.rownoHex() ? &GlyphAtlas::addHex : &GlyphAtlas::addDec;
 
     for (int rowno = rowStart; rowno <= rowEnd; ++rowno) {
-        auto const& fgcolor = mForegroundColors[highlightIndex(rowno)];
-        p.setPen(mPen.get(fgcolor));
-        (*this.*rownoDraw)(p, rowno, PatternLayout::SPACING, ypos);
+        auto const highlight = highlightIndex(rowno);
+        // the pen is only used for non-text (note cuts and empty cells)
+        p.setPen(mPen.get(mForegroundColors[highlight]));
+        (mAtlas.*rownoDraw)(rowno, highlight, PatternLayout::SPACING, ypos);
         int xpos = start + PatternLayout::SPACING;
         for (int track = 0; track <= 3; ++track) {
             auto &trackdata = pattern.getTrackRow(static_cast<trackerboy::ChType>(track), rowno);
 
             auto note = trackdata.queryNote();
             if (note) {
-                xpos = drawNote(p, *note, xpos, ypos);
+                xpos = drawNote(p, *note, highlight, xpos, ypos);
             } else {
                 xpos = drawNone(p, 3, xpos, ypos);
             }
@@ -220,9 +243,7 @@ int PatternPainter::drawPattern(
             xpos += PatternLayout::SPACING;
             auto instrument = trackdata.queryInstrument();
             if (instrument) {
-                p.setPen(mPen.get(mColorInstrument));
-                xpos = drawHex(p, *instrument, xpos, ypos);
-                p.setPen(mPen.get(fgcolor));
+                xpos = mAtlas.addHex(*instrument, TU::ATLAS_INSTRUMENT, xpos, ypos);
             } else {
                 xpos = drawNone(p, 2, xpos, ypos);
             }
@@ -233,12 +254,8 @@ int PatternPainter::drawPattern(
             for (int effect = 0; effect < effectsVisible; ++effect) {
                 auto effectdata = trackdata.effects[effect];
                 if (effectdata.type != trackerboy::EffectType::noEffect) {
-                    p.setPen(mPen.get(mColorEffect));
-
-                    xpos = drawCell(p, TU::effectTypeToChar(effectdata.type), xpos, ypos);
-
-                    p.setPen(mPen.get(fgcolor));
-                    xpos = drawHex(p, effectdata.param, xpos, ypos);
+                    xpos = mAtlas.add(TU::effectTypeToChar(effectdata.type), TU::ATLAS_EFFECT, xpos, ypos);
+                    xpos = mAtlas.addHex(effectdata.param, highlight, xpos, ypos);
                 } else {
                     xpos = drawNone(p, 3, xpos, ypos);
                 }
@@ -253,6 +270,9 @@ int PatternPainter::drawPattern(
         ypos += _cellHeight;
     }
 
+    // draw all the text for these rows in one go
+    mAtlas.flush(p);
+
     return ypos - 1;
 }
 
@@ -260,7 +280,7 @@ void PatternPainter::drawSelection(QPainter &painter, QRect const& rect) const {
     painter.fillRect(rect, mColorSelection);
 }
 
-int PatternPainter::drawNote(QPainter &painter, uint8_t note, int xpos, int ypos) const {
+int PatternPainter::drawNote(QPainter &painter, uint8_t note, int highlight, int xpos, int ypos) const {
     auto const _cellWidth = cellWidth();
 
     if (note == trackerboy::NOTE_CUT) {
@@ -273,9 +293,9 @@ int PatternPainter::drawNote(QPainter &painter, uint8_t note, int xpos, int ypos
         octave += 2;
 
         auto notestr = (*mNoteTable)[key];
-        xpos = drawCell(painter, *notestr++, xpos, ypos);
-        xpos = drawCell(painter, *notestr, xpos, ypos);
-        return drawCell(painter, octave + '0', xpos, ypos);
+        xpos = mAtlas.add(*notestr++, highlight, xpos, ypos);
+        xpos = mAtlas.add(*notestr, highlight, xpos, ypos);
+        return mAtlas.add(octave + '0', highlight, xpos, ypos);
     }
 }
 
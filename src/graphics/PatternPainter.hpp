@@ -7,6 +7,7 @@
 #include "core/NoteStrings.hpp"
 #include "graphics/CachedPen.hpp"
 #include "graphics/CellPainter.hpp"
+#include "graphics/GlyphAtlas.hpp"
 #include "graphics/PatternLayout.hpp"
 
 #include "trackerboy/data/Pattern.hpp"
@@ -33,6 +34,12 @@ public:
     //
     bool flats() const;
 
+    //
+    // Sets the font, hides CellPainter::setFont so that the glyph atlas is
+    // updated as well.
+    //
+    void setFont(QFont const& font);
+
     void setColors(Palette const& colors);
 
     void setFirstHighlight(int interval);
@@ -83,9 +90,10 @@ public:
 
     //
     // Paints a note at the given x and y position. The x position of the next
-    // cell is returned.
+    // cell is returned. Text is queued in the glyph atlas using the given
+    // highlight index for its color, and is drawn on the next flush.
     //
-    int drawNote(QPainter &painter, uint8_t note, int xpos, int ypos) const;
+    int drawNote(QPainter &painter, uint8_t note, int highlight, int xpos, int ypos) const;
 
 private:
 
@@ -110,5 +118,8 @@ private:
 
     CachedPen mutable mPen;
 
+    // all pattern text is drawn from here
+    GlyphAtlas mutable mAtlas;
+
 
 };
@@ -0,0 +1,72 @@
+
+#include "graphics/RowCache.hpp"
+
+#include <QtMath>
+
+#include <utility>
+
+#define TU RowCacheTU
+namespace TU {
+
+// rows per pattern never exceed 256
+static constexpr int ROW_BITS = 8;
+
+}
+
+RowCache::RowCache() :
+    mEntries(),
+    mRatio(1.0),
+    mStamp(0)
+{
+}
+
+void RowCache::setRatio(qreal ratio) {
+    if (!qFuzzyCompare(ratio, mRatio)) {
+        mRatio = ratio;
+        clear();
+    }
+}
+
+QPixmap const* RowCache::find(int pattern, int row) {
+    auto iter = mEntries.find(key(pattern, row));
+    if (iter == mEntries.end()) {
+        return nullptr;
+    }
+    iter->stamp = mStamp;
+    return &iter->pixmap;
+}
+
+QPixmap& RowCache::insert(int pattern, int row, QSize size) {
+    QPixmap pixmap(qCeil(size.width() * mRatio), qCeil(size.height() * mRatio));
+    pixmap.setDevicePixelRatio(mRatio);
+    pixmap.fill(Qt::transparent);
+
+    auto iter = mEntries.insert(key(pattern, row), { std::move(pixmap), mStamp });
+    return iter->pixmap;
+}
+
+void RowCache::clear() {
+    mEntries.clear();
+}
+
+void RowCache::trim(int capacity) {
+    if (mEntries.size() > capacity) {
+        auto iter = mEntries.begin();
+        while (iter != mEntries.end()) {
+            if (iter->stamp != mStamp) {
+                iter = mEntries.erase(iter);
+            } else {
+                ++iter;
+            }
+        }
+    }
+    ++mStamp;
+}
+
+unsigned RowCache::key(int pattern, int row) {
+    // pattern is -1 when the previous pattern is previewed above the first
+    // one, left shifting a negative value is undefined
+    return ((unsigned)pattern << TU::ROW_BITS) | (unsigned)row;
+}
+
+#undef TU
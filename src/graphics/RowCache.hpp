@@ -0,0 +1,63 @@
+#pragma once
+
+#include <QHash>
+#include <QPixmap>
+#include <QSize>
+
+//
+// Cache of rendered pattern rows. Each entry is a transparent pixmap of a
+// single row, keyed by the pattern (order index) and row number. Views draw a
+// row once and then just blit it on subsequent paints until the row is
+// invalidated, so scrolling by one row only needs to render the newly exposed
+// row.
+//
+// The cache does not know what affects the look of a row (font, colors,
+// highlights, layout), it is up to the owner to clear it when any of these
+// change.
+//
+class RowCache {
+
+public:
+    RowCache();
+
+    //
+    // Sets the device pixel ratio of the pixmaps. The cache is cleared if the
+    // ratio differs from the current one.
+    //
+    void setRatio(qreal ratio);
+
+    //
+    // Gets the cached pixmap for the given row, nullptr is returned if the row
+    // is not in the cache.
+    //
+    QPixmap const* find(int pattern, int row);
+
+    //
+    // Adds a new transparent pixmap with the given size to the cache, the
+    // caller is to paint the row in the returned pixmap.
+    //
+    QPixmap& insert(int pattern, int row, QSize size);
+
+    void clear();
+
+    //
+    // Call after painting. If more than the given number of rows are cached,
+    // all rows that were not used since the last call are evicted.
+    //
+    void trim(int capacity);
+
+private:
+    Q_DISABLE_COPY(RowCache)
+
+    static unsigned key(int pattern, int row);
+
+    struct Entry {
+        QPixmap pixmap;
+        unsigned stamp;
+    };
+
+    QHash<unsigned, Entry> mEntries;
+    qreal mRatio;
+    unsigned mStamp;
+
+};
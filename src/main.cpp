@@ -1,4 +1,5 @@
 
+#include "export/RenderCommand.hpp"
 #include "forms/MainWindow.hpp"
 
 #include <QApplication>
@@ -19,6 +20,7 @@
 #include <memory>
 #include <new>
 #include <cstdio>
+#include <cstring>
 
 #include "version.hpp"
 
@@ -127,21 +129,46 @@ public:
 
 
 
+static void setApplicationInfo() {
+    QCoreApplication::setOrganizationName("Trackerboy");
+    QCoreApplication::setApplicationName("Trackerboy");
+    QCoreApplication::setApplicationVersion(VERSION_STR);
+    // use INI on all systems, much easier to edit by hand
+    QSettings::setDefaultFormat(QSettings::IniFormat);
+}
+
+//
+// Returns true if the --render option was given, in which case the GUI is
+// not started. This must be checked before any QApplication is created.
+//
+static bool isRenderCommand(int argc, char *argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--render") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
 int main(int argc, char *argv[]) {
 
     int code;
 
+    if (isRenderCommand(argc, argv)) {
+        // headless, no widgets are needed
+        QCoreApplication app(argc, argv);
+        setApplicationInfo();
+        return runRenderCommand(app);
+    }
+
     #ifndef QT_NO_INFO_OUTPUT
     QElapsedTimer timer;
     timer.start();
     #endif
 
     Application app(argc, argv);
-    QCoreApplication::setOrganizationName("Trackerboy");
-    QCoreApplication::setApplicationName("Trackerboy");
-    QCoreApplication::setApplicationVersion(VERSION_STR);
-    // use INI on all systems, much easier to edit by hand
-    QSettings::setDefaultFormat(QSettings::IniFormat);
+    setApplicationInfo();
 
 #define main_tr(str) QCoreApplication::translate("main", str)
 
@@ -149,6 +176,11 @@ int main(int argc, char *argv[]) {
     parser.setApplicationDescription(main_tr("Game Boy music tracker"));
     parser.addHelpOption();
     parser.addVersionOption();
+    // handled before the application is created, listed here for --help
+    parser.addOption(QCommandLineOption(
+        "render",
+        main_tr("Render modules to WAV files without starting the GUI. See --render --help for options")
+    ));
     parser.addPositionalArgument("[module_file]", main_tr("(Optional) the module file to open"));
 
     parser.process(app);
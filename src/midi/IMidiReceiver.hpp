@@ -2,7 +2,9 @@
 #pragma once
 
 //
-// Interface for receiving MIDI input messages
+// Interface for receiving MIDI input messages. Receivers set with
+// Midi::setReceiver are called from the GUI thread, a receiver set with
+// Midi::setDirectReceiver is called from the MIDI input thread.
 //
 class IMidiReceiver {
 
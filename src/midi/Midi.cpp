@@ -78,6 +78,7 @@ Midi::Midi(QObject *parent) :
     QObject(parent),
     mReceiver(nullptr),
     mNoteDown(false),
+    mDirectReceiver(nullptr),
     mMidiIn(),
     mMutex(),
     mLastNotePitch(-1)
@@ -175,6 +176,10 @@ void Midi::setReceiver(IMidiReceiver *receiver) {
     }
 }
 
+void Midi::setDirectReceiver(IMidiReceiver *receiver) {
+    mDirectReceiver = receiver;
+}
+
 void Midi::customEvent(QEvent *evt) {
     if (evt->type() == TU::MidiEvent::getType()) {
         auto midiEvt = static_cast<TU::MidiEvent*>(evt);
@@ -248,6 +253,9 @@ void Midi::handleMidiIn(double deltatime, std::vector<unsigned char> &message) {
             if (msgSize == 3) {
                 if (mLastNotePitch == (int)message[1]) {
                     mLastNotePitch = -1;
+                    if (auto direct = mDirectReceiver.load(); direct) {
+                        direct->midiNoteOff();
+                    }
                     QCoreApplication::postEvent(this, new TU::MidiEvent(TU::MidiEvent::NoteOff), Qt::HighEventPriority);
                 }
             }
@@ -259,6 +267,10 @@ void Midi::handleMidiIn(double deltatime, std::vector<unsigned char> &message) {
                 // 69 is A-4
                 // 36 is C-2
                 int trackerboyNote = std::clamp((int)message[1] - 36, 0, (int)trackerboy::NOTE_LAST);
+                // the direct receiver gets the note without waiting on the GUI
+                if (auto direct = mDirectReceiver.load(); direct) {
+                    direct->midiNoteOn(trackerboyNote);
+                }
                 QCoreApplication::postEvent(this, new TU::MidiEvent(TU::MidiEvent::NoteOn, trackerboyNote), Qt::HighEventPriority);
             }
             break;
@@ -9,6 +9,8 @@
 #include <QMutex>
 #include <QObject>
 
+#include <atomic>
+
 #ifdef __clang__
 // std::optional<RtMidiIn> does not compile on Clang
 // use this nonstd implementation instead
@@ -61,6 +63,15 @@ public:
     //
     void setReceiver(IMidiReceiver *receiver);
 
+    //
+    // Sets a receiver that is called directly from the MIDI input thread, in
+    // addition to the receiver. Its functions must be thread-safe and should
+    // not block, ie the Renderer. Receivers set by setReceiver are then only
+    // notified of notes, the direct receiver is responsible for previewing
+    // them.
+    //
+    void setDirectReceiver(IMidiReceiver *receiver);
+
     
 signals:
     //
@@ -78,6 +89,8 @@ private:
     IMidiReceiver *mReceiver;
     bool mNoteDown;
 
+    std::atomic<IMidiReceiver*> mDirectReceiver;
+
     // callback functions
     // note that these functions are called from a separate thread
 
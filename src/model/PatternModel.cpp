@@ -35,7 +35,8 @@ PatternModel::PatternModel(Module &mod, SongModel &songModel, QObject *parent) :
     mPatternCurr(mod.song()->getPattern(0)),
     mPatternNext(),
     mHasSelection(false),
-    mSelection()
+    mSelection(),
+    mIndex()
 {
     setMaxColumns();
     connect(&songModel, &SongModel::patternSizeChanged, this,
@@ -45,12 +46,16 @@ PatternModel::PatternModel(Module &mod, SongModel &songModel, QObject *parent) :
                 mCursor.row = rows - 1;
                 flags |= CursorRowChanged;
             }
+            mIndex.invalidate();
+            emit patternDataChanged();
             setPatterns(mCursorPattern, flags);
             emitIfChanged(flags);
         });
 
     connect(&mModule, &Module::songChanged, this,
         [this]() {
+            mIndex.invalidate();
+            emit patternDataChanged();
             mCursorPattern = -1;
             setCursorPattern(0);
             setCursor(PatternCursor(0, 0, 0));
@@ -490,6 +495,40 @@ void PatternModel::setCursorWrapPattern(bool wrap) {
     mWrapPattern = wrap;
 }
 
+// find and replace ==========================================================
+
+std::vector<PatternIndex::Match> PatternModel::find(PatternQuery const& query) {
+    return mIndex.find(*source(), query);
+}
+
+std::vector<std::vector<PatternIndex::Match>> PatternModel::findInModule(PatternQuery const& query) {
+    auto &songs = mModule.data().songs();
+    auto const count = (int)songs.size();
+
+    std::vector<std::vector<PatternIndex::Match>> matches;
+    matches.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        auto song = songs.get(i);
+        if (song == source()) {
+            matches.push_back(find(query));
+        } else {
+            PatternIndex index;
+            matches.push_back(index.find(*song, query));
+        }
+    }
+    return matches;
+}
+
+int PatternModel::replace(PatternQuery const& query, PatternReplacement const& replacement) {
+    auto cmd = std::make_unique<ReplaceCmd>(*this, query, replacement);
+    auto const rows = cmd->rowsChanged();
+    if (rows) {
+        cmd->setText(tr("replace %n row(s)", "", rows));
+        mModule.undoStack()->push(cmd.release());
+    }
+    return rows;
+}
+
 trackerboy::Song* PatternModel::source() const {
     return mModule.song();
 }
@@ -548,6 +587,14 @@ int PatternModel::cursorEffectNo() {
 
 void PatternModel::invalidate(int pattern, bool updatePatterns) {
 
+    if (pattern >= 0 && pattern < patterns()) {
+        mIndex.invalidate(order()[pattern]);
+    }
+    journal(pattern);
+
+    // the data has changed regardless of the pattern being visible
+    emit patternDataChanged();
+
     // check if the pattern being invalidated is accessible
     bool isInvalid = (mCursorPattern == pattern) ||
                      (mPatternPrev && pattern == mCursorPattern - 1) ||
@@ -569,6 +616,34 @@ void PatternModel::invalidate(int pattern, bool updatePatterns) {
 
 }
 
+void PatternModel::invalidateTracks(std::vector<PatternIndex::TrackRef> const& tracks) {
+    for (auto ref : tracks) {
+        mIndex.invalidate(ref);
+    }
+
+    auto const& ord = order();
+    auto const count = patterns();
+    for (int pattern = 0; pattern < count; ++pattern) {
+        auto const row = ord[pattern];
+        auto const uses = std::any_of(tracks.begin(), tracks.end(),
+            [&row](PatternIndex::TrackRef ref) {
+                return row[ref.track] == ref.id;
+            });
+        if (uses) {
+            journal(pattern);
+        }
+    }
+
+    emit patternDataChanged();
+    CursorChangeFlags flags = CursorUnchanged;
+    setPatterns(mCursorPattern, flags);
+    emitIfChanged(flags);
+}
+
+void PatternModel::journal(int pattern) {
+    mModule.journal().record(*source(), mModule.songIndex(), pattern);
+}
+
 bool PatternModel::selectionDataIsEmpty() {
     if (mHasSelection) {
         auto iter = mSelection.iterator();
@@ -1023,7 +1098,9 @@ void PatternModel::insertOrderImpl(const trackerboy::OrderRow &row, int before)
         auto editor = mModule.edit();
         _order.insert(before, row);
     }
+    journal(-1);
 
+    emit patternDataChanged();
     emit patternCountChanged(_order.size());
     if (mCursorPattern == before) {
         invalidate(before, true);
@@ -1042,7 +1119,9 @@ void PatternModel::removeOrderImpl(int at) {
         }
         _order.remove(at);
     }
+    journal(-1);
 
+    emit patternDataChanged();
     auto count = _order.size();
     if (mCursorPattern >= count) {
         setCursorPattern(count - 1);
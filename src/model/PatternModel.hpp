@@ -5,6 +5,7 @@
 #include "model/SongModel.hpp"
 #include "core/Module.hpp"
 #include "core/PatternCursor.hpp"
+#include "core/PatternIndex.hpp"
 #include "core/PatternSelection.hpp"
 
 #include "trackerboy/data/Pattern.hpp"
@@ -15,6 +16,7 @@
 
 #include <array>
 #include <optional>
+#include <vector>
 
 
 //
@@ -240,6 +242,27 @@ public:
 
     void setPreviewEnable(bool previews);
 
+    // Find and replace =======================================================
+
+    //
+    // Finds every row in the current song matching the query. The song's
+    // pattern data is indexed, so only the tracks using the query are
+    // scanned.
+    //
+    std::vector<PatternIndex::Match> find(PatternQuery const& query);
+
+    //
+    // Same as find, but for every song in the module. The result is indexed
+    // by song. Only the current song is indexed, other songs are scanned.
+    //
+    std::vector<std::vector<PatternIndex::Match>> findInModule(PatternQuery const& query);
+
+    //
+    // Replaces every occurrence of the query in the current song, as a
+    // single undoable command. Returns the number of rows changed.
+    //
+    int replace(PatternQuery const& query, PatternReplacement const& replacement);
+
 signals:
     void cursorChanged(PatternModel::CursorChangeFlags flags);
     void cursorPatternChanged(int pattern);
@@ -260,6 +283,15 @@ signals:
     //
     void invalidated();
 
+    //
+    // emitted when pattern data or the order has been modified. Unlike
+    // invalidated, this signal is not emitted when the cursor moves to
+    // another pattern. Views that cache rendered pattern data should discard
+    // it. Since track data can be shared by multiple patterns in the order,
+    // any modification may affect every pattern.
+    //
+    void patternDataChanged();
+
     void effectsVisibleChanged();
 
     void totalColumnsChanged(int columns);
@@ -281,6 +313,7 @@ private:
     friend class OrderRemoveCmd;
     friend class OrderDuplicateCmd;
     friend class OrderSwapCmd;
+    friend class ReplaceCmd;
 
     Q_DISABLE_COPY(PatternModel)
 
@@ -311,6 +344,19 @@ private:
 
     void invalidate(int pattern, bool updatePatterns);
 
+    //
+    // Invalidates the given tracks, for edits made to tracks instead of
+    // patterns. Every pattern using the tracks is journaled.
+    //
+    void invalidateTracks(std::vector<PatternIndex::TrackRef> const& tracks);
+
+    //
+    // Records the modified pattern (or -1 for just the order) in the
+    // module's edit journal. Commands modifying data must call this, invalidate
+    // does so already.
+    //
+    void journal(int pattern);
+
     bool selectionDataIsEmpty();
 
     // called by insert, remove and duplicate commands
@@ -341,6 +387,9 @@ private:
 
     std::array<int, 4> mMaxColumns;
 
+    // usage index of the current song
+    PatternIndex mIndex;
+
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(PatternModel::CursorChangeFlags)
@@ -8,20 +8,22 @@
 
 
 OrderDuplicateCmd::OrderDuplicateCmd(PatternModel &model, int row) :
+    UndoCmd(model.mModule),
     mModel(model),
     mRow(row)
 {
 }
 
-void OrderDuplicateCmd::redo() {
+void OrderDuplicateCmd::redoImpl() {
     mModel.insertOrderImpl(mModel.order()[mRow], mRow + 1);
 }
 
-void OrderDuplicateCmd::undo() {
+void OrderDuplicateCmd::undoImpl() {
     mModel.removeOrderImpl(mRow + 1);
 }
 
 OrderEditCmd::OrderEditCmd(PatternModel &model, trackerboy::OrderRow newRow, int pattern) :
+    UndoCmd(model.mModule),
     mModel(model),
     mOldRow(model.order()[pattern]),
     mNewRow(newRow),
@@ -29,11 +31,11 @@ OrderEditCmd::OrderEditCmd(PatternModel &model, trackerboy::OrderRow newRow, int
 {
 }
 
-void OrderEditCmd::redo() {
+void OrderEditCmd::redoImpl() {
     setData(mNewRow);
 }
 
-void OrderEditCmd::undo() {
+void OrderEditCmd::undoImpl() {
     setData(mOldRow);
 }
 
@@ -46,49 +48,52 @@ void OrderEditCmd::setData(trackerboy::OrderRow row) {
 }
 
 OrderInsertCmd::OrderInsertCmd(PatternModel &model, int row) :
+    UndoCmd(model.mModule),
     mModel(model),
     mRow(row)
 {
 }
 
-void OrderInsertCmd::redo() {
+void OrderInsertCmd::redoImpl() {
     mModel.insertOrderImpl(mModel.order().nextUnused(), mRow + 1);
 }
 
-void OrderInsertCmd::undo() {
+void OrderInsertCmd::undoImpl() {
     // to undo an insert, we remove the inserted row
     mModel.removeOrderImpl(mRow + 1);
 }
 
 OrderRemoveCmd::OrderRemoveCmd(PatternModel &model, int row) :
+    UndoCmd(model.mModule),
     mModel(model),
     mRemovedRow(model.order()[row]),
     mRow(row)
 {
 }
 
-void OrderRemoveCmd::redo() {
+void OrderRemoveCmd::redoImpl() {
     mModel.removeOrderImpl(mRow);
 }
 
-void OrderRemoveCmd::undo() {
+void OrderRemoveCmd::undoImpl() {
     // to undo, re-insert the previously removed row
     mModel.insertOrderImpl(mRemovedRow, mRow);
 }
 
 OrderSwapCmd::OrderSwapCmd(PatternModel &model, int from, int to) :
+    UndoCmd(model.mModule),
     mModel(model),
     mFrom(from),
     mTo(to)
 {
 }
 
-void OrderSwapCmd::redo() {
+void OrderSwapCmd::redoImpl() {
     swap();
     mModel.setCursorPattern(mTo);
 }
 
-void OrderSwapCmd::undo() {
+void OrderSwapCmd::undoImpl() {
     swap();
     mModel.setCursorPattern(mFrom);
 }
@@ -99,5 +104,7 @@ void OrderSwapCmd::swap() {
         auto editor = mModel.mModule.edit();
         order.swapPatterns(mFrom, mTo);
     }
+    mModel.journal(-1);
+    emit mModel.patternDataChanged();
 }
 
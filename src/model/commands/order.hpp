@@ -2,22 +2,25 @@
 
 class PatternModel;
 
+#include "model/commands/undo.hpp"
+
 #include "trackerboy/data/OrderRow.hpp"
 
-#include <QUndoCommand>
 
 //
 // Command for duplicating a row in the order
 //
-class OrderDuplicateCmd : public QUndoCommand {
+class OrderDuplicateCmd : public UndoCmd {
 
 public:
 
     explicit OrderDuplicateCmd(PatternModel &model, int row);
 
-    virtual void redo() override;
+protected:
+
+    virtual void redoImpl() override;
 
-    virtual void undo() override;
+    virtual void undoImpl() override;
 
 private:
     PatternModel &mModel;
@@ -28,7 +31,7 @@ private:
 //
 // Command for editing a row in the order
 //
-class OrderEditCmd : public QUndoCommand {
+class OrderEditCmd : public UndoCmd {
 
 public:
 
@@ -38,9 +41,11 @@ public:
         int pattern
     );
 
-    virtual void redo() override;
+protected:
+
+    virtual void redoImpl() override;
 
-    virtual void undo() override;
+    virtual void undoImpl() override;
 
 private:
 
@@ -56,15 +61,17 @@ private:
 //
 // Command for inserting an order after a given row.
 //
-class OrderInsertCmd : public QUndoCommand {
+class OrderInsertCmd : public UndoCmd {
 
 public:
 
     explicit OrderInsertCmd(PatternModel &model, int row);
 
-    virtual void redo() override;
+protected:
 
-    virtual void undo() override;
+    virtual void redoImpl() override;
+
+    virtual void undoImpl() override;
 
 private:
 
@@ -77,15 +84,17 @@ private:
 //
 // Command for removing a row in the order
 //
-class OrderRemoveCmd : public QUndoCommand {
+class OrderRemoveCmd : public UndoCmd {
 
 public:
 
     explicit OrderRemoveCmd(PatternModel &model, int row);
 
-    virtual void redo() override;
+protected:
+
+    virtual void redoImpl() override;
 
-    virtual void undo() override;
+    virtual void undoImpl() override;
 
 private:
 
@@ -98,15 +107,17 @@ private:
 //
 // Command for swapping two row indices (for moving up or moving down)
 //
-class OrderSwapCmd : public QUndoCommand {
+class OrderSwapCmd : public UndoCmd {
 
 public:
 
     explicit OrderSwapCmd(PatternModel &model, int from, int to);
 
-    virtual void redo() override;
+protected:
+
+    virtual void redoImpl() override;
 
-    virtual void undo() override;
+    virtual void undoImpl() override;
 
 private:
 
@@ -2,69 +2,97 @@
 #include "model/commands/pattern.hpp"
 #include "model/PatternModel.hpp"
 
-SelectionCmd::SelectionCmd(PatternModel &model) :
+#include <QThreadPool>
+
+#include <algorithm>
+
+SelectionCmd::SelectionCmd(PatternModel &model, bool updatePatterns) :
+    SelectionCmd(model, model.mSelection, updatePatterns)
+{
+}
+
+SelectionCmd::SelectionCmd(PatternModel &model, PatternSelection const& region, bool updatePatterns) :
+    UndoCmd(model.mModule),
     mModel(model),
     mPattern((uint8_t)model.mCursorPattern),
-    mClip()
+    mSelection(region),
+    mDelta(),
+    mUpdatePatterns(updatePatterns)
 {
-    mClip.save(model.mPatternCurr, model.mSelection);
 }
 
-void SelectionCmd::restore(bool update) {
-    auto pattern = mModel.source()->getPattern(mPattern);
+void SelectionCmd::redoImpl() {
+    bool const recorded = mDelta.isRecorded();
     {
         auto ctx = mModel.mModule.edit();
-        mClip.restore(pattern);
+        auto pattern = mModel.source()->getPattern(mPattern);
+        if (recorded) {
+            mDelta.apply(pattern);
+        } else {
+            mDelta.begin(pattern, mSelection);
+            edit(pattern);
+            mDelta.end(pattern);
+        }
     }
 
-    mModel.invalidate(mPattern, update);
-}
-
-EraseCmd::EraseCmd(PatternModel &model) :
-    SelectionCmd(model)
-{
+    if (!recorded) {
+        updateSize();
+    }
+    mModel.invalidate(mPattern, mUpdatePatterns);
 }
 
-void EraseCmd::redo() {
+void SelectionCmd::undoImpl() {
     {
         auto ctx = mModel.mModule.edit();
-        // clear all set data in the selection
-        auto iter = mClip.selection().iterator();
         auto pattern = mModel.source()->getPattern(mPattern);
+        mDelta.apply(pattern);
+    }
 
-        for (auto track = iter.trackStart(); track <= iter.trackEnd(); ++track) {
-            auto tmeta = iter.getTrackMeta(track);
-            for (auto row = iter.rowStart(); row <= iter.rowEnd(); ++row) {
-                auto &rowdata = pattern.getTrackRow(static_cast<trackerboy::ChType>(track), (uint16_t)row);
-                if (tmeta.hasColumn<PatternAnchor::SelectNote>()) {
-                    rowdata.note = 0;
-                }
+    mModel.invalidate(mPattern, mUpdatePatterns);
+}
 
-                if (tmeta.hasColumn<PatternAnchor::SelectInstrument>()) {
-                    rowdata.instrumentId = 0;
-                }
+size_t SelectionCmd::dataSize() const {
+    return mDelta.size();
+}
 
-                if (tmeta.hasColumn<PatternAnchor::SelectEffect1>()) {
-                    rowdata.effects[0] = trackerboy::NO_EFFECT;
-                }
+void SelectionCmd::release() {
+    mDelta.clear();
+}
 
-                if (tmeta.hasColumn<PatternAnchor::SelectEffect2>()) {
-                    rowdata.effects[1] = trackerboy::NO_EFFECT;
-                }
+EraseCmd::EraseCmd(PatternModel &model) :
+    SelectionCmd(model, true)
+{
+}
 
-                if (tmeta.hasColumn<PatternAnchor::SelectEffect3>()) {
-                    rowdata.effects[2] = trackerboy::NO_EFFECT;
-                }
+void EraseCmd::edit(trackerboy::Pattern &pattern) {
+    // clear all set data in the selection
+    auto iter = mSelection.iterator();
+
+    for (auto track = iter.trackStart(); track <= iter.trackEnd(); ++track) {
+        auto tmeta = iter.getTrackMeta(track);
+        for (auto row = iter.rowStart(); row <= iter.rowEnd(); ++row) {
+            auto &rowdata = pattern.getTrackRow(static_cast<trackerboy::ChType>(track), (uint16_t)row);
+            if (tmeta.hasColumn<PatternAnchor::SelectNote>()) {
+                rowdata.note = 0;
             }
-        }
 
-    }
+            if (tmeta.hasColumn<PatternAnchor::SelectInstrument>()) {
+                rowdata.instrumentId = 0;
+            }
 
-    mModel.invalidate(mPattern, true);
-}
+            if (tmeta.hasColumn<PatternAnchor::SelectEffect1>()) {
+                rowdata.effects[0] = trackerboy::NO_EFFECT;
+            }
 
-void EraseCmd::undo() {
-    restore(true);
+            if (tmeta.hasColumn<PatternAnchor::SelectEffect2>()) {
+                rowdata.effects[1] = trackerboy::NO_EFFECT;
+            }
+
+            if (tmeta.hasColumn<PatternAnchor::SelectEffect3>()) {
+                rowdata.effects[2] = trackerboy::NO_EFFECT;
+            }
+        }
+    }
 }
 
 PasteCmd::PasteCmd(
@@ -73,52 +101,44 @@ PasteCmd::PasteCmd(
     PatternCursor pos,
     bool mix
 ) :
-    QUndoCommand(),
-    mModel(model),
+    SelectionCmd(model, pasteRegion(model, clip, pos), true),
     mSrc(clip),
-    mPast(),
     mPos(pos),
-    mPattern((uint8_t)model.mCursorPattern),
     mMix(mix)
 {
-    auto region = mSrc.selection();
-    region.moveTo(pos);
-    region.clamp(model.mPatternCurr.size() - 1);
-    mPast.save(model.mPatternCurr, region);
+    updateSize();
 }
 
-void PasteCmd::redo() {
-    {
-        auto ctx = mModel.mModule.edit();
-        auto pattern = mModel.source()->getPattern(mPattern);
-        mSrc.paste(pattern, mPos, mMix);
-    }
-
-    mModel.invalidate(mPattern, true);
+size_t PasteCmd::dataSize() const {
+    // the clip is only held until pasted
+    return SelectionCmd::dataSize() + mSrc.byteSize();
 }
 
-void PasteCmd::undo() {
-    {
-        auto ctx = mModel.mModule.edit();
-        auto pattern = mModel.source()->getPattern(mPattern);
-        mPast.restore(pattern);
-    }
+void PasteCmd::edit(trackerboy::Pattern &pattern) {
+    mSrc.paste(pattern, mPos, mMix);
+    mSrc = PatternClip();
+}
 
-    mModel.invalidate(mPattern, true);
+PatternSelection PasteCmd::pasteRegion(PatternModel &model, PatternClip const& clip, PatternCursor pos) {
+    auto region = clip.selection();
+    region.moveTo(pos);
+    region.clamp(model.mPatternCurr.size() - 1);
+    return region;
 }
 
 ReverseCmd::ReverseCmd(PatternModel &model) :
+    UndoCmd(model.mModule),
     mModel(model),
     mSelection(model.mSelection),
     mPattern((uint8_t)model.mCursorPattern)
 {
 }
 
-void ReverseCmd::redo() {
+void ReverseCmd::redoImpl() {
     reverse();
 }
 
-void ReverseCmd::undo() {
+void ReverseCmd::undoImpl() {
     // same as redo() since reversing is an involutory function
     reverse();
 }
@@ -168,36 +188,26 @@ void ReverseCmd::reverse() {
 }
 
 ReplaceInstrumentCmd::ReplaceInstrumentCmd(PatternModel &model, int instrument) :
-    SelectionCmd(model),
+    SelectionCmd(model, false),
     mInstrument(instrument)
 {
 
 }
 
-void ReplaceInstrumentCmd::redo() {
-    {
-        auto ctx = mModel.mModule.edit();
-        auto iter = mClip.selection().iterator();
-        auto pattern = mModel.source()->getPattern(mPattern);
+void ReplaceInstrumentCmd::edit(trackerboy::Pattern &pattern) {
+    auto iter = mSelection.iterator();
 
-        for (auto track = iter.trackStart(); track <= iter.trackEnd(); ++track) {
-            auto tmeta = iter.getTrackMeta(track);
-            if (tmeta.hasColumn<PatternAnchor::SelectInstrument>()) {
-                for (auto row = iter.rowStart(); row <= iter.rowEnd(); ++row) {
-                    auto &rowdata = pattern.getTrackRow(static_cast<trackerboy::ChType>(track), row);
-                    if (rowdata.queryInstrument().has_value()) {
-                        rowdata.setInstrument((uint8_t)mInstrument);
-                    }
+    for (auto track = iter.trackStart(); track <= iter.trackEnd(); ++track) {
+        auto tmeta = iter.getTrackMeta(track);
+        if (tmeta.hasColumn<PatternAnchor::SelectInstrument>()) {
+            for (auto row = iter.rowStart(); row <= iter.rowEnd(); ++row) {
+                auto &rowdata = pattern.getTrackRow(static_cast<trackerboy::ChType>(track), row);
+                if (rowdata.queryInstrument().has_value()) {
+                    rowdata.setInstrument((uint8_t)mInstrument);
                 }
             }
         }
     }
-
-    mModel.invalidate(mPattern, false);
-}
-
-void ReplaceInstrumentCmd::undo() {
-    restore(false);
 }
 
 
@@ -207,7 +217,7 @@ TrackEditCmd::TrackEditCmd(
     uint8_t dataOld,
     QUndoCommand *parent
 ) :
-    QUndoCommand(parent),
+    UndoCmd(model.mModule, parent),
     mModel(model),
     mTrack((uint8_t)(model.mCursor.track)),
     mPattern((uint8_t)model.mCursorPattern),
@@ -217,11 +227,11 @@ TrackEditCmd::TrackEditCmd(
 {
 }
 
-void TrackEditCmd::redo() {
+void TrackEditCmd::redoImpl() {
     setData(mNewData);
 }
 
-void TrackEditCmd::undo() {
+void TrackEditCmd::undoImpl() {
     setData(mOldData);
 }
 
@@ -294,39 +304,29 @@ bool EffectParamEditCmd::edit(trackerboy::TrackRow &rowdata, uint8_t data) {
 }
 
 TransposeCmd::TransposeCmd(PatternModel &model, int8_t transposeAmount) :
-    SelectionCmd(model),
+    SelectionCmd(model, false),
     mTransposeAmount(transposeAmount)
 {
 }
 
-void TransposeCmd::redo()  {
-    {
-        auto ctx = mModel.mModule.edit();
-        auto iter = mClip.selection().iterator();
-        auto pattern = mModel.source()->getPattern(mPattern);
+void TransposeCmd::edit(trackerboy::Pattern &pattern) {
+    auto iter = mSelection.iterator();
 
-        for (auto track = iter.trackStart(); track <= iter.trackEnd(); ++track) {
-            auto tmeta = iter.getTrackMeta(track);
-            if (!tmeta.hasColumn<PatternAnchor::SelectNote>()) {
-                continue;
-            }
+    for (auto track = iter.trackStart(); track <= iter.trackEnd(); ++track) {
+        auto tmeta = iter.getTrackMeta(track);
+        if (!tmeta.hasColumn<PatternAnchor::SelectNote>()) {
+            continue;
+        }
 
-            for (auto row = iter.rowStart(); row <= iter.rowEnd(); ++row) {
-                auto &rowdata = pattern.getTrackRow(static_cast<trackerboy::ChType>(track), (uint16_t)row);
-                rowdata.transpose(mTransposeAmount);
-            }
+        for (auto row = iter.rowStart(); row <= iter.rowEnd(); ++row) {
+            auto &rowdata = pattern.getTrackRow(static_cast<trackerboy::ChType>(track), (uint16_t)row);
+            rowdata.transpose(mTransposeAmount);
         }
     }
-
-    mModel.invalidate(mPattern, false);
-}
-
-void TransposeCmd::undo() {
-    restore(false);
 }
 
 BackspaceCmd::BackspaceCmd(PatternModel &model, QUndoCommand *parent) :
-    QUndoCommand(parent),
+    UndoCmd(model.mModule, parent),
     mModel(model),
     mPattern(model.mCursorPattern),
     mTrack(model.mCursor.track),
@@ -353,7 +353,7 @@ BackspaceCmd::BackspaceCmd(PatternModel &model, QUndoCommand *parent) :
 // 3 d
 
 
-void BackspaceCmd::redo() {
+void BackspaceCmd::redoImpl() {
     {
         auto editor = mModel.mModule.edit();
         auto &dest = mModel.source()->patterns().getTrack(static_cast<trackerboy::ChType>(mTrack), mPattern);
@@ -367,7 +367,7 @@ void BackspaceCmd::redo() {
     mModel.invalidate(mPattern, true);
 }
 
-void BackspaceCmd::undo() {
+void BackspaceCmd::undoImpl() {
 
     {
         auto editor = mModel.mModule.edit();
@@ -381,3 +381,106 @@ void BackspaceCmd::undo() {
     mModel.invalidate(mPattern, true);
 }
 
+ReplaceCmd::ReplaceCmd(PatternModel &model, PatternQuery const& query, PatternReplacement const& replacement) :
+    UndoCmd(model.mModule),
+    mModel(model),
+    mChanges()
+{
+    auto song = model.source();
+    auto const refs = model.mIndex.tracks(*song, query);
+    if (refs.empty()) {
+        return;
+    }
+
+    // getTrack may add to the pattern map, so get the tracks before scanning
+    std::vector<trackerboy::Track const*> tracks;
+    tracks.reserve(refs.size());
+    mChanges.resize(refs.size());
+    for (size_t i = 0; i < refs.size(); ++i) {
+        tracks.push_back(&song->patterns().getTrack(static_cast<trackerboy::ChType>(refs[i].track), refs[i].id));
+        mChanges[i].ref = refs[i];
+    }
+
+    // each job scans every nth track, the song is only read
+    auto scan = [&](size_t first, size_t step) {
+        for (size_t i = first; i < tracks.size(); i += step) {
+            auto const& track = *tracks[i];
+            auto &rows = mChanges[i].rows;
+            auto const size = (int)track.size();
+            for (int row = 0; row < size; ++row) {
+                auto rowdata = track[row];
+                if (replacement.apply(query, rowdata)) {
+                    rows.push_back({ (uint16_t)row, track[row], rowdata });
+                }
+            }
+        }
+    };
+
+    QThreadPool pool;
+    auto const jobs = (size_t)std::clamp(pool.maxThreadCount(), 1, (int)tracks.size());
+    if (jobs == 1) {
+        scan(0, 1);
+    } else {
+        for (size_t job = 0; job < jobs; ++job) {
+            pool.start([&scan, job, jobs]() {
+                scan(job, jobs);
+            });
+        }
+        pool.waitForDone();
+    }
+
+    mChanges.erase(
+        std::remove_if(mChanges.begin(), mChanges.end(),
+            [](TrackChange const& change) {
+                return change.rows.empty();
+            }),
+        mChanges.end()
+    );
+    updateSize();
+}
+
+int ReplaceCmd::rowsChanged() const {
+    int count = 0;
+    for (auto const& change : mChanges) {
+        count += (int)change.rows.size();
+    }
+    return count;
+}
+
+void ReplaceCmd::redoImpl() {
+    setRows(true);
+}
+
+void ReplaceCmd::undoImpl() {
+    setRows(false);
+}
+
+size_t ReplaceCmd::dataSize() const {
+    size_t size = mChanges.capacity() * sizeof(TrackChange);
+    for (auto const& change : mChanges) {
+        size += change.rows.capacity() * sizeof(RowChange);
+    }
+    return size;
+}
+
+void ReplaceCmd::release() {
+    mChanges.clear();
+    mChanges.shrink_to_fit();
+}
+
+void ReplaceCmd::setRows(bool replaced) {
+    std::vector<PatternIndex::TrackRef> refs;
+    refs.reserve(mChanges.size());
+    {
+        auto editor = mModel.mModule.edit();
+        auto song = mModel.source();
+        for (auto const& change : mChanges) {
+            auto &track = song->patterns().getTrack(static_cast<trackerboy::ChType>(change.ref.track), change.ref.id);
+            for (auto const& row : change.rows) {
+                track[row.row] = replaced ? row.after : row.before;
+            }
+            refs.push_back(change.ref);
+        }
+    }
+    mModel.invalidateTracks(refs);
+}
@@ -4,33 +4,51 @@
 class PatternModel;
 
 #include "clipboard/PatternClip.hpp"
+#include "core/PatternIndex.hpp"
+#include "model/commands/undo.hpp"
 
 #include "trackerboy/data/TrackRow.hpp"
 
-#include <QUndoCommand>
-
 #include <cstdint>
+#include <vector>
 
 
 //
-// Base class for commands that operate on a PatternSelection
+// Base class for commands that operate on a PatternSelection. The edit is
+// performed once, when the command is first redone, and recorded as a
+// PatternDelta. Undo and redo then apply the delta.
 //
-class SelectionCmd : public QUndoCommand {
+class SelectionCmd : public UndoCmd {
 
 protected:
     PatternModel &mModel;
     uint8_t mPattern;
-    PatternClip mClip;
+    PatternSelection mSelection;
+    PatternDelta mDelta;
+    bool const mUpdatePatterns;
 
     //
-    // initializes the command by saving a clip of the current selection
+    // initializes the command for the model's current selection
     //
-    explicit SelectionCmd(PatternModel &model);
+    explicit SelectionCmd(PatternModel &model, bool updatePatterns);
 
     //
-    // Restores the saved clip
+    // initializes the command for the given region of the current pattern
     //
-    void restore(bool update);
+    explicit SelectionCmd(PatternModel &model, PatternSelection const& region, bool updatePatterns);
+
+    virtual void redoImpl() override;
+
+    virtual void undoImpl() override;
+
+    virtual size_t dataSize() const override;
+
+    virtual void release() override;
+
+    //
+    // Performs the edit on the selection, called once.
+    //
+    virtual void edit(trackerboy::Pattern &pattern) = 0;
 
 };
 
@@ -43,22 +61,20 @@ public:
 
     EraseCmd(PatternModel &model);
 
-    virtual void redo() override;
+protected:
 
-    virtual void undo() override;
+    virtual void edit(trackerboy::Pattern &pattern) override;
 
 };
 
 //
 // Command for pasting pattern data
 //
-class PasteCmd : public QUndoCommand {
+class PasteCmd : public SelectionCmd {
 
-    PatternModel &mModel;
+    // released once pasted, the delta is used from then on
     PatternClip mSrc;
-    PatternClip mPast;
     PatternCursor mPos;
-    uint8_t mPattern;
     bool mMix;
 
 public:
@@ -69,9 +85,15 @@ public:
         bool mix
     );
 
-    virtual void redo() override;
+protected:
+
+    virtual size_t dataSize() const override;
+
+    virtual void edit(trackerboy::Pattern &pattern) override;
+
+private:
 
-    virtual void undo() override;
+    static PatternSelection pasteRegion(PatternModel &model, PatternClip const& clip, PatternCursor pos);
 
 };
 
@@ -81,7 +103,7 @@ public:
 // redo/undo actions are the same (reversing is an involutory function). So
 // there is no need to save a chunk of the selection for undo'ing
 //
-class ReverseCmd : public QUndoCommand {
+class ReverseCmd : public UndoCmd {
 
     PatternModel &mModel;
     PatternSelection mSelection;
@@ -91,9 +113,11 @@ public:
 
     explicit ReverseCmd(PatternModel &model);
 
-    virtual void redo() override;
+protected:
+
+    virtual void redoImpl() override;
 
-    virtual void undo() override;
+    virtual void undoImpl() override;
 
 private:
 
@@ -113,17 +137,16 @@ public:
 
     explicit ReplaceInstrumentCmd(PatternModel &model, int instrument);
 
-    virtual void redo() override;
-    
-    virtual void undo() override;
-    
+protected:
+
+    virtual void edit(trackerboy::Pattern &pattern) override;
 
 };
 
 //
 // Base command class for editing a column in a track row
 //
-class TrackEditCmd : public QUndoCommand {
+class TrackEditCmd : public UndoCmd {
 
 protected:
     PatternModel &mModel;
@@ -141,11 +164,11 @@ public:
         QUndoCommand *parent = nullptr
     );
 
-    virtual void redo() override;
+protected:
+    virtual void redoImpl() override;
 
-    virtual void undo() override;
+    virtual void undoImpl() override;
 
-protected:
     trackerboy::TrackRow& getRow();
 
     virtual bool edit(trackerboy::TrackRow &rowdata, uint8_t data) = 0;
@@ -231,9 +254,9 @@ public:
 
     explicit TransposeCmd(PatternModel &model, int8_t transposeAmount);
 
-    virtual void redo() override;
+protected:
 
-    virtual void undo() override;
+    virtual void edit(trackerboy::Pattern &pattern) override;
 
 };
 
@@ -241,7 +264,7 @@ public:
 // Backspace command. Deletes the previous row in the track and shifts all rows
 // below it up 1.
 //
-class BackspaceCmd : public QUndoCommand {
+class BackspaceCmd : public UndoCmd {
 
     PatternModel &mModel;
     int const mPattern;
@@ -253,8 +276,59 @@ public:
 
     explicit BackspaceCmd(PatternModel &model, QUndoCommand *parent = nullptr);
 
-    virtual void redo() override;
+protected:
+
+    virtual void redoImpl() override;
+
+    virtual void undoImpl() override;
+
+};
+
+//
+// Command for replacing every occurrence of a query in the song. Only the
+// tracks using the query (according to the model's index) are scanned, in
+// parallel. The changed rows are kept for undo/redo.
+//
+class ReplaceCmd : public UndoCmd {
+
+    struct RowChange {
+        uint16_t row;
+        trackerboy::TrackRow before;
+        trackerboy::TrackRow after;
+    };
+
+    struct TrackChange {
+        PatternIndex::TrackRef ref;
+        std::vector<RowChange> rows;
+    };
+
+    PatternModel &mModel;
+    std::vector<TrackChange> mChanges;
+
+public:
+
+    //
+    // Determines the rows to replace, the song is not modified until redo.
+    //
+    explicit ReplaceCmd(PatternModel &model, PatternQuery const& query, PatternReplacement const& replacement);
+
+    //
+    // Number of rows changed by this command
+    //
+    int rowsChanged() const;
+
+protected:
+
+    virtual void redoImpl() override;
+
+    virtual void undoImpl() override;
+
+    virtual size_t dataSize() const override;
+
+    virtual void release() override;
+
+private:
 
-    virtual void undo() override;
+    void setRows(bool replaced);
 
 };
@@ -0,0 +1,268 @@
+
+#include "model/commands/undo.hpp"
+
+#include "core/Module.hpp"
+
+#include <algorithm>
+
+#define TU UndoCmdTU
+namespace TU {
+
+// number of bytes for a packed TrackRow
+static constexpr size_t ROW_SIZE = 8;
+
+static void packRow(trackerboy::TrackRow const& row, uint8_t *dest) {
+    *dest++ = row.note;
+    *dest++ = row.instrumentId;
+    for (auto const& effect : row.effects) {
+        *dest++ = (uint8_t)effect.type;
+        *dest++ = effect.param;
+    }
+}
+
+static void unpackRow(uint8_t const *src, trackerboy::TrackRow &row) {
+    row.note = *src++;
+    row.instrumentId = *src++;
+    for (auto &effect : row.effects) {
+        effect.type = (trackerboy::EffectType)*src++;
+        effect.param = *src++;
+    }
+}
+
+static void appendVarint(std::vector<uint8_t> &dest, size_t value) {
+    while (value >= 0x80) {
+        dest.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    dest.push_back((uint8_t)value);
+}
+
+static size_t readVarint(uint8_t const *&src) {
+    size_t value = 0;
+    int shift = 0;
+    uint8_t byte;
+    do {
+        byte = *src++;
+        value |= (size_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return value;
+}
+
+//
+// Evicts the command and all of its children. Children of a macro may not be
+// UndoCmds, but macros created by QUndoStack::beginMacro never are.
+//
+static void evictAll(QUndoCommand *cmd) {
+    auto undoCmd = dynamic_cast<UndoCmd*>(cmd);
+    if (undoCmd) {
+        undoCmd->evict();
+    }
+    auto const count = cmd->childCount();
+    for (int i = 0; i < count; ++i) {
+        evictAll(const_cast<QUndoCommand*>(cmd->child(i)));
+    }
+}
+
+}
+
+
+UndoCmd::UndoCmd(Module &mod, QUndoCommand *parent) :
+    QUndoCommand(parent),
+    mBudget(mod.undoBudget()),
+    mSize(OVERHEAD),
+    mEvicted(false)
+{
+    mBudget->add(mSize);
+}
+
+UndoCmd::~UndoCmd() {
+    mBudget->remove(mSize);
+}
+
+size_t UndoCmd::size() const {
+    return mSize;
+}
+
+void UndoCmd::evict() {
+    if (!mEvicted) {
+        mEvicted = true;
+        release();
+        updateSize();
+    }
+}
+
+bool UndoCmd::isEvicted() const {
+    return mEvicted;
+}
+
+void UndoCmd::redo() {
+    // evicted commands are always done, so they are never redone
+    if (!mEvicted) {
+        redoImpl();
+    }
+}
+
+void UndoCmd::undo() {
+    if (mEvicted) {
+        // nothing to undo, have the stack remove this command
+        setObsolete(true);
+    } else {
+        undoImpl();
+    }
+}
+
+void UndoCmd::trim(QUndoStack &stack, UndoBudget &budget) {
+    if (!budget.isExceeded()) {
+        return;
+    }
+
+    // trim a quarter of the budget so that we aren't evicting on every push
+    auto const target = budget.limit() / 4 * 3;
+    // the most recent command is always kept, it may still be merged with
+    auto const last = stack.index() - 1;
+    for (int i = 0; i < last && budget.used() > target; ++i) {
+        auto cmd = const_cast<QUndoCommand*>(stack.command(i));
+        if (cmd->isObsolete()) {
+            continue;
+        }
+        TU::evictAll(cmd);
+        // the stack removes the command when it is next undone
+        cmd->setObsolete(true);
+    }
+}
+
+size_t UndoCmd::dataSize() const {
+    return 0;
+}
+
+void UndoCmd::release() {
+}
+
+void UndoCmd::updateSize() {
+    auto const size = OVERHEAD + (mEvicted ? 0 : dataSize());
+    mBudget->remove(mSize);
+    mBudget->add(size);
+    mSize = size;
+}
+
+
+PatternDelta::PatternDelta() :
+    mTrackStart(0),
+    mTrackEnd(-1),
+    mRowStart(0),
+    mRowEnd(-1),
+    mData(),
+    mRecorded(false)
+{
+}
+
+bool PatternDelta::isRecorded() const {
+    return mRecorded;
+}
+
+void PatternDelta::begin(trackerboy::Pattern const& pattern, PatternSelection const& region) {
+    auto const iter = region.iterator();
+    mTrackStart = iter.trackStart();
+    mTrackEnd = iter.trackEnd();
+    mRowStart = iter.rowStart();
+    mRowEnd = iter.rowEnd();
+    mRecorded = false;
+
+    mData.resize((mTrackEnd - mTrackStart + 1) * iter.rows() * TU::ROW_SIZE);
+    auto dest = mData.data();
+    for (auto track = mTrackStart; track <= mTrackEnd; ++track) {
+        for (auto row = mRowStart; row <= mRowEnd; ++row) {
+            TU::packRow(pattern.getTrackRow(static_cast<trackerboy::ChType>(track), (uint16_t)row), dest);
+            dest += TU::ROW_SIZE;
+        }
+    }
+}
+
+void PatternDelta::end(trackerboy::Pattern const& pattern) {
+    // XOR the saved rows with the current ones, unchanged bytes become 0
+    auto saved = mData.data();
+    for (auto track = mTrackStart; track <= mTrackEnd; ++track) {
+        for (auto row = mRowStart; row <= mRowEnd; ++row) {
+            uint8_t packed[TU::ROW_SIZE];
+            TU::packRow(pattern.getTrackRow(static_cast<trackerboy::ChType>(track), (uint16_t)row), packed);
+            for (size_t i = 0; i < TU::ROW_SIZE; ++i) {
+                *saved++ ^= packed[i];
+            }
+        }
+    }
+
+    // encode as runs of zeros followed by runs of literal bytes
+    std::vector<uint8_t> encoded;
+    auto const begin = mData.cbegin();
+    auto const end = mData.cend();
+    auto iter = begin;
+    while (iter != end) {
+        auto const literalStart = std::find_if(iter, end, [](uint8_t byte) { return byte != 0; });
+        if (literalStart == end) {
+            // trailing zeros are implied
+            break;
+        }
+        auto literalEnd = literalStart;
+        // short runs of zeros between changes are cheaper as literals
+        while (literalEnd != end) {
+            auto const zeros = std::find_if(literalEnd, end, [](uint8_t byte) { return byte != 0; });
+            if (zeros == end || zeros - literalEnd > 2) {
+                break;
+            }
+            literalEnd = std::find(zeros, end, (uint8_t)0);
+        }
+        TU::appendVarint(encoded, literalStart - iter);
+        TU::appendVarint(encoded, literalEnd - literalStart);
+        encoded.insert(encoded.end(), literalStart, literalEnd);
+        iter = literalEnd;
+    }
+
+    encoded.shrink_to_fit();
+    mData = std::move(encoded);
+    mRecorded = true;
+}
+
+void PatternDelta::apply(trackerboy::Pattern &pattern) const {
+    auto const rowsPerTrack = (size_t)(mRowEnd - mRowStart + 1);
+    auto const total = (size_t)(mTrackEnd - mTrackStart + 1) * rowsPerTrack * TU::ROW_SIZE;
+
+    auto src = mData.data();
+    auto const srcEnd = src + mData.size();
+    size_t pos = 0;
+    while (src < srcEnd && pos < total) {
+        pos += TU::readVarint(src);
+        auto const literals = TU::readVarint(src);
+        // apply the run, row by row
+        for (size_t i = 0; i < literals; ) {
+            auto const rowIndex = pos / TU::ROW_SIZE;
+            auto const offset = pos % TU::ROW_SIZE;
+            auto &rowdata = pattern.getTrackRow(
+                static_cast<trackerboy::ChType>(mTrackStart + (int)(rowIndex / rowsPerTrack)),
+                (uint16_t)(mRowStart + (int)(rowIndex % rowsPerTrack))
+            );
+            uint8_t packed[TU::ROW_SIZE];
+            TU::packRow(rowdata, packed);
+            auto const count = std::min(literals - i, TU::ROW_SIZE - offset);
+            for (size_t j = 0; j < count; ++j) {
+                packed[offset + j] ^= src[i + j];
+            }
+            TU::unpackRow(packed, rowdata);
+            i += count;
+            pos += count;
+        }
+        src += literals;
+    }
+}
+
+size_t PatternDelta::size() const {
+    return mData.capacity();
+}
+
+void PatternDelta::clear() {
+    mData.clear();
+    mData.shrink_to_fit();
+    mRecorded = false;
+}
+
+#undef TU
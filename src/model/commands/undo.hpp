@@ -0,0 +1,144 @@
+#pragma once
+
+class Module;
+
+#include "core/PatternSelection.hpp"
+#include "core/UndoBudget.hpp"
+
+#include "trackerboy/data/Pattern.hpp"
+
+#include <QUndoCommand>
+#include <QUndoStack>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//
+// Base class for all undoable edits to a module. The command's memory usage
+// is accounted for in the undo budget of the song it was created for.
+//
+// When the budget is exceeded, the oldest commands are evicted: their data is
+// released and undoing them does nothing (the command is then removed from
+// the stack). Since only the oldest commands already done are evicted, the
+// module simply can no longer be undone past them.
+//
+class UndoCmd : public QUndoCommand {
+
+public:
+
+    //
+    // Estimated size of a command without any data, includes the allocations
+    // made by QUndoCommand.
+    //
+    static constexpr size_t OVERHEAD = 128;
+
+    virtual ~UndoCmd();
+
+    //
+    // Gets the accounted size of the command, in bytes.
+    //
+    size_t size() const;
+
+    //
+    // Releases the command's data, undo will no longer do anything.
+    //
+    void evict();
+
+    bool isEvicted() const;
+
+    void redo() final;
+
+    void undo() final;
+
+    //
+    // Evicts the oldest done commands in the stack until the budget's usage
+    // is at most 3/4 of its limit. Does nothing if the budget is not
+    // exceeded.
+    //
+    static void trim(QUndoStack &stack, UndoBudget &budget);
+
+protected:
+
+    explicit UndoCmd(Module &mod, QUndoCommand *parent = nullptr);
+
+    virtual void redoImpl() = 0;
+
+    virtual void undoImpl() = 0;
+
+    //
+    // Size of the data held by this command, in bytes. Call updateSize when
+    // this size changes.
+    //
+    virtual size_t dataSize() const;
+
+    //
+    // Frees any data held by this command, called when evicted.
+    //
+    virtual void release();
+
+    void updateSize();
+
+private:
+
+    std::shared_ptr<UndoBudget> mBudget;
+    size_t mSize;
+    bool mEvicted;
+
+};
+
+//
+// Compact record of a change to a region of a pattern. Instead of storing the
+// rows before and after the change, only the XOR of the two is kept, which is
+// mostly zero and run-length encoded. Applying the delta toggles the region
+// between the two states, so the same delta is used for both undo and redo.
+//
+class PatternDelta {
+
+public:
+
+    PatternDelta();
+
+    //
+    // Returns true if a change has been recorded.
+    //
+    bool isRecorded() const;
+
+    //
+    // Begins recording a change to the given region of the pattern. The
+    // rows in the region are saved until end is called.
+    //
+    void begin(trackerboy::Pattern const& pattern, PatternSelection const& region);
+
+    //
+    // Ends recording, computing the delta from the saved rows and the
+    // current rows.
+    //
+    void end(trackerboy::Pattern const& pattern);
+
+    //
+    // Applies the delta to the pattern, undoing the change if the pattern is
+    // in its changed state or redoing it otherwise.
+    //
+    void apply(trackerboy::Pattern &pattern) const;
+
+    //
+    // Size of the encoded delta, in bytes.
+    //
+    size_t size() const;
+
+    void clear();
+
+private:
+
+    int mTrackStart;
+    int mTrackEnd;
+    int mRowStart;
+    int mRowEnd;
+
+    // saved rows while recording, the encoded delta once recorded
+    std::vector<uint8_t> mData;
+    bool mRecorded;
+
+};
@@ -0,0 +1,101 @@
+
+#include "utils/Histogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+Histogram::Snapshot::Snapshot() :
+    counts(),
+    total(0),
+    max(0)
+{
+}
+
+uint32_t Histogram::Snapshot::percentile(double p) const {
+    if (total == 0) {
+        return 0;
+    }
+
+    auto const target = std::max((uint64_t)1, (uint64_t)std::ceil(std::clamp(p, 0.0, 1.0) * total));
+    uint64_t sum = 0;
+    for (int i = 0; i < BUCKETS; ++i) {
+        sum += counts[i];
+        if (sum >= target) {
+            return std::min(bucketUpper(i), max);
+        }
+    }
+    // counts were modified during the snapshot
+    return max;
+}
+
+uint32_t Histogram::Snapshot::min() const {
+    for (int i = 0; i < BUCKETS; ++i) {
+        if (counts[i]) {
+            return bucketLower(i);
+        }
+    }
+    return 0;
+}
+
+Histogram::Histogram() :
+    mCounts(),
+    mMax(0)
+{
+    clear();
+}
+
+void Histogram::record(uint32_t value) noexcept {
+    mCounts[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    // single writer, so no compare-exchange is needed
+    if (value > mMax.load(std::memory_order_relaxed)) {
+        mMax.store(value, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::clear() noexcept {
+    for (auto &count : mCounts) {
+        count.store(0, std::memory_order_relaxed);
+    }
+    mMax.store(0, std::memory_order_relaxed);
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+    Snapshot snap;
+    for (int i = 0; i < BUCKETS; ++i) {
+        auto const count = mCounts[i].load(std::memory_order_relaxed);
+        snap.counts[i] = count;
+        snap.total += count;
+    }
+    snap.max = mMax.load(std::memory_order_relaxed);
+    return snap;
+}
+
+int Histogram::bucketIndex(uint32_t value) noexcept {
+    if (value < SUB_COUNT) {
+        return (int)value;
+    }
+
+    // position of the most significant bit, at least SUB_BITS
+    int msb = SUB_BITS;
+    while (msb < 31 && (value >> (msb + 1))) {
+        ++msb;
+    }
+    auto const shift = msb - SUB_BITS;
+    return (shift + 1) * SUB_COUNT + (int)((value >> shift) - SUB_COUNT);
+}
+
+uint32_t Histogram::bucketLower(int index) noexcept {
+    if (index < SUB_COUNT) {
+        return (uint32_t)index;
+    }
+    auto const shift = index / SUB_COUNT - 1;
+    return (uint32_t)(SUB_COUNT + index % SUB_COUNT) << shift;
+}
+
+uint32_t Histogram::bucketUpper(int index) noexcept {
+    if (index + 1 >= BUCKETS) {
+        return UINT32_MAX;
+    }
+    return bucketLower(index + 1) - 1;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+//
+// Fixed-bucket histogram of unsigned 32-bit values that can be recorded to
+// from a realtime thread. Recording is wait-free (a relaxed increment) and
+// never allocates. Reading is done from another thread by taking a
+// snapshot, which may be slightly inconsistent if values are recorded during
+// the copy, this is fine for diagnostics.
+//
+// Buckets are log-linear: values below 16 have their own bucket, larger
+// values are split into 16 buckets per power of two, giving a relative
+// error of at most 1/16 (6.25%) over the entire 32-bit range.
+//
+// Only one thread should record at a time.
+//
+class Histogram {
+
+    static constexpr int SUB_BITS = 4;
+    static constexpr int SUB_COUNT = 1 << SUB_BITS;
+
+public:
+
+    static constexpr int BUCKETS = SUB_COUNT * (32 - SUB_BITS + 1);
+
+    //
+    // Copy of a histogram's counts at a point in time.
+    //
+    struct Snapshot {
+        std::array<uint32_t, BUCKETS> counts;
+        // total number of values recorded
+        uint64_t total;
+        // largest value recorded, exact
+        uint32_t max;
+
+        Snapshot();
+
+        //
+        // Gets the value at the given percentile, 0.0 to 1.0. The result is
+        // the upper bound of the bucket containing the percentile, clamped to
+        // max. 0 is returned if nothing was recorded.
+        //
+        uint32_t percentile(double p) const;
+
+        //
+        // Gets the lower bound of the smallest bucket with a recorded value.
+        //
+        uint32_t min() const;
+    };
+
+    Histogram();
+
+    //
+    // Records a value. Thread-safe, wait-free.
+    //
+    void record(uint32_t value) noexcept;
+
+    //
+    // Resets all counts to 0. Values recorded during a clear may be lost.
+    //
+    void clear() noexcept;
+
+    Snapshot snapshot() const;
+
+    //
+    // Gets the bucket index the value is counted in.
+    //
+    static int bucketIndex(uint32_t value) noexcept;
+
+    //
+    // Smallest value counted in the given bucket.
+    //
+    static uint32_t bucketLower(int index) noexcept;
+
+    //
+    // Largest value counted in the given bucket.
+    //
+    static uint32_t bucketUpper(int index) noexcept;
+
+private:
+    Q_DISABLE_COPY(Histogram)
+
+    std::array<std::atomic_uint32_t, BUCKETS> mCounts;
+    std::atomic_uint32_t mMax;
+
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+//
+// Bounded, lock-free, single producer single consumer queue. Exactly one
+// thread may push and exactly one thread may pop at any given time. Neither
+// push nor pop will ever block, making this suitable for sending data to and
+// from a realtime thread.
+//
+// The capacity, N, must be a power of two. Items are stored inline so T must
+// be default constructible.
+//
+template <class T, size_t N>
+class SpscQueue {
+
+    static_assert(N > 0 && (N & (N - 1)) == 0, "capacity must be a power of 2");
+
+    static constexpr size_t MASK = N - 1;
+
+public:
+
+    SpscQueue() :
+        mItems(),
+        mReadIndex(0),
+        mWriteIndex(0)
+    {
+    }
+
+    //
+    // Producer: adds an item to the back of the queue. false is returned and
+    // the item is not added if the queue is full.
+    //
+    bool push(T const& item) {
+        return emplace(item);
+    }
+
+    bool push(T &&item) {
+        return emplace(std::move(item));
+    }
+
+    //
+    // Consumer: removes the item at the front of the queue, moving it into
+    // the given reference. false is returned if the queue is empty.
+    //
+    bool pop(T &item) {
+        auto const read = mReadIndex.load(std::memory_order_relaxed);
+        if (read == mWriteIndex.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        item = std::move(mItems[read & MASK]);
+        mReadIndex.store(read + 1, std::memory_order_release);
+        return true;
+    }
+
+    //
+    // Determines if the queue is empty. The result is only a snapshot, the
+    // other thread may change the queue at any time.
+    //
+    bool isEmpty() const {
+        return mReadIndex.load(std::memory_order_acquire) == mWriteIndex.load(std::memory_order_acquire);
+    }
+
+    static constexpr size_t capacity() {
+        return N;
+    }
+
+private:
+    Q_DISABLE_COPY(SpscQueue)
+
+    template <class U>
+    bool emplace(U &&item) {
+        auto const write = mWriteIndex.load(std::memory_order_relaxed);
+        if (write - mReadIndex.load(std::memory_order_acquire) == N) {
+            return false;
+        }
+
+        mItems[write & MASK] = std::forward<U>(item);
+        mWriteIndex.store(write + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::array<T, N> mItems;
+
+    // indices are kept on separate cache lines so that the producer and
+    // consumer do not contend with each other
+    alignas(64) std::atomic_size_t mReadIndex;
+    alignas(64) std::atomic_size_t mWriteIndex;
+
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <array>
+#include <atomic>
+
+//
+// Wait-free single writer, single reader value exchange. The writer publishes
+// complete copies of T and the reader always gets the most recently published
+// copy. Neither side ever blocks or waits on the other.
+//
+// Three copies of T are kept: one owned by the writer, one owned by the reader
+// and a middle one that is atomically swapped between the two.
+//
+template <class T>
+class TripleBuffer {
+
+    // set in the middle index when it contains a value not yet seen by the reader
+    static constexpr int FRESH = 0x4;
+    static constexpr int INDEX_MASK = 0x3;
+
+public:
+
+    TripleBuffer() :
+        mBuffers(),
+        mWriteIndex(0),
+        mMiddle(1),
+        mReadIndex(2)
+    {
+    }
+
+    //
+    // Writer: publishes a copy of the given value.
+    //
+    void write(T const& value) {
+        mBuffers[mWriteIndex] = value;
+        mWriteIndex = mMiddle.exchange(mWriteIndex | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    //
+    // Reader: gets the most recently published value. A default constructed
+    // T is returned if nothing has been written yet.
+    //
+    T const& read() {
+        if (mMiddle.load(std::memory_order_relaxed) & FRESH) {
+            mReadIndex = mMiddle.exchange(mReadIndex, std::memory_order_acq_rel) & INDEX_MASK;
+        }
+        return mBuffers[mReadIndex];
+    }
+
+private:
+    Q_DISABLE_COPY(TripleBuffer)
+
+    std::array<T, 3> mBuffers;
+
+    int mWriteIndex;            // writer only
+    std::atomic_int mMiddle;    // shared
+    int mReadIndex;             // reader only
+
+};
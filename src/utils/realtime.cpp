@@ -0,0 +1,168 @@
+
+#include "utils/realtime.hpp"
+
+#include <QtDebug>
+
+#include <algorithm>
+
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define TU realtimeTU
+namespace TU {
+
+static auto const LOG_PREFIX = "[realtime]";
+
+#ifdef Q_OS_LINUX
+
+// stack used by the render thread, touched by prefaultStack
+constexpr size_t STACK_PREFAULT = 64 * 1024;
+
+// nice value used when real-time scheduling is denied
+constexpr int FALLBACK_NICE = -10;
+
+static pid_t threadId() {
+    return (pid_t)syscall(SYS_gettid);
+}
+
+#endif
+
+}
+
+
+bool realtimeSupported() {
+    #ifdef Q_OS_LINUX
+    return true;
+    #else
+    return false;
+    #endif
+}
+
+bool setRealtimePriority(int priority) {
+    #ifdef Q_OS_LINUX
+    priority = qBound(sched_get_priority_min(SCHED_FIFO), priority, sched_get_priority_max(SCHED_FIFO));
+
+    // unprivileged processes may be allowed a limited priority
+    // (ie limits.conf for the audio group)
+    rlimit limit;
+    if (getrlimit(RLIMIT_RTPRIO, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur > 0) {
+        priority = std::min(priority, (int)limit.rlim_cur);
+    }
+
+    sched_param param{};
+    param.sched_priority = priority;
+    auto const error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (error == 0) {
+        return true;
+    }
+
+    qWarning().noquote() << TU::LOG_PREFIX << "real-time scheduling denied:" << strerror(error);
+    // a higher priority is better than nothing, nice values are per-thread on Linux
+    if (setpriority(PRIO_PROCESS, (id_t)TU::threadId(), TU::FALLBACK_NICE) != 0) {
+        qWarning().noquote() << TU::LOG_PREFIX << "unable to raise priority:" << strerror(errno);
+    }
+    return false;
+    #else
+    Q_UNUSED(priority)
+    return false;
+    #endif
+}
+
+void clearRealtimePriority() {
+    #ifdef Q_OS_LINUX
+    sched_param param{};
+    pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+    // lowering priority is always permitted
+    setpriority(PRIO_PROCESS, (id_t)TU::threadId(), 0);
+    #endif
+}
+
+bool setThreadAffinity(int cpu) {
+    #ifdef Q_OS_LINUX
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (cpu < 0) {
+        auto const count = std::min(sysconf(_SC_NPROCESSORS_CONF), (long)CPU_SETSIZE);
+        for (long i = 0; i < count; ++i) {
+            CPU_SET(i, &set);
+        }
+    } else if (cpu < CPU_SETSIZE) {
+        CPU_SET(cpu, &set);
+    } else {
+        return false;
+    }
+
+    auto const error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (error != 0) {
+        qWarning().noquote() << TU::LOG_PREFIX << "unable to set CPU affinity:" << strerror(error);
+        return false;
+    }
+    return true;
+    #else
+    Q_UNUSED(cpu)
+    return false;
+    #endif
+}
+
+void prefaultStack() {
+    #ifdef Q_OS_LINUX
+    volatile char stack[TU::STACK_PREFAULT];
+    auto const pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    for (size_t i = 0; i < TU::STACK_PREFAULT; i += pageSize) {
+        stack[i] = 0;
+    }
+    // only written to fault the pages in
+    Q_UNUSED(stack)
+    #endif
+}
+
+
+MemoryLock::MemoryLock() :
+    mRegions()
+{
+}
+
+MemoryLock::~MemoryLock() {
+    unlock();
+}
+
+bool MemoryLock::lock(void const *data, size_t size, char const *name) {
+    if (data == nullptr || size == 0) {
+        return false;
+    }
+    #ifdef Q_OS_LINUX
+    // mlock also faults in any page not yet resident
+    if (mlock(data, size) != 0) {
+        qWarning().noquote() << TU::LOG_PREFIX << "unable to lock" << name << "in memory:" << strerror(errno);
+        return false;
+    }
+    mRegions.emplace_back(data, size);
+    return true;
+    #else
+    Q_UNUSED(name)
+    return false;
+    #endif
+}
+
+void MemoryLock::unlock() {
+    #ifdef Q_OS_LINUX
+    for (auto const& region : mRegions) {
+        munlock(region.first, region.second);
+    }
+    #endif
+    mRegions.clear();
+}
+
+bool MemoryLock::isLocked() const {
+    return !mRegions.empty();
+}
+
+#undef TU
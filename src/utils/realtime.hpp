@@ -0,0 +1,83 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+//
+// Real-time scheduling and memory locking for the calling thread. Only
+// implemented on Linux, elsewhere every request fails and realtimeSupported
+// returns false.
+//
+// None of these should be called from a thread that must not block, as they
+// are system calls that may page in memory.
+//
+
+//
+// Determines if real-time scheduling can be requested on this platform.
+// Permission to use it is only known by trying.
+//
+bool realtimeSupported();
+
+//
+// Promotes the calling thread to SCHED_FIFO with the given priority (1-99).
+// The priority is lowered to RLIMIT_RTPRIO if the process is limited. If
+// real-time scheduling is denied, the thread's nice value is lowered instead
+// when permitted. Returns true if the thread is scheduled as real-time.
+//
+bool setRealtimePriority(int priority);
+
+//
+// Returns the calling thread to normal scheduling.
+//
+void clearRealtimePriority();
+
+//
+// Pins the calling thread to the given CPU, or lets it run on any CPU when
+// cpu is -1. Returns true on success.
+//
+bool setThreadAffinity(int cpu);
+
+//
+// Touches the calling thread's stack so that its pages are resident before
+// a time-critical section uses them.
+//
+void prefaultStack();
+
+//
+// Keeps regions of memory resident (mlock), so that the render thread never
+// takes a page fault on them. Regions are locked one at a time and unlocked
+// all together: unlocking a page unlocks it for every region sharing it, so
+// the regions must be locked again after any of them is unlocked. A region
+// must be unlocked before it is freed.
+//
+class MemoryLock {
+
+public:
+
+    MemoryLock();
+    ~MemoryLock();
+
+    //
+    // Locks the given region, name is used to log a failure. Returns false
+    // if the region could not be locked, typically when RLIMIT_MEMLOCK is
+    // exceeded.
+    //
+    bool lock(void const *data, size_t size, char const *name);
+
+    //
+    // Unlocks every locked region.
+    //
+    void unlock();
+
+    bool isLocked() const;
+
+private:
+
+    Q_DISABLE_COPY(MemoryLock)
+
+    std::vector<std::pair<void const*, size_t>> mRegions;
+
+};
@@ -437,6 +437,10 @@ void PatternEditor::setInstrument(int id) {
     }
 }
 
+int PatternEditor::instrument() const {
+    return mInstrument ? (int)*mInstrument : -1;
+}
+
 void PatternEditor::setKeyRepeat(bool repeat) {
     mKeyRepeat = repeat;
 }
@@ -561,17 +565,14 @@ void PatternEditor::setCursorFromHScroll(int value) {
 }
 
 void PatternEditor::midiNoteOn(int note) {
+    // the note is previewed by the renderer, directly from the MIDI thread
     if (mModel.isRecording()) {
         mModel.setNote((uint8_t)note, mInstrument);
         stepDown();
     }
-
-    emit previewNote(note, mModel.cursorTrack(), mInstrument.value_or(-1));
-
 }
 
 void PatternEditor::midiNoteOff() {
-    emit stopNotePreview();
 }
 
 #undef TU
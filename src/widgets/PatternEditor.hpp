@@ -50,6 +50,11 @@ public:
 
     void setInstrument(int id);
 
+    //
+    // Instrument id set for note entry, -1 for none
+    //
+    int instrument() const;
+
     void setKeyRepeat(bool repeat);
 
     void cut();
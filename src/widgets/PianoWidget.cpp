@@ -123,14 +123,18 @@ void PianoWidget::release() {
 }
 
 void PianoWidget::midiNoteOn(int note) {
+    // MIDI notes are previewed by the renderer, only show the key
     if (isEnabled()) {
-        play(note);
+        mNote = note;
+        mIsKeyDown = true;
+        update();
     }
 }
 
 void PianoWidget::midiNoteOff() {
     if (isEnabled()) {
-        release();
+        mIsKeyDown = false;
+        update();
     }
 }
 
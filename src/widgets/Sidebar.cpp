@@ -16,6 +16,7 @@ Sidebar::Sidebar(
 ) :
     QWidget(parent),
     mScope(new AudioScope),
+    mPeakMeter(new PeakMeter),
     mOrderEditor(new OrderEditor(patternModel)),
     mSongEditor(new SongEditor(songModel)),
     mSongChooser(new QComboBox)
@@ -23,6 +24,7 @@ Sidebar::Sidebar(
 
     auto layout = new QVBoxLayout;
     layout->addWidget(mScope);
+    layout->addWidget(mPeakMeter);
 
     auto groupbox = new QGroupBox(tr("Song"));
     auto groupLayout = new QVBoxLayout;
@@ -76,6 +78,10 @@ AudioScope* Sidebar::scope() {
     return mScope;
 }
 
+PeakMeter* Sidebar::peakMeter() {
+    return mPeakMeter;
+}
+
 OrderEditor* Sidebar::orderEditor() {
     return mOrderEditor;
 }
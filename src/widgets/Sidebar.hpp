@@ -7,6 +7,7 @@
 #include "widgets/sidebar/AudioScope.hpp"
 #include "widgets/sidebar/OrderEditor.hpp"
 #include "widgets/sidebar/SongEditor.hpp"
+#include "widgets/visualizers/PeakMeter.hpp"
 
 #include <QAction>
 #include <QComboBox>
@@ -32,6 +33,8 @@ public:
 
     AudioScope* scope();
 
+    PeakMeter* peakMeter();
+
     OrderEditor* orderEditor();
 
     SongEditor* songEditor();
@@ -59,6 +62,7 @@ private:
     void updateActions();
 
     AudioScope *mScope;
+    PeakMeter *mPeakMeter;
     OrderEditor *mOrderEditor;
     SongEditor *mSongEditor;
     QComboBox *mSongChooser;
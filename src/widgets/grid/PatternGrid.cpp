@@ -41,6 +41,7 @@ PatternGrid::PatternGrid(
     mHeader(header),
     mModel(model),
     mPainter(font()),
+    mRowCache(),
     mShowShadow(true),
     mSelecting(false),
     mVisibleRows(0),
@@ -63,6 +64,7 @@ PatternGrid::PatternGrid(
     // these changes require a full redraw
     connect(&model, &PatternModel::invalidated, this, &PatternGrid::updateAll);
     connect(&model, &PatternModel::selectionChanged, this, &PatternGrid::updateAll);
+    connect(&model, &PatternModel::patternDataChanged, this, &PatternGrid::invalidateRows);
     // these we only need to redraw the cursor row
     connect(&model, &PatternModel::recordingChanged, this, &PatternGrid::updateCursorRow);
     
@@ -78,7 +80,7 @@ PatternGrid::PatternGrid(
                 mLayout.setEffectsVisible((int)i, counts[i]);
             }
             // redraw everything
-            update();
+            invalidateRows();
             mHeader.update();
 
         });
@@ -100,13 +102,13 @@ void PatternGrid::setColors(Palette const& colors) {
     setPalette(pal);
 
     // new colors, redraw everything
-    update();
+    invalidateRows();
 }
 
 void PatternGrid::setShowFlats(bool showFlats) {
     if (showFlats != mPainter.flats()) {
         mPainter.setFlats(showFlats);
-        update();
+        invalidateRows();
     }
 }
 
@@ -120,7 +122,7 @@ void PatternGrid::setShowShadow(bool shadow) {
 void PatternGrid::setRownoHex(bool hex) {
     if (hex != mLayout.rownoHex()) {
         mLayout.setRownoHex(hex);
-        update();
+        invalidateRows();
     }
 }
 
@@ -188,6 +190,7 @@ void PatternGrid::paintEvent(QPaintEvent *evt) {
     Q_UNUSED(evt)
 
     QPainter painter(this);
+    mRowCache.setRatio(devicePixelRatioF());
 
 
     auto const h = height();
@@ -195,6 +198,7 @@ void PatternGrid::paintEvent(QPaintEvent *evt) {
     auto const centerRow = mVisibleRows / 2;
 
     auto const cursor = mModel.cursor();
+    auto const cursorPattern = mModel.cursorPattern();
     auto patternPrev = mModel.previousPattern();
     auto patternCurr = mModel.currentPattern();
     auto patternNext = mModel.nextPattern();
@@ -208,7 +212,7 @@ void PatternGrid::paintEvent(QPaintEvent *evt) {
     // 3. current row
     // 4. selection
     // 5. cursor
-    // 6. pattern text (mDisplay)
+    // 6. pattern text (mRowCache)
     // 7. lines
 
     // [2] row background
@@ -270,7 +274,7 @@ void PatternGrid::paintEvent(QPaintEvent *evt) {
                     rowno = rowIndexToPrev;
                 }
                 painter.setOpacity(0.5);
-                rowYpos = mPainter.drawPattern(painter, mLayout, *patternPrev, rowno, rowsInPrevious - 1, rowYpos);
+                rowYpos = drawRows(painter, cursorPattern - 1, *patternPrev, rowno, rowsInPrevious - 1, rowYpos);
                 painter.setOpacity(1.0);
             } else {
                 // previews disabled or we don't have a previous pattern, just skip these rows
@@ -286,7 +290,7 @@ void PatternGrid::paintEvent(QPaintEvent *evt) {
         if (rowEnd >= rowsInCurrent) {
             rowEnd = rowsInCurrent - 1;
         }
-        rowYpos = mPainter.drawPattern(painter, mLayout, patternCurr, relativeRowIndex, rowEnd, rowYpos);
+        rowYpos = drawRows(painter, cursorPattern, patternCurr, relativeRowIndex, rowEnd, rowYpos);
         rowsToDraw -= rowEnd - relativeRowIndex;
 
         if (rowsToDraw > 0 && patternNext) {
@@ -295,7 +299,7 @@ void PatternGrid::paintEvent(QPaintEvent *evt) {
                 rowsToDraw = rowsInNext;
             }
             painter.setOpacity(0.5);
-            mPainter.drawPattern(painter, mLayout, *patternNext, 0, rowsToDraw - 1, rowYpos);
+            drawRows(painter, cursorPattern + 1, *patternNext, 0, rowsToDraw - 1, rowYpos);
             painter.setOpacity(1.0);
         }
     }
@@ -325,6 +329,9 @@ void PatternGrid::paintEvent(QPaintEvent *evt) {
         painter.fillRect(0, 1, w, 1, QColor(0, 0, 0, 120));
         painter.fillRect(0, 2, w, 1, QColor(0, 0, 0, 60));
     }
+
+    // keep the rows just drawn, discard the ones scrolled out of view
+    mRowCache.trim(mVisibleRows * 2);
 }
 
 void PatternGrid::resizeEvent(QResizeEvent *evt) {
@@ -490,23 +497,56 @@ void PatternGrid::setPlaying(bool playing) {
 
 void PatternGrid::setFirstHighlight(int highlight) {
     mPainter.setFirstHighlight(highlight);
-    update();
+    invalidateRows();
 }
 
 void PatternGrid::setSecondHighlight(int highlight) {
     mPainter.setSecondHighlight(highlight);
-    update();
+    invalidateRows();
 }
 
 void PatternGrid::fontChanged() {
 
     mVisibleRows = mPainter.calculateRowsAvailable(height());
     mLayout.setCellSize(mPainter.cellWidth(), mPainter.cellHeight());
+    invalidateRows();
     //auto const rownoWidth = mPainter.rownoWidth();
     //auto const trackWidth = mPainter.trackWidth();
     //mHeader.setWidths(rownoWidth, trackWidth);
 }
 
+void PatternGrid::invalidateRows() {
+    mRowCache.clear();
+    update();
+}
+
+int PatternGrid::drawRows(
+    QPainter &painter,
+    int pattern,
+    trackerboy::Pattern const& data,
+    int rowStart,
+    int rowEnd,
+    int ypos
+) {
+    auto const rowHeight = mPainter.cellHeight();
+    // text is drawn a pixel below the top of the row, add room for it
+    QSize const rowSize(mLayout.patternStart() + mLayout.rowWidth(), rowHeight + 1);
+
+    for (int row = rowStart; row <= rowEnd; ++row) {
+        auto pixmap = mRowCache.find(pattern, row);
+        if (pixmap == nullptr) {
+            auto &rendered = mRowCache.insert(pattern, row, rowSize);
+            QPainter rowPainter(&rendered);
+            mPainter.drawPattern(rowPainter, mLayout, data, row, row, 0);
+            pixmap = &rendered;
+        }
+        painter.drawPixmap(0, ypos, *pixmap);
+        ypos += rowHeight;
+    }
+
+    return ypos;
+}
+
 int PatternGrid::mouseToRow(int const mouseY) {
     return mModel.cursorRow() + (mouseY / mPainter.cellHeight() - (mVisibleRows / 2));
 }
@@ -3,6 +3,7 @@
 
 #include "graphics/PatternLayout.hpp"
 #include "graphics/PatternPainter.hpp"
+#include "graphics/RowCache.hpp"
 #include "model/PatternModel.hpp"
 #include "config/data/Palette.hpp"
 #include "config/data/PianoInput.hpp"
@@ -100,6 +101,26 @@ private:
     //
     void fontChanged();
 
+    //
+    // Discards all cached rows and redraws. Call this whenever something that
+    // affects the appearance of pattern text has changed.
+    //
+    void invalidateRows();
+
+    //
+    // Draws the given range of rows for a pattern using the row cache, rows
+    // not in the cache are rendered and added to it. The y position of the
+    // next row is returned.
+    //
+    int drawRows(
+        QPainter &painter,
+        int pattern,
+        trackerboy::Pattern const& data,
+        int rowStart,
+        int rowEnd,
+        int ypos
+    );
+
     int mouseToRow(int const mouseY);
 
     PatternCursor mouseToCursor(QPoint const pos);
@@ -115,6 +136,9 @@ private:
     PatternLayout mLayout;
     PatternPainter mPainter;
 
+    // rendered pattern text, so that only newly exposed rows need to be drawn
+    RowCache mRowCache;
+
     bool mShowShadow;
 
     bool mSelecting;
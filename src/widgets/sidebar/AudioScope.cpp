@@ -15,7 +15,9 @@ constexpr int LINE_WIDTH = 1;
 AudioScope::AudioScope(QWidget *parent) :
     QFrame(parent),
     mBuffer(nullptr),
-    mLineColor(Qt::white)
+    mLineColor(Qt::white),
+    mEnvelopeThread(),
+    mEnvelope(new ScopeEnvelope)
 {
     setAttribute(Qt::WA_StyledBackground);
     setAutoFillBackground(true);
@@ -34,12 +36,24 @@ AudioScope::AudioScope(QWidget *parent) :
     setLineWidth(TU::LINE_WIDTH);
     setFixedHeight(WAVE_HEIGHT * 2 + TU::LINE_WIDTH * 2);
 
+    mEnvelope->moveToThread(&mEnvelopeThread);
+    connect(&mEnvelopeThread, &QThread::finished, mEnvelope, &ScopeEnvelope::deleteLater);
+    connect(mEnvelope, &ScopeEnvelope::ready, this, qOverload<>(&AudioScope::update));
+    mEnvelopeThread.setObjectName(QStringLiteral("scope envelope thread"));
+    mEnvelopeThread.start();
+
+}
+
+AudioScope::~AudioScope() {
+    mEnvelopeThread.quit();
+    mEnvelopeThread.wait();
 }
 
-void AudioScope::setBuffer(Guarded<VisualizerBuffer> *buffer) {
+void AudioScope::setBuffer(VisualizerBuffer *buffer) {
     if (buffer != mBuffer) {
         mBuffer = buffer;
-        update();
+        mEnvelope->setBuffer(buffer);
+        refresh();
     }
 }
 
@@ -53,58 +67,36 @@ void AudioScope::setColors(Palette const& pal) {
     update();
 }
 
+void AudioScope::refresh() {
+    mEnvelope->update();
+}
+
 void AudioScope::paintEvent(QPaintEvent *evt) {
     QFrame::paintEvent(evt);
 
-    // it may be more efficient to do renderering in a separate thread
-    // we can convert a sample buffer to a buffer of QLines, then
-    // the paint event just draws the lines
-
-    if (mBuffer == nullptr) {
-        // no buffer, draw nothing
-        drawSilence();
-        return;
-    }
-
-    auto handle = mBuffer->access();
-    auto size = handle->size();
-    if (size == 0) {
-        // buffer is empty, draw nothing
+    // lines are computed by the envelope thread, we just draw the latest
+    auto const& lines = mEnvelope->lines();
+    if (lines.left.isEmpty()) {
+        // no buffer or the buffer is empty, draw nothing
         drawSilence();
         return;
     }
 
-    auto const w = width() - (TU::LINE_WIDTH * 2);
-    
     QPainter painter(this);
     painter.setRenderHint(QPainter::Antialiasing);
     painter.setPen(mLineColor);
 
-    // pixels per sample
-    float ratio = (unsigned)size / (float)w;
-    float index = 0;
-
-    float prevLeft;
-    float prevRight;
-    sample(handle, 0.0f, ratio, prevLeft, prevRight);
-
-    int const end = w + TU::LINE_WIDTH;
-    for (int t = 1 + TU::LINE_WIDTH; t < end; ++t) {
-        index += ratio;
-        
-        float leftSample;
-        float rightSample;
-        sample(handle, index, ratio, leftSample, rightSample);
-
-        painter.drawLine(QLineF(t - 1, prevLeft, t, leftSample));
-        painter.drawLine(QLineF(t - 1, prevRight, t, rightSample));
+    painter.translate(TU::LINE_WIDTH, WAVE_LEFT_AXIS);
+    painter.drawPolyline(lines.left);
+    painter.translate(0, WAVE_RIGHT_AXIS - WAVE_LEFT_AXIS);
+    painter.drawPolyline(lines.right);
+}
 
-        prevLeft = leftSample;
-        prevRight = rightSample;
+void AudioScope::resizeEvent(QResizeEvent *evt) {
+    QFrame::resizeEvent(evt);
 
-        
-    }
-    
+    mEnvelope->setGeometry(width() - (TU::LINE_WIDTH * 2), WAVE_HEIGHT / 2);
+    refresh();
 }
 
 void AudioScope::drawSilence() {
@@ -116,12 +108,4 @@ void AudioScope::drawSilence() {
 
 }
 
-void AudioScope::sample(Locked<VisualizerBuffer> &handle, float index, float ratio, float &outLeft, float &outRight) {
-    float left, right;
-    handle->averageSample(index, ratio, left, right);
-
-    outLeft = WAVE_LEFT_AXIS - (left / (2.0f / WAVE_HEIGHT));
-    outRight = WAVE_RIGHT_AXIS - (right / (2.0f / WAVE_HEIGHT));
-}
-
 #undef TU
@@ -4,9 +4,10 @@
 
 #include "audio/VisualizerBuffer.hpp"
 #include "config/data/Palette.hpp"
-#include "utils/Guarded.hpp"
+#include "widgets/sidebar/ScopeEnvelope.hpp"
 
 #include <QFrame>
+#include <QThread>
 
 
 class AudioScope : public QFrame {
@@ -17,23 +18,30 @@ class AudioScope : public QFrame {
 public:
 
     explicit AudioScope(QWidget *parent = nullptr);
+    ~AudioScope();
 
 
-    void setBuffer(Guarded<VisualizerBuffer>* buffer);
+    void setBuffer(VisualizerBuffer *buffer);
 
     void setColors(Palette const& pal);
 
+    //
+    // Recomputes the scope's lines from the buffer, call this when the buffer
+    // has been modified. The scope is repainted once the lines are ready.
+    //
+    void refresh();
+
 protected:
 
     void paintEvent(QPaintEvent *evt) override;
 
+    void resizeEvent(QResizeEvent *evt) override;
+
 private:
     Q_DISABLE_COPY(AudioScope)
 
     void drawSilence();
 
-    void sample(Locked<VisualizerBuffer> &handle, float index, float ratio, float &outLeft, float &outRight);
-
     static constexpr int WAVE_WIDTH = 160;
     static constexpr int WAVE_HEIGHT = 64;
     static constexpr int WAVE_AXIS = WAVE_HEIGHT / 2 - 1;
@@ -41,9 +49,12 @@ private:
     static constexpr int WAVE_LEFT_AXIS = (WAVE_HEIGHT / 2) + 1;
     static constexpr int WAVE_RIGHT_AXIS = (WAVE_HEIGHT / 2) + WAVE_HEIGHT + 1;
 
-    Guarded<VisualizerBuffer> *mBuffer;
+    VisualizerBuffer *mBuffer;
 
     QColor mLineColor;
 
+    QThread mEnvelopeThread;
+    ScopeEnvelope *mEnvelope;
+
 
 };
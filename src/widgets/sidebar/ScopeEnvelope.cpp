@@ -0,0 +1,146 @@
+
+#include "widgets/sidebar/ScopeEnvelope.hpp"
+
+#include <algorithm>
+#include <limits>
+
+// SSE2 is part of the x86-64 baseline, see SampleConverter
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCOPE_ENVELOPE_SSE2
+#include <emmintrin.h>
+#endif
+
+#define TU ScopeEnvelopeTU
+namespace TU {
+
+struct Extent {
+    float minLeft;
+    float maxLeft;
+    float minRight;
+    float maxRight;
+};
+
+//
+// Finds the minimum and maximum of each channel in the given interleaved
+// stereo samples. count is the number of stereo samples and must be nonzero.
+//
+static Extent minMax(float const *in, size_t count) {
+    Extent extent;
+    extent.minLeft = extent.minRight = std::numeric_limits<float>::infinity();
+    extent.maxLeft = extent.maxRight = -std::numeric_limits<float>::infinity();
+
+    size_t i = 0;
+
+    #ifdef SCOPE_ENVELOPE_SSE2
+    if (count >= 2) {
+        // each vector holds two stereo samples: L R L R
+        auto vmin = _mm_loadu_ps(in);
+        auto vmax = vmin;
+        for (i = 2; i + 2 <= count; i += 2) {
+            auto const v = _mm_loadu_ps(in + i * 2);
+            vmin = _mm_min_ps(vmin, v);
+            vmax = _mm_max_ps(vmax, v);
+        }
+        // fold the upper sample onto the lower one
+        vmin = _mm_min_ps(vmin, _mm_movehl_ps(vmin, vmin));
+        vmax = _mm_max_ps(vmax, _mm_movehl_ps(vmax, vmax));
+
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, vmin);
+        extent.minLeft = lanes[0];
+        extent.minRight = lanes[1];
+        _mm_store_ps(lanes, vmax);
+        extent.maxLeft = lanes[0];
+        extent.maxRight = lanes[1];
+    }
+    #endif
+
+    for (; i < count; ++i) {
+        auto const left = in[i * 2];
+        auto const right = in[i * 2 + 1];
+        extent.minLeft = std::min(extent.minLeft, left);
+        extent.maxLeft = std::max(extent.maxLeft, left);
+        extent.minRight = std::min(extent.minRight, right);
+        extent.maxRight = std::max(extent.maxRight, right);
+    }
+
+    return extent;
+}
+
+}
+
+
+ScopeEnvelope::ScopeEnvelope(QObject *parent) :
+    QObject(parent),
+    mBuffer(nullptr),
+    mColumns(0),
+    mAmplitude(0),
+    mPending(false),
+    mSamples(),
+    mWorkLines(),
+    mLines()
+{
+}
+
+void ScopeEnvelope::setBuffer(VisualizerBuffer *buffer) {
+    mBuffer = buffer;
+}
+
+void ScopeEnvelope::setGeometry(int columns, int amplitude) {
+    mColumns = columns;
+    mAmplitude = amplitude;
+}
+
+void ScopeEnvelope::update() {
+    if (!mPending.exchange(true)) {
+        QMetaObject::invokeMethod(this, &ScopeEnvelope::compute, Qt::QueuedConnection);
+    }
+}
+
+ScopeEnvelope::Lines const& ScopeEnvelope::lines() {
+    return mLines.read();
+}
+
+void ScopeEnvelope::compute() {
+    // requests made from here on need another computation
+    mPending = false;
+
+    auto const buffer = mBuffer.load();
+    auto const columns = mColumns.load();
+    auto const amplitude = (qreal)mAmplitude.load();
+
+    size_t size = 0;
+    if (buffer != nullptr && columns > 0) {
+        // lock-free copy, never blocks the render thread
+        size = buffer->read(mSamples);
+    }
+
+    auto &left = mWorkLines.left;
+    auto &right = mWorkLines.right;
+    left.clear();
+    right.clear();
+
+    if (size) {
+        left.reserve(columns * 2);
+        right.reserve(columns * 2);
+
+        auto const ratio = (double)size / columns;
+        auto const samples = mSamples.data();
+        for (int x = 0; x < columns; ++x) {
+            auto const begin = std::min((size_t)(x * ratio), size - 1);
+            auto const end = std::clamp((size_t)((x + 1) * ratio), begin + 1, size);
+            auto const extent = TU::minMax(samples + begin * 2, end - begin);
+
+            // top to bottom, the next column connects from the bottom
+            left.append({ (qreal)x, -extent.maxLeft * amplitude });
+            left.append({ (qreal)x, -extent.minLeft * amplitude });
+            right.append({ (qreal)x, -extent.maxRight * amplitude });
+            right.append({ (qreal)x, -extent.minRight * amplitude });
+        }
+    }
+
+    mLines.write(mWorkLines);
+    emit ready();
+}
+
+#undef TU
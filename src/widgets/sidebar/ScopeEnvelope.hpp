@@ -0,0 +1,86 @@
+#pragma once
+
+#include "audio/VisualizerBuffer.hpp"
+#include "utils/TripleBuffer.hpp"
+
+#include <QObject>
+#include <QPolygonF>
+
+#include <atomic>
+#include <vector>
+
+//
+// Computes the waveform displayed by AudioScope. For each pixel column, the
+// minimum and maximum sample of the samples in that column are found and
+// added to a polyline, so that every sample is represented no matter the
+// width of the scope.
+//
+// Computation is done in the thread this object lives in, which should not
+// be the GUI thread. The lines are published through a triple buffer, so the
+// GUI thread only has to draw the latest lines when painting.
+//
+class ScopeEnvelope : public QObject {
+
+    Q_OBJECT
+
+public:
+
+    //
+    // Polylines for each channel. Points are in pixels, with x starting at 0
+    // and y being relative to the channel's axis.
+    //
+    struct Lines {
+        QPolygonF left;
+        QPolygonF right;
+    };
+
+    explicit ScopeEnvelope(QObject *parent = nullptr);
+
+    //
+    // Sets the buffer to compute lines from, nullptr for no buffer. Thread-safe.
+    //
+    void setBuffer(VisualizerBuffer *buffer);
+
+    //
+    // Sets the number of pixel columns and the height in pixels of a full
+    // scale sample. Thread-safe.
+    //
+    void setGeometry(int columns, int amplitude);
+
+    //
+    // Schedules the lines to be recomputed. Multiple requests made before
+    // the computation starts result in a single computation. Thread-safe.
+    //
+    void update();
+
+    //
+    // Gets the most recently computed lines. Must only be called from a
+    // single thread, the GUI thread.
+    //
+    Lines const& lines();
+
+signals:
+
+    //
+    // Emitted from the envelope's thread when new lines are available.
+    //
+    void ready();
+
+private:
+    Q_DISABLE_COPY(ScopeEnvelope)
+
+    void compute();
+
+    std::atomic<VisualizerBuffer*> mBuffer;
+    std::atomic_int mColumns;
+    std::atomic_int mAmplitude;
+    std::atomic_bool mPending;
+
+    // envelope thread only
+    std::vector<float> mSamples;
+    Lines mWorkLines;
+
+    // envelope thread -> GUI
+    TripleBuffer<Lines> mLines;
+
+};
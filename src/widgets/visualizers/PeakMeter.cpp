@@ -3,21 +3,128 @@
 
 #include <QPaintEvent>
 #include <QPainter>
+#include <QScreen>
+#include <QTimerEvent>
+
+#include <algorithm>
+#include <cmath>
+
+#define TU PeakMeterTU
+namespace TU {
+
+constexpr int HEIGHT = 16;
+constexpr int RMS_HEIGHT = 4;
+
+static qint16 toSample(float level) {
+    return (qint16)std::clamp(std::lround(level * INT16_MAX), 0l, (long)INT16_MAX);
+}
+
+static qreal toDb(float level) {
+    return level > 0.0f ? std::max(20.0 * std::log10(level), VolumeMeterAnimation::MIN_DB) : VolumeMeterAnimation::MIN_DB;
+}
+
+static qreal dbWidth(qreal db, int width) {
+    return (db - VolumeMeterAnimation::MIN_DB) * width / -VolumeMeterAnimation::MIN_DB;
+}
+
+}
 
 
 PeakMeter::PeakMeter(QWidget *parent) :
-    QWidget(parent)
+    QWidget(parent),
+    mMeter(nullptr),
+    mActive(false),
+    mPollTimer(),
+    mMeterLeft(),
+    mMeterRight(),
+    mRmsLeft(VolumeMeterAnimation::MIN_DB),
+    mRmsRight(VolumeMeterAnimation::MIN_DB)
 {
+    setFixedHeight(TU::HEIGHT);
     connect(&mMeterLeft, &VolumeMeterAnimation::redraw, this, qOverload<>(&PeakMeter::update));
     connect(&mMeterRight, &VolumeMeterAnimation::redraw, this, qOverload<>(&PeakMeter::update));
 }
 
+void PeakMeter::setMeter(LevelMeter *meter) {
+    mMeter = meter;
+    if (mMeter == nullptr) {
+        mPollTimer.stop();
+        mMeterLeft.setTarget(0);
+        mMeterRight.setTarget(0);
+        mRmsLeft = mRmsRight = VolumeMeterAnimation::MIN_DB;
+        update();
+    } else if (mActive && isVisible()) {
+        startPolling();
+    }
+}
 
-void PeakMeter::setPeaks(qint16 left, qint16 right) {
+void PeakMeter::setActive(bool active) {
+    mActive = active;
+    if (mMeter == nullptr) {
+        return;
+    }
 
-    mMeterLeft.setTarget(left);
-    mMeterRight.setTarget(right);
+    if (active) {
+        if (isVisible()) {
+            startPolling();
+        }
+    } else {
+        mPollTimer.stop();
+        poll();
+    }
+}
 
+void PeakMeter::startPolling() {
+    // poll once per displayed frame, polling any faster is wasted work
+    int interval = 1000 / 60;
+    if (auto const scr = screen(); scr != nullptr && scr->refreshRate() > 0.0) {
+        interval = std::max(1, (int)(1000.0 / scr->refreshRate()));
+    }
+    mPollTimer.start(interval, Qt::PreciseTimer, this);
+}
+
+void PeakMeter::hideEvent(QHideEvent *evt) {
+    Q_UNUSED(evt)
+    mPollTimer.stop();
+}
+
+void PeakMeter::showEvent(QShowEvent *evt) {
+    Q_UNUSED(evt)
+    if (mMeter != nullptr) {
+        if (mActive) {
+            startPolling();
+        } else {
+            // levels may have been reset while hidden
+            poll();
+        }
+    }
+}
+
+void PeakMeter::timerEvent(QTimerEvent *evt) {
+    if (evt->timerId() == mPollTimer.timerId()) {
+        poll();
+    } else {
+        QWidget::timerEvent(evt);
+    }
+}
+
+void PeakMeter::poll() {
+    LevelMeter::Levels levels;
+    if (!mMeter->poll(levels)) {
+        // nothing was published since the last poll, keep the targets
+        return;
+    }
+
+    mMeterLeft.setTarget(TU::toSample(levels.peakLeft));
+    mMeterRight.setTarget(TU::toSample(levels.peakRight));
+
+    auto const rmsLeft = TU::toDb(levels.rmsLeft);
+    auto const rmsRight = TU::toDb(levels.rmsRight);
+    if (!qFuzzyCompare(rmsLeft, mRmsLeft) || !qFuzzyCompare(rmsRight, mRmsRight)) {
+        mRmsLeft = rmsLeft;
+        mRmsRight = rmsRight;
+        update();
+    }
 }
 
 void PeakMeter::paintEvent(QPaintEvent *evt) {
@@ -28,6 +135,13 @@ void PeakMeter::paintEvent(QPaintEvent *evt) {
     int const w = width();
     int const center = w / 2;
 
-    painter.fillRect(QRectF(center, 0.0, mMeterLeft.meterWidth(center), 16.0), Qt::black);
-    painter.fillRect(QRectF(center, 0.0, -mMeterRight.meterWidth(center), 16.0), Qt::black);
+    // left channel grows to the left, right channel to the right
+    painter.fillRect(QRectF(center, 0.0, -mMeterLeft.meterWidth(center), TU::HEIGHT), Qt::black);
+    painter.fillRect(QRectF(center, 0.0, mMeterRight.meterWidth(center), TU::HEIGHT), Qt::black);
+
+    qreal const rmsY = TU::HEIGHT - TU::RMS_HEIGHT;
+    painter.fillRect(QRectF(center, rmsY, -TU::dbWidth(mRmsLeft, center), TU::RMS_HEIGHT), Qt::darkGray);
+    painter.fillRect(QRectF(center, rmsY, TU::dbWidth(mRmsRight, center), TU::RMS_HEIGHT), Qt::darkGray);
 }
+
+#undef TU
@@ -1,10 +1,18 @@
 
 #pragma once
 
+#include "audio/LevelMeter.hpp"
 #include "widgets/visualizers/VolumeMeterAnimation.hpp"
 
+#include <QBasicTimer>
 #include <QWidget>
 
+//
+// Stereo level meter. Peaks are shown as animated bars growing outwards from
+// the center, with the RMS level drawn underneath. Levels are polled from a
+// LevelMeter at display rate while the meter is visible and active (the
+// renderer is rendering).
+//
 class PeakMeter : public QWidget {
 
     Q_OBJECT
@@ -12,18 +20,44 @@ class PeakMeter : public QWidget {
 public:
     PeakMeter(QWidget *parent = nullptr);
 
-public slots:
+    //
+    // Sets the level meter to poll, nullptr for none.
+    //
+    void setMeter(LevelMeter *meter);
 
-    void setPeaks(qint16 left, qint16 right);
+    //
+    // Starts or stops polling, call when rendering starts and stops. The
+    // meter is polled one last time when deactivated so that the levels
+    // fall back to silence.
+    //
+    void setActive(bool active);
 
 protected:
 
+    void hideEvent(QHideEvent *evt) override;
+
     void paintEvent(QPaintEvent *evt) override;
 
+    void showEvent(QShowEvent *evt) override;
+
+    void timerEvent(QTimerEvent *evt) override;
+
 private:
     Q_DISABLE_COPY(PeakMeter)
 
+    void startPolling();
+
+    void poll();
+
+    LevelMeter *mMeter;
+    bool mActive;
+    QBasicTimer mPollTimer;
+
     VolumeMeterAnimation mMeterLeft;
     VolumeMeterAnimation mMeterRight;
 
+    // RMS levels in dB
+    qreal mRmsLeft;
+    qreal mRmsRight;
+
 };
@@ -53,3 +53,20 @@ void TestAudioEnumerator::populate() {
         QVERIFY(enumerator.devices(backend) >= 1);
     }
 }
+
+void TestAudioEnumerator::populateAsync() {
+    AudioEnumerator enumerator;
+    QSignalSpy spy(&enumerator, &AudioEnumerator::populated);
+
+    for (int backend = 0; backend < enumerator.backends(); ++backend) {
+        QVERIFY(!enumerator.isPopulated(backend));
+
+        enumerator.populateAsync(backend);
+
+        // the signal is emitted once probing has finished
+        QVERIFY(spy.wait(10000));
+        QCOMPARE(spy.takeFirst().at(0).toInt(), backend);
+        QVERIFY(enumerator.isPopulated(backend));
+        QVERIFY(enumerator.devices(backend) >= 1);
+    }
+}
@@ -19,4 +19,6 @@ private slots:
 
     void populate();
 
+    void populateAsync();
+
 };
@@ -0,0 +1,103 @@
+#include "units/TestChannelTapApu.hpp"
+
+#include "audio/ChannelTapApu.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#define TU TestChannelTapApuTU
+namespace TU {
+
+constexpr int SAMPLERATE = 48000;
+constexpr size_t BUFFER_SIZE = 4096;
+// cycles in a frame at 59.7 Hz
+constexpr uint32_t FRAME_CYCLES = 70224;
+
+static float peak(std::vector<float> const& samples, size_t count) {
+    float result = 0.0f;
+    for (size_t i = 0; i < count * 2; ++i) {
+        result = std::max(result, std::abs(samples[i]));
+    }
+    return result;
+}
+
+//
+// Plays a frame of a square on CH1, panned to both terminals with every
+// channel enabled in NR51.
+//
+static void playSquare(ChannelTapApu &apu) {
+    apu.setSamplerate(SAMPLERATE);
+    apu.setBuffer(BUFFER_SIZE);
+    apu.reset();
+
+    apu.writeRegister(0x26, 0x80); // NR52: power on
+    apu.writeRegister(0x24, 0x77); // NR50: full master volume
+    apu.writeRegister(0x25, 0xFF); // NR51: all channels on both terminals
+    apu.writeRegister(0x11, 0x80); // NR11: 50% duty
+    apu.writeRegister(0x12, 0xF0); // NR12: full volume, no envelope
+    apu.writeRegister(0x13, 0x00); // NR13
+    apu.writeRegister(0x14, 0x87); // NR14: trigger
+
+    apu.step(FRAME_CYCLES);
+    apu.endFrame();
+}
+
+}
+
+
+TestChannelTapApu::TestChannelTapApu() {
+
+}
+
+void TestChannelTapApu::taps() {
+    ChannelTapApu apu;
+    TU::playSquare(apu);
+
+    // the mix reads back unmasked registers
+    QCOMPARE(apu.readRegister(0x25), (uint8_t)0xFF);
+
+    std::vector<float> mix(TU::BUFFER_SIZE * 2);
+    auto const mixCount = apu.readSamples(mix.data(), TU::BUFFER_SIZE);
+    QVERIFY(mixCount > 0);
+    QVERIFY(TU::peak(mix, mixCount) > 0.0f);
+
+    std::vector<float> channel(TU::BUFFER_SIZE * 2);
+    for (int ch = 0; ch < ChannelTapApu::CHANNELS; ++ch) {
+        auto const count = apu.readChannelSamples(ch, channel.data(), TU::BUFFER_SIZE);
+        QCOMPARE(count, mixCount);
+        if (ch == 0) {
+            // CH1 is the only channel sounding, so its tap is the mix
+            for (size_t i = 0; i < count * 2; ++i) {
+                QVERIFY(std::abs(channel[i] - mix[i]) < 1e-5f);
+            }
+        } else {
+            QCOMPARE(TU::peak(channel, count), 0.0f);
+        }
+    }
+}
+void TestChannelTapApu::withoutMix() {
+    // only CH1 and CH2 are tapped
+    ChannelTapApu apu(false, 0x3);
+    TU::playSquare(apu);
+
+    // NR51 reads back as written even though no APU has all of its bits
+    QCOMPARE(apu.readRegister(0x25), (uint8_t)0xFF);
+
+    std::vector<float> samples(TU::BUFFER_SIZE * 2);
+    QCOMPARE(apu.samplesAvailable(), (size_t)0);
+    QCOMPARE(apu.readSamples(samples.data(), TU::BUFFER_SIZE), (size_t)0);
+
+    auto const count = apu.readChannelSamples(0, samples.data(), TU::BUFFER_SIZE);
+    QVERIFY(count > 0);
+    QVERIFY(TU::peak(samples, count) > 0.0f);
+
+    QVERIFY(apu.readChannelSamples(1, samples.data(), TU::BUFFER_SIZE) > 0);
+    QCOMPARE(TU::peak(samples, count), 0.0f);
+
+    // disabled taps are not emulated
+    QCOMPARE(apu.readChannelSamples(2, samples.data(), TU::BUFFER_SIZE), (size_t)0);
+    QCOMPARE(apu.readChannelSamples(3, samples.data(), TU::BUFFER_SIZE), (size_t)0);
+}
+
+#undef TU
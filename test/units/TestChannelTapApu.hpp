@@ -0,0 +1,19 @@
+#pragma once
+
+#include <QtTest/QtTest>
+
+class TestChannelTapApu : public QObject {
+
+    Q_OBJECT
+
+public:
+
+    Q_INVOKABLE TestChannelTapApu();
+
+private slots:
+
+    void taps();
+
+    void withoutMix();
+
+};
@@ -0,0 +1,59 @@
+#include "units/TestHistogram.hpp"
+
+#include "utils/Histogram.hpp"
+
+
+TestHistogram::TestHistogram() {
+
+}
+
+void TestHistogram::buckets() {
+    // buckets are contiguous and cover the entire range
+    QCOMPARE(Histogram::bucketLower(0), 0u);
+    QCOMPARE(Histogram::bucketUpper(Histogram::BUCKETS - 1), UINT32_MAX);
+    for (int i = 0; i < Histogram::BUCKETS; ++i) {
+        auto const lower = Histogram::bucketLower(i);
+        auto const upper = Histogram::bucketUpper(i);
+        QVERIFY(lower <= upper);
+        QCOMPARE(Histogram::bucketIndex(lower), i);
+        QCOMPARE(Histogram::bucketIndex(upper), i);
+        if (i + 1 < Histogram::BUCKETS) {
+            QCOMPARE(Histogram::bucketLower(i + 1), upper + 1);
+        }
+        // relative error of at most 1/16
+        QVERIFY(upper - lower <= lower / 16);
+    }
+}
+
+void TestHistogram::percentiles() {
+    Histogram histogram;
+    auto snapshot = histogram.snapshot();
+    QCOMPARE(snapshot.total, (uint64_t)0);
+    QCOMPARE(snapshot.percentile(0.5), 0u);
+
+    for (uint32_t i = 1; i <= 1000; ++i) {
+        histogram.record(i);
+    }
+    snapshot = histogram.snapshot();
+    QCOMPARE(snapshot.total, (uint64_t)1000);
+    QCOMPARE(snapshot.max, 1000u);
+    QCOMPARE(snapshot.min(), 1u);
+
+    auto const p50 = snapshot.percentile(0.5);
+    QVERIFY(p50 >= 500 && p50 <= 500 + 500 / 16);
+    auto const p99 = snapshot.percentile(0.99);
+    QVERIFY(p99 >= 990 && p99 <= 1000);
+    QCOMPARE(snapshot.percentile(1.0), 1000u);
+}
+
+void TestHistogram::clear() {
+    Histogram histogram;
+    histogram.record(42);
+    histogram.record(100000);
+    QCOMPARE(histogram.snapshot().total, (uint64_t)2);
+
+    histogram.clear();
+    auto const snapshot = histogram.snapshot();
+    QCOMPARE(snapshot.total, (uint64_t)0);
+    QCOMPARE(snapshot.max, 0u);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <QtTest/QtTest>
+
+class TestHistogram : public QObject {
+
+    Q_OBJECT
+
+public:
+
+    Q_INVOKABLE TestHistogram();
+
+private slots:
+
+    void buckets();
+
+    void percentiles();
+
+    void clear();
+
+};
@@ -0,0 +1,113 @@
+#include "units/TestLatencyController.hpp"
+
+#include "audio/LatencyController.hpp"
+
+#define TU TestLatencyControllerTU
+namespace TU {
+
+constexpr int SAMPLERATE = 48000;
+constexpr size_t MAX_TARGET = 4800;
+// 5 ms periods, the device consumes 240 samples per period
+constexpr size_t PERIOD = 240;
+constexpr LatencyController::Duration PERIOD_TIME = std::chrono::milliseconds(5);
+
+//
+// Simulates a steady stream for the given amount of time: the buffer was
+// filled to the target last period and one period has been consumed since.
+//
+static void run(LatencyController &controller, unsigned underruns, LatencyController::Duration time) {
+    for (LatencyController::Duration elapsed(0); elapsed < time; elapsed += PERIOD_TIME) {
+        auto const target = controller.target();
+        controller.update(target > PERIOD ? target - PERIOD : 0, underruns, PERIOD_TIME);
+    }
+}
+
+}
+
+
+TestLatencyController::TestLatencyController() {
+
+}
+
+void TestLatencyController::reset() {
+    LatencyController controller;
+    controller.reset(0, TU::MAX_TARGET, TU::SAMPLERATE);
+    QCOMPARE(controller.target(), TU::MAX_TARGET);
+
+    // minimum is clamped to the maximum
+    controller.reset(10000, TU::MAX_TARGET, TU::SAMPLERATE);
+    QCOMPARE(controller.target(), TU::MAX_TARGET);
+    TU::run(controller, 0, std::chrono::seconds(10));
+    QCOMPARE(controller.target(), TU::MAX_TARGET);
+}
+
+void TestLatencyController::shrink() {
+    LatencyController controller;
+    controller.reset(0, TU::MAX_TARGET, TU::SAMPLERATE);
+    controller.restart(0);
+
+    // nothing changes until a full window has been measured
+    TU::run(controller, 0, LatencyController::WINDOW - TU::PERIOD_TIME);
+    QCOMPARE(controller.target(), TU::MAX_TARGET);
+    TU::run(controller, 0, TU::PERIOD_TIME);
+    QVERIFY(controller.target() < TU::MAX_TARGET);
+
+    // settles on two periods: one being consumed and a margin for another
+    TU::run(controller, 0, std::chrono::seconds(30));
+    auto const target = controller.target();
+    QVERIFY(target >= 2 * TU::PERIOD);
+    QVERIFY(target <= 2 * TU::PERIOD + 2);
+}
+
+void TestLatencyController::minimum() {
+    LatencyController controller;
+    controller.reset(1000, TU::MAX_TARGET, TU::SAMPLERATE);
+    controller.restart(0);
+    TU::run(controller, 0, std::chrono::seconds(30));
+    QCOMPARE(controller.target(), (size_t)1000);
+}
+
+void TestLatencyController::underrun() {
+    LatencyController controller;
+    controller.reset(0, TU::MAX_TARGET, TU::SAMPLERATE);
+    controller.restart(0);
+    TU::run(controller, 0, std::chrono::seconds(30));
+    auto const settled = controller.target();
+
+    // a long period empties the buffer
+    controller.update(0, 1, std::chrono::milliseconds(20));
+    auto const grown = controller.target();
+    QCOMPARE(grown, settled + (TU::MAX_TARGET - settled + 1) / 2);
+
+    // no shrinking during the cooldown and the window that follows
+    TU::run(controller, 1, LatencyController::MIN_COOLDOWN + LatencyController::WINDOW - TU::PERIOD_TIME);
+    QCOMPARE(controller.target(), grown);
+    TU::run(controller, 1, std::chrono::seconds(30));
+    QVERIFY(controller.target() < grown);
+
+    // counter was reset, not an underrun
+    auto const target = controller.target();
+    controller.update(target - TU::PERIOD, 0, TU::PERIOD_TIME);
+    QCOMPARE(controller.target(), target);
+}
+
+void TestLatencyController::cooldown() {
+    LatencyController controller;
+    controller.reset(0, TU::MAX_TARGET, TU::SAMPLERATE);
+    controller.restart(0);
+
+    controller.update(0, 1, TU::PERIOD_TIME);
+    auto grown = controller.target();
+    TU::run(controller, 1, LatencyController::MIN_COOLDOWN + LatencyController::WINDOW);
+    QVERIFY(controller.target() < grown);
+
+    // second underrun waits twice as long
+    controller.update(0, 2, TU::PERIOD_TIME);
+    grown = controller.target();
+    TU::run(controller, 2, 2 * LatencyController::MIN_COOLDOWN + LatencyController::WINDOW - TU::PERIOD_TIME);
+    QCOMPARE(controller.target(), grown);
+    TU::run(controller, 2, TU::PERIOD_TIME);
+    QVERIFY(controller.target() < grown);
+}
+
+#undef TU
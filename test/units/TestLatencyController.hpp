@@ -0,0 +1,25 @@
+#pragma once
+
+#include <QtTest/QtTest>
+
+class TestLatencyController : public QObject {
+
+    Q_OBJECT
+
+public:
+
+    Q_INVOKABLE TestLatencyController();
+
+private slots:
+
+    void reset();
+
+    void shrink();
+
+    void minimum();
+
+    void underrun();
+
+    void cooldown();
+
+};
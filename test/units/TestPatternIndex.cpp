@@ -0,0 +1,98 @@
+#include "units/TestPatternIndex.hpp"
+
+#include "core/PatternIndex.hpp"
+
+#include "trackerboy/note.hpp"
+
+
+TestPatternIndex::TestPatternIndex() {
+
+}
+
+void TestPatternIndex::query() {
+    trackerboy::Track track(4);
+    track.setNote(0, trackerboy::NOTE_G + trackerboy::OCTAVE_5);
+    track.setInstrument(0, 0x1F);
+    track.setEffect(1, 2, trackerboy::EffectType::arpeggio, 0x37);
+
+    QVERIFY(PatternQuery::note(trackerboy::NOTE_G + trackerboy::OCTAVE_5).matches(track[0]));
+    QVERIFY(!PatternQuery::note(trackerboy::NOTE_B + trackerboy::OCTAVE_5).matches(track[0]));
+    QVERIFY(PatternQuery::instrument(0x1F).matches(track[0]));
+    QVERIFY(!PatternQuery::instrument(0x1F).matches(track[1]));
+
+    // effects match in any column, optionally by parameter
+    QVERIFY(PatternQuery::effect(trackerboy::EffectType::arpeggio).matches(track[1]));
+    QVERIFY(PatternQuery::effect(trackerboy::EffectType::arpeggio, 0x37).matches(track[1]));
+    QVERIFY(!PatternQuery::effect(trackerboy::EffectType::arpeggio, 0x36).matches(track[1]));
+
+    // empty columns never match
+    QVERIFY(!PatternQuery::effect(trackerboy::EffectType::noEffect).matches(track[2]));
+}
+
+void TestPatternIndex::replacement() {
+    trackerboy::Track track(2);
+    track.setInstrument(0, 0x1F);
+    track.setEffect(0, 0, trackerboy::EffectType::arpeggio, 0x37);
+    track.setEffect(0, 1, trackerboy::EffectType::arpeggio, 0x12);
+
+    PatternReplacement replacement{ (uint8_t)2, std::nullopt };
+    QVERIFY(replacement.apply(PatternQuery::instrument(0x1F), track[0]));
+    QCOMPARE(track[0].queryInstrument(), std::optional<uint8_t>(2));
+    // already replaced, no change
+    QVERIFY(!replacement.apply(PatternQuery::instrument(0x1F), track[0]));
+    QVERIFY(!replacement.apply(PatternQuery::instrument(0x1F), track[1]));
+
+    // replace only the parameter of the matching effect
+    PatternReplacement paramReplacement{ std::nullopt, (uint8_t)0x47 };
+    QVERIFY(paramReplacement.apply(PatternQuery::effect(trackerboy::EffectType::arpeggio, 0x37), track[0]));
+    QCOMPARE(track[0].effects[0].type, trackerboy::EffectType::arpeggio);
+    QCOMPARE(track[0].effects[0].param, (uint8_t)0x47);
+    QCOMPARE(track[0].effects[1].param, (uint8_t)0x12);
+}
+
+void TestPatternIndex::find() {
+    trackerboy::Song song;
+    // 00: 00 00 00 00
+    // 01: 01 00 00 00
+    // 02: 00 01 00 00
+    song.order().insert(1, { 1, 0, 0, 0 });
+    song.order().insert(2, { 0, 1, 0, 0 });
+    song.patterns().getTrack(trackerboy::ChType::ch1, 1).setInstrument(5, 0x1F);
+    song.patterns().getTrack(trackerboy::ChType::ch2, 1).setInstrument(3, 0x1F);
+    song.patterns().getTrack(trackerboy::ChType::ch2, 1).setInstrument(8, 0x1F);
+
+    PatternIndex index;
+    auto const matches = index.find(song, PatternQuery::instrument(0x1F));
+    QCOMPARE(matches.size(), (size_t)3);
+    QCOMPARE(matches[0].pattern, 1);
+    QCOMPARE(matches[0].track, 0);
+    QCOMPARE(matches[0].row, 5);
+    QCOMPARE(matches[1].pattern, 2);
+    QCOMPARE(matches[1].track, 1);
+    QCOMPARE(matches[1].row, 3);
+    QCOMPARE(matches[2].row, 8);
+
+    QVERIFY(index.find(song, PatternQuery::instrument(0x1E)).empty());
+
+    auto const tracks = index.tracks(song, PatternQuery::instrument(0x1F));
+    QCOMPARE(tracks.size(), (size_t)2);
+}
+
+void TestPatternIndex::invalidate() {
+    trackerboy::Song song;
+    auto &track = song.patterns().getTrack(trackerboy::ChType::ch3, 0);
+
+    PatternIndex index;
+    QVERIFY(index.find(song, PatternQuery::instrument(4)).empty());
+
+    // usage is kept until the track is invalidated
+    track.setInstrument(0, 4);
+    QVERIFY(index.find(song, PatternQuery::instrument(4)).empty());
+    index.invalidate(PatternIndex::TrackRef{ 2, 0 });
+    QCOMPARE(index.find(song, PatternQuery::instrument(4)).size(), (size_t)1);
+
+    track.setInstrument(0, 5);
+    index.invalidate(song.order()[0]);
+    QVERIFY(index.find(song, PatternQuery::instrument(4)).empty());
+    QCOMPARE(index.find(song, PatternQuery::instrument(5)).size(), (size_t)1);
+}
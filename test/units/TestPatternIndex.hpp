@@ -0,0 +1,23 @@
+#pragma once
+
+#include <QtTest/QtTest>
+
+class TestPatternIndex : public QObject {
+
+    Q_OBJECT
+
+public:
+
+    Q_INVOKABLE TestPatternIndex();
+
+private slots:
+
+    void query();
+
+    void replacement();
+
+    void find();
+
+    void invalidate();
+
+};
@@ -0,0 +1,95 @@
+#include "units/TestSampleConverter.hpp"
+
+#include "audio/SampleConverter.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#define TU TestSampleConverterTU
+namespace TU {
+
+static std::vector<float> randomSamples(size_t count) {
+    // slightly out of range so that clipping is exercised
+    std::mt19937 gen(1234);
+    std::uniform_real_distribution<float> dist(-1.25f, 1.25f);
+    std::vector<float> samples(count);
+    for (auto &sample : samples) {
+        sample = dist(gen);
+    }
+    return samples;
+}
+
+}
+
+Q_DECLARE_METATYPE(Wav::Format)
+
+
+TestSampleConverter::TestSampleConverter() {
+
+}
+
+void TestSampleConverter::clipping() {
+    float const samples[] = { 0.0f, 1.0f, -1.0f, 0.5f, 2.0f, -2.0f, 0.25f };
+    int16_t const expected[] = { 0, 32767, -32767, 16384, 32767, -32768, 8192 };
+    int16_t output[7];
+
+    SampleConverter converter(Wav::Format::pcm16);
+    converter.convert(samples, output, 7);
+    for (int i = 0; i < 7; ++i) {
+        QCOMPARE(output[i], expected[i]);
+    }
+}
+
+void TestSampleConverter::simdMatchesScalar_data() {
+    QTest::addColumn<Wav::Format>("format");
+
+    QTest::newRow("pcm16") << Wav::Format::pcm16;
+    QTest::newRow("pcm24") << Wav::Format::pcm24;
+}
+
+void TestSampleConverter::simdMatchesScalar() {
+    if (!SampleConverter::hasSimd()) {
+        QSKIP("SIMD kernels not available on this target");
+    }
+
+    QFETCH(Wav::Format, format);
+
+    // odd count so that the scalar tail of the SIMD path is used
+    auto const samples = TU::randomSamples(1027);
+    auto const bytes = samples.size() * Wav::sampleSize(format);
+    std::vector<uint8_t> simdOutput(bytes);
+    std::vector<uint8_t> scalarOutput(bytes);
+
+    SampleConverter simd(format);
+    simd.convert(samples.data(), simdOutput.data(), samples.size());
+
+    SampleConverter scalar(format);
+    scalar.setSimdEnabled(false);
+    scalar.convert(samples.data(), scalarOutput.data(), samples.size());
+
+    QVERIFY(simdOutput == scalarOutput);
+}
+
+void TestSampleConverter::ditherWithinOneLsb() {
+    auto const samples = TU::randomSamples(1027);
+    std::vector<int16_t> plain(samples.size());
+    std::vector<int16_t> dithered(samples.size());
+
+    SampleConverter plainConverter(Wav::Format::pcm16);
+    plainConverter.convert(samples.data(), plain.data(), samples.size());
+
+    SampleConverter ditherConverter(Wav::Format::pcm16, true);
+    ditherConverter.convert(samples.data(), dithered.data(), samples.size());
+
+    bool anyDifferent = false;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        auto const diff = std::abs(plain[i] - dithered[i]);
+        QVERIFY(diff <= 1);
+        anyDifferent = anyDifferent || diff != 0;
+    }
+    QVERIFY(anyDifferent);
+}
+
+#undef TU
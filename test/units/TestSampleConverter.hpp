@@ -0,0 +1,22 @@
+#pragma once
+
+#include <QtTest/QtTest>
+
+class TestSampleConverter : public QObject {
+
+    Q_OBJECT
+
+public:
+
+    Q_INVOKABLE TestSampleConverter();
+
+private slots:
+
+    void clipping();
+
+    void simdMatchesScalar_data();
+    void simdMatchesScalar();
+
+    void ditherWithinOneLsb();
+
+};
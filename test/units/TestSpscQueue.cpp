@@ -0,0 +1,83 @@
+#include "units/TestSpscQueue.hpp"
+
+#include "utils/SpscQueue.hpp"
+
+#include <thread>
+
+
+TestSpscQueue::TestSpscQueue() {
+
+}
+
+void TestSpscQueue::emptyAndFull() {
+    SpscQueue<int, 4> queue;
+    int item = 0;
+
+    QVERIFY(queue.isEmpty());
+    QVERIFY(!queue.pop(item));
+
+    for (int i = 0; i < 4; ++i) {
+        QVERIFY(queue.push(i));
+    }
+    QVERIFY(!queue.isEmpty());
+    // full, push should fail
+    QVERIFY(!queue.push(4));
+
+    QVERIFY(queue.pop(item));
+    QCOMPARE(item, 0);
+    // room for one more
+    QVERIFY(queue.push(4));
+    QVERIFY(!queue.push(5));
+}
+
+void TestSpscQueue::order() {
+    SpscQueue<int, 8> queue;
+
+    // push/pop enough times to wrap around the buffer
+    int expected = 0;
+    int next = 0;
+    for (int round = 0; round < 10; ++round) {
+        for (int i = 0; i < 5; ++i) {
+            QVERIFY(queue.push(next++));
+        }
+        int item;
+        while (queue.pop(item)) {
+            QCOMPARE(item, expected);
+            ++expected;
+        }
+    }
+    QCOMPARE(expected, next);
+}
+
+void TestSpscQueue::threaded() {
+    constexpr int COUNT = 100000;
+    SpscQueue<int, 64> queue;
+
+    std::thread producer([&queue]() {
+        for (int i = 0; i < COUNT; ) {
+            if (queue.push(i)) {
+                ++i;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    int expected = 0;
+    bool inOrder = true;
+    while (expected < COUNT) {
+        int item;
+        if (queue.pop(item)) {
+            if (item != expected) {
+                inOrder = false;
+            }
+            ++expected;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+
+    QVERIFY(inOrder);
+    QVERIFY(queue.isEmpty());
+}
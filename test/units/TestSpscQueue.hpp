@@ -0,0 +1,21 @@
+#pragma once
+
+#include <QtTest/QtTest>
+
+class TestSpscQueue : public QObject {
+
+    Q_OBJECT
+
+public:
+
+    Q_INVOKABLE TestSpscQueue();
+
+private slots:
+
+    void emptyAndFull();
+
+    void order();
+
+    void threaded();
+
+};
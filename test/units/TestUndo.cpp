@@ -0,0 +1,231 @@
+#include "units/TestUndo.hpp"
+
+#include "core/Module.hpp"
+#include "model/commands/undo.hpp"
+
+#include "trackerboy/note.hpp"
+
+#include <array>
+#include <functional>
+#include <vector>
+
+#define TU TestUndoTU
+namespace TU {
+
+constexpr int PATTERN_SIZE = 64;
+
+using Tracks = std::array<trackerboy::Track, 4>;
+
+//
+// Sample data for the pattern, so that deltas are not just the edited rows
+//
+static Tracks sampleTracks() {
+    Tracks tracks{
+        trackerboy::Track(PATTERN_SIZE),
+        trackerboy::Track(PATTERN_SIZE),
+        trackerboy::Track(PATTERN_SIZE),
+        trackerboy::Track(PATTERN_SIZE)
+    };
+    for (int row = 0; row < PATTERN_SIZE; row += 4) {
+        tracks[0].setNote(row, trackerboy::NOTE_C + trackerboy::OCTAVE_4);
+        tracks[0].setInstrument(row, 0);
+        tracks[3].setNote(row + 2, trackerboy::NOTE_G + trackerboy::OCTAVE_6);
+        tracks[3].setInstrument(row + 2, 1);
+        tracks[3].setEffect(row + 2, 0, trackerboy::EffectType::delayedNote, 3);
+    }
+    return tracks;
+}
+
+static trackerboy::Pattern patternOf(Tracks &tracks) {
+    return { tracks[0], tracks[1], tracks[2], tracks[3] };
+}
+
+static PatternSelection fullRows(int rowStart, int trackStart, int rowEnd, int trackEnd) {
+    return PatternSelection(
+        PatternAnchor(rowStart, 0, trackStart),
+        PatternAnchor(rowEnd, PatternAnchor::MAX_SELECTS - 1, trackEnd)
+    );
+}
+
+//
+// Records the edit as a delta, then checks that applying the delta restores
+// the original rows and applying it again restores the edited ones.
+//
+static void roundTrip(
+    PatternSelection const& region,
+    std::function<void(Tracks&)> const& edit,
+    size_t maxSize = (size_t)-1
+) {
+    auto const original = sampleTracks();
+    auto tracks = original;
+    auto pattern = patternOf(tracks);
+
+    PatternDelta delta;
+    QVERIFY(!delta.isRecorded());
+    delta.begin(pattern, region);
+    edit(tracks);
+    delta.end(pattern);
+    QVERIFY(delta.isRecorded());
+    QVERIFY(delta.size() <= maxSize);
+
+    auto const edited = tracks;
+    QVERIFY(edited != original);
+
+    // undo
+    delta.apply(pattern);
+    QVERIFY(tracks == original);
+
+    // redo
+    delta.apply(pattern);
+    QVERIFY(tracks == edited);
+}
+
+class TestCmd : public UndoCmd {
+
+public:
+    TestCmd(Module &mod, size_t dataSize, int &undos) :
+        UndoCmd(mod),
+        mDataSize(dataSize),
+        mUndos(undos)
+    {
+        updateSize();
+    }
+
+protected:
+
+    void redoImpl() override {
+    }
+
+    void undoImpl() override {
+        ++mUndos;
+    }
+
+    size_t dataSize() const override {
+        return mDataSize;
+    }
+
+    void release() override {
+        mDataSize = 0;
+    }
+
+private:
+    size_t mDataSize;
+    int &mUndos;
+
+};
+
+}
+
+
+TestUndo::TestUndo() {
+
+}
+
+void TestUndo::deltaSparse() {
+    // two single byte changes, far apart in a region spanning every track
+    TU::roundTrip(
+        TU::fullRows(0, 0, TU::PATTERN_SIZE - 1, 3),
+        [](TU::Tracks &tracks) {
+            tracks[0][2].note = trackerboy::NOTE_E + trackerboy::OCTAVE_3;
+            tracks[3][60].effects[2].param = 0x12;
+        },
+        16
+    );
+}
+
+void TestUndo::deltaDense() {
+    // every row in the region changed, region starts and ends mid-pattern
+    TU::roundTrip(
+        TU::fullRows(16, 1, 39, 3),
+        [](TU::Tracks &tracks) {
+            for (int track = 1; track <= 3; ++track) {
+                for (int row = 16; row <= 39; ++row) {
+                    auto &rowdata = tracks[track][row];
+                    rowdata.note = (uint8_t)(row + 1);
+                    rowdata.instrumentId ^= 0x3;
+                    rowdata.effects[0].type = trackerboy::EffectType::arpeggio;
+                    rowdata.effects[1].param = (uint8_t)(track * row);
+                }
+            }
+        }
+    );
+}
+
+void TestUndo::deltaTrailingZeros() {
+    // only the first byte changes, the rest of the region is implied
+    TU::roundTrip(
+        TU::fullRows(0, 0, TU::PATTERN_SIZE - 1, 3),
+        [](TU::Tracks &tracks) {
+            tracks[0][0].note = trackerboy::NOTE_D + trackerboy::OCTAVE_5;
+        },
+        8
+    );
+}
+
+void TestUndo::deltaShortGaps() {
+    // a row is packed as note, instrument then type and param of each effect
+    TU::roundTrip(
+        TU::fullRows(0, 2, 15, 3),
+        [](TU::Tracks &tracks) {
+            auto &row = tracks[2][5];
+            // 2 byte gap (instrument, effect 1 type), kept as literals
+            row.note = trackerboy::NOTE_A + trackerboy::OCTAVE_4;
+            row.effects[0].param = 0x44;
+            // 3 byte gap (effect 2, effect 3 type), starts a new run
+            row.effects[2].param = 0x55;
+            // 1 byte gap across the row boundary (note of the next row)
+            tracks[2][6].instrumentId = 0x20;
+            // adjacent bytes across the track boundary
+            tracks[2][15].effects[2].param = 0x66;
+            tracks[3][0].note = trackerboy::NOTE_B + trackerboy::OCTAVE_2;
+        }
+    );
+}
+
+void TestUndo::trim() {
+    Module mod;
+    auto budget = mod.undoBudget();
+    QVERIFY(budget);
+    auto const target = budget->limit() / 4 * 3;
+    auto const cmdSize = budget->limit() / 8;
+
+    // a standalone stack, so that trim is only called when we want to
+    QUndoStack stack;
+    int undos = 0;
+    std::vector<TU::TestCmd*> cmds;
+    for (int i = 0; i < 10; ++i) {
+        auto cmd = new TU::TestCmd(mod, cmdSize, undos);
+        cmds.push_back(cmd);
+        stack.push(cmd);
+    }
+    QVERIFY(budget->isExceeded());
+
+    UndoCmd::trim(stack, *budget);
+    QVERIFY(budget->used() <= target);
+
+    // the oldest commands were evicted, just enough to get under the target
+    int evicted = 0;
+    while (evicted < (int)cmds.size() && cmds[evicted]->isEvicted()) {
+        QCOMPARE(cmds[evicted]->size(), UndoCmd::OVERHEAD);
+        ++evicted;
+    }
+    QCOMPARE(evicted, 5);
+    for (int i = evicted; i < (int)cmds.size(); ++i) {
+        QVERIFY(!cmds[i]->isEvicted());
+        QCOMPARE(cmds[i]->size(), UndoCmd::OVERHEAD + cmdSize);
+    }
+
+    // under budget, nothing more is evicted
+    UndoCmd::trim(stack, *budget);
+    QVERIFY(!cmds[evicted]->isEvicted());
+
+    // only the kept commands can be undone, evicted ones are removed
+    while (stack.canUndo()) {
+        stack.undo();
+    }
+    QCOMPARE(undos, 5);
+    QCOMPARE(stack.count(), 5);
+    QCOMPARE(budget->used(), 5 * (UndoCmd::OVERHEAD + cmdSize));
+}
+
+#undef TU
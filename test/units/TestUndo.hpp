@@ -0,0 +1,25 @@
+#pragma once
+
+#include <QtTest/QtTest>
+
+class TestUndo : public QObject {
+
+    Q_OBJECT
+
+public:
+
+    Q_INVOKABLE TestUndo();
+
+private slots:
+
+    void deltaSparse();
+
+    void deltaDense();
+
+    void deltaTrailingZeros();
+
+    void deltaShortGaps();
+
+    void trim();
+
+};
@@ -0,0 +1,88 @@
+#include "units/TestVisualizerBuffer.hpp"
+
+#include "audio/VisualizerBuffer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+TestVisualizerBuffer::TestVisualizerBuffer() {
+
+}
+
+void TestVisualizerBuffer::empty() {
+    VisualizerBuffer buffer;
+    std::vector<float> samples;
+    QCOMPARE(buffer.read(samples), (size_t)0);
+    QVERIFY(samples.empty());
+
+    // resizing publishes silence
+    buffer.resize(4);
+    QCOMPARE(buffer.read(samples), (size_t)4);
+    QCOMPARE(samples, std::vector<float>(8, 0.0f));
+}
+
+void TestVisualizerBuffer::newestKept() {
+    VisualizerBuffer buffer;
+    buffer.resize(4);
+    std::vector<float> samples;
+
+    float const first[] = { 1, 1, 2, 2, 3, 3 };
+    buffer.beginWrite(3);
+    buffer.write(first, 3);
+    // nothing is visible until the write ends
+    buffer.read(samples);
+    QCOMPARE(samples, std::vector<float>(8, 0.0f));
+    buffer.endWrite();
+    buffer.read(samples);
+    QCOMPARE(samples, std::vector<float>({ 0, 0, 1, 1, 2, 2, 3, 3 }));
+
+    // writing more than the capacity only keeps the newest samples
+    float const second[] = { 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9 };
+    buffer.beginWrite(6);
+    buffer.write(second, 3);
+    buffer.write(second + 6, 3);
+    buffer.endWrite();
+    buffer.read(samples);
+    QCOMPARE(samples, std::vector<float>({ 6, 6, 7, 7, 8, 8, 9, 9 }));
+}
+
+void TestVisualizerBuffer::threaded() {
+    constexpr size_t SIZE = 256;
+    constexpr int WRITES = 50000;
+
+    VisualizerBuffer buffer;
+    buffer.resize(SIZE);
+    std::atomic_bool done(false);
+
+    // every write fills the entire buffer with the same value, so a torn read
+    // would have a mix of values
+    std::thread writer([&]() {
+        std::vector<float> block(SIZE * 2);
+        for (int i = 1; i <= WRITES; ++i) {
+            std::fill(block.begin(), block.end(), (float)i);
+            buffer.beginWrite(SIZE);
+            buffer.write(block.data(), SIZE);
+            buffer.endWrite();
+        }
+        done = true;
+    });
+
+    std::vector<float> samples;
+    bool consistent = true;
+    float last = 0.0f;
+    while (!done) {
+        buffer.read(samples);
+        consistent = consistent && std::all_of(samples.begin(), samples.end(), [&](float s) { return s == samples[0]; });
+        // readers never go back in time
+        consistent = consistent && samples[0] >= last;
+        last = samples[0];
+    }
+    writer.join();
+
+    QVERIFY(consistent);
+    buffer.read(samples);
+    QCOMPARE(samples[0], (float)WRITES);
+}
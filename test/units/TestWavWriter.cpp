@@ -0,0 +1,111 @@
+#include "units/TestWavWriter.hpp"
+
+#include "audio/WavWriter.hpp"
+
+#include <QFile>
+#include <QTemporaryDir>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#define TU TestWavWriterTU
+namespace TU {
+
+// size of the wav header, sample data follows
+static constexpr int HEADER_SIZE = 58;
+static constexpr int FORMAT_TAG_OFFSET = 20;
+static constexpr int BITS_PER_SAMPLE_OFFSET = 34;
+static constexpr int DATA_SIZE_OFFSET = 54;
+
+}
+
+
+TestWavWriter::TestWavWriter() {
+
+}
+
+void TestWavWriter::writesAllSamples() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    auto const filename = dir.filePath(QStringLiteral("test.wav"));
+
+    constexpr int FRAMES = 1000;
+    std::vector<float> samples(FRAMES * 2);
+    for (size_t i = 0; i < samples.size(); ++i) {
+        samples[i] = (float)i / samples.size();
+    }
+
+    {
+        // tiny blocks so that several are written by the I/O thread
+        WavWriter writer(filename.toStdString(), 2, 44100, Wav::Format::float32, false, 64);
+        QVERIFY(writer.good());
+
+        // write in uneven chunks that do not line up with the block size
+        int written = 0;
+        int chunk = 1;
+        while (written < FRAMES) {
+            auto const count = std::min(chunk, FRAMES - written);
+            writer.write(samples.data() + written * 2, count);
+            written += count;
+            chunk = chunk % 13 + 1;
+        }
+        writer.close();
+        QVERIFY(writer.good());
+    }
+
+    QFile file(filename);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    auto const contents = file.readAll();
+    auto const dataSize = (int)(samples.size() * sizeof(float));
+    QCOMPARE(contents.size(), TU::HEADER_SIZE + dataSize);
+
+    uint32_t dataChunkSize;
+    std::memcpy(&dataChunkSize, contents.constData() + TU::DATA_SIZE_OFFSET, sizeof(dataChunkSize));
+    QCOMPARE(dataChunkSize, (uint32_t)dataSize);
+
+    QVERIFY(std::memcmp(contents.constData() + TU::HEADER_SIZE, samples.data(), dataSize) == 0);
+}
+
+void TestWavWriter::pcm16() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    auto const filename = dir.filePath(QStringLiteral("test.wav"));
+
+    float const samples[] = { 0.0f, 1.0f, -1.0f, 0.5f, 2.0f, -2.0f };
+    int16_t const expected[] = { 0, 32767, -32767, 16384, 32767, -32768 };
+
+    {
+        WavWriter writer(filename.toStdString(), 2, 44100, Wav::Format::pcm16);
+        writer.write(samples, 3);
+        writer.close();
+        QVERIFY(writer.good());
+    }
+
+    QFile file(filename);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    auto const contents = file.readAll();
+    QCOMPARE(contents.size(), TU::HEADER_SIZE + (int)sizeof(expected));
+
+    uint16_t formatTag;
+    std::memcpy(&formatTag, contents.constData() + TU::FORMAT_TAG_OFFSET, sizeof(formatTag));
+    QCOMPARE(formatTag, (uint16_t)1);
+    uint16_t bitsPerSample;
+    std::memcpy(&bitsPerSample, contents.constData() + TU::BITS_PER_SAMPLE_OFFSET, sizeof(bitsPerSample));
+    QCOMPARE(bitsPerSample, (uint16_t)16);
+
+    QVERIFY(std::memcmp(contents.constData() + TU::HEADER_SIZE, expected, sizeof(expected)) == 0);
+}
+
+void TestWavWriter::openFailure() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    // the directory does not exist, so the file cannot be created
+    auto const filename = dir.filePath(QStringLiteral("missing/test.wav"));
+
+    WavWriter writer(filename.toStdString(), 2, 44100);
+    QVERIFY(!writer.good());
+}
+
+#undef TU
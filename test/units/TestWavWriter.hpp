@@ -0,0 +1,21 @@
+#pragma once
+
+#include <QtTest/QtTest>
+
+class TestWavWriter : public QObject {
+
+    Q_OBJECT
+
+public:
+
+    Q_INVOKABLE TestWavWriter();
+
+private slots:
+
+    void writesAllSamples();
+
+    void pcm16();
+
+    void openFailure();
+
+};